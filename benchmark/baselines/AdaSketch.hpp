@@ -2,40 +2,41 @@
 
 #include <algorithm>
 #include <bit>
+#include <compare>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
-#include <random>
+#include <optional>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
 
 #include "../../src/utils/hash.hpp"
 #include "../../src/utils/memory.hpp"
-#include "../../src/utils/time.hpp"
+#include "../../src/utils/random.hpp"
+#include "../../src/utils/stats.hpp"
 
 template <typename F>
   requires std::is_invocable_r_v<float, F, uint32_t>
 struct AdaSketchOptions {
   F f;
+  // The seed of the row hashes, drawn from `std::random_device` if unset
+  std::optional<uint64_t> seed = std::nullopt;
 };
 
-template <typename T, typename F>
+template <typename T, typename F, typename Stats = NoStats>
   requires std::is_invocable_r_v<float, F, uint32_t>
 class AdaSketch {
 public:
-  explicit AdaSketch(size_t size, const AdaSketchOptions<F> &options)
-      : k_width_(std::bit_ceil(std::max(size / 4, 8UZ))),
-        data_(aligned_alloc<std::remove_pointer_t<decltype(data_)>>(4 * k_width_)),
-        k_f_(options.f) {
-    if (!data_)
-      throw std::bad_alloc();
-
-    for (size_t i = 0; i < 4 * k_width_; i++)
-      data_[i] = 0;
+  explicit AdaSketch(const size_t size, const AdaSketchOptions<F> &options)
+      : AdaSketch(options, std::bit_ceil(std::max(size / 4, 8UZ))) {}
 
-    std::mt19937 gen{std::random_device{}()};
-    for (auto &seed : seeds_)
-      seed = gen();
-  }
+  /**
+   * @brief Construct a sketch that occupies at most `budget` in total (see `footprint_bytes()`),
+   * using the widest rows that fit instead of rounding the width to a power of two.
+   */
+  explicit AdaSketch(const MemoryBudget budget, const AdaSketchOptions<F> &options)
+      : AdaSketch(options, width_for(budget)) {}
 
   ~AdaSketch() { cleanup(); }
 
@@ -111,51 +112,87 @@ public:
     return *this;
   }
 
-  void update(const T &item) {
-    const auto start = get_current_time_in_seconds();
+  void update(const T &item) { update(item, 1.0F); }
 
-    const auto increment = k_f_(++t_);
+  /**
+   * @brief Update `item` by `weight` (non-negative) units at once.
+   */
+  void update(const T &item, const float weight) {
+    [[maybe_unused]] const auto scope = stats_.measure(SketchOp::UPDATE);
 
-    size_t index = hash(item) % k_width_;
-    for (size_t i = 0; i < 4; i++) {
-      if (i > 0)
-        index = alt_index(index, seeds_[i]);
-      const size_t pos = i * k_width_ + index;
-      data_[pos] += increment;
-    }
+    size_t positions[4];
+    locate(item, positions);
+    update_counters(positions, weight);
+  }
 
-    total_update_time_seconds_ += get_current_time_in_seconds() - start;
-    update_count_++;
+  /**
+   * @brief Update `item` by `weight` and return its estimate after the update.
+   *
+   * Counted as an update by the stats policy.
+   */
+  auto update_and_estimate(const T &item, const float weight = 1.0F) -> float {
+    [[maybe_unused]] const auto scope = stats_.measure(SketchOp::UPDATE);
+
+    size_t positions[4];
+    locate(item, positions);
+    update_counters(positions, weight);
+    const auto res = min_counter(positions) / k_f_(t_);
+
+    return res;
   }
 
   [[nodiscard]] auto estimate(const T &item) const -> float {
-    const auto start = get_current_time_in_seconds();
+    [[maybe_unused]] const auto scope = stats_.measure(SketchOp::ESTIMATE);
 
-    auto res = std::numeric_limits<std::remove_pointer_t<decltype(data_)>>::max();
-    size_t index = hash(item) % k_width_;
+    size_t positions[4];
+    locate(item, positions);
+    const auto res = min_counter(positions) / k_f_(t_);
+
+    return res;
+  }
+
+  /**
+   * @brief Compare the estimates of `a` and `b`, probing the counters of both items at once.
+   *
+   * Counted as a single estimate by the stats policy.
+   */
+  [[nodiscard]] auto compare(const T &a, const T &b) const -> std::partial_ordering {
+    [[maybe_unused]] const auto scope = stats_.measure(SketchOp::ESTIMATE);
+
+    size_t positions_a[4];
+    size_t positions_b[4];
+    locate(a, positions_a);
+    locate(b, positions_b);
     for (size_t i = 0; i < 4; i++) {
-      if (i > 0)
-        index = alt_index(index, seeds_[i]);
-      const size_t pos = i * k_width_ + index;
-      res = std::min(res, data_[pos] / k_f_(t_));
+      prefetch(&data_[positions_a[i]]);
+      prefetch(&data_[positions_b[i]]);
     }
-
-    total_estimate_time_seconds_ += get_current_time_in_seconds() - start;
-    estimate_count_++;
+    const auto res = min_counter(positions_a) <=> min_counter(positions_b);
 
     return res;
   }
 
-  /* Benchmark start */
+  /**
+   * @brief The number of bytes occupied by the sketch, including the counter rows.
+   */
+  [[nodiscard]] auto footprint_bytes() const noexcept -> size_t {
+    return sizeof(*this) + 4 * k_width_ * sizeof(std::remove_pointer_t<decltype(data_)>);
+  }
+
+  [[nodiscard]] auto op_stats() const noexcept -> const Stats & { return stats_; }
+
   [[nodiscard]] auto update_time_avg_seconds() const -> double {
-    return total_update_time_seconds_ / update_count_;
+    return stats_.avg_seconds(SketchOp::UPDATE);
   }
   [[nodiscard]] auto estimate_time_avg_seconds() const -> double {
-    return total_estimate_time_seconds_ / estimate_count_;
+    return stats_.avg_seconds(SketchOp::ESTIMATE);
   }
-  /* Benchmark end */
 
 private:
+  // Restart the clock before `f` overflows floats, leaving room for counters to sum up many such
+  // increments, which does not change any estimate as long as `f(a + b) == f(a) * f(b)`
+  static constexpr float RESTART_THRESHOLD = 1e30F;
+
   size_t k_width_;
 
   float *data_;
@@ -164,12 +201,31 @@ private:
   uint32_t t_ = 0;
   F k_f_;
 
-  /* Benchmark start */
-  mutable size_t update_count_ = 0;
-  mutable double total_update_time_seconds_ = 0.0;
-  mutable size_t estimate_count_ = 0;
-  mutable double total_estimate_time_seconds_ = 0.0;
-  /* Benchmark end */
+  [[no_unique_address]] Stats stats_;
+
+  // Shared by the public constructors, which only differ in how they pick the width
+  AdaSketch(const AdaSketchOptions<F> &options, const size_t width)
+      : k_width_(width),
+        data_(aligned_alloc<std::remove_pointer_t<decltype(data_)>>(4 * k_width_)),
+        k_f_(options.f) {
+    if (!data_)
+      throw std::bad_alloc();
+
+    for (size_t i = 0; i < 4 * k_width_; i++)
+      data_[i] = 0;
+
+    auto gen = make_random_engine(options.seed);
+    for (auto &seed : seeds_)
+      seed = gen();
+  }
+
+  [[nodiscard]] static auto width_for(const MemoryBudget budget) -> size_t {
+    constexpr size_t row_bytes = sizeof(std::remove_pointer_t<decltype(data_)>);
+    if (budget.bytes < sizeof(AdaSketch) + 4 * row_bytes)
+      throw std::invalid_argument("Memory budget of " + std::to_string(budget.bytes) +
+                                  " bytes is too small for a sketch");
+    return (budget.bytes - sizeof(AdaSketch)) / (4 * row_bytes);
+  }
 
   void cleanup() {
     if (data_) {
@@ -178,9 +234,40 @@ private:
     }
   }
 
-  [[nodiscard]] auto alt_index(const size_t index, const size_t seed) const -> size_t {
-    // A quick and dirty way to generate an alternative index
-    // 0x5bd1e995 is the hash constant from MurmurHash2
-    return (index ^ (seed * 0x5bd1e995)) % k_width_;
+  void locate(const T &item, size_t (&positions)[4]) const {
+    const size_t h = hash(item);
+    for (size_t i = 0; i < 4; i++)
+      positions[i] = i * k_width_ + fastrange(row_hash(h, seeds_[i]), k_width_);
+  }
+
+  [[nodiscard]] auto min_counter(const size_t (&positions)[4]) const -> float {
+    auto res = std::numeric_limits<std::remove_pointer_t<decltype(data_)>>::max();
+    for (const size_t pos : positions)
+      res = std::min(res, data_[pos]);
+    return res;
+  }
+
+  void update_counters(const size_t (&positions)[4], const float weight) {
+    auto d = k_f_(++t_);
+    if (d > RESTART_THRESHOLD) {
+      t_--;
+      restart();
+      ++t_;
+      d = k_f_(t_);
+    }
+    const auto increment = weight * d;
+    for (const size_t pos : positions)
+      data_[pos] += increment;
+  }
+
+  /**
+   * @brief Scale the counters down to the current time and restart the clock from 0, where `f(0)`
+   * must be 1.
+   */
+  void restart() {
+    const auto d = k_f_(t_);
+    for (size_t i = 0; i < 4 * k_width_; i++)
+      data_[i] /= d;
+    t_ = 0;
   }
 };
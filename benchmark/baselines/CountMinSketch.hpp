@@ -3,30 +3,42 @@
 #include <algorithm>
 #include <bit>
 #include <cmath>
+#include <compare>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
-#include <random>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
 
 #include "../../src/utils/hash.hpp"
 #include "../../src/utils/memory.hpp"
-#include "../../src/utils/time.hpp"
+#include "../../src/utils/random.hpp"
+#include "../../src/utils/stats.hpp"
 
-template <typename T> class CountMinSketch {
+template <typename T, typename Stats = NoStats> class CountMinSketch {
 public:
-  explicit CountMinSketch(const size_t size)
+  /**
+   * @brief Construct a sketch of about `size` bytes, whose row hashes are seeded with `seed` (or
+   * from `std::random_device` if unset).
+   */
+  explicit CountMinSketch(const size_t size, const std::optional<uint64_t> seed = std::nullopt)
       : k_width_(std::bit_ceil(std::max(size / 4, 8UZ))),
         data_(aligned_alloc<std::remove_pointer_t<decltype(data_)>>(4 * k_width_)) {
-    if (!data_)
-      throw std::bad_alloc();
-
-    for (size_t i = 0; i < 4 * k_width_; i++)
-      data_[i] = 0;
+    init(seed);
+  }
 
-    std::mt19937 gen{std::random_device{}()};
-    for (auto &seed : seeds_)
-      seed = gen();
+  /**
+   * @brief Construct a sketch that occupies at most `budget` in total (see `footprint_bytes()`),
+   * using the widest rows that fit instead of rounding the width to a power of two.
+   */
+  explicit CountMinSketch(const MemoryBudget budget,
+                          const std::optional<uint64_t> seed = std::nullopt)
+      : k_width_(width_for(budget)),
+        data_(aligned_alloc<std::remove_pointer_t<decltype(data_)>>(4 * k_width_)) {
+    init(seed);
   }
 
   ~CountMinSketch() { cleanup(); }
@@ -98,46 +110,99 @@ public:
   }
 
   void update(const T &item) {
-    const auto start = get_current_time_in_seconds();
+    [[maybe_unused]] const auto scope = stats_.measure(SketchOp::UPDATE);
 
-    size_t index = hash(item) % k_width_;
-    for (size_t i = 0; i < 4; i++) {
-      if (i > 0)
-        index = alt_index(index, seeds_[i]);
-      const size_t pos = i * k_width_ + index;
-      data_[pos]++;
-    }
+    constexpr auto max = std::numeric_limits<std::remove_pointer_t<decltype(data_)>>::max();
+
+    size_t positions[4];
+    locate(item, positions);
+    // Saturate like the weighted update rather than wrapping around to zero
+    for (const size_t pos : positions)
+      data_[pos] += data_[pos] != max;
+  }
 
-    total_update_time_seconds_ += get_current_time_in_seconds() - start;
-    update_count_++;
+  /**
+   * @brief Update `item` by `weight` (non-negative) units at once, rounded to the nearest integer.
+   * Counters saturate instead of wrapping around, as byte-weighted counts can easily exceed 2^32.
+   */
+  void update(const T &item, const float weight) {
+    [[maybe_unused]] const auto scope = stats_.measure(SketchOp::UPDATE);
+
+    constexpr auto max = std::numeric_limits<std::remove_pointer_t<decltype(data_)>>::max();
+    const auto increment = static_cast<uint32_t>(
+        std::min(std::round(static_cast<double>(weight)), static_cast<double>(max)));
+
+    size_t positions[4];
+    locate(item, positions);
+    for (const size_t pos : positions)
+      data_[pos] = data_[pos] > max - increment ? max : data_[pos] + increment;
+  }
+
+  /**
+   * @brief Update `item` by one and return its estimate after the update.
+   *
+   * Counted as an update by the stats policy.
+   */
+  auto update_and_estimate(const T &item) -> uint32_t {
+    [[maybe_unused]] const auto scope = stats_.measure(SketchOp::UPDATE);
+
+    constexpr auto max = std::numeric_limits<std::remove_pointer_t<decltype(data_)>>::max();
+
+    size_t positions[4];
+    locate(item, positions);
+    for (const size_t pos : positions)
+      data_[pos] += data_[pos] != max;
+    const auto res = min_counter(positions);
+
+    return res;
   }
 
   [[nodiscard]] auto estimate(const T &item) const -> uint32_t {
-    const auto start = get_current_time_in_seconds();
+    [[maybe_unused]] const auto scope = stats_.measure(SketchOp::ESTIMATE);
 
-    auto res = std::numeric_limits<std::remove_pointer_t<decltype(data_)>>::max();
-    size_t index = hash(item) % k_width_;
+    size_t positions[4];
+    locate(item, positions);
+    const auto res = min_counter(positions);
+
+    return res;
+  }
+
+  /**
+   * @brief Compare the estimates of `a` and `b`, probing the counters of both items at once.
+   *
+   * Counted as a single estimate by the stats policy.
+   */
+  [[nodiscard]] auto compare(const T &a, const T &b) const -> std::strong_ordering {
+    [[maybe_unused]] const auto scope = stats_.measure(SketchOp::ESTIMATE);
+
+    size_t positions_a[4];
+    size_t positions_b[4];
+    locate(a, positions_a);
+    locate(b, positions_b);
     for (size_t i = 0; i < 4; i++) {
-      if (i > 0)
-        index = alt_index(index, seeds_[i]);
-      const size_t pos = i * k_width_ + index;
-      res = std::min(res, data_[pos]);
+      prefetch(&data_[positions_a[i]]);
+      prefetch(&data_[positions_b[i]]);
     }
-
-    total_estimate_time_seconds_ += get_current_time_in_seconds() - start;
-    estimate_count_++;
+    const auto res = min_counter(positions_a) <=> min_counter(positions_b);
 
     return res;
   }
 
-  /* Benchmark start */
+  /**
+   * @brief The number of bytes occupied by the sketch, including the counter rows.
+   */
+  [[nodiscard]] auto footprint_bytes() const noexcept -> size_t {
+    return sizeof(*this) + 4 * k_width_ * sizeof(std::remove_pointer_t<decltype(data_)>);
+  }
+
+  [[nodiscard]] auto op_stats() const noexcept -> const Stats & { return stats_; }
+
   [[nodiscard]] auto update_time_avg_seconds() const -> double {
-    return total_update_time_seconds_ / update_count_;
+    return stats_.avg_seconds(SketchOp::UPDATE);
   }
   [[nodiscard]] auto estimate_time_avg_seconds() const -> double {
-    return total_estimate_time_seconds_ / estimate_count_;
+    return stats_.avg_seconds(SketchOp::ESTIMATE);
   }
-  /* Benchmark end */
 
 private:
   size_t k_width_;
@@ -145,12 +210,27 @@ private:
   uint32_t *data_;
   size_t seeds_[4];
 
-  /* Benchmark start */
-  mutable size_t update_count_ = 0;
-  mutable double total_update_time_seconds_ = 0.0;
-  mutable size_t estimate_count_ = 0;
-  mutable double total_estimate_time_seconds_ = 0.0;
-  /* Benchmark end */
+  [[no_unique_address]] Stats stats_;
+
+  [[nodiscard]] static auto width_for(const MemoryBudget budget) -> size_t {
+    constexpr size_t row_bytes = sizeof(std::remove_pointer_t<decltype(data_)>);
+    if (budget.bytes < sizeof(CountMinSketch) + 4 * row_bytes)
+      throw std::invalid_argument("Memory budget of " + std::to_string(budget.bytes) +
+                                  " bytes is too small for a sketch");
+    return (budget.bytes - sizeof(CountMinSketch)) / (4 * row_bytes);
+  }
+
+  void init(const std::optional<uint64_t> seed) {
+    if (!data_)
+      throw std::bad_alloc();
+
+    for (size_t i = 0; i < 4 * k_width_; i++)
+      data_[i] = 0;
+
+    auto gen = make_random_engine(seed);
+    for (auto &row_seed : seeds_)
+      row_seed = gen();
+  }
 
   void cleanup() {
     if (data_) {
@@ -159,9 +239,16 @@ private:
     }
   }
 
-  [[nodiscard]] auto alt_index(const size_t index, const size_t seed) const -> size_t {
-    // A quick and dirty way to generate an alternative index
-    // 0x5bd1e995 is the hash constant from MurmurHash2
-    return (index ^ (seed * 0x5bd1e995)) % k_width_;
+  void locate(const T &item, size_t (&positions)[4]) const {
+    const size_t h = hash(item);
+    for (size_t i = 0; i < 4; i++)
+      positions[i] = i * k_width_ + fastrange(row_hash(h, seeds_[i]), k_width_);
+  }
+
+  [[nodiscard]] auto min_counter(const size_t (&positions)[4]) const -> uint32_t {
+    auto res = std::numeric_limits<std::remove_pointer_t<decltype(data_)>>::max();
+    for (const size_t pos : positions)
+      res = std::min(res, data_[pos]);
+    return res;
   }
 };
@@ -1,10 +1,21 @@
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <exception>
 #include <format>
+#include <filesystem>
 #include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
 #include <mutex>
+#include <optional>
 #include <print>
+#include <random>
+#include <set>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -12,18 +23,517 @@
 #include <tuple>
 #include <unordered_map>
 #include <utility>
-#include <variant>
 #include <vector>
 
 #include <argparse/argparse.hpp>
 #include <fplus/fplus.hpp>
+#include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
 #include <tabulate/table.hpp>
 
 #include "caching/reader.hpp"
 #include "hm/reader.hpp"
 #include "utils/benchmark.hpp"
+#include "utils/concurrent.hpp"
 #include "utils/errors.hpp"
+#include "utils/records.hpp"
+#include "utils/results.hpp"
+#include "utils/statistics.hpp"
+#include "utils/sweep.hpp"
+
+using ResultMap = std::unordered_map<std::string, std::unordered_map<std::string, double>>;
+// Results of each repetition by alpha, then name
+using SampleMap =
+    std::unordered_map<std::string, std::unordered_map<std::string, std::vector<double>>>;
+
+// How much slower packed shards may be than padded ones before it is reported as false sharing
+inline constexpr double FALSE_SHARING_TOLERANCE = 0.1;
+
+/**
+ * @brief Print `table` right-aligned with a rule under its header row, the way all results are
+ * printed.
+ */
+void print_table(tabulate::Table &table) {
+  table.format()
+      .font_align(tabulate::FontAlign::right)
+      .corner(" ")
+      .border_top(" ")
+      .border_bottom(" ")
+      .border_left(" ")
+      .border_right(" ");
+  table[1].format().corner("-").border_top("-");
+  std::ostringstream oss;
+  oss << table;
+  std::istringstream iss{oss.str()};
+  std::string output;
+  std::string line;
+  while (std::getline(iss, line))
+    if (line.find_first_not_of(' ') != std::string::npos)
+      output += line + "\n";
+  std::println("{}", output);
+}
+
+/**
+ * @brief Add the `--results` option, which appends every result to a JSON lines file (see
+ * `ResultStore`).
+ */
+void add_results_argument(argparse::ArgumentParser &program) {
+  program.add_argument("--results")
+      .help("Append every result with the metadata of the run to this file (as JSON lines), e.g., "
+            "to `compare` runs later")
+      .default_value("");
+}
+
+/**
+ * @brief Add the `--seed` and `--repeat` options of benchmarks whose sketches and adapters are
+ * randomized.
+ */
+void add_repeat_arguments(argparse::ArgumentParser &program) {
+  program.add_argument("--seed")
+      .help("The seed of the first repetition, the next ones using the following seeds (drawn at "
+            "random and logged if unset)")
+      .scan<'u', uint64_t>();
+  program.add_argument("--repeat")
+      .help("The number of repetitions of each run, which are reported as their mean and 95% "
+            "confidence interval")
+      .default_value(size_t{1})
+      .scan<'u', size_t>();
+}
+
+/**
+ * @brief Add the `--in-process`, `--fan-out` and `--workers` options of benchmarks whose tasks
+ * replay a trace.
+ */
+void add_in_process_arguments(argparse::ArgumentParser &program) {
+  program.add_argument("--in-process")
+      .help("Run tasks as functions on a pool of threads in one process, which decodes the trace "
+            "once for all of them, rather than in a process each")
+      .flag();
+  program.add_argument("--fan-out")
+      .help("Run tasks as with --in-process, but replay the trace once for all of them, handing "
+            "each chunk of it to every task in turn")
+      .flag();
+  program.add_argument("--workers")
+      .help("The threads of --in-process (0 for one per physical core with --parallel, and one "
+            "without)")
+      .default_value(size_t{0})
+      .scan<'u', size_t>();
+}
+
+/**
+ * @brief Add the `--jobs` and `--memory-budget` options that bound what `--parallel` runs at once.
+ */
+void add_scheduler_arguments(argparse::ArgumentParser &program) {
+  program.add_argument("-j", "--jobs")
+      .help("The tasks that --parallel runs at once, each pinned to a core of its own (0 for one "
+            "per physical core), not with --in-process or --fan-out")
+      .default_value(size_t{0})
+      .scan<'u', size_t>();
+  program.add_argument("--memory-budget")
+      .help("The bytes that tasks running at once may be estimated to use in total, counting "
+            "their shared trace once (0 for the available memory), not with --in-process or "
+            "--fan-out")
+      .default_value(size_t{0})
+      .scan<'u', size_t>();
+}
+
+/**
+ * @brief Reject `--jobs` and `--memory-budget` with `--in-process` or `--fan-out`, whose tasks run
+ * on the threads of one process (see `--workers`) rather than through the scheduler they bound.
+ */
+void check_scheduler_arguments(const argparse::ArgumentParser &program) {
+  if ((program.get<bool>("--in-process") || program.get<bool>("--fan-out")) &&
+      (program.is_used("--jobs") || program.is_used("--memory-budget")))
+    throw std::invalid_argument(
+        "--jobs and --memory-budget do not apply to --in-process or --fan-out (see --workers)");
+}
+
+// What a task is estimated to use besides its trace, per object that fits in the cache (i.e., the
+// cache index, the policy metadata and the sketch counters), and regardless of the cache size
+inline constexpr size_t TASK_BYTES_PER_CACHED_OBJECT = 192;
+inline constexpr size_t TASK_BASE_BYTES = size_t{16} << 20;
+
+/**
+ * @brief The memory of its own that a task replaying a trace with a cache of `cache_size` objects
+ * is estimated to use.
+ */
+auto estimate_task_bytes(const size_t cache_size) -> size_t {
+  return cache_size * TASK_BYTES_PER_CACHED_OBJECT + TASK_BASE_BYTES;
+}
+
+/**
+ * @brief The pages of the trace at `trace_path`, which the tasks replaying it map and thus share
+ * through the page cache.
+ */
+auto estimate_trace_memory(const std::string &trace_path) -> SharedMemoryEstimate {
+  return {.key = trace_path, .bytes = std::filesystem::file_size(trace_path)};
+}
+
+/**
+ * @brief Whether the task `baseline` of the `caching` or `hm` benchmark runs an evolving sketch,
+ * i.e., takes an adaptation interval.
+ */
+auto is_evolving_sketch(const std::string_view baseline) -> bool {
+  return baseline == "EVO" || baseline.ends_with("_EVO") || baseline.ends_with("-EVO") ||
+         baseline.ends_with("_EVO_TIME");
+}
+
+/**
+ * @brief The name of the results of the evolving sketch task `baseline` at `adapt_interval`, e.g.,
+ * "W-TinyLFU_EVO (Ia=10000)". Time-driven variants interpret the interval in seconds.
+ */
+auto evolving_sketch_name(const std::string_view baseline, const std::string_view adapt_interval)
+    -> std::string {
+  return std::format("{} (Ia={}{})", baseline, adapt_interval,
+                     baseline.ends_with("_TIME") ? "s" : "");
+}
+
+/**
+ * @brief The seed of the first repetition, drawn at random without `seed` and logged so that the
+ * run can be reproduced.
+ */
+auto first_seed(const std::optional<uint64_t> seed) -> uint64_t {
+  if (seed)
+    return *seed;
+  std::random_device device;
+  const uint64_t drawn = (static_cast<uint64_t>(device()) << 32) | device();
+  spdlog::info("Seeding repetitions from {} (pass --seed {} to reproduce)", drawn, drawn);
+  return drawn;
+}
+
+/**
+ * @brief The result of `name` at `alpha` in `map`, if it was run.
+ */
+auto find_result(const ResultMap &map, const std::string &alpha, const std::string &name)
+    -> std::optional<double> {
+  if (const auto it = map.find(alpha); it != map.end())
+    if (const auto it2 = it->second.find(name); it2 != it->second.end())
+      return it2->second;
+  return std::nullopt;
+}
+
+/**
+ * @brief Add `value` to the samples of `name` at `alpha`, and update its result in `map` to their
+ * mean.
+ */
+void add_sample(ResultMap &map, SampleMap &samples, const std::string &alpha,
+                const std::string &name, const double value) {
+  auto &values = samples[alpha][name];
+  values.push_back(value);
+  map[alpha][name] = mean(values);
+}
+
+/**
+ * @brief The half-width of the 95% confidence interval of the mean of each result.
+ */
+auto confidence_half_widths(const SampleMap &samples) -> ResultMap {
+  ResultMap half_widths;
+  for (const auto &[alpha, by_name] : samples)
+    for (const auto &[name, values] : by_name)
+      half_widths[alpha][name] = confidence_half_width(values);
+  return half_widths;
+}
+
+/**
+ * @brief A result shown with its confidence interval, see `print_confidence_tables()`.
+ */
+struct ConfidenceColumn {
+  std::string type;   // e.g., "miss_ratio"
+  std::string header; // e.g., "Miss Ratio"
+  // Applied to each sample before averaging, e.g., from seconds per call to MOps
+  std::function<double(double)> transform;
+  std::function<std::string(double)> format;
+};
+
+auto mops_column(const std::string &type, const std::string &header) -> ConfidenceColumn {
+  return {.type = type,
+          .header = header,
+          .transform = [](const double seconds) { return 1.0 / seconds / 1'000'000; },
+          .format = [](const double mops) { return std::format("{:.3f}MOps", mops); }};
+}
+
+/**
+ * @brief Print a table per alpha with the mean and 95% confidence interval of each of `columns`
+ * for each benchmark, over the repetitions in `samples` (by type, e.g., "miss_ratio").
+ */
+void print_confidence_tables(const std::vector<std::string> &alphas,
+                             const std::vector<std::string> &names,
+                             const std::unordered_map<std::string, SampleMap> &samples,
+                             const std::vector<ConfidenceColumn> &columns, const size_t repeat) {
+  auto lookup = [&](const std::string &type, const std::string &alpha,
+                    const std::string &name) -> const std::vector<double> * {
+    if (const auto it = samples.find(type); it != samples.end())
+      if (const auto it2 = it->second.find(alpha); it2 != it->second.end())
+        if (const auto it3 = it2->second.find(name); it3 != it2->second.end())
+          return &it3->second;
+    return nullptr;
+  };
+
+  for (const auto &alpha : alphas) {
+    tabulate::Table table;
+    tabulate::Table::Row_t header{"Benchmark"};
+    for (const auto &column : columns)
+      header.emplace_back(column.header);
+    table.add_row(header);
+    for (const auto &name : names) {
+      tabulate::Table::Row_t row{name};
+      for (const auto &column : columns) {
+        const auto *values = lookup(column.type, alpha, name);
+        if (values == nullptr) {
+          row.emplace_back("N/A");
+          continue;
+        }
+        const auto shown = fplus::transform(column.transform, *values);
+        const double half_width = confidence_half_width(shown);
+        row.emplace_back(std::format("{} ± {}", column.format(mean(shown)),
+                                     std::isnan(half_width) ? "N/A" : column.format(half_width)));
+      }
+      table.add_row(row);
+    }
+    std::println("\nMean ± 95% confidence interval over {} repetitions (α={}):", repeat, alpha);
+    print_table(table);
+  }
+}
+
+/**
+ * @brief Format a number of bytes with the largest binary unit that keeps it at least 1.
+ */
+auto format_bytes(double bytes) -> std::string {
+  constexpr std::array<std::string_view, 5> UNITS = {"B", "KiB", "MiB", "GiB", "TiB"};
+  size_t unit = 0;
+  while (bytes >= 1024.0 && unit + 1 < UNITS.size()) {
+    bytes /= 1024.0;
+    unit++;
+  }
+  return std::format("{:.2f}{}", bytes, UNITS[unit]);
+}
+
+/**
+ * @brief Print a table per alpha with the throughput and latency quantiles of each benchmark next
+ * to each other, skipping alphas for which no latency was recorded.
+ */
+void print_latency_tables(const std::vector<std::string> &alphas,
+                          const std::vector<std::string> &names, const ResultMap &update_avg_times,
+                          const ResultMap &estimate_avg_times,
+                          const std::unordered_map<std::string, ResultMap> &latencies) {
+  for (const auto &alpha : alphas) {
+    tabulate::Table table;
+    tabulate::Table::Row_t header{"Benchmark"};
+    for (const auto op : {"Update", "Estimate"}) {
+      header.emplace_back(std::format("{} MOps", op));
+      for (const auto quantile_name : LATENCY_QUANTILE_NAMES)
+        header.emplace_back(std::format("{} {}", op, quantile_name));
+    }
+    table.add_row(header);
+
+    bool recorded = false;
+    for (const auto &name : names) {
+      tabulate::Table::Row_t row{name};
+      for (const auto op : {SketchOp::UPDATE, SketchOp::ESTIMATE}) {
+        const auto avg = find_result(
+            op == SketchOp::UPDATE ? update_avg_times : estimate_avg_times, alpha, name);
+        row.emplace_back(avg ? std::format("{:.6f}", 1.0 / *avg / 1'000'000) : "N/A");
+        for (const auto &column : latency_columns()) {
+          if (column.op != op)
+            continue;
+          const auto it = latencies.find(column.type);
+          const auto latency =
+              it != latencies.end() ? find_result(it->second, alpha, name) : std::nullopt;
+          recorded = recorded || latency.has_value();
+          row.emplace_back(latency ? std::format("{:.0f}ns", *latency * 1e9) : "N/A");
+        }
+      }
+      table.add_row(row);
+    }
+    if (!recorded)
+      continue;
+
+    std::println("\nLatency (α={}):", alpha);
+    print_table(table);
+  }
+}
+
+/**
+ * @brief The task-specific result of the `caching` or `hm` benchmark, e.g., the miss ratio.
+ */
+struct PrimaryMetric {
+  std::string type;        // e.g., "miss_ratio"
+  std::string header;      // e.g., "Miss Ratio"
+  std::string description; // The title of its table, e.g., "Miss Ratios"
+  // Applied to each result before it is shown, e.g., from a ratio to a percentage
+  std::function<double(double)> transform;
+  std::function<std::string(double)> format;
+};
+
+/**
+ * @brief The names of the results of `tasks` of the `caching` or `hm` benchmark, where evolving
+ * sketches come last with one result per adaptation interval.
+ */
+auto sketch_result_names(const std::vector<std::string> &tasks,
+                         const std::vector<size_t> &adapt_intervals) -> std::vector<std::string> {
+  std::vector<std::string> names;
+  for (const std::string &task : tasks)
+    if (!is_evolving_sketch(task))
+      names.push_back(task);
+  for (const std::string &task : tasks)
+    if (is_evolving_sketch(task))
+      for (const size_t adapt_interval : adapt_intervals)
+        names.push_back(evolving_sketch_name(task, std::to_string(adapt_interval)));
+  return names;
+}
+
+/**
+ * @brief The results of the tasks of the `caching` or `hm` benchmark over their repetitions, which
+ * are reported as their means and 95% confidence intervals.
+ */
+class SketchResults {
+public:
+  explicit SketchResults(PrimaryMetric primary) : primary_(std::move(primary)) {}
+
+  /**
+   * @brief Add the `results` of a task (see `ResultColumn`) to those of `name` at `alpha`, and
+   * describe them for the log, e.g., "(Miss Ratio) 12.345678%, (Update) 9.876543MOps, ...".
+   */
+  auto add(const std::string &alpha, const std::string &name, const std::vector<double> &results)
+      -> std::string {
+    const double primary = result_at(results, ResultColumn::PRIMARY);
+    const double update_avg_s = result_at(results, ResultColumn::UPDATE_AVG_S);
+    const double estimate_avg_s = result_at(results, ResultColumn::ESTIMATE_AVG_S);
+
+    add_sample(means_[primary_.type], samples_[primary_.type], alpha, name, primary);
+    if (update_avg_s != 0.0) {
+      add_sample(means_["update_avg_time_s"], samples_["update_avg_time_s"], alpha, name,
+                 update_avg_s);
+      add_sample(means_["estimate_avg_time_s"], samples_["estimate_avg_time_s"], alpha, name,
+                 estimate_avg_s);
+    }
+    for (const auto &column : latency_columns())
+      if (const double latency = result_at(results, column.column); latency != 0.0)
+        add_sample(means_[column.type], samples_[column.type], alpha, name, latency);
+    for (const auto &column : MEMORY_COLUMNS) {
+      const std::string type(column.type);
+      if (static_cast<size_t>(column.column) < results.size())
+        add_sample(means_[type], samples_[type], alpha, name, result_at(results, column.column));
+    }
+
+    return std::format("({}) {}{}", primary_.header, primary_.format(primary_.transform(primary)),
+                       update_avg_s != 0.0
+                           ? std::format(", (Update) {:.6f}MOps, (Estimate) {:.6f}MOps",
+                                         1.0 / update_avg_s / 1'000'000,
+                                         1.0 / estimate_avg_s / 1'000'000)
+                           : "");
+  }
+
+  /**
+   * @brief Log the results at `alpha` from the best to the worst primary metric.
+   */
+  void log_ranking(const std::string &alpha) {
+    const bool descending = higher_is_better(primary_.type);
+    std::vector<std::pair<std::string_view, double>> sorted(means_[primary_.type][alpha].begin(),
+                                                            means_[primary_.type][alpha].end());
+    std::ranges::sort(sorted, [&](const auto &lhs, const auto &rhs) {
+      return descending ? lhs.second > rhs.second : lhs.second < rhs.second;
+    });
+    spdlog::info("[α={}] Sorted by {} ({}):", alpha, primary_.header,
+                 descending ? "descending" : "ascending");
+    for (const auto &[name, value] : sorted)
+      spdlog::info("[α={}] {}: {}", alpha, name, primary_.format(primary_.transform(value)));
+    std::println();
+  }
+
+  /**
+   * @brief Print the results of `names` at each of `alphas` as tables, and write them to the CSV
+   * file at `output_path` unless it is empty, with their confidence intervals after more than one
+   * repetition.
+   */
+  void report(const std::vector<std::string> &alphas, const std::vector<std::string> &names,
+              const size_t repeat, const std::string &output_path) {
+    // Results by type with the titles of their tables. Latencies are printed together (see
+    // `print_latency_tables()`) and so are confidence intervals (see `print_confidence_tables()`),
+    // but both are saved like other results, the latter as "<type>_ci95" rows
+    std::vector<std::tuple<std::string, std::string, ResultMap>> result_maps = {
+        {primary_.type, primary_.description, means_[primary_.type]},
+        {"update_avg_time_s", "Average Update Time by Seconds", means_["update_avg_time_s"]},
+        {"estimate_avg_time_s", "Average Estimate Time by Seconds", means_["estimate_avg_time_s"]},
+    };
+    for (const auto &column : latency_columns())
+      result_maps.emplace_back(column.type, "", means_[column.type]);
+    for (const auto &column : MEMORY_COLUMNS)
+      result_maps.emplace_back(column.type, column.description, means_[std::string(column.type)]);
+    if (repeat > 1)
+      for (const auto &[type, type_samples] : samples_)
+        result_maps.emplace_back(type + "_ci95", "", confidence_half_widths(type_samples));
+
+    auto format_cell = [&](const std::string &type, const double value) -> std::string {
+      if (type == primary_.type)
+        return primary_.format(primary_.transform(value));
+      if (std::ranges::any_of(MEMORY_COLUMNS,
+                              [&](const auto &column) { return column.type == type; }))
+        return format_bytes(value);
+      return std::format("{:.6f}MOps", 1.0 / value / 1'000'000);
+    };
+
+    // Print results
+    bool first = true;
+    for (const auto &[type, description, map] : result_maps) {
+      if (description.empty())
+        continue;
+      std::println("{}{}:", std::exchange(first, false) ? "" : "\n", description);
+      tabulate::Table table;
+      tabulate::Table::Row_t header{"Alpha"};
+      for (const auto &name : names)
+        header.emplace_back(name);
+      table.add_row(header);
+      for (const auto &alpha : alphas) {
+        tabulate::Table::Row_t row{alpha};
+        for (const auto &name : names) {
+          const auto value = find_result(map, alpha, name);
+          row.emplace_back(value ? format_cell(type, *value) : "N/A");
+        }
+        table.add_row(row);
+      }
+      print_table(table);
+    }
+
+    print_latency_tables(alphas, names, means_["update_avg_time_s"],
+                         means_["estimate_avg_time_s"], means_);
+    if (repeat > 1) {
+      const std::vector<ConfidenceColumn> confidence_columns = {
+          {.type = primary_.type,
+           .header = primary_.header,
+           .transform = primary_.transform,
+           .format = primary_.format},
+          mops_column("update_avg_time_s", "Update"),
+          mops_column("estimate_avg_time_s", "Estimate"),
+      };
+      print_confidence_tables(alphas, names, samples_, confidence_columns, repeat);
+    }
+
+    // Write results to CSV, where results that were not run are "N/A"
+    if (output_path.empty())
+      return;
+    std::ofstream output_file(output_path);
+    if (!output_file.is_open())
+      throw std::runtime_error("Failed to open output file: " + output_path);
+    std::println(output_file, "type,alpha,{}", fplus::join_elem(',', names));
+    for (const auto &[type, _, map] : result_maps)
+      for (const auto &alpha : alphas)
+        std::println(output_file, "{},{},{}", type, alpha,
+                     fplus::join_elem(',', fplus::transform(
+                                               [&](const std::string &name) {
+                                                 const auto value = find_result(map, alpha, name);
+                                                 return value ? std::format("{}", *value) : "N/A";
+                                               },
+                                               names)));
+  }
+
+private:
+  PrimaryMetric primary_;
+  // Means by type (e.g., "update_p99_s"), then alpha, then name
+  std::unordered_map<std::string, ResultMap> means_;
+  // All of the above over the repetitions, by type
+  std::unordered_map<std::string, SampleMap> samples_;
+};
 
 BENCHMARK("caching") {
   argparse::ArgumentParser program;
@@ -41,12 +551,30 @@ BENCHMARK("caching") {
       .default_value(DEFAULT_PARALLEL)
       .implicit_value(true);
   program.add_argument("-o", "--output").help("Output file path (as CSV)").default_value("");
+  program.add_argument("--stats")
+      .help("What sketches record about their operations: 'none', 'counting', 'sampled' (cycles "
+            "of one in 64 calls), or 'full' (cycles of every call, for exact maximum latencies)")
+      .choices("none", "counting", "sampled", "full")
+      .default_value(std::string("sampled"));
+  program.add_argument("--dense-ids")
+      .help("Replay dense object IDs instead of hashed ones in every task (see `benchmark_caching "
+            "--help`), whose results are recorded apart from hashed replays")
+      .flag();
+  add_results_argument(program);
+  add_repeat_arguments(program);
+  add_in_process_arguments(program);
+  add_scheduler_arguments(program);
 
   std::string trace_path;
   double cache_size_ratio;
   std::vector<size_t> adapt_intervals;
   std::vector<std::string> alphas;
   std::string output_path;
+  std::string stats;
+  std::string results_path;
+  bool dense_ids = false;
+  uint64_t seed;
+  size_t repeat;
   try {
     program.parse_args(argc, argv);
     trace_path = program.get<decltype(trace_path)>("trace_path");
@@ -58,10 +586,27 @@ BENCHMARK("caching") {
                                         }));
     alphas = fplus::split(',', false, program.get<std::string>("alphas"));
     options.parallel = program.get<bool>("--parallel");
+    options.in_process = program.get<bool>("--in-process");
+    options.fan_out = program.get<bool>("--fan-out");
+    options.workers = program.get<size_t>("--workers");
+    options.jobs = program.get<size_t>("--jobs");
+    options.memory_budget_bytes = program.get<size_t>("--memory-budget");
+    check_scheduler_arguments(program);
     output_path = program.get<decltype(output_path)>("--output");
+    stats = program.get<decltype(stats)>("--stats");
+    results_path = program.get<decltype(results_path)>("--results");
+    dense_ids = program.get<bool>("--dense-ids");
+    repeat = program.get<decltype(repeat)>("--repeat");
+    if (repeat == 0)
+      throw std::invalid_argument("At least one repetition is required");
   } catch (const std::exception &e) {
     throw usage_error(program.help().str(), e.what());
   }
+  seed = first_seed(program.present<uint64_t>("--seed"));
+
+  ResultStore store(results_path, collect_run_metadata(argc, argv));
+  if (store.enabled())
+    store.metadata().trace_checksum = file_checksum(trace_path);
 
   // Read trace
   spdlog::info("Reading trace from \"{}\"...", trace_path);
@@ -72,6 +617,7 @@ BENCHMARK("caching") {
   spdlog::info("#requests={}, #objects={}", trace.size(), object_count);
   const auto cache_size = static_cast<size_t>(static_cast<double>(object_count) * cache_size_ratio);
   spdlog::info("Cache size: {} ({}% of #objects)", cache_size, cache_size_ratio * 100);
+  estimate_task_memory(estimate_task_bytes(cache_size), estimate_trace_memory(trace_path));
 
   // Print first 5 requests
   spdlog::info("First 5 requests:");
@@ -83,54 +629,66 @@ BENCHMARK("caching") {
   }
 
   // Benchmark
-  std::unordered_map<std::string, std::unordered_map<std::string, double>> miss_ratios;
-  std::unordered_map<std::string, std::unordered_map<std::string, double>> update_avg_times;
-  std::unordered_map<std::string, std::unordered_map<std::string, double>> estimate_avg_times;
-
-  auto is_baseline_evolving_sketch = [](std::string_view baseline) {
-    return baseline == "EVO" || baseline.ends_with("_EVO") || baseline.ends_with("-EVO");
-  };
+  SketchResults sketch_results({
+      .type = "miss_ratio",
+      .header = "Miss Ratio",
+      .description = "Miss Ratios",
+      .transform = [](const double miss_ratio) { return miss_ratio * 100; },
+      .format = [](const double percent) { return std::format("{:.6f}%", percent); },
+  });
 
   std::mutex map_mutex;
   on_benchmark_finished([&](const auto baseline, const auto &args,
                             const std::vector<double> &results, const double time_spent) {
     std::lock_guard<std::mutex> lock(map_mutex);
 
-    const std::string name = is_baseline_evolving_sketch(baseline)
-                                 ? std::format("{} (Ia={})", baseline, args[2])
+    const std::string name = is_evolving_sketch(baseline)
+                                 ? evolving_sketch_name(baseline, args[2])
                                  : std::string(baseline);
     const std::string &alpha = args[3];
 
-    const double miss_ratio = results[0];
-    const double update_time_avg_seconds = results[1];
-    const double estimate_time_avg_seconds = results[2];
-
-    miss_ratios[alpha][name] = miss_ratio;
-    if (update_time_avg_seconds != 0.0) {
-      update_avg_times[alpha][name] = update_time_avg_seconds;
-      estimate_avg_times[alpha][name] = estimate_time_avg_seconds;
-    }
-    spdlog::info(
-        "[α={}] {}: (Miss Ratio) {:.6f}%{} ({:.6f}s elapsed)", alpha, name, miss_ratio * 100,
-        update_time_avg_seconds != 0.0 ? std::format(", (Update) {:.6f}MOps, (Estimate) {:.6f}MOps",
-                                                     1.0 / update_time_avg_seconds / 1'000'000,
-                                                     1.0 / estimate_time_avg_seconds / 1'000'000)
-                                       : "",
-        time_spent);
+    ResultRecord record{.benchmark = "caching",
+                        .name = name,
+                        .params = {{"trace", trace_path},
+                                   {"cache_size", args[1]},
+                                   {"alpha", alpha},
+                                   {"stats", stats}},
+                        .metrics = sketch_metrics("miss_ratio", results),
+                        .time_spent_s = time_spent};
+    // Only recorded when set, so that hashed replays compare with those recorded before the option
+    if (dense_ids)
+      record.params["dense_ids"] = "true";
+    store.record(std::move(record));
+    spdlog::info("[α={}] {}: {} ({:.6f}s elapsed, seed {})", alpha, name,
+                 sketch_results.add(alpha, name, results), time_spent, args.back());
   });
 
+  // The arguments of a task, whose seed comes last (see the log of its results above)
+  auto task_args = [&](const size_t adapt_interval, const std::string &alpha,
+                       const uint64_t task_seed) {
+    std::vector<std::string> args{trace_path, std::to_string(cache_size),
+                                  std::to_string(adapt_interval), alpha, "--stats", stats};
+    if (dense_ids)
+      args.emplace_back("--dense-ids");
+    args.insert(args.end(), {"--seed", std::to_string(task_seed)});
+    return args;
+  };
+
   auto run_benchmarks = [&](const std::string &alpha) {
     std::vector<std::string> other_benchmark_names;
-    std::string evolving_sketch_benchmark_name;
+    std::vector<std::string> evolving_sketch_benchmark_names;
     for (const std::string &name : enabled_benchmark_names())
-      if (is_baseline_evolving_sketch(name))
-        evolving_sketch_benchmark_name = name;
+      if (is_evolving_sketch(name))
+        evolving_sketch_benchmark_names.push_back(name);
       else
         other_benchmark_names.push_back(name);
-    for (const std::string &name : other_benchmark_names)
-      benchmark(name, trace_path, cache_size, 10, alpha);
-    for (size_t adapt_interval : adapt_intervals)
-      benchmark(evolving_sketch_benchmark_name, trace_path, cache_size, adapt_interval, alpha);
+    for (size_t i = 0; i < repeat; i++) {
+      for (const std::string &name : other_benchmark_names)
+        benchmark(name, task_args(10, alpha, seed + i));
+      for (const std::string &name : evolving_sketch_benchmark_names)
+        for (size_t adapt_interval : adapt_intervals)
+          benchmark(name, task_args(adapt_interval, alpha, seed + i));
+    }
   };
 
   if (options.parallel) {
@@ -142,17 +700,8 @@ BENCHMARK("caching") {
     wait();
     std::println();
 
-    for (const auto &alpha : alphas) {
-      // Sort by miss ratio (ascending)
-      std::vector<std::pair<std::string_view, double>> miss_ratios_sorted(
-          miss_ratios[alpha].begin(), miss_ratios[alpha].end());
-      std::ranges::sort(miss_ratios_sorted,
-                        [](const auto &lhs, const auto &rhs) { return lhs.second < rhs.second; });
-      spdlog::info("[α={}] Sorted by miss ratio (ascending):", alpha);
-      for (const auto &[name, miss_ratio] : miss_ratios_sorted)
-        spdlog::info("[α={}] {}: {:.6f}%", alpha, name, miss_ratio * 100);
-      std::println();
-    }
+    for (const auto &alpha : alphas)
+      sketch_results.log_ranking(alpha);
   } else {
     for (const auto &alpha : alphas) {
       spdlog::info("Running benchmark with α={}...", alpha);
@@ -161,120 +710,12 @@ BENCHMARK("caching") {
       wait();
       std::println();
 
-      // Sort by miss ratio (ascending)
-      std::vector<std::pair<std::string_view, double>> miss_ratios_sorted(
-          miss_ratios[alpha].begin(), miss_ratios[alpha].end());
-      std::ranges::sort(miss_ratios_sorted,
-                        [](const auto &lhs, const auto &rhs) { return lhs.second < rhs.second; });
-      spdlog::info("[α={}] Sorted by miss ratio (ascending):", alpha);
-      for (const auto &[name, miss_ratio] : miss_ratios_sorted)
-        spdlog::info("[α={}] {}: {:.6f}%", alpha, name, miss_ratio * 100);
-      std::println();
-    }
-  }
-
-  std::vector<std::tuple<std::string, std::string,
-                         std::unordered_map<std::string, std::unordered_map<std::string, double>>>>
-      result_maps = {
-          {"miss_ratio", "Miss Ratios", miss_ratios},
-          {"update_avg_time_s", "Average Update Time by Seconds", update_avg_times},
-          {"estimate_avg_time_s", "Average Estimate Time by Seconds", estimate_avg_times},
-      };
-
-  auto output_benchmark_names = [&]() {
-    std::vector<std::string> benchmark_names;
-    std::string evolving_sketch_benchmark_name;
-    for (const std::string &name : enabled_benchmark_names())
-      if (is_baseline_evolving_sketch(name))
-        evolving_sketch_benchmark_name = name;
-      else
-        benchmark_names.push_back(name);
-    for (size_t adapt_interval : adapt_intervals)
-      benchmark_names.push_back(
-          std::format("{} (Ia={})", evolving_sketch_benchmark_name, adapt_interval));
-    return benchmark_names;
-  };
-
-  std::unordered_map<std::string, std::vector<std::vector<std::variant<double, std::string>>>>
-      results;
-  for (const auto &[type, _, map] : result_maps) {
-    std::vector<std::vector<std::variant<double, std::string>>> result;
-    for (const auto &alpha : alphas) {
-      std::vector<std::variant<double, std::string>> row;
-      row.emplace_back(alpha);
-      for (const auto &name : output_benchmark_names()) {
-        if (const auto it = map.find(alpha); it != map.end())
-          if (const auto it2 = it->second.find(name); it2 != it->second.end())
-            row.emplace_back(it2->second);
-          else
-            row.emplace_back("N/A"); // If the benchmark was not run
-        else
-          row.emplace_back("N/A"); // If no results for this alpha
-      }
-      result.emplace_back(std::move(row));
+      sketch_results.log_ranking(alpha);
     }
-    results[type] = result;
   }
 
-  // Print results
-  for (const auto &[type, desc, _] : result_maps) {
-    std::println("{}{}:", type == std::get<0>(result_maps[0]) ? "" : "\n", desc);
-    tabulate::Table table;
-    tabulate::Table::Row_t header{"Alpha"};
-    for (const auto &name : output_benchmark_names())
-      header.emplace_back(name);
-    table.add_row(header);
-    for (const auto &rows : results[type]) {
-      tabulate::Table::Row_t row;
-      for (const auto &cell : rows)
-        if (std::holds_alternative<double>(cell)) {
-          if (type == "miss_ratio")
-            row.emplace_back(std::format("{:.6f}%", std::get<double>(cell) * 100));
-          else
-            row.emplace_back(std::format("{:.6f}MOps", 1.0 / std::get<double>(cell) / 1'000'000));
-        } else {
-          row.emplace_back(std::get<std::string>(cell));
-        }
-      table.add_row(row);
-    }
-    table.format()
-        .font_align(tabulate::FontAlign::right)
-        .corner(" ")
-        .border_top(" ")
-        .border_bottom(" ")
-        .border_left(" ")
-        .border_right(" ");
-    table[1].format().corner("-").border_top("-");
-    std::ostringstream oss;
-    oss << table;
-    std::istringstream iss{oss.str()};
-    std::string output;
-    std::string line;
-    while (std::getline(iss, line))
-      if (line.find_first_not_of(' ') != std::string::npos)
-        output += line + "\n";
-    std::println("{}", output);
-  }
-
-  // Write results to CSV
-  if (!output_path.empty()) {
-    std::ofstream output_file(output_path);
-    if (!output_file.is_open())
-      throw std::runtime_error("Failed to open output file: " + output_path);
-    std::println(output_file, "{}",
-                 "type,alpha," + fplus::join_elem(',', output_benchmark_names()));
-    for (const auto &[type, rows] : results)
-      for (const auto &row : rows)
-        std::println(output_file, "{},{}", type,
-                     fplus::join_elem(',', fplus::transform(
-                                               [](const auto &v) {
-                                                 return std::holds_alternative<double>(v)
-                                                            ? std::format("{}", std::get<double>(v))
-                                                            : std::get<std::string>(v);
-                                               },
-                                               row)));
-    output_file.close();
-  }
+  sketch_results.report(alphas, sketch_result_names(enabled_benchmark_names(), adapt_intervals),
+                        repeat, output_path);
 }
 
 BENCHMARK("hm") {
@@ -294,6 +735,15 @@ BENCHMARK("hm") {
       .default_value(DEFAULT_PARALLEL)
       .implicit_value(true);
   program.add_argument("-o", "--output").help("Output file path (as CSV)").default_value("");
+  program.add_argument("--stats")
+      .help("What sketches record about their operations: 'none', 'counting', 'sampled' (cycles "
+            "of one in 64 calls), or 'full' (cycles of every call, for exact maximum latencies)")
+      .choices("none", "counting", "sampled", "full")
+      .default_value(std::string("sampled"));
+  add_results_argument(program);
+  add_repeat_arguments(program);
+  add_in_process_arguments(program);
+  add_scheduler_arguments(program);
 
   std::string trace_path;
   double cache_size_ratio;
@@ -301,6 +751,10 @@ BENCHMARK("hm") {
   std::vector<size_t> adapt_intervals;
   std::vector<std::string> alphas;
   std::string output_path;
+  std::string stats;
+  std::string results_path;
+  uint64_t seed;
+  size_t repeat;
   try {
     program.parse_args(argc, argv);
     trace_path = program.get<decltype(trace_path)>("trace_path");
@@ -313,10 +767,26 @@ BENCHMARK("hm") {
                                         }));
     alphas = fplus::split(',', false, program.get<std::string>("alphas"));
     options.parallel = program.get<bool>("--parallel");
+    options.in_process = program.get<bool>("--in-process");
+    options.fan_out = program.get<bool>("--fan-out");
+    options.workers = program.get<size_t>("--workers");
+    options.jobs = program.get<size_t>("--jobs");
+    options.memory_budget_bytes = program.get<size_t>("--memory-budget");
+    check_scheduler_arguments(program);
     output_path = program.get<decltype(output_path)>("--output");
+    stats = program.get<decltype(stats)>("--stats");
+    results_path = program.get<decltype(results_path)>("--results");
+    repeat = program.get<decltype(repeat)>("--repeat");
+    if (repeat == 0)
+      throw std::invalid_argument("At least one repetition is required");
   } catch (const std::exception &e) {
     throw usage_error(program.help().str(), e.what());
   }
+  seed = first_seed(program.present<uint64_t>("--seed"));
+
+  ResultStore store(results_path, collect_run_metadata(argc, argv));
+  if (store.enabled())
+    store.metadata().trace_checksum = file_checksum(trace_path);
 
   // Read trace
   spdlog::info("Reading trace from \"{}\"...", trace_path);
@@ -328,6 +798,7 @@ BENCHMARK("hm") {
   const auto cache_size =
       static_cast<size_t>(static_cast<double>(unique_products) * cache_size_ratio);
   spdlog::info("Cache size: {} ({}% of #unique_products)", cache_size, cache_size_ratio * 100);
+  estimate_task_memory(estimate_task_bytes(cache_size), estimate_trace_memory(trace_path));
 
   // Print first 5 packets
   spdlog::info("First 5 transactions:");
@@ -338,51 +809,56 @@ BENCHMARK("hm") {
   }
 
   // Benchmark
-  std::unordered_map<std::string, std::unordered_map<std::string, double>> dcgs;
-  std::unordered_map<std::string, std::unordered_map<std::string, double>> update_avg_times;
-  std::unordered_map<std::string, std::unordered_map<std::string, double>> estimate_avg_times;
-
-  auto is_baseline_evolving_sketch = [](std::string_view baseline) {
-    return baseline == "EVO" || baseline.ends_with("_EVO") || baseline.ends_with("-EVO");
-  };
+  SketchResults sketch_results({
+      .type = "dcg",
+      .header = "DCG",
+      .description = "DCG",
+      .transform = [](const double dcg) { return dcg; },
+      .format = [](const double dcg) { return std::format("{:.6f}", dcg); },
+  });
 
   std::mutex map_mutex;
   on_benchmark_finished([&](const auto baseline, const auto &args,
                             const std::vector<double> &results, const double time_spent) {
     std::lock_guard<std::mutex> lock(map_mutex);
 
-    const std::string name = is_baseline_evolving_sketch(baseline)
-                                 ? std::format("{} (Ia={})", baseline, args[3])
+    const std::string name = is_evolving_sketch(baseline)
+                                 ? evolving_sketch_name(baseline, args[3])
                                  : std::string(baseline);
     const std::string &alpha = args[4];
 
-    const double dcg = results[0];
-    const double update_time_avg_seconds = results[1];
-    const double estimate_time_avg_seconds = results[2];
-
-    dcgs[alpha][name] = dcg;
-    update_avg_times[alpha][name] = update_time_avg_seconds;
-    estimate_avg_times[alpha][name] = estimate_time_avg_seconds;
+    store.record({.benchmark = "hm",
+                  .name = name,
+                  .params = {{"trace", trace_path},
+                             {"cache_size", args[1]},
+                             {"top_k", args[2]},
+                             {"alpha", alpha},
+                             {"stats", stats}},
+                  .metrics = sketch_metrics("dcg", results),
+                  .time_spent_s = time_spent});
     spdlog::info(
-        "[α={}] {}: (DCG) {:.6f}, (Update) {:.6f}MOps, (Estimate) {:.6f}MOps ({:.6f}s elapsed)",
+        "[α={}] {}: {} ({:.6f}s elapsed, seed {})",
         fplus::trim_right('.', fplus::trim_right('0', std::format("{:f}", std::stod(alpha)))), name,
-        dcg, 1.0 / update_time_avg_seconds / 1'000'000, 1.0 / estimate_time_avg_seconds / 1'000'000,
-        time_spent);
+        sketch_results.add(alpha, name, results), time_spent, args.back());
   });
 
   auto run_benchmarks = [&](const std::string &alpha) {
     std::vector<std::string> other_benchmark_names;
-    std::string evolving_sketch_benchmark_name;
+    std::vector<std::string> evolving_sketch_benchmark_names;
     for (const std::string &name : enabled_benchmark_names())
-      if (is_baseline_evolving_sketch(name))
-        evolving_sketch_benchmark_name = name;
+      if (is_evolving_sketch(name))
+        evolving_sketch_benchmark_names.push_back(name);
       else
         other_benchmark_names.push_back(name);
-    for (const std::string &name : other_benchmark_names)
-      benchmark(name, trace_path, cache_size, top_k, 0, alpha);
-    for (size_t adapt_interval : adapt_intervals)
-      benchmark(evolving_sketch_benchmark_name, trace_path, cache_size, top_k, adapt_interval,
-                alpha);
+    for (size_t i = 0; i < repeat; i++) {
+      for (const std::string &name : other_benchmark_names)
+        benchmark(name, trace_path, cache_size, top_k, 0, alpha, "--stats", stats, "--seed",
+                  seed + i);
+      for (const std::string &name : evolving_sketch_benchmark_names)
+        for (size_t adapt_interval : adapt_intervals)
+          benchmark(name, trace_path, cache_size, top_k, adapt_interval, alpha, "--stats", stats,
+                    "--seed", seed + i);
+    }
   };
 
   if (options.parallel) {
@@ -394,17 +870,8 @@ BENCHMARK("hm") {
     wait();
     std::println();
 
-    for (const auto &alpha : alphas) {
-      // Sort by DCG (descending)
-      std::vector<std::pair<std::string_view, double>> dcgs_sorted(dcgs[alpha].begin(),
-                                                                   dcgs[alpha].end());
-      std::ranges::sort(dcgs_sorted,
-                        [](const auto &lhs, const auto &rhs) { return lhs.second > rhs.second; });
-      spdlog::info("[α={}] Sorted by DCG (descending):", alpha);
-      for (const auto &[name, dcg] : dcgs_sorted)
-        spdlog::info("[α={}] {}: {:.6f}", alpha, name, dcg);
-      std::println();
-    }
+    for (const auto &alpha : alphas)
+      sketch_results.log_ranking(alpha);
   } else {
     for (const auto &alpha : alphas) {
       spdlog::info("Running H&M Trending (k={}) benchmark with α={}...", top_k, alpha);
@@ -413,99 +880,369 @@ BENCHMARK("hm") {
       wait();
       std::println();
 
-      // Sort by DCG (descending)
-      std::vector<std::pair<std::string_view, double>> dcgs_sorted(dcgs[alpha].begin(),
-                                                                   dcgs[alpha].end());
-      std::ranges::sort(dcgs_sorted,
-                        [](const auto &lhs, const auto &rhs) { return lhs.second > rhs.second; });
-      spdlog::info("[α={}] Sorted by DCG (descending):", alpha);
-      for (const auto &[name, dcg] : dcgs_sorted)
-        spdlog::info("[α={}] {}: {:.6f}", alpha, name, dcg);
-      std::println();
+      sketch_results.log_ranking(alpha);
     }
   }
 
-  std::vector<std::tuple<std::string, std::string,
-                         std::unordered_map<std::string, std::unordered_map<std::string, double>>>>
-      result_maps = {
-          {"dcg", "DCG", dcgs},
-          {"update_avg_time_s", "Average Update Time by Seconds", update_avg_times},
-          {"estimate_avg_time_s", "Average Estimate Time by Seconds", estimate_avg_times},
-      };
+  sketch_results.report(alphas, sketch_result_names(enabled_benchmark_names(), adapt_intervals),
+                        repeat, output_path);
+}
 
-  auto output_benchmark_names = [&]() {
-    std::vector<std::string> benchmark_names;
-    std::string evolving_sketch_benchmark_name;
-    for (const std::string &name : enabled_benchmark_names())
-      if (is_baseline_evolving_sketch(name))
-        evolving_sketch_benchmark_name = name;
-      else
-        benchmark_names.push_back(name);
-    for (size_t adapt_interval : adapt_intervals)
-      benchmark_names.push_back(
-          std::format("{} (Ia={})", evolving_sketch_benchmark_name, adapt_interval));
-    return benchmark_names;
+BENCHMARK("micro") {
+  argparse::ArgumentParser program;
+  program.add_argument("sizes").help(
+      "Comma-separated list of sketch sizes in bytes, e.g., from L1 to DRAM "
+      "(e.g., '16384,262144,4194304,67108864,268435456')");
+  program.add_argument("thetas").help(
+      "Comma-separated list of Zipf exponents of the key stream, 0 being uniform "
+      "(e.g., '0,0.5,0.99,1.2')");
+  program.add_argument("--keys")
+      .help("The number of distinct keys")
+      .default_value(std::string("1048576"));
+  program.add_argument("--ops")
+      .help("The number of calls timed per operation")
+      .default_value(std::string("4194304"));
+  program.add_argument("-o", "--output").help("Output file path (as CSV)").default_value("");
+  add_results_argument(program);
+
+  std::vector<std::string> sizes;
+  std::vector<std::string> thetas;
+  std::string keys;
+  std::string ops;
+  std::string output_path;
+  std::string results_path;
+  try {
+    program.parse_args(argc, argv);
+    sizes = fplus::split(',', false, program.get<std::string>("sizes"));
+    thetas = fplus::split(',', false, program.get<std::string>("thetas"));
+    keys = program.get<decltype(keys)>("--keys");
+    ops = program.get<decltype(ops)>("--ops");
+    output_path = program.get<decltype(output_path)>("--output");
+    results_path = program.get<decltype(results_path)>("--results");
+  } catch (const std::exception &e) {
+    throw usage_error(program.help().str(), e.what());
+  }
+
+  // Values per call by theta, then size, then name (see `MICRO_OPS`). Tasks always run one at a
+  // time, as concurrent ones would share caches and memory bandwidth
+  std::unordered_map<std::string,
+                     std::unordered_map<std::string, std::unordered_map<std::string,
+                                                                        std::vector<double>>>>
+      values;
+  ResultStore store(results_path, collect_run_metadata(argc, argv));
+  on_benchmark_finished([&](const auto name, const auto &args, const std::vector<double> &result,
+                            const double time_spent) {
+    const std::string &size = args[0];
+    const std::string &theta = args[1];
+    values[theta][size][std::string(name)] = result;
+    ResultRecord record{.benchmark = "micro",
+                        .name = std::string(name),
+                        .params = {{"size_bytes", size},
+                                   {"theta", theta},
+                                   {"keys", keys},
+                                   {"ops", ops}},
+                        .metrics = {},
+                        .time_spent_s = time_spent};
+    for (size_t op = 0; op < MICRO_OPS.size(); op++)
+      for (size_t i = 0; i < MICRO_VALUES_PER_OP; i++)
+        record.metrics[std::format("{}_{}_per_op", MICRO_OPS[op],
+                                   i == 0 ? std::string_view("ns") : PERF_EVENT_NAMES[i - 1])] =
+            result.at(op * MICRO_VALUES_PER_OP + i);
+    store.record(std::move(record));
+    spdlog::info("[θ={}, {} bytes] {}: (Update) {:.2f}ns, (Estimate) {:.2f}ns", theta, size, name,
+                 result.at(0), result.at(MICRO_VALUES_PER_OP));
+  });
+
+  for (const auto &theta : thetas)
+    for (const auto &size : sizes)
+      benchmark_all(size, theta, "--keys", keys, "--ops", ops);
+
+  // Format a value per call, which is NaN for the hardware events that could not be counted
+  auto cell = [](const double value, const int precision) {
+    return std::isnan(value) ? std::string("N/A") : std::format("{:.{}f}", value, precision);
   };
 
-  std::unordered_map<std::string, std::vector<std::vector<std::variant<double, std::string>>>>
-      results;
-  for (const auto &[type, _, map] : result_maps) {
-    std::vector<std::vector<std::variant<double, std::string>>> result;
-    for (const auto &alpha : alphas) {
-      std::vector<std::variant<double, std::string>> row;
-      row.emplace_back(alpha);
-      for (const auto &name : output_benchmark_names()) {
-        if (const auto it = map.find(alpha); it != map.end())
-          if (const auto it2 = it->second.find(name); it2 != it->second.end())
-            row.emplace_back(it2->second);
-          else
-            row.emplace_back("N/A"); // If the benchmark was not run
-        else
-          row.emplace_back("N/A"); // If no results for this alpha
+  bool counted = false;
+  for (const auto &theta : thetas)
+    for (size_t op = 0; op < MICRO_OPS.size(); op++) {
+      tabulate::Table table;
+      table.add_row({"Benchmark", "Size", "ns", "cycles", "IPC", "LLC misses", "dTLB misses",
+                     "branch misses"});
+      for (const auto &size : sizes)
+        for (const auto &name : enabled_benchmark_names()) {
+          const auto it = values[theta][size].find(name);
+          if (it == values[theta][size].end())
+            continue;
+          const auto *v = it->second.data() + op * MICRO_VALUES_PER_OP;
+          counted = counted || !std::isnan(v[1]);
+          table.add_row({name, size, cell(v[0], 2), cell(v[1], 1), cell(v[2] / v[1], 2),
+                         cell(v[3], 4), cell(v[4], 4), cell(v[5], 4)});
+        }
+
+      std::println("\n{} per call (θ={}):", MICRO_OPS[op], theta);
+      print_table(table);
+    }
+  if (!counted)
+    spdlog::warn("Hardware counters are unavailable (e.g., perf_event_paranoid is too high, or "
+                 "running in a VM), so only times were measured");
+
+  // Write results to CSV
+  if (!output_path.empty()) {
+    std::ofstream output_file(output_path);
+    if (!output_file.is_open())
+      throw std::runtime_error("Failed to open output file: " + output_path);
+    std::println(output_file, "{}",
+                 "type,size_bytes,theta," + fplus::join_elem(',', enabled_benchmark_names()));
+    for (size_t op = 0; op < MICRO_OPS.size(); op++)
+      for (size_t i = 0; i < MICRO_VALUES_PER_OP; i++) {
+        const auto type = std::format("{}_{}_per_op", MICRO_OPS[op],
+                                      i == 0 ? std::string_view("ns") : PERF_EVENT_NAMES[i - 1]);
+        for (const auto &theta : thetas)
+          for (const auto &size : sizes) {
+            std::vector<std::string> row{type, size, theta};
+            for (const auto &name : enabled_benchmark_names()) {
+              const auto it = values[theta][size].find(name);
+              const double value = it != values[theta][size].end()
+                                       ? it->second.at(op * MICRO_VALUES_PER_OP + i)
+                                       : std::numeric_limits<double>::quiet_NaN();
+              row.push_back(std::isnan(value) ? "N/A" : std::format("{}", value));
+            }
+            std::println(output_file, "{}", fplus::join_elem(',', row));
+          }
+      }
+    output_file.close();
+  }
+}
+
+BENCHMARK("concurrency") {
+  argparse::ArgumentParser program;
+  program.add_argument("size_bytes").help("The memory budget of the shared sketch in bytes");
+  program.add_argument("threads").help(
+      "Comma-separated list of thread counts (e.g., '1,2,4,8,16')");
+  program.add_argument("mixes").help(
+      "Comma-separated list of the number of updates per estimate (e.g., '100,10,1')");
+  program.add_argument("--ops")
+      .help("The number of operations per thread")
+      .default_value(std::string("2097152"));
+  program.add_argument("--theta")
+      .help("The exponent of the Zipf distribution of keys (0 for uniform)")
+      .default_value(std::string("0.99"));
+  program.add_argument("-o", "--output").help("Output file path (as CSV)").default_value("");
+  add_results_argument(program);
+
+  std::string size_bytes;
+  std::vector<std::string> thread_counts;
+  std::vector<std::string> mixes;
+  std::string ops;
+  std::string theta;
+  std::string output_path;
+  std::string results_path;
+  try {
+    program.parse_args(argc, argv);
+    size_bytes = program.get<decltype(size_bytes)>("size_bytes");
+    thread_counts = fplus::split(',', false, program.get<std::string>("threads"));
+    mixes = fplus::split(',', false, program.get<std::string>("mixes"));
+    ops = program.get<decltype(ops)>("--ops");
+    theta = program.get<decltype(theta)>("--theta");
+    output_path = program.get<decltype(output_path)>("--output");
+    results_path = program.get<decltype(results_path)>("--results");
+  } catch (const std::exception &e) {
+    throw usage_error(program.help().str(), e.what());
+  }
+
+  // Results by mix, then thread count, then name (see `CONCURRENCY_QUANTILES`). Tasks always run
+  // one at a time, as each one already occupies the cores it needs
+  std::unordered_map<std::string,
+                     std::unordered_map<std::string, std::unordered_map<std::string,
+                                                                        std::vector<double>>>>
+      values;
+  ResultStore store(results_path, collect_run_metadata(argc, argv));
+  on_benchmark_finished([&](const auto name, const auto &args, const std::vector<double> &result,
+                            const double time_spent) {
+    const std::string &threads = args[0];
+    const std::string &mix = args[1];
+    values[mix][threads][std::string(name)] = result;
+    ResultRecord record{.benchmark = "concurrency",
+                        .name = std::string(name),
+                        .params = {{"size_bytes", size_bytes},
+                                   {"threads", threads},
+                                   {"updates_per_estimate", mix},
+                                   {"ops", ops},
+                                   {"theta", theta}},
+                        .metrics = {{"mops", result.at(0)}},
+                        .time_spent_s = time_spent};
+    for (size_t i = 0; i < CONCURRENCY_QUANTILES.size(); i++)
+      record.metrics[std::format("{}_s", CONCURRENCY_QUANTILE_KEYS[i])] = result.at(i + 1);
+    store.record(std::move(record));
+    spdlog::info("[{}:1, {} threads] {}: {:.3f}MOps, (p99) {:.0f}ns, (max) {:.0f}ns", mix, threads,
+                 name, result.at(0), result.at(2) * 1e9, result.back() * 1e9);
+  });
+
+  for (const auto &mix : mixes)
+    for (const auto &threads : thread_counts)
+      benchmark_all(threads, mix, size_bytes, "--ops", ops, "--theta", theta);
+
+  auto lookup = [&](const std::string &mix, const std::string &threads, const std::string &name,
+                    const size_t index) -> std::optional<double> {
+    const auto it = values[mix][threads].find(name);
+    if (it == values[mix][threads].end())
+      return std::nullopt;
+    return it->second.at(index);
+  };
+
+  for (const auto &mix : mixes) {
+    tabulate::Table throughput;
+    tabulate::Table tail;
+    tabulate::Table::Row_t header{"Benchmark"};
+    for (const auto &threads : thread_counts)
+      header.emplace_back(std::format("{} threads", threads));
+    throughput.add_row(header);
+    tail.add_row(header);
+    for (const auto &name : enabled_benchmark_names()) {
+      tabulate::Table::Row_t throughput_row{name};
+      tabulate::Table::Row_t tail_row{name};
+      for (const auto &threads : thread_counts) {
+        const auto mops = lookup(mix, threads, name, 0);
+        const auto p99 = lookup(mix, threads, name, 2);
+        throughput_row.emplace_back(mops ? std::format("{:.3f}MOps", *mops) : "N/A");
+        tail_row.emplace_back(p99 ? std::format("{:.0f}ns", *p99 * 1e9) : "N/A");
       }
-      result.emplace_back(std::move(row));
+      throughput.add_row(throughput_row);
+      tail.add_row(tail_row);
+    }
+    std::println("\nThroughput ({}:1 updates to estimates):", mix);
+    print_table(throughput);
+    std::println("p99 latency of the slowest thread ({}:1 updates to estimates):", mix);
+    print_table(tail);
+
+    // Padded and packed shards only differ in layout, so a gap between them is false sharing
+    for (const auto &threads : thread_counts) {
+      const auto padded = lookup(mix, threads, "SHARDED", 0);
+      const auto packed = lookup(mix, threads, "SHARDED_PACKED", 0);
+      if (padded && packed && *packed < *padded * (1.0 - FALSE_SHARING_TOLERANCE))
+        spdlog::warn("[{}:1, {} threads] False sharing detected: packed shards reach {:.3f}MOps "
+                     "against {:.3f}MOps when padded",
+                     mix, threads, *packed, *padded);
+    }
+  }
+
+  // Write results to CSV
+  if (!output_path.empty()) {
+    std::ofstream output_file(output_path);
+    if (!output_file.is_open())
+      throw std::runtime_error("Failed to open output file: " + output_path);
+    std::println(output_file, "{}",
+                 "type,updates_per_estimate,threads," +
+                     fplus::join_elem(',', enabled_benchmark_names()));
+    for (size_t i = 0; i <= CONCURRENCY_QUANTILES.size(); i++) {
+      const auto type = i == 0 ? std::string("mops")
+                               : std::format("{}_s", CONCURRENCY_QUANTILE_KEYS[i - 1]);
+      for (const auto &mix : mixes)
+        for (const auto &threads : thread_counts) {
+          std::vector<std::string> row{type, mix, threads};
+          for (const auto &name : enabled_benchmark_names()) {
+            const auto value = lookup(mix, threads, name, i);
+            row.push_back(value ? std::format("{}", *value) : "N/A");
+          }
+          std::println(output_file, "{}", fplus::join_elem(',', row));
+        }
     }
-    results[type] = result;
+    output_file.close();
+  }
+}
+
+BENCHMARK("accuracy") {
+  argparse::ArgumentParser program;
+  program.add_argument("trace_path").help("The path to the cache trace file");
+  program.add_argument("sizes").help(
+      "Comma-separated list of sketch sizes in bytes, from small to large "
+      "(e.g., '4096,16384,65536,262144,1048576')");
+  program.add_argument("alpha").help("The alpha value of time-decaying sketches and the oracle");
+  program.add_argument("--top")
+      .help("The number of most frequent keys to measure the error on")
+      .default_value(std::string("1000"));
+  program.add_argument("--samples")
+      .help("The number of keys drawn uniformly from all keys to measure the error on")
+      .default_value(std::string("1000"));
+  program.add_argument("-o", "--output").help("Output file path (as CSV)").default_value("");
+  add_results_argument(program);
+
+  std::string trace_path;
+  std::vector<std::string> sizes;
+  std::string alpha;
+  std::string top;
+  std::string samples;
+  std::string output_path;
+  std::string results_path;
+  try {
+    program.parse_args(argc, argv);
+    trace_path = program.get<decltype(trace_path)>("trace_path");
+    sizes = fplus::split(',', false, program.get<std::string>("sizes"));
+    alpha = program.get<decltype(alpha)>("alpha");
+    top = program.get<decltype(top)>("--top");
+    samples = program.get<decltype(samples)>("--samples");
+    output_path = program.get<decltype(output_path)>("--output");
+    results_path = program.get<decltype(results_path)>("--results");
+  } catch (const std::exception &e) {
+    throw usage_error(program.help().str(), e.what());
   }
 
-  // Print results
-  for (const auto &[type, desc, _] : result_maps) {
-    std::println("{}{}:", type == std::get<0>(result_maps[0]) ? "" : "\n", desc);
+  // Errors by name (see `ACCURACY_METRICS`). Each task replays the trace into all sizes at once
+  std::unordered_map<std::string, std::vector<double>> values;
+  ResultStore store(results_path, collect_run_metadata(argc, argv));
+  if (store.enabled())
+    store.metadata().trace_checksum = file_checksum(trace_path);
+  on_benchmark_finished([&](const auto name, const auto & /*args*/,
+                            const std::vector<double> &result, const double time_spent) {
+    values[std::string(name)] = result;
+    for (size_t i = 0; i < sizes.size(); i++) {
+      ResultRecord record{
+          .benchmark = "accuracy",
+          .name = std::string(name),
+          .params = {{"trace", trace_path},
+                     {"size_bytes", sizes[i]},
+                     {"alpha", alpha},
+                     {"top", top},
+                     {"samples", samples}},
+          .metrics = {},
+          .time_spent_s = time_spent};
+      for (size_t metric = 0; metric < ACCURACY_METRICS.size(); metric++)
+        record.metrics[std::string(ACCURACY_METRICS[metric])] =
+            result.at(i * ACCURACY_METRICS.size() + metric);
+      store.record(std::move(record));
+    }
+    spdlog::info("{}: (Top ARE) {:.6f} at {} bytes, {:.6f} at {} bytes", name, result.at(0),
+                 sizes.front(), result.at(result.size() - ACCURACY_METRICS.size()), sizes.back());
+  });
+
+  benchmark_all(trace_path, fplus::join(std::string(","), sizes), alpha, "--top", top,
+                "--samples", samples);
+
+  auto lookup = [&](const std::string &name, const size_t size_index,
+                    const size_t metric) -> std::optional<double> {
+    const auto it = values.find(name);
+    const auto index = size_index * ACCURACY_METRICS.size() + metric;
+    if (it == values.end() || index >= it->second.size() || std::isnan(it->second[index]))
+      return std::nullopt;
+    return it->second[index];
+  };
+
+  for (size_t metric = 0; metric < ACCURACY_METRICS.size(); metric++) {
     tabulate::Table table;
-    tabulate::Table::Row_t header{"Alpha"};
-    for (const auto &name : output_benchmark_names())
+    tabulate::Table::Row_t header{"Size"};
+    for (const auto &name : enabled_benchmark_names())
       header.emplace_back(name);
     table.add_row(header);
-    for (const auto &rows : results[type]) {
-      tabulate::Table::Row_t row;
-      for (const auto &cell : rows)
-        if (std::holds_alternative<double>(cell)) {
-          if (type == "dcg")
-            row.emplace_back(std::format("{:.6f}", std::get<double>(cell)));
-          else
-            row.emplace_back(std::format("{:.6f}MOps", 1.0 / std::get<double>(cell) / 1'000'000));
-        } else {
-          row.emplace_back(std::get<std::string>(cell));
-        }
+    for (size_t i = 0; i < sizes.size(); i++) {
+      tabulate::Table::Row_t row{sizes[i]};
+      for (const auto &name : enabled_benchmark_names()) {
+        const auto value = lookup(name, i, metric);
+        row.emplace_back(value ? std::format("{:.6f}", *value) : "N/A");
+      }
       table.add_row(row);
     }
-    table.format()
-        .font_align(tabulate::FontAlign::right)
-        .corner(" ")
-        .border_top(" ")
-        .border_bottom(" ")
-        .border_left(" ")
-        .border_right(" ");
-    table[1].format().corner("-").border_top("-");
-    std::ostringstream oss;
-    oss << table;
-    std::istringstream iss{oss.str()};
-    std::string output;
-    std::string line;
-    while (std::getline(iss, line))
-      if (line.find_first_not_of(' ') != std::string::npos)
-        output += line + "\n";
-    std::println("{}", output);
+    std::println("\n{} (α={}):", ACCURACY_METRICS[metric], alpha);
+    print_table(table);
   }
 
   // Write results to CSV
@@ -514,21 +1251,372 @@ BENCHMARK("hm") {
     if (!output_file.is_open())
       throw std::runtime_error("Failed to open output file: " + output_path);
     std::println(output_file, "{}",
-                 "type,alpha," + fplus::join_elem(',', output_benchmark_names()));
-    for (const auto &[type, rows] : results)
-      for (const auto &row : rows)
-        std::println(output_file, "{},{}", type,
-                     fplus::join_elem(',', fplus::transform(
-                                               [](const auto &v) {
-                                                 return std::holds_alternative<double>(v)
-                                                            ? std::format("{}", std::get<double>(v))
-                                                            : std::get<std::string>(v);
-                                               },
-                                               row)));
+                 "type,size_bytes," + fplus::join_elem(',', enabled_benchmark_names()));
+    for (size_t metric = 0; metric < ACCURACY_METRICS.size(); metric++)
+      for (size_t i = 0; i < sizes.size(); i++) {
+        std::vector<std::string> row{std::string(ACCURACY_METRICS[metric]), sizes[i]};
+        for (const auto &name : enabled_benchmark_names()) {
+          const auto value = lookup(name, i, metric);
+          row.push_back(value ? std::format("{}", *value) : "N/A");
+        }
+        std::println(output_file, "{}", fplus::join_elem(',', row));
+      }
     output_file.close();
   }
 }
 
+BENCHMARK("compare", {.standalone = true}) {
+  argparse::ArgumentParser program;
+  program.add_argument("baseline").help("The result file of the baseline (see `--results`)");
+  program.add_argument("candidate").help("The result file to compare against the baseline");
+  program.add_argument("--significance")
+      .help("The p-value below which a difference is not attributed to noise")
+      .default_value(0.05)
+      .scan<'g', double>();
+  program.add_argument("--threshold")
+      .help("The relative change below which a significant difference is ignored")
+      .default_value(0.01)
+      .scan<'g', double>();
+
+  std::string baseline_path;
+  std::string candidate_path;
+  double significance = 0.0;
+  double threshold = 0.0;
+  try {
+    program.parse_args(argc, argv);
+    baseline_path = program.get<decltype(baseline_path)>("baseline");
+    candidate_path = program.get<decltype(candidate_path)>("candidate");
+    significance = program.get<double>("--significance");
+    threshold = program.get<double>("--threshold");
+  } catch (const std::exception &e) {
+    throw usage_error(program.help().str(), e.what());
+  }
+
+  // Samples of each metric by configuration, i.e., over the repetitions of each configuration
+  using Samples = std::map<std::string, std::map<std::string, std::vector<double>>>;
+  auto group = [](const std::vector<ResultRecord> &records) {
+    Samples samples;
+    for (const auto &record : records)
+      for (const auto &[metric, value] : record.metrics)
+        samples[record.configuration()][metric].push_back(value);
+    return samples;
+  };
+  const auto baseline_records = ResultStore::load(baseline_path);
+  const auto candidate_records = ResultStore::load(candidate_path);
+  const Samples baseline = group(baseline_records);
+  const Samples candidate = group(candidate_records);
+
+  // Differences in machine or trace make any difference in results meaningless
+  auto warn_if_differs = [&](const std::string_view field, auto get) {
+    std::set<std::string> values;
+    for (const auto *records : {&baseline_records, &candidate_records})
+      for (const auto &record : *records)
+        values.insert(get(record.metadata));
+    if (values.size() > 1)
+      spdlog::warn("Results come from different values of {}: {}", field,
+                   fplus::join(std::string(", "), values));
+  };
+  warn_if_differs("cpu_model", [](const RunMetadata &m) { return m.cpu_model; });
+  warn_if_differs("build_type", [](const RunMetadata &m) { return m.build_type; });
+  warn_if_differs("trace_checksum", [](const RunMetadata &m) { return m.trace_checksum; });
+
+  tabulate::Table table;
+  table.add_row({"Configuration", "Metric", "Baseline (n)", "Candidate (n)", "Change", "p",
+                 "Verdict"});
+  size_t compared = 0;
+  size_t changed = 0;
+  size_t regressions = 0;
+  for (const auto &[configuration, metrics] : candidate) {
+    const auto baseline_it = baseline.find(configuration);
+    if (baseline_it == baseline.end())
+      continue;
+    for (const auto &[metric, candidate_samples] : metrics) {
+      const auto samples_it = baseline_it->second.find(metric);
+      if (samples_it == baseline_it->second.end())
+        continue;
+      const auto &baseline_samples = samples_it->second;
+      compared++;
+
+      const double baseline_mean = mean(baseline_samples);
+      const double candidate_mean = mean(candidate_samples);
+      constexpr double INF = std::numeric_limits<double>::infinity();
+      const double change =
+          baseline_mean != 0.0 ? (candidate_mean - baseline_mean) / std::abs(baseline_mean)
+          : candidate_mean == 0.0 ? 0.0
+                                  : std::copysign(INF, candidate_mean);
+      const auto test = welch_t_test(baseline_samples, candidate_samples);
+
+      std::string verdict;
+      if (std::isnan(test.p))
+        verdict = "n<2";
+      else if (test.p >= significance || std::abs(change) <= threshold)
+        verdict = "~";
+      else if ((change > 0.0) == higher_is_better(metric))
+        verdict = "improvement";
+      else {
+        verdict = "REGRESSION";
+        regressions++;
+      }
+      if (verdict == "~")
+        continue;
+      changed++;
+      table.add_row({configuration, metric,
+                     std::format("{:.6g} ({})", baseline_mean, baseline_samples.size()),
+                     std::format("{:.6g} ({})", candidate_mean, candidate_samples.size()),
+                     std::format("{:+.2f}%", change * 100.0),
+                     std::isnan(test.p) ? "N/A" : std::format("{:.3g}", test.p), verdict});
+    }
+  }
+
+  if (compared == 0)
+    throw std::runtime_error("No configuration and metric is in both result files");
+  std::println("Compared {} metrics, {} of which changed beyond noise and the {:.2f}% threshold "
+               "(or have too few repetitions to tell):",
+               compared, changed, threshold * 100.0);
+  if (changed > 0)
+    print_table(table);
+  if (regressions > 0)
+    throw std::runtime_error(std::format("{} regressions detected", regressions));
+}
+
+BENCHMARK("sweep", {.standalone = true}) {
+  argparse::ArgumentParser program;
+  program.add_argument("spec").help(
+      "The JSON file that specifies the sweep (see `benchmark/utils/sweep.hpp`)");
+  program.add_argument("results").help(
+      "The result file of the sweep (see `--results`), which each point is appended to as it "
+      "finishes, and whose points are skipped when the sweep is run again");
+  program.add_argument("-p", "--parallel")
+      .help("Run all points in parallel")
+      .default_value(DEFAULT_PARALLEL)
+      .implicit_value(true);
+  program.add_argument("--dry-run").help("List the points left to run without running them").flag();
+  add_in_process_arguments(program);
+  add_scheduler_arguments(program);
+
+  std::string spec_path;
+  std::string results_path;
+  bool dry_run = false;
+  BenchmarkOptions runner_options;
+  try {
+    program.parse_args(argc, argv);
+    spec_path = program.get<decltype(spec_path)>("spec");
+    results_path = program.get<decltype(results_path)>("results");
+    dry_run = program.get<bool>("--dry-run");
+    runner_options = {
+        .parallel = program.get<bool>("--parallel"),
+        .in_process = program.get<bool>("--in-process"),
+        .fan_out = program.get<bool>("--fan-out"),
+        .workers = program.get<size_t>("--workers"),
+        .jobs = program.get<size_t>("--jobs"),
+        .memory_budget_bytes = program.get<size_t>("--memory-budget"),
+    };
+    check_scheduler_arguments(program);
+  } catch (const std::exception &e) {
+    throw usage_error(program.help().str(), e.what());
+  }
+
+  const SweepSpec spec = SweepSpec::load(spec_path);
+  const bool caching = spec.benchmark == "caching";
+  if (!caching && spec.benchmark != "hm")
+    throw std::invalid_argument("Sweeps run the caching or hm benchmark, not: " + spec.benchmark);
+
+  // The tasks of the swept benchmark run as they would from its own command
+  Benchmark &runner = *Benchmark::benchmarks.at(spec.benchmark);
+  runner.set_options(runner_options);
+  runner.set_enabled_benchmarks(spec.algorithms); // Fails on unknown algorithms
+
+  spdlog::info("Reading trace from \"{}\"...", spec.trace);
+  const size_t object_count = caching ? count_unique_objects(CachingTrace(spec.trace))
+                                      : count_unique_products(TransactionTrace(spec.trace));
+  auto cache_size_of = [&](const SweepPoint &point) {
+    return static_cast<size_t>(static_cast<double>(object_count) * point.cache_size_ratio);
+  };
+
+  const auto points = expand_sweep(spec, is_evolving_sketch);
+  std::vector<ResultRecord> records;
+  for (const auto &point : points)
+    records.push_back(sweep_record(
+        spec, point,
+        point.adapt_interval != 0
+            ? evolving_sketch_name(point.algorithm, std::to_string(point.adapt_interval))
+            : point.algorithm,
+        cache_size_of(point)));
+  const auto completed = std::filesystem::exists(results_path) ? ResultStore::load(results_path)
+                                                               : std::vector<ResultRecord>{};
+  std::vector<std::pair<SweepPoint, ResultRecord>> pending;
+  for (const size_t i : pending_sweep_records(records, completed))
+    pending.emplace_back(points[i], std::move(records[i]));
+  spdlog::info("Sweep of {} points ({} sampling): {} completed, {} to run", points.size(),
+               spec.sampling, points.size() - pending.size(), pending.size());
+
+  if (dry_run) {
+    for (const auto &[point, record] : pending)
+      std::println("{} {}", record.name, nlohmann::json(record.params).dump());
+    return;
+  }
+  if (pending.empty())
+    return;
+
+  ResultStore store(results_path, collect_run_metadata(argc, argv));
+  store.metadata().trace_checksum = file_checksum(spec.trace);
+
+  // The pending points of each task by its name and arguments, which points with the same cache
+  // size after rounding share
+  std::map<std::string, std::vector<size_t>> task_points;
+  auto task_key = [](const std::string_view name, const std::vector<std::string> &args) {
+    return std::format("{} {}", name, fplus::join(std::string(" "), args));
+  };
+  std::mutex mutex;
+  size_t finished = 0;
+  runner.on_benchmark_finished([&](const auto name, const auto &args,
+                                   const std::vector<double> &results, const double time_spent) {
+    const std::lock_guard lock(mutex);
+    auto it = task_points.find(task_key(name, args));
+    if (it == task_points.end() || it->second.empty())
+      return;
+    ResultRecord record = pending[it->second.back()].second;
+    it->second.pop_back();
+    record.metrics = sketch_metrics(caching ? "miss_ratio" : "dcg", results);
+    record.time_spent_s = time_spent;
+    store.record(record);
+    spdlog::info("[{}/{}] {} {} ({:.6f}s elapsed)", ++finished, pending.size(), record.name,
+                 nlohmann::json(record.params).dump(), time_spent);
+  });
+
+  // What the caching and hm benchmarks pass as the interval of tasks that do not adapt
+  const size_t unused_adapt_interval = caching ? 10 : 0;
+  for (size_t i = 0; i < pending.size(); i++) {
+    const auto &[point, record] = pending[i];
+    const size_t cache_size = cache_size_of(point);
+    std::vector<std::string> args{spec.trace, std::to_string(cache_size)};
+    if (!caching)
+      args.push_back(std::to_string(spec.top_k));
+    args.push_back(
+        std::to_string(point.adapt_interval != 0 ? point.adapt_interval : unused_adapt_interval));
+    args.insert(args.end(), {record.params.at("alpha"), "--stats", spec.stats});
+    if (spec.dense_ids)
+      args.emplace_back("--dense-ids");
+    args.insert(args.end(), {"--seed", std::to_string(point.seed)});
+    {
+      const std::lock_guard lock(mutex);
+      task_points[task_key(point.algorithm, args)].push_back(i);
+    }
+    runner.estimate_task_memory(estimate_task_bytes(cache_size), estimate_trace_memory(spec.trace));
+    runner.benchmark(point.algorithm, args);
+  }
+  runner.wait();
+
+  if (finished < pending.size())
+    spdlog::error("{} of {} points failed or were interrupted, and run again with the sweep",
+                  pending.size() - finished, pending.size());
+}
+
+BENCHMARK("compact", {.standalone = true}) {
+  argparse::ArgumentParser program;
+  program.add_argument("trace_path").help("The path to the `.oracleGeneral` trace to convert");
+  program.add_argument("output").help("The path of the compact trace to write");
+  program.add_argument("--block-records")
+      .help("The requests per block, i.e., the granularity of seeking")
+      .default_value(uint32_t{1} << 16)
+      .scan<'u', uint32_t>();
+  program.add_argument("--no-sizes")
+      .help("Leave out object sizes, which the sketch benchmarks do not use")
+      .flag();
+  program.add_argument("--zstd")
+      .help("Compress blocks with zstd at this level, if zstd is available (0 to not compress)")
+      .default_value(0)
+      .scan<'i', int>();
+
+  std::string trace_path;
+  std::string output_path;
+  CompactTraceOptions options;
+  try {
+    program.parse_args(argc, argv);
+    trace_path = program.get<decltype(trace_path)>("trace_path");
+    output_path = program.get<decltype(output_path)>("output");
+    options = {
+        .block_records = program.get<uint32_t>("--block-records"),
+        .sizes = !program.get<bool>("--no-sizes"),
+        .zstd_level = program.get<int>("--zstd"),
+    };
+  } catch (const std::exception &e) {
+    throw usage_error(program.help().str(), e.what());
+  }
+
+  const CachingTrace trace(trace_path);
+  if (trace.compact() != nullptr)
+    throw std::invalid_argument("The trace is compact already: " + trace_path);
+  const auto bytes = write_compact_trace(trace, output_path, options);
+  const auto raw_bytes = std::filesystem::file_size(trace_path);
+  spdlog::info("Wrote {} requests to \"{}\": {} bytes ({:.2f} per request, {:.1f}x smaller)",
+               trace.size(), output_path, bytes,
+               static_cast<double>(bytes) / static_cast<double>(std::max<size_t>(1, trace.size())),
+               static_cast<double>(raw_bytes) / static_cast<double>(bytes));
+}
+
+BENCHMARK("profile", {.standalone = true}) {
+  argparse::ArgumentParser program;
+  program.add_argument("benchmark")
+      .help("The benchmark that reads the trace, i.e., 'caching' or 'hm'")
+      .choices("caching", "hm");
+  program.add_argument("trace_path").help("The path to the trace to profile");
+  program.add_argument("-o", "--output")
+      .help("The path of a JSON file where the profile is saved")
+      .default_value("");
+  program.add_argument("--no-cache")
+      .help("Profile the trace anew instead of reading its sidecar file, and do not save one")
+      .flag();
+
+  std::string benchmark;
+  std::string trace_path;
+  std::string output_path;
+  bool use_cache = true;
+  try {
+    program.parse_args(argc, argv);
+    benchmark = program.get<decltype(benchmark)>("benchmark");
+    trace_path = program.get<decltype(trace_path)>("trace_path");
+    output_path = program.get<decltype(output_path)>("--output");
+    use_cache = !program.get<bool>("--no-cache");
+  } catch (const std::exception &e) {
+    throw usage_error(program.help().str(), e.what());
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  const TraceProfile profile = benchmark == "caching"
+                                   ? profile_trace(CachingTrace(trace_path), use_cache)
+                                   : profile_trace(TransactionTrace(trace_path), use_cache);
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  spdlog::info("Profiled \"{}\" in {:.3f}s", trace_path, elapsed.count());
+
+  spdlog::info("#requests={}, #objects={}", profile.num_requests, profile.num_objects);
+  spdlog::info("One-hit wonders: {} ({:.2f}% of objects)", profile.one_hit_wonders,
+               profile.one_hit_wonder_ratio() * 100);
+  spdlog::info("Zipf alpha: {:.3f}", profile.zipf_alpha);
+  spdlog::info("Objects by number of requests:");
+  for (size_t i = 0; i < profile.popularity_histogram.size(); i++)
+    spdlog::info("  [{}, {}): {}", uint64_t{1} << i, uint64_t{1} << (i + 1),
+                 profile.popularity_histogram[i]);
+  if (!profile.request_rate.empty()) {
+    const auto [min, max] = std::ranges::minmax(profile.request_rate);
+    const auto interval = static_cast<double>(profile.rate_interval);
+    spdlog::info("Requests per second over {} intervals of {}s: {:.2f} on average, {:.2f} to "
+                 "{:.2f}",
+                 profile.request_rate.size(), profile.rate_interval,
+                 static_cast<double>(profile.num_requests) /
+                     (interval * static_cast<double>(profile.request_rate.size())),
+                 static_cast<double>(min) / interval, static_cast<double>(max) / interval);
+  }
+
+  if (!output_path.empty()) {
+    std::ofstream output_file(output_path);
+    if (!output_file.is_open())
+      throw std::runtime_error("Failed to open output file: " + output_path);
+    output_file << nlohmann::json(profile).dump(2) << '\n';
+    spdlog::info("Saved the profile to \"{}\"", output_path);
+  }
+}
+
 /********
  * Main *
  ********/
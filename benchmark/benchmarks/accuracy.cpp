@@ -0,0 +1,11 @@
+#include "../utils/accuracy.hpp"
+#include "../utils/benchmark_task.hpp"
+#include "../utils/results.hpp"
+
+REGISTER_BENCHMARK_TASK("CMS") { return cms_accuracy(parse_accuracy_args(argc, argv)); }
+
+REGISTER_BENCHMARK_TASK("ADA") { return ada_accuracy(parse_accuracy_args(argc, argv)); }
+
+REGISTER_BENCHMARK_TASK("EVO") { return evo_accuracy(parse_accuracy_args(argc, argv)); }
+
+BENCHMARK_TASK_MAIN();
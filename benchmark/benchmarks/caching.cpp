@@ -12,81 +12,54 @@
 #include <variant>
 #include <vector>
 
-#include <argparse/argparse.hpp>
 #include <fplus/fplus.hpp>
 
 #include "../../src/adapters/EpsilonGreedyAdapter.hpp"
 #include "../../src/sketch.hpp"
+#include "../../src/utils/random.hpp"
 #include "../baselines/AdaSketch.hpp"
 #include "../baselines/CountMinSketch.hpp"
 #include "../caching/FIFO.hpp"
 #include "../caching/W-TinyLFU.hpp"
+#include "../caching/args.hpp"
+#include "../caching/dense.hpp"
 #include "../caching/policy.hpp"
 #include "../caching/reader.hpp"
+#include "../caching/stream.hpp"
+#include "../utils/batch.hpp"
 #include "../utils/benchmark_task.hpp"
-#include "../utils/errors.hpp"
+#include "../utils/events.hpp"
+#include "../utils/key_index.hpp"
+#include "../utils/results.hpp"
 #include "../utils/sketch.hpp"
+#include "../utils/stats.hpp"
 
 using K = uint64_t;
 using V = uint64_t;
 
-struct Args {
-  std::string trace_path;
-  size_t cache_size;
-  size_t adapt_interval;
-  double alpha;
-  bool progress;
-  std::string trace;
-};
-
-auto parse_args(int argc, char **argv) -> Args {
-  argparse::ArgumentParser program;
-  program.add_argument("trace_path").help("The path to the cache trace file");
-  program.add_argument("cache_size").help("The cache size").scan<'u', size_t>();
-  program.add_argument("adapt_interval")
-      .help("The interval of adaptation (only used by EvolvingSketch)")
-      .scan<'u', size_t>();
-  program.add_argument("alpha")
-      .help("The initial alpha value for time-decaying sketches")
-      .scan<'g', double>();
-  program.add_argument("-p", "--progress").help("Show progress bar").flag();
-  program.add_argument("--trace")
-      .help("The path to a CSV file where the objective history is saved at each adapt_interval. "
-            "For W-TinyLFU_EVO, an additional 'parameter' (i.e., alpha) column is included.")
-      .default_value("");
-
-  try {
-    program.parse_args(argc, argv);
-    return {
-        .trace_path = program.get<std::string>("trace_path"),
-        .cache_size = program.get<size_t>("cache_size"),
-        .adapt_interval = program.get<size_t>("adapt_interval"),
-        .alpha = program.get<double>("alpha"),
-        .progress = program.get<bool>("--progress"),
-        .trace = program.get<std::string>("--trace"),
-    };
-  } catch (const std::exception &e) {
-    throw usage_error(program.help().str(), e.what());
-  }
-}
-
 struct Noop0 {
   void operator()() const noexcept {}
 };
 
-template <typename OnHit = Noop0>
-  requires std::is_invocable_r_v<void, OnHit>
-auto benchmark(CacheReplacementPolicy<K, V> &policy, const Args &args, OnHit on_hit = Noop0{})
-    -> double {
+struct Noop1 {
+  void operator()(const Request & /*req*/) const noexcept {}
+};
+
+template <typename CacheType, typename Trace, typename OnHit, typename OnRequest>
+  requires IsCache<CacheType> && std::is_invocable_r_v<void, OnHit> &&
+           std::is_invocable_r_v<void, OnRequest, const Request &>
+auto replay(const Trace &trace, CacheReplacementPolicy<K, V> &policy, const CachingArgs &args,
+            OnHit on_hit, OnRequest on_request) -> double {
   size_t hit_count = 0;
 
-  const CachingTrace trace(args.trace_path);
-  MockCache<K, V> cache(args.cache_size);
+  CacheType cache(args.cache_size);
 
   size_t progress = 0;
 
   if (args.trace.empty()) {
     for (const auto &req : trace) {
+      if constexpr (!std::same_as<OnRequest, Noop1>)
+        on_request(req);
       V value; // This is a dummy value
       if (cache.contains(req.obj_id)) {
         hit_count++;
@@ -107,6 +80,8 @@ auto benchmark(CacheReplacementPolicy<K, V> &policy, const Args &args, OnHit on_
     std::vector<double> history;
 
     for (const auto &req : trace) {
+      if constexpr (!std::same_as<OnRequest, Noop1>)
+        on_request(req);
       V value; // This is a dummy value
       if (cache.contains(req.obj_id)) {
         hit_count++;
@@ -146,74 +121,198 @@ auto benchmark(CacheReplacementPolicy<K, V> &policy, const Args &args, OnHit on_
   return static_cast<double>(trace.size() - hit_count) / static_cast<double>(trace.size());
 }
 
-REGISTER_BENCHMARK_TASK("FIFO") {
-  const Args args = parse_args(argc, argv);
-  FIFOPolicy<K, V> policy(args.cache_size);
-  return benchmark(policy, args);
+/**
+ * @brief Replay the trace through `policy`, together with the other tasks of a fan-out batch, or
+ * from the copy decoded once per process when the task runs in a batch, or else mapped from the
+ * file. Traces too large for memory are streamed through a few buffers instead, and never decoded
+ * whole. With dense IDs, requests carry them instead of object IDs, and the cache is an array.
+ */
+template <typename OnHit = Noop0, typename OnRequest = Noop1>
+  requires std::is_invocable_r_v<void, OnHit> &&
+           std::is_invocable_r_v<void, OnRequest, const Request &>
+auto benchmark(CacheReplacementPolicy<K, V> &policy, const CachingArgs &args,
+               OnHit on_hit = Noop0{}, OnRequest on_request = Noop1{}) -> double {
+  if (args.dense_ids) {
+    if (BenchmarkTask::fan_out)
+      return replay<DenseMockCache<K, V>>(
+          FanOutTrace<Request>::subscribe<DenseCachingTrace>(args.trace_path), policy, args, on_hit,
+          on_request);
+    if (BenchmarkTask::batched)
+      return replay<DenseMockCache<K, V>>(
+          *SharedTraces<Request>::get<DenseCachingTrace>(args.trace_path), policy, args, on_hit,
+          on_request);
+    return replay<DenseMockCache<K, V>>(DenseCachingTrace(args.trace_path), policy, args, on_hit,
+                                        on_request);
+  }
+  if (BenchmarkTask::fan_out) {
+    if (args.stream)
+      return replay<MockCache<K, V>>(
+          FanOutTrace<Request>::subscribe<StreamingCachingTrace>(args.trace_path), policy, args,
+          on_hit, on_request);
+    return replay<MockCache<K, V>>(FanOutTrace<Request>::subscribe<CachingTrace>(args.trace_path),
+                                   policy, args, on_hit, on_request);
+  }
+  if (args.stream)
+    return replay<MockCache<K, V>>(StreamingCachingTrace(args.trace_path), policy, args, on_hit,
+                                   on_request);
+  if (BenchmarkTask::batched)
+    return replay<MockCache<K, V>>(*SharedTraces<Request>::get<CachingTrace>(args.trace_path),
+                                   policy, args, on_hit, on_request);
+  return replay<MockCache<K, V>>(CachingTrace(args.trace_path), policy, args, on_hit, on_request);
+}
+
+/**
+ * @brief Call `fn` with `std::type_identity<Stats>` for the stats policy of the command line, as
+ * `with_stats()` does, and with `std::type_identity<Keys>` for the key index of `WTinyLFUPolicy`
+ * that matches the IDs replayed.
+ */
+template <typename Fn> auto with_policy_types(const CachingArgs &args, Fn &&fn) {
+  return with_stats(args.stats, [&]<typename Stats>(std::type_identity<Stats> stats) {
+    if (args.dense_ids)
+      return fn(stats, std::type_identity<DenseKeys>{});
+    return fn(stats, std::type_identity<HashKeys>{});
+  });
 }
 
 auto f(const uint32_t t, const double alpha) -> float {
   return static_cast<float>(std::exp(alpha * static_cast<double>(t) / 10000.0));
 }
 
+// Decay function for sketches driven by request timestamps (i.e., `DecayClock::SECONDS`), where
+// `t` is measured in seconds rather than in updates
+auto f_seconds(const uint32_t t, const double alpha) -> float {
+  return static_cast<float>(std::exp(alpha * static_cast<double>(t) / 3600.0));
+}
+
+REGISTER_BENCHMARK_TASK("FIFO") {
+  const CachingArgs args = parse_caching_args(argc, argv);
+  FIFOPolicy<K, V> policy(args.cache_size);
+  return sketchless_results(benchmark(policy, args));
+}
+
 REGISTER_BENCHMARK_TASK("W-TinyLFU_CMS") {
-  const Args args = parse_args(argc, argv);
-  WTinyLFUPolicy<K, V, CountMinSketch<K>> policy{
-      args.cache_size, std::make_shared<CountMinSketch<K>>(args.cache_size)};
-  const double miss_ratio = benchmark(policy, args);
-  return std::vector{miss_ratio, policy.update_time_avg_seconds(),
-                     policy.estimate_time_avg_seconds()};
+  const CachingArgs args = parse_caching_args(argc, argv);
+  return with_policy_types(args, [&]<typename Stats, typename Keys>(std::type_identity<Stats>,
+                                                                    std::type_identity<Keys>) {
+    using Sketch = CountMinSketch<K, Stats>;
+    auto sketch =
+        std::make_shared<Sketch>(args.cache_size, derive_seed(args.seed, SKETCH_SEED_STREAM));
+    WTinyLFUPolicy<K, V, Sketch, Keys> policy{args.cache_size, sketch};
+    const double miss_ratio = benchmark(policy, args);
+    return sketch_results(miss_ratio, *sketch);
+  });
 }
 
 REGISTER_BENCHMARK_TASK("W-TinyLFU_ADA") {
-  const Args args = parse_args(argc, argv);
+  const CachingArgs args = parse_caching_args(argc, argv);
   auto f2 = [alpha = args.alpha](uint32_t t) -> float { return f(t, alpha); };
-  WTinyLFUPolicy<K, V, AdaSketch<K, decltype(f2)>> policy{
-      args.cache_size, std::make_shared<AdaSketch<K, decltype(f2)>>(
-                           args.cache_size, AdaSketchOptions<decltype(f2)>{.f = f2})};
-  const double miss_ratio = benchmark(policy, args);
-  return std::vector{miss_ratio, policy.update_time_avg_seconds(),
-                     policy.estimate_time_avg_seconds()};
+  return with_policy_types(args, [&]<typename Stats, typename Keys>(std::type_identity<Stats>,
+                                                                    std::type_identity<Keys>) {
+    using Sketch = AdaSketch<K, decltype(f2), Stats>;
+    auto sketch = std::make_shared<Sketch>(
+        args.cache_size, AdaSketchOptions<decltype(f2)>{
+                             .f = f2, .seed = derive_seed(args.seed, SKETCH_SEED_STREAM)});
+    WTinyLFUPolicy<K, V, Sketch, Keys> policy{args.cache_size, sketch};
+    const double miss_ratio = benchmark(policy, args);
+    return sketch_results(miss_ratio, *sketch);
+  });
 }
 
 REGISTER_BENCHMARK_TASK("W-TinyLFU_EVO_PRUNING_ONLY") {
-  const Args args = parse_args(argc, argv);
+  const CachingArgs args = parse_caching_args(argc, argv);
+  const auto events = make_event_trace(args.events);
   auto f2 = [](uint32_t t, double alpha) -> float { return f(t, alpha); };
-  WTinyLFUPolicy<K, V, EvolvingSketch<K, decltype(f2)>> policy{
-      args.cache_size, std::make_shared<EvolvingSketch<K, decltype(f2)>>(
-                           args.cache_size, EvolvingSketchOptions<decltype(f2)>{
-                                                .initial_alpha = args.alpha, .f = f2})};
-  const double miss_ratio = benchmark(policy, args);
-  return std::vector{miss_ratio, policy.update_time_avg_seconds(),
-                     policy.estimate_time_avg_seconds()};
+  return with_policy_types(args, [&]<typename Stats, typename Keys>(std::type_identity<Stats>,
+                                                                    std::type_identity<Keys>) {
+    using Sketch = EvolvingSketch<K, decltype(f2), std::monostate, IdentityAdapter<std::monostate>,
+                                  Stats>;
+    auto sketch = std::make_shared<Sketch>(
+        args.cache_size,
+        EvolvingSketchOptions<decltype(f2)>{.initial_alpha = args.alpha,
+                                            .f = f2,
+                                            .events = events.get(),
+                                            .seed = derive_seed(args.seed, SKETCH_SEED_STREAM)});
+    WTinyLFUPolicy<K, V, Sketch, Keys> policy{args.cache_size, sketch};
+    const double miss_ratio = benchmark(policy, args);
+    save_event_trace(events, args.events);
+    return sketch_results(miss_ratio, *sketch);
+  });
 }
 
 REGISTER_BENCHMARK_TASK("W-TinyLFU_EVO") {
-  const Args args = parse_args(argc, argv);
+  const CachingArgs args = parse_caching_args(argc, argv);
 
-  EpsilonGreedyAdapter adapter{0.01, 1000.0, 100, 0.01, 0.99};
+  EpsilonGreedyAdapter adapter{0.01, 1000.0, 100, 0.01, 0.99,
+                               derive_seed(args.seed, ADAPTER_SEED_STREAM)};
 
   if (!args.trace.empty())
     adapter.start_recording_history();
+  const auto events = make_event_trace(args.events);
 
   auto f2 = [](uint32_t t, double alpha) -> float { return f(t, alpha); };
-  auto sketch = std::make_shared<EvolvingSketchOptim<K, decltype(f2)>>(
-      args.cache_size,
-      EvolvingSketchOptimOptions{.initial_alpha = args.alpha,
-                                 .f = f2,
-                                 .adapter = &adapter,
-                                 .adapt_interval = static_cast<uint32_t>(args.adapt_interval)});
-  WTinyLFUPolicy<K, V, EvolvingSketchOptim<K, decltype(f2)>> policy{args.cache_size, sketch};
-
-  Args benchmark_args = args;
-  benchmark_args.trace = ""; // Disable internal trace recording
-  const double miss_ratio = benchmark(policy, benchmark_args, [&]() { sketch->sum++; });
+  return with_policy_types(args, [&]<typename Stats, typename Keys>(std::type_identity<Stats>,
+                                                                    std::type_identity<Keys>) {
+    using Sketch = EvolvingSketchOptim<K, decltype(f2), size_t, Stats>;
+    auto sketch = std::make_shared<Sketch>(
+        args.cache_size,
+        EvolvingSketchOptimOptions{.initial_alpha = args.alpha,
+                                   .f = f2,
+                                   .adapter = &adapter,
+                                   .adapt_interval = static_cast<uint32_t>(args.adapt_interval),
+                                   .events = events.get(),
+                                   .seed = derive_seed(args.seed, SKETCH_SEED_STREAM)});
+    WTinyLFUPolicy<K, V, Sketch, Keys> policy{args.cache_size, sketch};
+
+    CachingArgs benchmark_args = args;
+    benchmark_args.trace = ""; // Disable internal trace recording
+    const double miss_ratio = benchmark(policy, benchmark_args, [&]() { sketch->sum++; });
+
+    if (!args.trace.empty())
+      adapter.save_history(std::filesystem::path{args.trace});
+    save_event_trace(events, args.events);
+
+    return sketch_results(miss_ratio, *sketch);
+  });
+}
 
-  if (!args.trace.empty())
-    adapter.save_history(std::filesystem::path{args.trace});
+REGISTER_BENCHMARK_TASK("W-TinyLFU_EVO_TIME") {
+  const CachingArgs args = parse_caching_args(argc, argv);
 
-  return std::vector{miss_ratio, policy.update_time_avg_seconds(),
-                     policy.estimate_time_avg_seconds()};
+  EpsilonGreedyAdapter adapter{0.01, 1000.0, 100, 0.01, 0.99,
+                               derive_seed(args.seed, ADAPTER_SEED_STREAM)};
+
+  if (!args.trace.empty())
+    adapter.start_recording_history();
+  const auto events = make_event_trace(args.events);
+
+  // Decay and adaptation are both driven by request timestamps, so `adapt_interval` is in seconds
+  auto f2 = [](uint32_t t, double alpha) -> float { return f_seconds(t, alpha); };
+  return with_policy_types(args, [&]<typename Stats, typename Keys>(std::type_identity<Stats>,
+                                                                    std::type_identity<Keys>) {
+    using Sketch = EvolvingSketchOptim<K, decltype(f2), size_t, Stats>;
+    auto sketch = std::make_shared<Sketch>(
+        args.cache_size,
+        EvolvingSketchOptimOptions{.initial_alpha = args.alpha,
+                                   .f = f2,
+                                   .adapter = &adapter,
+                                   .adapt_interval = static_cast<uint32_t>(args.adapt_interval),
+                                   .clock = DecayClock::SECONDS,
+                                   .events = events.get(),
+                                   .seed = derive_seed(args.seed, SKETCH_SEED_STREAM)});
+    WTinyLFUPolicy<K, V, Sketch, Keys> policy{args.cache_size, sketch};
+
+    CachingArgs benchmark_args = args;
+    benchmark_args.trace = ""; // Disable internal trace recording
+    const double miss_ratio = benchmark(
+        policy, benchmark_args, [&]() { sketch->sum++; },
+        [&](const Request &req) { sketch->advance_to(req.timestamp); });
+
+    if (!args.trace.empty())
+      adapter.save_history(std::filesystem::path{args.trace});
+    save_event_trace(events, args.events);
+
+    return sketch_results(miss_ratio, *sketch);
+  });
 }
 
 BENCHMARK_TASK_MAIN();
@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <latch>
+#include <memory>
+#include <random>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <argparse/argparse.hpp>
+
+#include "../../src/sketch.hpp"
+#include "../../src/utils/histogram.hpp"
+#include "../../src/utils/random.hpp"
+#include "../../src/utils/stats.hpp"
+#include "../utils/benchmark_task.hpp"
+#include "../utils/concurrent.hpp"
+#include "../utils/errors.hpp"
+#include "../utils/zipf.hpp"
+
+struct Args {
+  size_t threads;
+  size_t updates_per_estimate;
+  size_t size_bytes;
+  size_t ops;
+  size_t keys;
+  double theta;
+  size_t shards;
+  uint64_t seed;
+};
+
+auto parse_args(int argc, char **argv) -> Args {
+  argparse::ArgumentParser program;
+  program.add_argument("threads").help("The number of threads").scan<'u', size_t>();
+  program.add_argument("updates_per_estimate")
+      .help("The number of updates per estimate, e.g., 100 for a 100:1 mix")
+      .scan<'u', size_t>();
+  program.add_argument("size_bytes")
+      .help("The memory budget of the sketch in bytes (split between shards, if any)")
+      .scan<'u', size_t>();
+  program.add_argument("--ops")
+      .help("The number of operations per thread")
+      .default_value(size_t{1} << 21)
+      .scan<'u', size_t>();
+  program.add_argument("--keys")
+      .help("The number of distinct keys")
+      .default_value(size_t{1} << 20)
+      .scan<'u', size_t>();
+  program.add_argument("--theta")
+      .help("The exponent of the Zipf distribution of keys (0 for uniform)")
+      .default_value(0.99)
+      .scan<'g', double>();
+  program.add_argument("--shards")
+      .help("The number of shards of sharded sketches (0 for 4 per thread)")
+      .default_value(size_t{0})
+      .scan<'u', size_t>();
+  program.add_argument("--seed")
+      .help("The seed of the key streams and of the row hashes of sketches")
+      .default_value(uint64_t{42})
+      .scan<'u', uint64_t>();
+
+  try {
+    program.parse_args(argc, argv);
+    Args args{
+        .threads = program.get<size_t>("threads"),
+        .updates_per_estimate = program.get<size_t>("updates_per_estimate"),
+        .size_bytes = program.get<size_t>("size_bytes"),
+        .ops = program.get<size_t>("--ops"),
+        .keys = program.get<size_t>("--keys"),
+        .theta = program.get<double>("--theta"),
+        .shards = program.get<size_t>("--shards"),
+        .seed = program.get<uint64_t>("--seed"),
+    };
+    if (args.threads == 0)
+      throw std::invalid_argument("At least one thread is required");
+    if (args.shards == 0)
+      args.shards = 4 * args.threads;
+    return args;
+  } catch (const std::exception &e) {
+    throw usage_error(program.help().str(), e.what());
+  }
+}
+
+// Time one in this many operations of each thread, so that reading the clock does not dominate
+inline constexpr size_t LATENCY_SAMPLE_PERIOD = 16;
+
+/**
+ * @brief Run `args.threads` pinned threads issuing a mix of updates and estimates against
+ * `sketch`, all starting at once.
+ *
+ * @return The results in the layout described by `CONCURRENCY_QUANTILES`.
+ */
+template <typename Concurrent>
+auto benchmark(Concurrent &sketch, const Args &args) -> std::vector<double> {
+  const ZipfGenerator generator(args.keys, args.theta);
+  std::vector<std::vector<uint64_t>> keys(args.threads);
+  for (size_t i = 0; i < args.threads; i++) {
+    std::mt19937_64 rng{derive_seed(args.seed, KEYS_SEED_STREAM + i)};
+    keys[i] = generator.generate(args.ops, rng);
+  }
+
+  std::vector<std::unique_ptr<LatencyHistogram<>>> latencies(args.threads);
+  for (auto &histogram : latencies)
+    histogram = std::make_unique<LatencyHistogram<>>();
+
+  std::latch ready(static_cast<std::ptrdiff_t>(args.threads) + 1);
+  std::latch done(static_cast<std::ptrdiff_t>(args.threads));
+  std::atomic<double> sink = 0.0;
+  std::vector<std::jthread> threads;
+  for (size_t i = 0; i < args.threads; i++)
+    threads.emplace_back([&, i] {
+      pin_to_core(i);
+      auto &histogram = *latencies[i];
+      double sum = 0.0;
+      ready.arrive_and_wait();
+      for (size_t j = 0; j < keys[i].size(); j++) {
+        const bool sampled = j % LATENCY_SAMPLE_PERIOD == 0;
+        const auto start = sampled ? read_cycles() : 0;
+        if (j % (args.updates_per_estimate + 1) == args.updates_per_estimate)
+          sum += sketch.estimate(keys[i][j]);
+        else
+          sketch.update(keys[i][j]);
+        if (sampled)
+          histogram.record(read_cycles() - start);
+      }
+      sink.fetch_add(sum, std::memory_order_relaxed);
+      done.count_down();
+    });
+
+  ready.arrive_and_wait();
+  const auto start = std::chrono::steady_clock::now();
+  done.wait();
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  threads.clear();
+
+  std::vector<double> results{static_cast<double>(args.threads * args.ops) / seconds / 1e6};
+  for (const auto quantile : CONCURRENCY_QUANTILES) {
+    uint64_t worst = 0;
+    for (const auto &histogram : latencies)
+      worst = std::max(worst, histogram->value_at(quantile));
+    results.push_back(static_cast<double>(worst) / cycles_per_second());
+  }
+  return results;
+}
+
+auto f(const uint32_t t, const double alpha) -> float {
+  return static_cast<float>(std::exp(alpha * static_cast<double>(t) / 10000.0));
+}
+
+using Sketch = EvolvingSketch<uint64_t, decltype(&f)>;
+
+auto make_sketch(const size_t size_bytes, const uint64_t seed) -> Sketch {
+  return Sketch(MemoryBudget{size_bytes},
+                {.initial_alpha = 1.0, .f = f, .seed = derive_seed(seed, SKETCH_SEED_STREAM)});
+}
+
+REGISTER_BENCHMARK_TASK("MUTEX") {
+  const Args args = parse_args(argc, argv);
+  LockedSketch<Sketch> sketch(make_sketch(args.size_bytes, args.seed));
+  return benchmark(sketch, args);
+}
+
+REGISTER_BENCHMARK_TASK("RW_LOCK") {
+  const Args args = parse_args(argc, argv);
+  LockedSketch<Sketch, std::shared_mutex> sketch(make_sketch(args.size_bytes, args.seed));
+  return benchmark(sketch, args);
+}
+
+REGISTER_BENCHMARK_TASK("SHARDED") {
+  const Args args = parse_args(argc, argv);
+  ShardedSketch<Sketch> sketch(
+      args.shards, [&] { return make_sketch(args.size_bytes / args.shards, args.seed); });
+  return benchmark(sketch, args);
+}
+
+REGISTER_BENCHMARK_TASK("SHARDED_PACKED") {
+  const Args args = parse_args(argc, argv);
+  ShardedSketch<Sketch, false> sketch(
+      args.shards, [&] { return make_sketch(args.size_bytes / args.shards, args.seed); });
+  return benchmark(sketch, args);
+}
+
+BENCHMARK_TASK_MAIN();
@@ -4,22 +4,32 @@
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <optional>
 #include <set>
 #include <stdexcept>
 #include <string>
 #include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <variant>
 
 #include <argparse/argparse.hpp>
 
 #include "../../src/adapters/EpsilonGreedyAdapter.hpp"
 #include "../../src/sketch.hpp"
+#include "../../src/utils/random.hpp"
 #include "../baselines/AdaSketch.hpp"
 #include "../baselines/CountMinSketch.hpp"
 #include "../hm/reader.hpp"
+#include "../utils/batch.hpp"
 #include "../utils/benchmark_task.hpp"
 #include "../utils/errors.hpp"
+#include "../utils/events.hpp"
+#include "../utils/memory.hpp"
+#include "../utils/results.hpp"
 #include "../utils/sketch.hpp"
+#include "../utils/stats.hpp"
 
 using T = uint32_t;
 
@@ -31,6 +41,9 @@ struct Args {
   double alpha;
   bool progress;
   std::string trace;
+  std::string stats;
+  std::string events;
+  std::optional<uint64_t> seed;
 };
 
 template <typename Freq> struct FreqCompare {
@@ -58,6 +71,19 @@ auto parse_args(int argc, char **argv) -> Args {
       .help("The path to a CSV file where the objective history is saved at each adapt_interval. "
             "For EVO, an additional 'parameter' (i.e., alpha) column is included.")
       .default_value("");
+  program.add_argument("--stats")
+      .help("What sketches record about their operations: 'none', 'counting' (calls only), "
+            "'sampled' (cycles of one in 64 calls), or 'full' (cycles of every call)")
+      .choices(STATS_NONE, STATS_COUNTING, STATS_SAMPLED, STATS_FULL)
+      .default_value(std::string(STATS_SAMPLED));
+  program.add_argument("--events")
+      .help("The path to a JSON file where the prunes and adaptations of EVO* are saved as a "
+            "Chrome trace")
+      .default_value("");
+  program.add_argument("--seed")
+      .help("The seed of the row hashes of sketches and of the choices of adapters, which are "
+            "nondeterministic without one")
+      .scan<'u', uint64_t>();
 
   try {
     program.parse_args(argc, argv);
@@ -69,6 +95,9 @@ auto parse_args(int argc, char **argv) -> Args {
         .alpha = program.get<double>("alpha"),
         .progress = program.get<bool>("--progress"),
         .trace = program.get<std::string>("--trace"),
+        .stats = program.get<std::string>("--stats"),
+        .events = program.get<std::string>("--events"),
+        .seed = program.present<uint64_t>("--seed"),
     };
   } catch (const std::exception &e) {
     throw usage_error(program.help().str(), e.what());
@@ -79,19 +108,26 @@ struct Noop0 {
   void operator()(size_t rank) const noexcept {}
 };
 
-template <typename Sketch, typename OnHit = Noop0>
+/**
+ * @brief Replay `trace` into `sketch`, where `unique_products` is the number of products of the
+ * trace, which only the history of the objective needs (see `--trace`).
+ */
+template <typename Trace, typename Sketch, typename OnHit>
   requires std::is_invocable_r_v<void, OnHit, size_t>
-auto benchmark(Sketch &sketch, const Args &args, OnHit on_hit = Noop0{}) -> double {
+auto replay(const Trace &trace, Sketch &sketch, const Args &args, const size_t unique_products,
+            OnHit on_hit) -> double {
   using Freq = decltype(sketch.estimate(0));
 
   double dcg = 0;
 
-  const TransactionTrace trace(args.trace_path);
-
   size_t progress = 0;
 
-  std::set<std::pair</* product_code */ uint32_t, /* freq */ Freq>, FreqCompare<Freq>> top_k;
-  std::unordered_map</* product_code */ uint32_t, /* freq */ Freq> product_code2freq_in_top_k;
+  // Both count as policy metadata, as the top-k tracking plays the role of the replacement policy
+  using Entry = std::pair</* product_code */ uint32_t, /* freq */ Freq>;
+  std::set<Entry, FreqCompare<Freq>, PolicyAllocator<Entry>> top_k;
+  std::unordered_map</* product_code */ uint32_t, /* freq */ Freq, std::hash<uint32_t>,
+                     std::equal_to<uint32_t>, PolicyAllocator<std::pair<const uint32_t, Freq>>>
+      product_code2freq_in_top_k;
 
   if (args.trace.empty()) {
     for (const auto &trans : trace) {
@@ -104,9 +140,8 @@ auto benchmark(Sketch &sketch, const Args &args, OnHit on_hit = Noop0{}) -> doub
         dcg += 1.0 / std::log2(rank + 1);
         if constexpr (!std::same_as<OnHit, Noop0>)
           on_hit(rank);
-        sketch.update(product);
         top_k.erase({product, product_code2freq_in_top_k[product]});
-        const auto freq = sketch.estimate(product);
+        const auto freq = sketch.update_and_estimate(product);
         product_code2freq_in_top_k[product] = freq;
         top_k.emplace(product, freq);
 
@@ -118,8 +153,7 @@ auto benchmark(Sketch &sketch, const Args &args, OnHit on_hit = Noop0{}) -> doub
         continue;
       }
 
-      sketch.update(product);
-      const auto freq = sketch.estimate(product);
+      const auto freq = sketch.update_and_estimate(product);
 
       if (top_k.size() < args.top_k) {
         top_k.emplace(product, freq);
@@ -181,9 +215,8 @@ auto benchmark(Sketch &sketch, const Args &args, OnHit on_hit = Noop0{}) -> doub
         dcg_curr += 1.0 / std::log2(rank + 1);
         if constexpr (!std::same_as<OnHit, Noop0>)
           on_hit(rank);
-        sketch.update(product);
         top_k.erase({product, product_code2freq_in_top_k[product]});
-        const auto freq = sketch.estimate(product);
+        const auto freq = sketch.update_and_estimate(product);
         product_code2freq_in_top_k[product] = freq;
         top_k.emplace(product, freq);
 
@@ -202,8 +235,7 @@ auto benchmark(Sketch &sketch, const Args &args, OnHit on_hit = Noop0{}) -> doub
         continue;
       }
 
-      sketch.update(product);
-      const auto freq = sketch.estimate(product);
+      const auto freq = sketch.update_and_estimate(product);
 
       if (top_k.size() < args.top_k) {
         top_k.emplace(product, freq);
@@ -284,8 +316,6 @@ auto benchmark(Sketch &sketch, const Args &args, OnHit on_hit = Noop0{}) -> doub
     const size_t approx_min = 5;
     burn = std::max(approx1, approx_min);
     // Also scale by unique_products/cache_size ratio to avoid excessive burn on tiny traces
-    const TransactionTrace trace(args.trace_path);
-    const size_t unique_products = count_unique_products(trace);
     if (unique_products > 0) {
       const double ratio = static_cast<double>(unique_products) /
                            std::max(1.0, static_cast<double>(args.cache_size));
@@ -305,57 +335,99 @@ auto benchmark(Sketch &sketch, const Args &args, OnHit on_hit = Noop0{}) -> doub
   return dcg;
 }
 
+/**
+ * @brief Replay the trace into `sketch`, together with the other tasks of a fan-out batch, or from
+ * the copy decoded once per process when the task runs in a batch, or else streamed from the file.
+ */
+template <typename Sketch, typename OnHit = Noop0>
+  requires std::is_invocable_r_v<void, OnHit, size_t>
+auto benchmark(Sketch &sketch, const Args &args, OnHit on_hit = Noop0{}) -> double {
+  // Counted from the profile of the trace before replaying it, rather than in a turn of a fan-out
+  // replay that all other tasks would wait for
+  const size_t unique_products =
+      args.trace.empty() ? 0 : count_unique_products(TransactionTrace(args.trace_path));
+  if (BenchmarkTask::fan_out)
+    return replay(FanOutTrace<Transaction>::subscribe<TransactionTrace>(args.trace_path), sketch,
+                  args, unique_products, on_hit);
+  if (BenchmarkTask::batched)
+    return replay(*SharedTraces<Transaction>::get<TransactionTrace>(args.trace_path), sketch, args,
+                  unique_products, on_hit);
+  return replay(TransactionTrace(args.trace_path), sketch, args, unique_products, on_hit);
+}
+
 auto f(const uint32_t t, const double alpha) -> float {
   return static_cast<float>(std::exp(alpha * static_cast<double>(t) / 10000.0));
 }
 
 REGISTER_BENCHMARK_TASK("CMS") {
   const Args args = parse_args(argc, argv);
-  CountMinSketch<T> sketch(args.cache_size);
-  const double dcg = benchmark(sketch, args);
-  return std::vector{dcg, sketch.update_time_avg_seconds(), sketch.estimate_time_avg_seconds()};
+  return with_stats(args.stats, [&]<typename Stats>(std::type_identity<Stats>) {
+    CountMinSketch<T, Stats> sketch(args.cache_size, derive_seed(args.seed, SKETCH_SEED_STREAM));
+    const double dcg = benchmark(sketch, args);
+    return sketch_results(dcg, sketch);
+  });
 }
 
 REGISTER_BENCHMARK_TASK("ADA") {
   const Args args = parse_args(argc, argv);
   auto f2 = [alpha = args.alpha](uint32_t t) -> float { return f(t, alpha); };
-  AdaSketch<T, decltype(f2)> sketch(args.cache_size, AdaSketchOptions<decltype(f2)>{.f = f2});
-  const double dcg = benchmark(sketch, args);
-  return std::vector{dcg, sketch.update_time_avg_seconds(), sketch.estimate_time_avg_seconds()};
+  return with_stats(args.stats, [&]<typename Stats>(std::type_identity<Stats>) {
+    AdaSketch<T, decltype(f2), Stats> sketch(
+        args.cache_size,
+        AdaSketchOptions<decltype(f2)>{.f = f2,
+                                       .seed = derive_seed(args.seed, SKETCH_SEED_STREAM)});
+    const double dcg = benchmark(sketch, args);
+    return sketch_results(dcg, sketch);
+  });
 }
 
 REGISTER_BENCHMARK_TASK("EVO_PRUNING_ONLY") {
   const Args args = parse_args(argc, argv);
+  const auto events = make_event_trace(args.events);
   auto f2 = [](uint32_t t, double alpha) -> float { return f(t, alpha); };
-  EvolvingSketch<T, decltype(f2)> sketch(args.cache_size, {.initial_alpha = args.alpha, .f = f2});
-  const double dcg = benchmark(sketch, args);
-  return std::vector{dcg, sketch.update_time_avg_seconds(), sketch.estimate_time_avg_seconds()};
+  return with_stats(args.stats, [&]<typename Stats>(std::type_identity<Stats>) {
+    EvolvingSketch<T, decltype(f2), std::monostate, IdentityAdapter<std::monostate>, Stats> sketch(
+        args.cache_size, {.initial_alpha = args.alpha,
+                          .f = f2,
+                          .events = events.get(),
+                          .seed = derive_seed(args.seed, SKETCH_SEED_STREAM)});
+    const double dcg = benchmark(sketch, args);
+    save_event_trace(events, args.events);
+    return sketch_results(dcg, sketch);
+  });
 }
 
 REGISTER_BENCHMARK_TASK("EVO") {
   const Args args = parse_args(argc, argv);
 
-  EpsilonGreedyAdapter adapter{0.01, 1000.0, 100, 0.01, 0.99};
+  EpsilonGreedyAdapter adapter{0.01, 1000.0, 100, 0.01, 0.99,
+                               derive_seed(args.seed, ADAPTER_SEED_STREAM)};
 
   if (!args.trace.empty())
     adapter.start_recording_history();
+  const auto events = make_event_trace(args.events);
 
   auto f2 = [](uint32_t t, double alpha) -> float { return f(t, alpha); };
-  EvolvingSketchOptim<T, decltype(f2), double> sketch(
-      args.cache_size, {.initial_alpha = args.alpha,
-                        .f = f2,
-                        .adapter = &adapter,
-                        .adapt_interval = static_cast<uint32_t>(args.adapt_interval)});
-
-  Args benchmark_args = args;
-  benchmark_args.trace = ""; // Disable internal trace recording
-  const double dcg = benchmark(sketch, benchmark_args,
-                               [&](size_t rank) { sketch.sum += 1.0 / std::log2(rank + 1); });
-
-  if (!args.trace.empty())
-    adapter.save_history(std::filesystem::path{args.trace});
-
-  return std::vector{dcg, sketch.update_time_avg_seconds(), sketch.estimate_time_avg_seconds()};
+  return with_stats(args.stats, [&]<typename Stats>(std::type_identity<Stats>) {
+    EvolvingSketchOptim<T, decltype(f2), double, Stats> sketch(
+        args.cache_size, {.initial_alpha = args.alpha,
+                          .f = f2,
+                          .adapter = &adapter,
+                          .adapt_interval = static_cast<uint32_t>(args.adapt_interval),
+                          .events = events.get(),
+                          .seed = derive_seed(args.seed, SKETCH_SEED_STREAM)});
+
+    Args benchmark_args = args;
+    benchmark_args.trace = ""; // Disable internal trace recording
+    const double dcg = benchmark(sketch, benchmark_args,
+                                 [&](size_t rank) { sketch.sum += 1.0 / std::log2(rank + 1); });
+
+    if (!args.trace.empty())
+      adapter.save_history(std::filesystem::path{args.trace});
+    save_event_trace(events, args.events);
+
+    return sketch_results(dcg, sketch);
+  });
 }
 
 BENCHMARK_TASK_MAIN();
@@ -0,0 +1,150 @@
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <argparse/argparse.hpp>
+
+#include "../../src/sketch.hpp"
+#include "../../src/utils/random.hpp"
+#include "../baselines/AdaSketch.hpp"
+#include "../baselines/CountMinSketch.hpp"
+#include "../utils/benchmark_task.hpp"
+#include "../utils/errors.hpp"
+#include "../utils/perf.hpp"
+#include "../utils/results.hpp"
+#include "../utils/sketch.hpp"
+#include "../utils/zipf.hpp"
+
+struct Args {
+  size_t size_bytes;
+  double theta;
+  size_t keys;
+  size_t ops;
+  uint64_t seed;
+};
+
+auto parse_args(int argc, char **argv) -> Args {
+  argparse::ArgumentParser program;
+  program.add_argument("size_bytes")
+      .help("The memory budget of the sketch in bytes")
+      .scan<'u', size_t>();
+  program.add_argument("theta")
+      .help("The exponent of the Zipf distribution of keys (0 for uniform)")
+      .scan<'g', double>();
+  program.add_argument("--keys")
+      .help("The number of distinct keys")
+      .default_value(size_t{1} << 20)
+      .scan<'u', size_t>();
+  program.add_argument("--ops")
+      .help("The number of calls timed per operation")
+      .default_value(size_t{1} << 22)
+      .scan<'u', size_t>();
+  program.add_argument("--seed")
+      .help("The seed of the key stream and of the row hashes of the sketch")
+      .default_value(uint64_t{42})
+      .scan<'u', uint64_t>();
+
+  try {
+    program.parse_args(argc, argv);
+    return {
+        .size_bytes = program.get<size_t>("size_bytes"),
+        .theta = program.get<double>("theta"),
+        .keys = program.get<size_t>("--keys"),
+        .ops = program.get<size_t>("--ops"),
+        .seed = program.get<uint64_t>("--seed"),
+    };
+  } catch (const std::exception &e) {
+    throw usage_error(program.help().str(), e.what());
+  }
+}
+
+/**
+ * @brief Append the time and hardware events per call of a timed loop to `results`.
+ */
+void append_per_op(std::vector<double> &results, const PerfReading &reading, const size_t ops) {
+  const auto n = static_cast<double>(ops);
+  results.push_back(reading.seconds * 1e9 / n);
+  for (const auto &count : reading.counts)
+    results.push_back(count ? *count / n : std::numeric_limits<double>::quiet_NaN());
+}
+
+/**
+ * @brief Time each operation of `sketch` (in the order of `MICRO_OPS`) over the same key stream.
+ */
+template <typename Sketch> auto benchmark(Sketch &sketch, const Args &args) -> std::vector<double> {
+  std::mt19937_64 rng{args.seed};
+  const auto keys = ZipfGenerator(args.keys, args.theta).generate(args.ops, rng);
+
+  // Warm up the caches and the TLB, and fill the counters so that estimates are not all zero
+  for (const auto key : keys)
+    sketch.update(key);
+
+  PerfCounters counters;
+  std::vector<double> results;
+
+  counters.start();
+  for (const auto key : keys)
+    sketch.update(key);
+  append_per_op(results, counters.stop(), keys.size());
+
+  double sum = 0.0;
+  counters.start();
+  for (const auto key : keys)
+    sum += sketch.estimate(key);
+  append_per_op(results, counters.stop(), keys.size());
+
+  counters.start();
+  for (const auto key : keys)
+    sum += sketch.update_and_estimate(key);
+  append_per_op(results, counters.stop(), keys.size());
+
+  // Keep the estimates from being optimized away
+  [[maybe_unused]] volatile double sink = sum;
+
+  return results;
+}
+
+auto f(const uint32_t t, const double alpha) -> float {
+  return static_cast<float>(std::exp(alpha * static_cast<double>(t) / 10000.0));
+}
+
+REGISTER_BENCHMARK_TASK("CMS") {
+  const Args args = parse_args(argc, argv);
+  CountMinSketch<uint64_t> sketch(MemoryBudget{args.size_bytes},
+                                  derive_seed(args.seed, SKETCH_SEED_STREAM));
+  return benchmark(sketch, args);
+}
+
+REGISTER_BENCHMARK_TASK("ADA") {
+  const Args args = parse_args(argc, argv);
+  auto f2 = [](uint32_t t) -> float { return f(t, 1.0); };
+  AdaSketch<uint64_t, decltype(f2)> sketch(
+      MemoryBudget{args.size_bytes},
+      {.f = f2, .seed = derive_seed(args.seed, SKETCH_SEED_STREAM)});
+  return benchmark(sketch, args);
+}
+
+REGISTER_BENCHMARK_TASK("EVO") {
+  const Args args = parse_args(argc, argv);
+  auto f2 = [](uint32_t t, double alpha) -> float { return f(t, alpha); };
+  EvolvingSketch<uint64_t, decltype(f2)> sketch(
+      MemoryBudget{args.size_bytes},
+      {.initial_alpha = 1.0, .f = f2, .seed = derive_seed(args.seed, SKETCH_SEED_STREAM)});
+  return benchmark(sketch, args);
+}
+
+REGISTER_BENCHMARK_TASK("EVO_OPTIM") {
+  const Args args = parse_args(argc, argv);
+  auto f2 = [](uint32_t t, double alpha) -> float { return f(t, alpha); };
+  EvolvingSketchOptim<uint64_t, decltype(f2)> sketch(
+      MemoryBudget{args.size_bytes},
+      {.initial_alpha = 1.0, .f = f2, .seed = derive_seed(args.seed, SKETCH_SEED_STREAM)});
+  return benchmark(sketch, args);
+}
+
+BENCHMARK_TASK_MAIN();
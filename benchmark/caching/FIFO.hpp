@@ -3,6 +3,7 @@
 #include <cstddef>
 
 #include "../utils/fifo.hpp"
+#include "../utils/memory.hpp"
 #include "policy.hpp"
 
 template <typename K, typename V> class FIFOPolicy : public CacheReplacementPolicy<K, V> {
@@ -24,5 +25,5 @@ public:
   }
 
 private:
-  RingBufferFIFO<K> queue_;
+  RingBufferFIFO<K, PolicyAllocator<K>> queue_;
 };
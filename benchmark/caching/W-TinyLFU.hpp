@@ -3,11 +3,12 @@
 #include <cstddef>
 #include <cstdint>
 #include <memory>
-#include <unordered_map>
 
 #include <spdlog/spdlog.h>
 
+#include "../utils/key_index.hpp"
 #include "../utils/list.hpp"
+#include "../utils/memory.hpp"
 #include "policy.hpp"
 
 enum class WTinyLFUNodeType : uint8_t { WINDOW, PROBATION, PROTECTED };
@@ -20,7 +21,10 @@ template <typename K> struct WTinyLFUNodeValue {
 // [ToS'17] TinyLFU: A Highly Efficient Cache Admission Policy
 // * Link: https://dl.acm.org/doi/abs/10.1145/3149371
 // * Paper: https://dl.acm.org/doi/pdf/10.1145/3149371
-template <typename K, typename V, typename Sketch>
+//
+// `Keys` is how nodes are looked up by key (see `key_index.hpp`), i.e., `DenseKeys` for the dense
+// IDs of `DenseCachingTrace`.
+template <typename K, typename V, typename Sketch, typename Keys = HashKeys>
 class WTinyLFUPolicy : public CacheReplacementPolicy<K, V> {
 private:
   static constexpr double WINDOW_SIZE_RATIO = 0.01;
@@ -68,8 +72,8 @@ public:
 
     if (window_list_.size() == k_max_window_size_) {
       if (probation_list_.size() == k_max_probation_size_) {
-        if (sketch_->estimate(window_list_.tail()->value.key) >
-            sketch_->estimate(probation_list_.tail()->value.key)) {
+        if (sketch_->compare(window_list_.tail()->value.key,
+                             probation_list_.tail()->value.key) > 0) {
           // Move window list tail to probation list and change its type
           auto *node = window_list_.transfer_tail_to_head_of(probation_list_);
           node->value.type = PROBATION;
@@ -110,11 +114,15 @@ private:
   size_t k_max_probation_size_;
   size_t k_max_protected_size_;
 
-  DoublyLinkedList<WTinyLFUNodeValue<K>> window_list_;
-  DoublyLinkedList<WTinyLFUNodeValue<K>> probation_list_;
-  DoublyLinkedList<WTinyLFUNodeValue<K>> protected_list_;
+  using List = DoublyLinkedList<WTinyLFUNodeValue<K>, PolicyAllocator<Node<WTinyLFUNodeValue<K>>>>;
 
-  std::unordered_map<K, Node<WTinyLFUNodeValue<K>> *> key2node_;
+  List window_list_;
+  List probation_list_;
+  List protected_list_;
+
+  typename Keys::template index<K, Node<WTinyLFUNodeValue<K>> *,
+                                PolicyAllocator<Node<WTinyLFUNodeValue<K>> *>>
+      key2node_;
 
   std::shared_ptr<Sketch> sketch_;
 };
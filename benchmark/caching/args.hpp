@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include <argparse/argparse.hpp>
+
+#include "../utils/errors.hpp"
+#include "../utils/stats.hpp"
+#include "stream.hpp"
+
+/**
+ * @brief The arguments of the caching benchmark tasks.
+ */
+struct CachingArgs {
+  std::string trace_path;
+  size_t cache_size;
+  size_t adapt_interval;
+  double alpha;
+  bool progress;
+  std::string trace;
+  std::string stats;
+  std::string events;
+  std::optional<uint64_t> seed;
+  bool stream;
+  bool dense_ids;
+};
+
+inline auto parse_caching_args(int argc, char **argv) -> CachingArgs {
+  argparse::ArgumentParser program;
+  program.add_argument("trace_path").help("The path to the cache trace file");
+  program.add_argument("cache_size").help("The cache size").scan<'u', size_t>();
+  program.add_argument("adapt_interval")
+      .help("The interval of adaptation (only used by EvolvingSketch; in seconds for "
+            "W-TinyLFU_EVO_TIME)")
+      .scan<'u', size_t>();
+  program.add_argument("alpha")
+      .help("The initial alpha value for time-decaying sketches")
+      .scan<'g', double>();
+  program.add_argument("-p", "--progress").help("Show progress bar").flag();
+  program.add_argument("--trace")
+      .help("The path to a CSV file where the objective history is saved at each adapt_interval. "
+            "For W-TinyLFU_EVO, an additional 'parameter' (i.e., alpha) column is included.")
+      .default_value("");
+  program.add_argument("--stats")
+      .help("What sketches record about their operations: 'none', 'counting' (calls only), "
+            "'sampled' (cycles of one in 64 calls), or 'full' (cycles of every call)")
+      .choices(STATS_NONE, STATS_COUNTING, STATS_SAMPLED, STATS_FULL)
+      .default_value(std::string(STATS_SAMPLED));
+  program.add_argument("--events")
+      .help("The path to a JSON file where the prunes and adaptations of W-TinyLFU_EVO* are saved "
+            "as a Chrome trace")
+      .default_value("");
+  program.add_argument("--seed")
+      .help("The seed of the row hashes of sketches and of the choices of adapters, which are "
+            "nondeterministic without one")
+      .scan<'u', uint64_t>();
+  program.add_argument("--stream")
+      .help("Stream the trace through a few buffers instead of mapping it, which is the default "
+            "for traces larger than half of the available memory")
+      .flag();
+  program.add_argument("--dense-ids")
+      .help("Replay dense object IDs, numbered once per trace under .cache/benchmark, so that the "
+            "cache and W-TinyLFU index arrays instead of hash tables. Sketches then hash the dense "
+            "IDs, and the arrays span every object of the trace rather than the cached ones.")
+      .flag();
+
+  try {
+    program.parse_args(argc, argv);
+    const bool dense_ids = program.get<bool>("--dense-ids");
+    if (dense_ids && program.get<bool>("--stream"))
+      throw std::invalid_argument("--dense-ids and --stream are mutually exclusive");
+    return {
+        .trace_path = program.get<std::string>("trace_path"),
+        .cache_size = program.get<size_t>("cache_size"),
+        .adapt_interval = program.get<size_t>("adapt_interval"),
+        .alpha = program.get<double>("alpha"),
+        .progress = program.get<bool>("--progress"),
+        .trace = program.get<std::string>("--trace"),
+        .stats = program.get<std::string>("--stats"),
+        .events = program.get<std::string>("--events"),
+        .seed = program.present<uint64_t>("--seed"),
+        .stream = program.get<bool>("--stream") ||
+                  (!dense_ids && prefer_streaming(program.get<std::string>("trace_path"))),
+        .dense_ids = dense_ids,
+    };
+  } catch (const std::exception &e) {
+    throw usage_error(program.help().str(), e.what());
+  }
+}
@@ -0,0 +1,410 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <ios>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <mio/mmap.hpp>
+
+#if defined(BENCHMARK_HAS_ZSTD)
+#include <zstd.h>
+#endif
+
+/*
+ * The compact trace format, a block-based alternative to `.oracleGeneral` that `CachingTrace` reads
+ * transparently, laid out as
+ *
+ *   CompactTraceHeader
+ *   block 0, block 1, ...              (each optionally compressed with zstd)
+ *   CompactBlockInfo[num_blocks]       (at `index_offset`, for seeking to any block)
+ *   uint64_t dictionary[num_objects]   (at `dictionary_offset`, the object ID of each dense ID)
+ *
+ * Objects are numbered densely in order of first request. Each block holds three bit-packed columns
+ * of `num_records` values, each `width` bits wide and followed by 8 bytes of padding: the zigzag
+ * deltas of timestamps from the previous request (or from `first_timestamp`), the dense IDs, and
+ * the object sizes minus `min_size` (only if the trace has sizes, or else every object has size 1).
+ * Next access times, which no benchmark reads, are not stored.
+ *
+ * Packing every value of a column at the same width, unlike varints, decodes without branches, and
+ * the width adapts to each block, so a block of small deltas or of popular objects stays small.
+ */
+
+inline constexpr std::array<char, 8> COMPACT_TRACE_MAGIC = {'C', 'T', 'R', 'A', 'C', 'E', 0, 1};
+inline constexpr uint32_t COMPACT_TRACE_VERSION = 1;
+
+struct CompactTraceHeader {
+  static constexpr uint32_t HAS_SIZES = 1U << 0;
+  static constexpr uint32_t ZSTD = 1U << 1;
+
+  std::array<char, 8> magic = COMPACT_TRACE_MAGIC;
+  uint32_t version = COMPACT_TRACE_VERSION;
+  uint32_t flags = 0;
+  uint64_t num_entries = 0;
+  uint64_t num_objects = 0;
+  uint32_t block_records = 0; // Records per block, but for the last one
+  uint32_t num_blocks = 0;
+  uint64_t index_offset = 0;
+  uint64_t dictionary_offset = 0;
+};
+
+struct CompactBlockInfo {
+  uint64_t offset = 0;       // Of the block in the file
+  uint32_t stored_bytes = 0; // In the file, i.e., compressed if the trace is
+  uint32_t raw_bytes = 0;    // Of the packed columns
+  uint32_t num_records = 0;
+  uint32_t first_timestamp = 0;
+  uint32_t min_size = 0;
+  uint8_t timestamp_width = 0;
+  uint8_t id_width = 0;
+  uint8_t size_width = 0;
+  uint8_t reserved = 0;
+};
+
+static_assert(sizeof(CompactTraceHeader) == 56 && sizeof(CompactBlockInfo) == 32);
+
+/**
+ * @brief Whether the file at `path` is a compact trace rather than an `.oracleGeneral` one.
+ */
+[[nodiscard]] inline auto is_compact_trace(const std::filesystem::path &path) -> bool {
+  std::ifstream file(path, std::ios::binary);
+  std::array<char, 8> magic{};
+  return file.read(magic.data(), magic.size()) && magic == COMPACT_TRACE_MAGIC;
+}
+
+namespace detail {
+
+// Bytes of a column of `count` values of `width` bits, including the padding that lets every value
+// be read with one unaligned 8-byte load
+[[nodiscard]] constexpr auto packed_bytes(const size_t count, const unsigned width) -> size_t {
+  return (count * width + 7) / 8 + sizeof(uint64_t);
+}
+
+// The bits needed by the largest of `values`
+template <typename T>
+[[nodiscard]] inline auto packed_width(const std::vector<T> &values) -> uint8_t {
+  T max = 0;
+  for (const T value : values)
+    max |= value;
+  return static_cast<uint8_t>(std::bit_width(static_cast<uint64_t>(max)));
+}
+
+template <typename T>
+void pack_bits(const std::vector<T> &values, const unsigned width, char *out) {
+  for (size_t i = 0; i < values.size(); i++) {
+    const size_t bit = i * width;
+    uint64_t word;
+    std::memcpy(&word, out + bit / 8, sizeof(word));
+    word |= static_cast<uint64_t>(values[i]) << (bit % 8);
+    std::memcpy(out + bit / 8, &word, sizeof(word));
+  }
+}
+
+// The `i`-th value of a column packed at `width` bits, which must be at most 57
+[[nodiscard]] inline auto unpack_bits_at(const char *in, const unsigned width, const size_t i)
+    -> uint64_t {
+  const size_t bit = i * width;
+  uint64_t word;
+  std::memcpy(&word, in + bit / 8, sizeof(word));
+  return (word >> (bit % 8)) & ((uint64_t{1} << width) - 1);
+}
+
+[[nodiscard]] constexpr auto zigzag(const int64_t value) -> uint64_t {
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+[[nodiscard]] constexpr auto unzigzag(const uint64_t value) -> int64_t {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+} // namespace detail
+
+/**
+ * @brief A compact trace mapped in memory, whose blocks are decoded on demand into columns.
+ */
+class CompactTrace {
+public:
+  // Where the last decode stopped, so that decoding a block piece by piece in order decompresses
+  // it and sums its timestamps once
+  struct Scratch {
+    const CompactBlockInfo *block = nullptr; // Whose decompressed columns `bytes` holds
+    std::vector<char> bytes;
+    const CompactBlockInfo *resume_block = nullptr;
+    size_t resume_index = 0;
+    int64_t resume_timestamp = 0; // Of the record before `resume_index`
+  };
+
+  /**
+   * @brief Read the trace in `mmap`, which must outlive it.
+   */
+  explicit CompactTrace(const mio::mmap_source &mmap) : data_(mmap.data()), size_(mmap.size()) {
+    if (size_ < sizeof(header_))
+      throw std::ios_base::failure("Truncated compact trace");
+    std::memcpy(&header_, data_, sizeof(header_));
+    if (header_.magic != COMPACT_TRACE_MAGIC || header_.version != COMPACT_TRACE_VERSION)
+      throw std::ios_base::failure(
+          std::format("Unsupported compact trace version {}", header_.version));
+#if !defined(BENCHMARK_HAS_ZSTD)
+    if (header_.flags & CompactTraceHeader::ZSTD)
+      throw std::ios_base::failure("The compact trace is compressed, but zstd is not available");
+#endif
+    if (header_.index_offset + header_.num_blocks * sizeof(CompactBlockInfo) > size_ ||
+        header_.dictionary_offset + header_.num_objects * sizeof(uint64_t) > size_ ||
+        header_.index_offset % alignof(uint64_t) != 0 ||
+        header_.dictionary_offset % alignof(uint64_t) != 0)
+      throw std::ios_base::failure("Truncated compact trace");
+    // Both are 8-byte aligned in the file, and the mapping is page-aligned
+    blocks_ = reinterpret_cast<const CompactBlockInfo *>(data_ + header_.index_offset);
+    dictionary_ = reinterpret_cast<const uint64_t *>(data_ + header_.dictionary_offset);
+  }
+
+  [[nodiscard]] auto num_entries() const noexcept -> size_t { return header_.num_entries; }
+
+  [[nodiscard]] auto num_objects() const noexcept -> size_t { return header_.num_objects; }
+
+  [[nodiscard]] auto has_sizes() const noexcept -> bool {
+    return (header_.flags & CompactTraceHeader::HAS_SIZES) != 0;
+  }
+
+  [[nodiscard]] auto block_records() const noexcept -> size_t { return header_.block_records; }
+
+  [[nodiscard]] auto num_blocks() const noexcept -> size_t { return header_.num_blocks; }
+
+  [[nodiscard]] auto block(const size_t b) const noexcept -> const CompactBlockInfo & {
+    return blocks_[b];
+  }
+
+  /**
+   * @brief Decode the records `[first, first + count)` of block `b` into the given columns.
+   * `scratch` holds the decompressed block of compressed traces between calls.
+   */
+  void decode_block(const size_t b, const size_t first, const size_t count, uint32_t *timestamps,
+                    uint64_t *obj_ids, uint32_t *obj_sizes, Scratch &scratch) const {
+    const auto &info = blocks_[b];
+    const char *columns = block_columns(info, scratch);
+    const char *const deltas = columns;
+    const char *const ids = deltas + detail::packed_bytes(info.num_records, info.timestamp_width);
+    const char *const sizes = ids + detail::packed_bytes(info.num_records, info.id_width);
+
+    // Timestamps are a running sum from the start of the block, so the skipped ones count too
+    size_t start = 0;
+    auto timestamp = static_cast<int64_t>(info.first_timestamp);
+    if (scratch.resume_block == &info && scratch.resume_index <= first) {
+      start = scratch.resume_index;
+      timestamp = scratch.resume_timestamp;
+    }
+    for (size_t i = start; i < first; i++)
+      timestamp += detail::unzigzag(detail::unpack_bits_at(deltas, info.timestamp_width, i));
+    for (size_t i = 0; i < count; i++) {
+      timestamp +=
+          detail::unzigzag(detail::unpack_bits_at(deltas, info.timestamp_width, first + i));
+      timestamps[i] = static_cast<uint32_t>(timestamp);
+    }
+    scratch.resume_block = &info;
+    scratch.resume_index = first + count;
+    scratch.resume_timestamp = timestamp;
+    // Independent loads and lookups, which the compiler unrolls and vectorizes
+    for (size_t i = 0; i < count; i++)
+      obj_ids[i] = dictionary_[detail::unpack_bits_at(ids, info.id_width, first + i)];
+    if (has_sizes()) {
+      for (size_t i = 0; i < count; i++)
+        obj_sizes[i] = info.min_size + static_cast<uint32_t>(detail::unpack_bits_at(
+                                           sizes, info.size_width, first + i));
+    } else {
+      std::fill_n(obj_sizes, count, uint32_t{1});
+    }
+  }
+
+  /**
+   * @brief The object ID of the `index`-th record, in O(1) unless the trace is compressed.
+   */
+  [[nodiscard]] auto obj_id(const size_t index, Scratch &scratch) const -> uint64_t {
+    const auto &info = blocks_[index / header_.block_records];
+    const char *ids = block_columns(info, scratch) +
+                      detail::packed_bytes(info.num_records, info.timestamp_width);
+    return dictionary_[detail::unpack_bits_at(ids, info.id_width, index % header_.block_records)];
+  }
+
+private:
+  const char *data_;
+  size_t size_;
+  CompactTraceHeader header_;
+  const CompactBlockInfo *blocks_ = nullptr;
+  const uint64_t *dictionary_ = nullptr;
+
+  [[nodiscard]] auto block_columns(const CompactBlockInfo &info,
+                                   [[maybe_unused]] Scratch &scratch) const
+      -> const char * {
+    if (info.offset + info.stored_bytes > size_)
+      throw std::ios_base::failure("Truncated compact trace");
+    if ((header_.flags & CompactTraceHeader::ZSTD) == 0)
+      return data_ + info.offset;
+#if defined(BENCHMARK_HAS_ZSTD)
+    if (scratch.block != &info) {
+      scratch.block = nullptr;
+      scratch.bytes.resize(info.raw_bytes);
+      const size_t n = ZSTD_decompress(scratch.bytes.data(), scratch.bytes.size(),
+                                       data_ + info.offset, info.stored_bytes);
+      if (ZSTD_isError(n) || n != info.raw_bytes)
+        throw std::ios_base::failure("Corrupt compressed block in compact trace");
+      scratch.block = &info;
+    }
+    return scratch.bytes.data();
+#else
+    throw std::ios_base::failure("The compact trace is compressed, but zstd is not available");
+#endif
+  }
+};
+
+struct CompactTraceOptions {
+  uint32_t block_records = uint32_t{1} << 16;
+  bool sizes = true;
+  // The zstd level the blocks are compressed at, where 0 leaves them uncompressed
+  int zstd_level = 0;
+};
+
+/**
+ * @brief Write `trace`, a range of records with `timestamp`, `obj_id` and `obj_size`, to `path` in
+ * the compact format.
+ *
+ * @return The bytes written.
+ */
+template <typename Trace>
+auto write_compact_trace(const Trace &trace, const std::filesystem::path &path,
+                         const CompactTraceOptions &options = {}) -> size_t {
+  if (options.block_records == 0)
+    throw std::invalid_argument("A compact trace needs at least one record per block");
+#if !defined(BENCHMARK_HAS_ZSTD)
+  if (options.zstd_level != 0)
+    throw std::invalid_argument("Cannot compress the compact trace: zstd is not available");
+#endif
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file)
+    throw std::ios_base::failure(std::format("Failed to open {} for writing", path.string()));
+
+  CompactTraceHeader header{
+      .flags = (options.sizes ? CompactTraceHeader::HAS_SIZES : 0U) |
+               (options.zstd_level != 0 ? CompactTraceHeader::ZSTD : 0U),
+      .block_records = options.block_records,
+  };
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  uint64_t offset = sizeof(header);
+
+  std::unordered_map<uint64_t, uint64_t> dense_ids;
+  std::vector<uint64_t> dictionary;
+  std::vector<CompactBlockInfo> blocks;
+
+  std::vector<uint64_t> deltas;
+  std::vector<uint64_t> ids;
+  std::vector<uint32_t> sizes;
+  std::vector<char> raw;
+  std::vector<char> stored;
+  uint32_t first_timestamp = 0;
+  int64_t previous_timestamp = 0;
+
+  auto flush = [&] {
+    if (ids.empty())
+      return;
+    CompactBlockInfo info{
+        .num_records = static_cast<uint32_t>(ids.size()),
+        .first_timestamp = first_timestamp,
+        .timestamp_width = detail::packed_width(deltas),
+        .id_width = detail::packed_width(ids),
+    };
+    if (options.sizes) {
+      info.min_size = *std::ranges::min_element(sizes);
+      for (auto &size : sizes)
+        size -= info.min_size;
+      info.size_width = detail::packed_width(sizes);
+    }
+    const size_t delta_bytes = detail::packed_bytes(ids.size(), info.timestamp_width);
+    const size_t id_bytes = detail::packed_bytes(ids.size(), info.id_width);
+    const size_t size_bytes = options.sizes ? detail::packed_bytes(ids.size(), info.size_width) : 0;
+    raw.assign(delta_bytes + id_bytes + size_bytes, 0);
+    detail::pack_bits(deltas, info.timestamp_width, raw.data());
+    detail::pack_bits(ids, info.id_width, raw.data() + delta_bytes);
+    if (options.sizes)
+      detail::pack_bits(sizes, info.size_width, raw.data() + delta_bytes + id_bytes);
+    info.raw_bytes = static_cast<uint32_t>(raw.size());
+
+    const std::vector<char> *out = &raw;
+#if defined(BENCHMARK_HAS_ZSTD)
+    if (options.zstd_level != 0) {
+      stored.resize(ZSTD_compressBound(raw.size()));
+      const size_t n = ZSTD_compress(stored.data(), stored.size(), raw.data(), raw.size(),
+                                     options.zstd_level);
+      if (ZSTD_isError(n))
+        throw std::runtime_error(std::format("Failed to compress block: {}", ZSTD_getErrorName(n)));
+      stored.resize(n);
+      out = &stored;
+    }
+#endif
+    info.offset = offset;
+    info.stored_bytes = static_cast<uint32_t>(out->size());
+    file.write(out->data(), static_cast<std::streamsize>(out->size()));
+    offset += out->size();
+    blocks.push_back(info);
+
+    deltas.clear();
+    ids.clear();
+    sizes.clear();
+  };
+
+  for (const auto &record : trace) {
+    if (ids.empty()) {
+      first_timestamp = record.timestamp;
+      previous_timestamp = record.timestamp;
+    }
+    deltas.push_back(detail::zigzag(static_cast<int64_t>(record.timestamp) - previous_timestamp));
+    previous_timestamp = record.timestamp;
+    const auto [it, inserted] = dense_ids.try_emplace(record.obj_id, dictionary.size());
+    if (inserted)
+      dictionary.push_back(record.obj_id);
+    ids.push_back(it->second);
+    if (options.sizes)
+      sizes.push_back(record.obj_size);
+    header.num_entries++;
+    if (ids.size() == options.block_records)
+      flush();
+  }
+  flush();
+
+  // Align the index and the dictionary, so that they can be read in place
+  const auto pad = [&] {
+    const std::array<char, alignof(uint64_t)> zeros{};
+    const size_t padding = (alignof(uint64_t) - offset % alignof(uint64_t)) % alignof(uint64_t);
+    file.write(zeros.data(), static_cast<std::streamsize>(padding));
+    offset += padding;
+  };
+  pad();
+  header.index_offset = offset;
+  header.num_blocks = static_cast<uint32_t>(blocks.size());
+  file.write(reinterpret_cast<const char *>(blocks.data()),
+             static_cast<std::streamsize>(blocks.size() * sizeof(CompactBlockInfo)));
+  offset += blocks.size() * sizeof(CompactBlockInfo);
+  pad();
+  header.dictionary_offset = offset;
+  header.num_objects = dictionary.size();
+  file.write(reinterpret_cast<const char *>(dictionary.data()),
+             static_cast<std::streamsize>(dictionary.size() * sizeof(uint64_t)));
+  offset += dictionary.size() * sizeof(uint64_t);
+
+  file.seekp(0);
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  if (!file)
+    throw std::ios_base::failure(std::format("Failed to write {}", path.string()));
+  return offset;
+}
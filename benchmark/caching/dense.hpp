@@ -0,0 +1,246 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <ios>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <version>
+
+#include <mio/mmap.hpp>
+
+#include "reader.hpp"
+
+/**
+ * @brief The header of a `.dense` file, which is followed by the dense ID of each of `num_entries`
+ * requests as native-endian `uint32_t`.
+ */
+struct DenseIdHeader {
+  static constexpr std::array<char, 8> MAGIC = {'D', 'E', 'N', 'S', 'E', 'I', 'D', '\1'};
+
+  std::array<char, 8> magic = MAGIC;
+  uint64_t num_entries = 0;
+  uint64_t num_objects = 0;
+};
+static_assert(sizeof(DenseIdHeader) == 24 && alignof(DenseIdHeader) <= alignof(uint64_t));
+
+namespace detail {
+
+inline auto caching_file_mtime_ms(const std::filesystem::path &path) -> long long {
+  const auto ftime = std::filesystem::last_write_time(path);
+#if __cpp_lib_chrono >= 201907L
+  const auto sys_time = std::chrono::clock_cast<std::chrono::system_clock>(ftime);
+#else
+  const auto sys_time = std::chrono::file_clock::to_sys(ftime);
+#endif
+  const auto ms = std::chrono::time_point_cast<std::chrono::milliseconds>(sys_time);
+  return ms.time_since_epoch().count();
+}
+
+// Whether the `.dense` file at `path` holds the dense IDs of all `num_entries` requests
+inline auto is_complete_dense_ids(const std::filesystem::path &path, const size_t num_entries)
+    -> bool {
+  std::ifstream file(path, std::ios::binary);
+  DenseIdHeader header;
+  if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)))
+    return false;
+  std::error_code ec;
+  return header.magic == DenseIdHeader::MAGIC && header.num_entries == num_entries &&
+         std::filesystem::file_size(path, ec) == sizeof(header) + num_entries * sizeof(uint32_t);
+}
+
+} // namespace detail
+
+/**
+ * @brief The dense IDs of the requests of `trace` in a `.dense` file under the cache directory,
+ * built on first use and again whenever the trace changes.
+ *
+ * Objects are numbered from 0 in order of first request, as in compact traces, so that simulators
+ * can index arrays by object instead of hashing 64-bit object IDs.
+ *
+ * @return The path of the `.dense` file.
+ */
+inline auto dense_id_cache(const CachingTrace &trace) -> std::filesystem::path {
+  const std::filesystem::path path = trace.filepath();
+  const auto cache_dir = get_cache_dir();
+  const std::string cache_key_prefix = "dense_ids_" + path.filename().string() + "_";
+  const std::string cache_key =
+      cache_key_prefix + std::to_string(detail::caching_file_mtime_ms(path)) + ".dense";
+  const auto cache_file = cache_dir / cache_key;
+  if (detail::is_complete_dense_ids(cache_file, trace.size()))
+    return cache_file;
+
+  // Write under a name of its own and rename it into place, so that concurrent benchmark processes
+  // numbering the same trace never see a partial file
+  const auto temp_file = cache_dir / std::format("{}.{}.tmp", cache_key, std::random_device{}());
+  {
+    std::ofstream ofs{temp_file, std::ios::out | std::ios::binary | std::ios::trunc};
+    DenseIdHeader header{.num_entries = trace.size()};
+    ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    std::unordered_map<uint64_t, uint32_t> dense_ids;
+    std::vector<uint32_t> ids;
+    RequestColumnBuffers buffers;
+    trace.for_each_columns(
+        [&](const RequestColumns &columns) {
+          ids.clear();
+          for (const uint64_t obj_id : columns.obj_ids) {
+            const auto [it, inserted] =
+                dense_ids.try_emplace(obj_id, static_cast<uint32_t>(dense_ids.size()));
+            if (inserted && dense_ids.size() > size_t{std::numeric_limits<uint32_t>::max()} + 1)
+              throw std::runtime_error(
+                  std::format("Too many objects for 32-bit dense IDs in {}", path.string()));
+            ids.push_back(it->second);
+          }
+          ofs.write(reinterpret_cast<const char *>(ids.data()),
+                    static_cast<std::streamsize>(ids.size() * sizeof(uint32_t)));
+        },
+        buffers);
+
+    header.num_objects = dense_ids.size();
+    ofs.seekp(0);
+    ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    if (!ofs)
+      throw std::ios_base::failure(std::format("Failed to write {}", temp_file.string()));
+  }
+  std::filesystem::rename(temp_file, cache_file);
+
+  // Remove outdated cache files sharing the prefix (but not the current key)
+  for (const auto &entry : std::filesystem::directory_iterator{cache_dir}) {
+    if (!entry.is_regular_file())
+      continue;
+    const auto filename = entry.path().filename().string();
+    if (filename.starts_with(cache_key_prefix) && filename != cache_key &&
+        filename.ends_with(".dense"))
+      std::filesystem::remove(entry.path());
+  }
+
+  return cache_file;
+}
+
+/**
+ * @brief A `CachingTrace` whose requests carry dense IDs (see `dense_id_cache`) instead of object
+ * IDs, for replays keyed by arrays rather than hash tables, e.g., through `DenseMockCache` and
+ * `DenseKeys`.
+ *
+ * The dense IDs are mapped from their file under the cache directory, and shared by copies of the
+ * trace and by its iterators.
+ */
+class DenseCachingTrace {
+public:
+  // Read-only iterator for DenseCachingTrace
+  class iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = Request;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Request *;
+    using reference = const Request &;
+
+    iterator() = default;
+
+    iterator(CachingTrace::iterator it, std::shared_ptr<const mio::mmap_source> ids,
+             const uint32_t *id, const uint32_t *end)
+        : it_(std::move(it)), ids_(std::move(ids)), id_(id), end_(end) {
+      read_current();
+    }
+
+    auto operator*() const -> const Request & { return current_record_; }
+
+    auto operator->() const -> const Request * { return &current_record_; }
+
+    auto operator++() -> iterator & {
+      if (id_ == end_)
+        return *this;
+      ++it_;
+      ++id_;
+      read_current();
+      return *this;
+    }
+
+    auto operator++(int) -> iterator {
+      iterator temp = *this;
+      ++(*this);
+      return temp;
+    }
+
+    auto operator==(const iterator &other) const -> bool { return id_ == other.id_; }
+
+    auto operator!=(const iterator &other) const -> bool { return !(*this == other); }
+
+  private:
+    void read_current() {
+      if (id_ == end_)
+        return;
+      current_record_ = *it_;
+      current_record_.obj_id = *id_;
+    }
+
+    CachingTrace::iterator it_;
+    std::shared_ptr<const mio::mmap_source> ids_; // Keeps the dense IDs mapped
+    const uint32_t *id_ = nullptr;
+    const uint32_t *end_ = nullptr;
+    Request current_record_{};
+  };
+
+  explicit DenseCachingTrace(const std::string_view pathname) : trace_(pathname) {
+    const auto path = dense_id_cache(trace_);
+    try {
+      ids_ = std::make_shared<const mio::mmap_source>(path.string());
+    } catch (const std::system_error &e) {
+      throw std::ios_base::failure(std::format("Failed to open file: {}", path.string()));
+    }
+    DenseIdHeader header;
+    if (ids_->size() < sizeof(header))
+      throw std::ios_base::failure(std::format("Truncated dense ID file: {}", path.string()));
+    std::memcpy(&header, ids_->data(), sizeof(header));
+    if (header.magic != DenseIdHeader::MAGIC || header.num_entries != trace_.size() ||
+        ids_->size() != sizeof(header) + header.num_entries * sizeof(uint32_t))
+      throw std::ios_base::failure(std::format("Corrupt dense ID file: {}", path.string()));
+    num_objects_ = header.num_objects;
+  }
+
+  [[nodiscard]] auto filepath() const noexcept -> const std::string & { return trace_.filepath(); }
+
+  [[nodiscard]] auto num_entries() const noexcept -> size_t { return trace_.num_entries(); }
+
+  [[nodiscard]] auto size() const noexcept -> size_t { return trace_.size(); }
+
+  /**
+   * @brief The distinct objects of the trace, i.e., one more than the largest dense ID.
+   */
+  [[nodiscard]] auto num_objects() const noexcept -> size_t { return num_objects_; }
+
+  [[nodiscard]] auto begin() const -> iterator {
+    return {trace_.begin(), ids_, ids(), ids() + trace_.size()};
+  }
+
+  [[nodiscard]] auto end() const -> iterator {
+    return {trace_.end(), ids_, ids() + trace_.size(), ids() + trace_.size()};
+  }
+
+private:
+  CachingTrace trace_;
+  std::shared_ptr<const mio::mmap_source> ids_; // The mapped `.dense` file
+  size_t num_objects_ = 0;
+
+  // The header is 8-byte aligned, and the mapping is page-aligned
+  [[nodiscard]] auto ids() const noexcept -> const uint32_t * {
+    return reinterpret_cast<const uint32_t *>(ids_->data() + sizeof(DenseIdHeader));
+  }
+};
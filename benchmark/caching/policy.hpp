@@ -1,8 +1,12 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <type_traits>
 #include <unordered_set>
+#include <vector>
 
 #include <spdlog/spdlog.h>
 
@@ -10,6 +14,8 @@
 #include "../utils/debug.hpp"
 #endif
 
+#include "../utils/memory.hpp"
+
 template <typename K, typename V> class Cache {
 public:
   using key_type = K;
@@ -62,7 +68,59 @@ public:
 private:
   size_t k_max_size_;
 
-  std::unordered_set<K> keys_;
+  std::unordered_set<K, std::hash<K>, std::equal_to<K>, CacheAllocator<K>> keys_;
+};
+
+/**
+ * @brief A `MockCache` for dense keys, i.e., small unsigned integers such as those of
+ * `DenseCachingTrace`, which marks cached keys in an array indexed by the keys instead of hashing
+ * them.
+ */
+template <typename K, typename V> class DenseMockCache : public Cache<K, V> {
+public:
+  explicit DenseMockCache(const size_t max_size) : k_max_size_(max_size) {}
+
+  auto contains(const K &key) const -> bool override {
+    const auto index = static_cast<size_t>(key);
+    return index < cached_.size() && cached_[index] != 0;
+  }
+
+  auto get(const K &key, V * /*value*/) const -> bool override { return contains(key); }
+
+  void put(const K &key, const V &value) override {
+#ifndef NDEBUG
+    if (size_ >= k_max_size_ && !contains(key))
+      spdlog::warn("DenseMockCache: Suspicious insertion {} -> {} to a full cache ({} >= {})",
+                   show(key), show(value), size_, k_max_size_);
+#endif
+
+    const auto index = static_cast<size_t>(key);
+    if (index >= cached_.size())
+      cached_.resize(std::max(index + 1, cached_.size() * 2));
+    size_ += cached_[index] == 0;
+    cached_[index] = 1;
+  }
+
+  void remove(const K &key) override {
+#ifndef NDEBUG
+    if (!contains(key))
+      spdlog::warn("DenseMockCache: Suspicious removal of non-existing key {}", show(key));
+#endif
+
+    if (contains(key)) {
+      cached_[static_cast<size_t>(key)] = 0;
+      size_--;
+    }
+  }
+
+  [[nodiscard]] auto is_full() const -> bool override { return size_ == k_max_size_; }
+
+private:
+  size_t k_max_size_;
+
+  size_t size_ = 0;
+  // One byte rather than one bit per key, so that marking a key is a plain store
+  std::vector<uint8_t, CacheAllocator<uint8_t>> cached_;
 };
 
 template <typename K, typename V> class Store {
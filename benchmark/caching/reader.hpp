@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
@@ -11,14 +12,30 @@
 #include <iostream>
 #include <iterator>
 #include <limits>
+#include <memory>
+#include <new>
+#include <optional>
+#include <span>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <utility>
+#include <vector>
 #include <version>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #include <mio/mmap.hpp>
 #include <spdlog/spdlog.h>
 #include <unordered_set>
 
+#include "../../src/utils/memory.hpp"
+#include "../utils/profile.hpp"
+#include "compact.hpp"
+
 struct Request {
   uint32_t timestamp;         // in seconds
   uint64_t obj_id;            // hash of object id (string)
@@ -27,12 +44,154 @@ struct Request {
 
   static constexpr size_t UNALIGNED_SIZE =
       sizeof(timestamp) + sizeof(obj_id) + sizeof(obj_size) + sizeof(next_access_vtime);
+
+  static constexpr size_t OBJ_ID_OFFSET = sizeof(timestamp);
+  static constexpr size_t OBJ_SIZE_OFFSET = OBJ_ID_OFFSET + sizeof(obj_id);
+  static constexpr size_t NEXT_ACCESS_VTIME_OFFSET = OBJ_SIZE_OFFSET + sizeof(obj_size);
+};
+
+namespace detail {
+
+template <typename T> [[nodiscard]] inline auto load_unaligned(const char *data) noexcept -> T {
+  T value;
+  std::memcpy(&value, data, sizeof(T));
+  return value;
+}
+
+// A next access of -1, i.e., never, as the largest logical time
+[[nodiscard]] inline auto decode_next_access_vtime(const char *data) noexcept -> uint64_t {
+  const auto vtime = load_unaligned<uint64_t>(data + Request::NEXT_ACCESS_VTIME_OFFSET);
+  return static_cast<int64_t>(vtime) == -1 ? std::numeric_limits<uint64_t>::max() : vtime;
+}
+
+// The record starting at `data`, which must hold `Request::UNALIGNED_SIZE` bytes
+[[nodiscard]] inline auto decode_request(const char *data) noexcept -> Request {
+  return {
+      .timestamp = load_unaligned<uint32_t>(data),
+      .obj_id = load_unaligned<uint64_t>(data + Request::OBJ_ID_OFFSET),
+      .obj_size = load_unaligned<uint32_t>(data + Request::OBJ_SIZE_OFFSET),
+      .next_access_vtime = decode_next_access_vtime(data),
+  };
+}
+
+// Hint the kernel about how `[data, data + size)` of a mapping will be read, where supported
+inline void advise_mapping(const char *data, size_t size, [[maybe_unused]] const int advice) {
+#if defined(__unix__) || defined(__APPLE__)
+  if (size == 0)
+    return;
+  // The range must start on a page boundary
+  static const auto page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  const auto start = reinterpret_cast<uintptr_t>(data) & ~(page_size - 1);
+  size += reinterpret_cast<uintptr_t>(data) - start;
+  posix_madvise(reinterpret_cast<void *>(start), size, advice); // A hint, so errors do not matter
+#else
+  (void)data;
+  (void)size;
+#endif
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+inline constexpr int ADVICE_SEQUENTIAL = POSIX_MADV_SEQUENTIAL;
+inline constexpr int ADVICE_WILLNEED = POSIX_MADV_WILLNEED;
+#else
+inline constexpr int ADVICE_SEQUENTIAL = 0;
+inline constexpr int ADVICE_WILLNEED = 0;
+#endif
+
+// A 64-byte aligned array of trivial values that only ever grows
+template <typename T> class AlignedColumn {
+public:
+  AlignedColumn() = default;
+  ~AlignedColumn() { aligned_free(data_); }
+
+  AlignedColumn(const AlignedColumn &) = delete;
+  auto operator=(const AlignedColumn &) -> AlignedColumn & = delete;
+  AlignedColumn(AlignedColumn &&other) noexcept
+      : data_(std::exchange(other.data_, nullptr)), capacity_(std::exchange(other.capacity_, 0)) {}
+  auto operator=(AlignedColumn &&other) noexcept -> AlignedColumn & {
+    if (this != &other) {
+      aligned_free(data_);
+      data_ = std::exchange(other.data_, nullptr);
+      capacity_ = std::exchange(other.capacity_, 0);
+    }
+    return *this;
+  }
+
+  // At least `size` values, whose contents are unspecified after growing
+  [[nodiscard]] auto reserve(const size_t size) -> T * {
+    if (size > capacity_) {
+      T *data = aligned_alloc<T>(size);
+      if (data == nullptr)
+        throw std::bad_alloc();
+      aligned_free(data_);
+      data_ = data;
+      capacity_ = size;
+    }
+    return data_;
+  }
+
+private:
+  T *data_ = nullptr;
+  size_t capacity_ = 0;
+};
+
+} // namespace detail
+
+/**
+ * @brief A range of records of a trace decoded column by column, i.e., the `i`-th request is made
+ * of the `i`-th value of each column. Valid until the buffers are decoded into again.
+ */
+struct RequestColumns {
+  std::span<const uint32_t> timestamps;
+  std::span<const uint64_t> obj_ids;
+  std::span<const uint32_t> obj_sizes;
+  std::span<const uint64_t> next_access_vtimes;
+
+  [[nodiscard]] auto size() const noexcept -> size_t { return obj_ids.size(); }
+};
+
+/**
+ * @brief Reusable buffers that `CachingTrace::decode_columns` decodes records into, so that a scan
+ * over a trace allocates once.
+ */
+class RequestColumnBuffers {
+public:
+  // The records a scan decodes at a time, i.e., about 400 KiB of columns, which stay in L2
+  static constexpr size_t DEFAULT_CHUNK_RECORDS = size_t{1} << 14;
+
+private:
+  friend class CachingTrace;
+
+  detail::AlignedColumn<uint32_t> timestamps_;
+  detail::AlignedColumn<uint64_t> obj_ids_;
+  detail::AlignedColumn<uint32_t> obj_sizes_;
+  detail::AlignedColumn<uint64_t> next_access_vtimes_;
+  CompactTrace::Scratch scratch_; // Decompressed blocks of compact traces
 };
 
 /**
  * @brief A wrapper of an `.oracleGeneral` trace file supporting read-only iteration using mmap.
+ *
+ * The file is mapped once, and the mapping is shared by copies of the trace and by its iterators.
+ * Compact traces (see `compact.hpp`) are detected and read the same way, one decoded block at a
+ * time, except that their next access times are unknown, i.e., the largest logical time.
  */
 class CachingTrace {
+  // The mapped file, and its blocks if it is a compact trace
+  struct Mapping {
+    mio::mmap_source mmap;
+    std::optional<CompactTrace> compact;
+  };
+
+  // The columns of one block of a compact trace
+  struct DecodedBlock {
+    size_t index = std::numeric_limits<size_t>::max();
+    std::vector<uint32_t> timestamps;
+    std::vector<uint64_t> obj_ids;
+    std::vector<uint32_t> obj_sizes;
+    CompactTrace::Scratch scratch;
+  };
+
 public:
   // Read-only iterator for CachingTrace
   class iterator {
@@ -45,78 +204,12 @@ public:
 
     iterator() : offset_(0), total_(0), end_(true), current_record_() {}
 
-    iterator(std::string filename, size_t index, size_t total)
-        : filename_(std::move(filename)), offset_(index), total_(total), end_(index >= total),
+    iterator(std::shared_ptr<const Mapping> mmap, size_t index, size_t total)
+        : mmap_(std::move(mmap)), offset_(index), total_(total), end_(index >= total),
           current_record_() {
-      if (!end_) {
-        // Memory-map the file
-        try {
-          mmap_ = mio::mmap_source(filename_);
-        } catch (const std::system_error &e) {
-          throw std::ios_base::failure(
-              std::format("Failed to open file in iterator: {}", filename_));
-        }
-        // Read the current record
-        read_current();
-      }
-    }
-
-    iterator(iterator &&other) noexcept
-        : filename_(std::move(other.filename_)), offset_(other.offset_), total_(other.total_),
-          end_(other.end_), mmap_(std::move(other.mmap_)), current_record_(other.current_record_) {
-      other.end_ = true;
-    }
-
-    auto operator=(iterator &&other) noexcept -> iterator & {
-      if (this != &other) {
-        filename_ = std::move(other.filename_);
-        offset_ = other.offset_;
-        total_ = other.total_;
-        end_ = other.end_;
-        mmap_ = std::move(other.mmap_);
-        current_record_ = other.current_record_;
-        other.end_ = true;
-      }
-      return *this;
-    }
-
-    iterator(const iterator &other)
-        : filename_(other.filename_), offset_(other.offset_), total_(other.total_),
-          end_(other.end_), current_record_(other.current_record_) {
-      try {
-        mmap_ = mio::mmap_source(filename_); // Re-map the file content
-      } catch (const std::system_error &e) {
-        throw std::ios_base::failure(std::format("Failed to copy mmap in iterator: {}", filename_));
-      }
-      if (!end_) {
-        read_current();
-      }
-    }
-
-    auto operator=(const iterator &other) -> iterator & {
-      if (this != &other) {
-        filename_ = other.filename_;
-        offset_ = other.offset_;
-        total_ = other.total_;
-        end_ = other.end_;
-        current_record_ = other.current_record_;
-
-        try {
-          mmap_ = mio::mmap_source(filename_); // Re-map the file content
-        } catch (const std::system_error &e) {
-          throw std::ios_base::failure(
-              std::format("Failed to copy mmap in iterator: {}", filename_));
-        }
-
-        if (!end_) {
-          read_current();
-        }
-      }
-      return *this;
+      read_current();
     }
 
-    ~iterator() = default;
-
     auto operator*() const -> const Request & { return current_record_; }
 
     auto operator->() const -> const Request * { return &current_record_; }
@@ -140,7 +233,7 @@ public:
     }
 
     auto operator==(const iterator &other) const -> bool {
-      return (end_ && other.end_) || (offset_ == other.offset_ && filename_ == other.filename_);
+      return (end_ && other.end_) || (offset_ == other.offset_ && mmap_ == other.mmap_);
     }
 
     auto operator!=(const iterator &other) const -> bool { return !(*this == other); }
@@ -149,123 +242,178 @@ public:
     void read_current() {
       if (end_)
         return;
-
-      // Compute the offset based on the index and record size
-      const auto offset = static_cast<std::streamoff>(offset_ * Request::UNALIGNED_SIZE);
-
-      if (offset + Request::UNALIGNED_SIZE > mmap_.size()) {
-        throw std::ios_base::failure(std::format("Index {} out of bounds.", offset_));
+      if (!mmap_->compact) {
+        // The trace checked that the file holds `total_` whole records
+        current_record_ =
+            detail::decode_request(mmap_->mmap.data() + offset_ * Request::UNALIGNED_SIZE);
+        return;
       }
 
-      // Read the raw data into the record
-      const char *data = &mmap_[offset];
-      std::memcpy(&current_record_.timestamp, data, sizeof(current_record_.timestamp));
-      std::memcpy(&current_record_.obj_id, data + sizeof(current_record_.timestamp),
-                  sizeof(current_record_.obj_id));
-      std::memcpy(&current_record_.obj_size,
-                  data + sizeof(current_record_.timestamp) + sizeof(current_record_.obj_id),
-                  sizeof(current_record_.obj_size));
-      std::memcpy(&current_record_.next_access_vtime,
-                  data + sizeof(current_record_.timestamp) + sizeof(current_record_.obj_id) +
-                      sizeof(current_record_.obj_size),
-                  sizeof(current_record_.next_access_vtime));
-
-      // If next_access_vtime is -1, set it to max value
-      if (static_cast<int64_t>(current_record_.next_access_vtime) == -1)
-        current_record_.next_access_vtime = std::numeric_limits<uint64_t>::max();
+      const auto &compact = *mmap_->compact;
+      const size_t b = offset_ / compact.block_records();
+      if (!block_ || block_->index != b) {
+        // Copies of the iterator share the block, so only decode over it if it is not shared
+        if (!block_ || block_.use_count() > 1)
+          block_ = std::make_shared<DecodedBlock>();
+        const size_t n = compact.block(b).num_records;
+        block_->timestamps.resize(n);
+        block_->obj_ids.resize(n);
+        block_->obj_sizes.resize(n);
+        compact.decode_block(b, 0, n, block_->timestamps.data(), block_->obj_ids.data(),
+                             block_->obj_sizes.data(), block_->scratch);
+        block_->index = b;
+      }
+      const size_t i = offset_ % compact.block_records();
+      current_record_ = {.timestamp = block_->timestamps[i],
+                         .obj_id = block_->obj_ids[i],
+                         .obj_size = block_->obj_sizes[i],
+                         .next_access_vtime = std::numeric_limits<uint64_t>::max()};
     }
 
-    std::string filename_;   // File path
-    size_t offset_;          // Current index
-    size_t total_;           // Total number of records
-    bool end_;               // End flag
-    mio::mmap_source mmap_;  // Memory-mapped file
-    Request current_record_; // Current record
+    std::shared_ptr<const Mapping> mmap_; // Memory-mapped file, shared with the trace
+    size_t offset_;                       // Current index
+    size_t total_;                        // Total number of records
+    bool end_;                            // End flag
+    Request current_record_;              // Current record
+    std::shared_ptr<DecodedBlock> block_; // Current block of a compact trace
   };
 
   // Constructor, open file and read total number of records
   explicit CachingTrace(const std::string_view pathname) : filepath_(pathname) {
+    auto mapping = std::make_shared<Mapping>();
     try {
-      mmap_ = mio::mmap_source(filepath_);
+      mapping->mmap = mio::mmap_source(filepath_);
     } catch (const std::system_error &e) {
       throw std::ios_base::failure(std::format("Failed to open file: {}", pathname));
     }
+    const auto &mmap = mapping->mmap;
+
+    if (mmap.size() >= COMPACT_TRACE_MAGIC.size() &&
+        std::equal(COMPACT_TRACE_MAGIC.begin(), COMPACT_TRACE_MAGIC.end(), mmap.data())) {
+      mapping->compact.emplace(mmap);
+      num_entries_ = mapping->compact->num_entries();
+    } else {
+      // Check file size and compute the number of entries
+      if (mmap.size() % Request::UNALIGNED_SIZE != 0)
+        throw std::ios_base::failure(std::format(
+            "File size is not a multiple of record size ({} bytes).", Request::UNALIGNED_SIZE));
+      num_entries_ = mmap.size() / Request::UNALIGNED_SIZE;
+    }
 
-    // Check file size and compute the number of entries
-    if (mmap_.size() % Request::UNALIGNED_SIZE != 0)
-      throw std::ios_base::failure(std::format(
-          "File size is not a multiple of record size ({} bytes).", Request::UNALIGNED_SIZE));
-    num_entries_ = mmap_.size() / Request::UNALIGNED_SIZE;
+    // Traces are almost always scanned front to back, so let the kernel read ahead aggressively
+    detail::advise_mapping(mmap.data(), mmap.size(), detail::ADVICE_SEQUENTIAL);
+    mmap_ = std::move(mapping);
   }
 
   ~CachingTrace() = default;
 
-  CachingTrace(const CachingTrace &other)
-      : filepath_(other.filepath_), num_entries_(other.num_entries_) {
-    try {
-      mmap_ = mio::mmap_source(filepath_); // Re-map the file content
-    } catch (const std::system_error &e) {
-      throw std::ios_base::failure(
-          std::format("Failed to copy mmap in CachingTrace: {}", filepath_));
-    }
-  }
-
-  CachingTrace &operator=(const CachingTrace &other) {
-    if (this != &other) {
-      filepath_ = other.filepath_;
-      num_entries_ = other.num_entries_;
-      try {
-        mmap_ = mio::mmap_source(filepath_); // Re-map the file content
-      } catch (const std::system_error &e) {
-        throw std::ios_base::failure(
-            std::format("Failed to copy mmap in CachingTrace: {}", filepath_));
-      }
-    }
-    return *this;
-  }
+  CachingTrace(const CachingTrace &) = default;
+  CachingTrace &operator=(const CachingTrace &) = default;
 
   CachingTrace(CachingTrace &&other) noexcept
-      : filepath_(std::move(other.filepath_)), num_entries_(other.num_entries_),
-        mmap_(std::move(other.mmap_)) {
-    other.num_entries_ = 0;
-  }
+      : filepath_(std::move(other.filepath_)),
+        num_entries_(std::exchange(other.num_entries_, 0)), mmap_(std::move(other.mmap_)) {}
 
   CachingTrace &operator=(CachingTrace &&other) noexcept {
     if (this != &other) {
       filepath_ = std::move(other.filepath_);
-      num_entries_ = other.num_entries_;
+      num_entries_ = std::exchange(other.num_entries_, 0);
       mmap_ = std::move(other.mmap_);
-      other.num_entries_ = 0;
     }
     return *this;
   }
 
+  /**
+   * @brief The `index`-th record.
+   *
+   * On compact traces this is not a seek but O(`block_records`) per call, as it sums the timestamp
+   * deltas from the start of the block, and decompresses the whole block if the trace is
+   * compressed. Scan them through iterators or `decode_columns()` instead.
+   */
   auto operator[](size_t index) const -> Request {
     if (index >= num_entries_)
       throw std::out_of_range(
           std::format("Index {} is out of range (total entries: {}).", index, num_entries_));
+    if (!mmap_->compact)
+      return detail::decode_request(record_data(index));
+
+    const auto &compact = *mmap_->compact;
+    Request record{.next_access_vtime = std::numeric_limits<uint64_t>::max()};
+    CompactTrace::Scratch scratch;
+    compact.decode_block(index / compact.block_records(), index % compact.block_records(), 1,
+                         &record.timestamp, &record.obj_id, &record.obj_size, scratch);
+    return record;
+  }
 
-    // Read the record from the memory-mapped file
-    const auto offset = static_cast<std::streamoff>(index * Request::UNALIGNED_SIZE);
-    if (offset + Request::UNALIGNED_SIZE > mmap_.size())
-      throw std::ios_base::failure(std::format("Index {} out of bounds in operator[].", index));
-
-    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-member-init)
-    Request record;
-    const char *data = &mmap_[offset];
-    std::memcpy(&record.timestamp, data, sizeof(record.timestamp));
-    std::memcpy(&record.obj_id, data + sizeof(record.timestamp), sizeof(record.obj_id));
-    std::memcpy(&record.obj_size, data + sizeof(record.timestamp) + sizeof(record.obj_id),
-                sizeof(record.obj_size));
-    std::memcpy(&record.next_access_vtime,
-                data + sizeof(record.timestamp) + sizeof(record.obj_id) + sizeof(record.obj_size),
-                sizeof(record.next_access_vtime));
-
-    // If next_access_vtime is -1, set it to max value
-    if (static_cast<int64_t>(record.next_access_vtime) == -1)
-      record.next_access_vtime = std::numeric_limits<uint64_t>::max();
+  /**
+   * @brief The object ID of the `index`-th record, without bounds checking or decoding the rest of
+   * the record (or of its block, unless the trace is a compressed compact trace).
+   */
+  [[nodiscard]] auto obj_id(size_t index) const -> uint64_t {
+    if (!mmap_->compact)
+      return detail::load_unaligned<uint64_t>(record_data(index) + Request::OBJ_ID_OFFSET);
+    CompactTrace::Scratch scratch;
+    return mmap_->compact->obj_id(index, scratch);
+  }
 
-    return record;
+  /**
+   * @brief Decode the records `[first, first + count)`, clamped to the trace, into `buffers`, one
+   * column per field, and hint the kernel to read the records that follow.
+   */
+  auto decode_columns(size_t first, size_t count, RequestColumnBuffers &buffers) const
+      -> RequestColumns {
+    first = std::min(first, num_entries_);
+    count = std::min(count, num_entries_ - first);
+    auto *timestamps = buffers.timestamps_.reserve(count);
+    auto *obj_ids = buffers.obj_ids_.reserve(count);
+    auto *obj_sizes = buffers.obj_sizes_.reserve(count);
+    auto *next_access_vtimes = buffers.next_access_vtimes_.reserve(count);
+
+    if (mmap_->compact) {
+      const auto &compact = *mmap_->compact;
+      for (size_t done = 0; done < count;) {
+        const size_t index = first + done;
+        const size_t b = index / compact.block_records();
+        const size_t start = index % compact.block_records();
+        const size_t n = std::min<size_t>(compact.block(b).num_records - start, count - done);
+        compact.decode_block(b, start, n, timestamps + done, obj_ids + done, obj_sizes + done,
+                             buffers.scratch_);
+        done += n;
+      }
+      std::fill_n(next_access_vtimes, count, std::numeric_limits<uint64_t>::max());
+    } else {
+      const size_t next = first + count;
+      detail::advise_mapping(record_data(next),
+                             std::min(count, num_entries_ - next) * Request::UNALIGNED_SIZE,
+                             detail::ADVICE_WILLNEED);
+
+      const char *data = record_data(first);
+      for (size_t i = 0; i < count; i++, data += Request::UNALIGNED_SIZE) {
+        timestamps[i] = detail::load_unaligned<uint32_t>(data);
+        obj_ids[i] = detail::load_unaligned<uint64_t>(data + Request::OBJ_ID_OFFSET);
+        obj_sizes[i] = detail::load_unaligned<uint32_t>(data + Request::OBJ_SIZE_OFFSET);
+        next_access_vtimes[i] = detail::decode_next_access_vtime(data);
+      }
+    }
+
+    return {
+        .timestamps = {timestamps, count},
+        .obj_ids = {obj_ids, count},
+        .obj_sizes = {obj_sizes, count},
+        .next_access_vtimes = {next_access_vtimes, count},
+    };
+  }
+
+  /**
+   * @brief Call `f` with the columns of each consecutive chunk of `chunk_records` records, in
+   * order, decoding them into `buffers`.
+   */
+  template <typename F>
+  void for_each_columns(F &&f, RequestColumnBuffers &buffers,
+                        const size_t chunk_records =
+                            RequestColumnBuffers::DEFAULT_CHUNK_RECORDS) const {
+    for (size_t first = 0; first < num_entries_; first += chunk_records)
+      f(decode_columns(first, chunk_records, buffers));
   }
 
   [[nodiscard]] auto filepath() const noexcept -> const std::string & { return filepath_; }
@@ -274,18 +422,27 @@ public:
 
   [[nodiscard]] auto size() const noexcept -> size_t { return num_entries_; }
 
-  [[nodiscard]] auto begin() const -> iterator { return {filepath_, 0, num_entries_}; }
-  [[nodiscard]] auto rbegin() const -> iterator {
-    return {filepath_, num_entries_ - 1, num_entries_};
+  /**
+   * @brief The blocks of the trace if it is a compact trace, or else null.
+   */
+  [[nodiscard]] auto compact() const noexcept -> const CompactTrace * {
+    return mmap_ && mmap_->compact ? &*mmap_->compact : nullptr;
   }
 
-  [[nodiscard]] auto end() const -> iterator { return {filepath_, num_entries_, num_entries_}; }
-  [[nodiscard]] auto rend() const -> iterator { return {filepath_, num_entries_, num_entries_}; }
+  [[nodiscard]] auto begin() const -> iterator { return {mmap_, 0, num_entries_}; }
+  [[nodiscard]] auto rbegin() const -> iterator { return {mmap_, num_entries_ - 1, num_entries_}; }
+
+  [[nodiscard]] auto end() const -> iterator { return {mmap_, num_entries_, num_entries_}; }
+  [[nodiscard]] auto rend() const -> iterator { return {mmap_, num_entries_, num_entries_}; }
 
 private:
-  std::string filepath_;   // File path
-  size_t num_entries_ = 0; // Total number of records
-  mio::mmap_source mmap_;  // Memory-mapped file
+  std::string filepath_;                // File path
+  size_t num_entries_ = 0;              // Total number of records
+  std::shared_ptr<const Mapping> mmap_; // Memory-mapped file, shared by copies and iterators
+
+  [[nodiscard]] auto record_data(const size_t index) const noexcept -> const char * {
+    return mmap_->mmap.data() + index * Request::UNALIGNED_SIZE;
+  }
 };
 
 inline auto get_cache_dir() -> std::filesystem::path {
@@ -297,77 +454,46 @@ inline auto get_cache_dir() -> std::filesystem::path {
 }
 
 /**
- * @brief Count unique object IDs in a cache trace, with persistent file-based cache.
+ * @brief The profile of a cache trace (see `TraceProfile`), computed in one parallel pass over its
+ * columns, with persistent file-based cache.
+ *
+ * @param trace Reference to a trace object.
+ * @param use_cache Whether to read/write cache files (default: true).
+ */
+inline auto profile_trace(const CachingTrace &trace, bool use_cache = true) -> TraceProfile {
+  return cached_trace_profile(
+      trace.filepath(), get_cache_dir(), trace.size(),
+      [&] {
+        std::optional<TraceTimeSpan> span;
+        if (trace.size() > 0)
+          span = TraceTimeSpan{.first = trace[0].timestamp,
+                               .last = trace[trace.size() - 1].timestamp};
+        return profile_keys<uint64_t>(
+            trace.size(),
+            [&](const size_t first, const size_t count, auto &&f) {
+              constexpr size_t CHUNK = RequestColumnBuffers::DEFAULT_CHUNK_RECORDS;
+              RequestColumnBuffers buffers;
+              for (size_t done = 0; done < count; done += CHUNK) {
+                const auto columns =
+                    trace.decode_columns(first + done, std::min(CHUNK, count - done), buffers);
+                f(columns.obj_ids, columns.timestamps);
+              }
+            },
+            span, profile_threads(trace.size()));
+      },
+      use_cache);
+}
+
+/**
+ * @brief Count unique object IDs in a cache trace, from its profile (see `profile_trace()`).
  *
  * @param trace Reference to a trace object.
  * @param use_cache Whether to read/write cache files (default: true).
  * @return Number of unique object IDs (size_t).
  */
 inline auto count_unique_objects(const CachingTrace &trace, bool use_cache = true) -> size_t {
-  // Determine cache directory
-  const auto cache_dir = get_cache_dir();
-
-  const std::filesystem::path file_path = trace.filepath();
-
-  // Get last write time and convert to milliseconds since epoch
-  const auto ftime = std::filesystem::last_write_time(file_path);
-#if __cpp_lib_chrono >= 201907L
-  const auto sys_time = std::chrono::clock_cast<std::chrono::system_clock>(ftime);
-#else
-  const auto sys_time = std::chrono::file_clock::to_sys(ftime);
-#endif
-  const auto ms = std::chrono::time_point_cast<std::chrono::milliseconds>(sys_time);
-  const auto mtime_ms = ms.time_since_epoch().count();
-
-  const auto basename = file_path.filename().string();
-  const std::string cache_key_prefix = "unique_objects_" + basename + "_";
-  const std::string cache_key = cache_key_prefix + std::to_string(mtime_ms);
-
-  // Full path to cache file
-  const auto cache_file = cache_dir / cache_key;
-
-  // Attempt to read from cache
-  if (use_cache) {
-    if (std::filesystem::exists(cache_file)) {
-      std::ifstream ifs{cache_file, std::ios::in};
-      if (ifs) {
-        std::string content;
-        std::getline(ifs, content);
-        try {
-          const size_t cached_count = std::stoull(content);
-          return cached_count;
-        } catch (const std::exception &e) {
-          std::cerr << "Warning: failed to parse cached count (" << e.what() << ")\n";
-          // Fall through to recompute
-        }
-      }
-    }
-  }
-
-  // Compute unique-count
-  std::unordered_set<uint64_t> id_set;
-  for (const auto &req : trace)
-    id_set.insert(req.obj_id);
-  const size_t unique_count = id_set.size();
-
-  // Write to cache and clean up old entries
-  if (use_cache) {
-    // Write current count
-    {
-      std::ofstream ofs{cache_file, std::ios::out | std::ios::trunc};
-      ofs << unique_count;
-    }
-
-    // Remove outdated cache files sharing the prefix (but not the current key)
-    for (const auto &entry : std::filesystem::directory_iterator{cache_dir}) {
-      if (!entry.is_regular_file())
-        continue;
-      const auto filename = entry.path().filename().string();
-      if (filename.starts_with(cache_key_prefix) && filename != cache_key) {
-        std::filesystem::remove(entry.path());
-      }
-    }
-  }
-
-  return unique_count;
+  // Compact traces number their objects densely
+  if (const auto *compact = trace.compact())
+    return compact->num_objects();
+  return profile_trace(trace, use_cache).num_objects;
 }
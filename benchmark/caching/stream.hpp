@@ -0,0 +1,332 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <ios>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "../utils/scheduler.hpp"
+#include "reader.hpp"
+
+struct StreamingTraceOptions {
+  // The bytes read at a time, rounded down to a whole number of records and disk blocks
+  size_t chunk_bytes = size_t{4} << 20;
+  // The chunks in flight, i.e., one being replayed while the others are read ahead
+  size_t buffers = 3;
+  // Whether to bypass the page cache (`O_DIRECT` on Linux, `F_NOCACHE` on macOS) where supported.
+  // Otherwise, the pages read are dropped from the page cache as soon as they are copied.
+  bool direct = true;
+};
+
+/**
+ * @brief A `.oracleGeneral` trace read front to back through a few fixed-size buffers instead of
+ * mapping it, for traces larger than memory.
+ *
+ * A thread reads chunks ahead with `pread` while the trace is replayed, so replays run at
+ * sequential disk bandwidth, take `footprint_bytes()` of memory whatever the size of the trace, and
+ * leave the page cache to the rest of the system. Each `begin()` starts a scan of its own, and its
+ * iterator can only move forward.
+ */
+class StreamingCachingTrace {
+  // The alignment of the buffers, offsets and lengths of direct I/O
+  static constexpr size_t BLOCK_BYTES = 4096;
+  // The smallest chunk that holds whole records and whole blocks, i.e., lcm(24, 4096)
+  static constexpr size_t CHUNK_UNIT = BLOCK_BYTES * 3;
+  static_assert(CHUNK_UNIT % Request::UNALIGNED_SIZE == 0);
+
+  class Stream {
+  public:
+    Stream(const std::string &path, const size_t file_bytes, const StreamingTraceOptions &options)
+        : file_bytes_(file_bytes),
+          chunk_bytes_(std::max(CHUNK_UNIT, options.chunk_bytes / CHUNK_UNIT * CHUNK_UNIT)) {
+#if defined(__unix__) || defined(__APPLE__)
+      const int flags = O_RDONLY | O_CLOEXEC;
+#if defined(O_DIRECT)
+      if (options.direct) {
+        fd_ = ::open(path.c_str(), flags | O_DIRECT);
+        direct_ = fd_ >= 0;
+      }
+#endif
+      // Without direct I/O, e.g., on file systems such as tmpfs that refuse it
+      if (fd_ < 0)
+        fd_ = ::open(path.c_str(), flags);
+      if (fd_ < 0)
+        throw std::ios_base::failure(std::format("Failed to open file: {}", path));
+#if defined(F_NOCACHE)
+      if (options.direct)
+        direct_ = ::fcntl(fd_, F_NOCACHE, 1) == 0;
+#endif
+#if defined(__linux__)
+      if (!direct_)
+        ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#else
+      (void)path;
+      throw std::runtime_error("Streaming traces are only supported on POSIX systems");
+#endif
+
+      const size_t buffers = std::max<size_t>(2, options.buffers);
+      for (size_t i = 0; i < buffers; i++)
+        buffers_.push_back({.data = std::unique_ptr<char[], BlockDeleter>(static_cast<char *>(
+                                ::operator new(chunk_bytes_, std::align_val_t{BLOCK_BYTES})))});
+      free_ = buffers;
+      reader_ = std::jthread([this](const std::stop_token &stop) { read_ahead(stop); });
+    }
+
+    ~Stream() {
+      reader_.request_stop();
+      reader_.join();
+#if defined(__unix__) || defined(__APPLE__)
+      ::close(fd_);
+#endif
+    }
+
+    Stream(const Stream &) = delete;
+    auto operator=(const Stream &) -> Stream & = delete;
+    Stream(Stream &&) = delete;
+    auto operator=(Stream &&) -> Stream & = delete;
+
+    /**
+     * @brief Give the chunk handed out last back to the reader and wait for the next one, which is
+     * empty at the end of the trace.
+     */
+    auto next() -> std::span<const char> {
+      std::unique_lock lock(mutex_);
+      if (std::exchange(holding_, false)) {
+        head_ = (head_ + 1) % buffers_.size();
+        free_++;
+        cv_.notify_all();
+      }
+      cv_.wait(lock, [this] { return ready_ > 0 || done_; });
+      if (ready_ == 0) {
+        if (error_)
+          std::rethrow_exception(error_);
+        return {};
+      }
+      ready_--;
+      holding_ = true;
+      return {buffers_[head_].data.get(), buffers_[head_].bytes};
+    }
+
+  private:
+    struct BlockDeleter {
+      void operator()(char *data) const { ::operator delete(data, std::align_val_t{BLOCK_BYTES}); }
+    };
+
+    struct Buffer {
+      std::unique_ptr<char[], BlockDeleter> data;
+      size_t bytes = 0;
+    };
+
+    size_t file_bytes_;
+    size_t chunk_bytes_;
+    int fd_ = -1;
+    bool direct_ = false;
+    std::vector<Buffer> buffers_;
+
+    std::mutex mutex_;
+    std::condition_variable_any cv_;
+    size_t free_ = 0;  // Buffers the reader may fill
+    size_t ready_ = 0; // Filled buffers not handed out yet, from `head_` on
+    size_t head_ = 0;
+    bool holding_ = false; // Whether the buffer at `head_` is being replayed
+    bool done_ = false;
+    std::exception_ptr error_;
+
+    std::jthread reader_; // Last, so that it stops before the rest goes away
+
+    void read_ahead(const std::stop_token &stop) {
+      try {
+        size_t tail = 0;
+        for (size_t offset = 0; offset < file_bytes_; offset += chunk_bytes_) {
+          {
+            std::unique_lock lock(mutex_);
+            if (!cv_.wait(lock, stop, [this] { return free_ > 0; }))
+              return;
+            free_--;
+          }
+          auto &buffer = buffers_[tail];
+          buffer.bytes = read_chunk(buffer.data.get(), offset);
+          {
+            const std::lock_guard lock(mutex_);
+            ready_++;
+          }
+          cv_.notify_all();
+          tail = (tail + 1) % buffers_.size();
+        }
+      } catch (...) {
+        const std::lock_guard lock(mutex_);
+        error_ = std::current_exception();
+      }
+      {
+        const std::lock_guard lock(mutex_);
+        done_ = true;
+      }
+      cv_.notify_all();
+    }
+
+    // Read the chunk at `offset` into `data`, and return its bytes, i.e., fewer than a full chunk
+    // only at the end of the file
+    auto read_chunk([[maybe_unused]] char *data, const size_t offset) -> size_t {
+      const size_t bytes = std::min(chunk_bytes_, file_bytes_ - offset);
+#if defined(__unix__) || defined(__APPLE__)
+      // Direct I/O reads whole blocks, past the end of the file if need be
+      const size_t length = direct_ ? (bytes + BLOCK_BYTES - 1) / BLOCK_BYTES * BLOCK_BYTES : bytes;
+      size_t done = 0;
+      while (done < bytes) {
+        const ssize_t n =
+            ::pread(fd_, data + done, length - done, static_cast<off_t>(offset + done));
+        if (n < 0 && errno == EINTR)
+          continue;
+#if defined(O_DIRECT)
+        if (n < 0 && errno == EINVAL && direct_ && done == 0) {
+          // Some file systems accept `O_DIRECT` when opening but not when reading
+          ::fcntl(fd_, F_SETFL, ::fcntl(fd_, F_GETFL) & ~O_DIRECT);
+          direct_ = false;
+          return read_chunk(data, offset);
+        }
+#endif
+        if (n < 0)
+          throw std::system_error(errno, std::generic_category(), "Failed to read trace");
+        if (n == 0)
+          throw std::ios_base::failure("Trace file shrank while streaming it");
+        done += static_cast<size_t>(n);
+      }
+#if defined(__linux__)
+      // The records are in the buffer now, so their pages only crowd out other data
+      if (!direct_)
+        ::posix_fadvise(fd_, static_cast<off_t>(offset), static_cast<off_t>(bytes),
+                        POSIX_FADV_DONTNEED);
+#endif
+#endif
+      return bytes;
+    }
+  };
+
+public:
+  class iterator {
+  public:
+    using value_type = Request;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+    explicit iterator(std::unique_ptr<Stream> stream) : stream_(std::move(stream)) { next_chunk(); }
+
+    iterator(iterator &&) noexcept = default;
+    auto operator=(iterator &&) noexcept -> iterator & = default;
+
+    auto operator*() const -> const Request & { return current_record_; }
+
+    auto operator->() const -> const Request * { return &current_record_; }
+
+    auto operator++() -> iterator & {
+      offset_ += Request::UNALIGNED_SIZE;
+      if (offset_ == chunk_.size())
+        next_chunk();
+      else
+        current_record_ = detail::decode_request(chunk_.data() + offset_);
+      return *this;
+    }
+
+    void operator++(int) { ++*this; }
+
+    friend auto operator==(const iterator &it, std::default_sentinel_t /*end*/) -> bool {
+      return it.stream_ == nullptr;
+    }
+
+  private:
+    std::unique_ptr<Stream> stream_; // Null at the end of the trace
+    std::span<const char> chunk_;
+    size_t offset_ = 0;
+    Request current_record_{};
+
+    void next_chunk() {
+      chunk_ = stream_->next();
+      offset_ = 0;
+      if (chunk_.empty())
+        stream_.reset();
+      else
+        current_record_ = detail::decode_request(chunk_.data());
+    }
+  };
+
+  explicit StreamingCachingTrace(const std::string_view pathname,
+                                 const StreamingTraceOptions &options = {})
+      : filepath_(pathname), options_(options) {
+    std::error_code ec;
+    file_bytes_ = std::filesystem::file_size(filepath_, ec);
+    if (ec)
+      throw std::ios_base::failure(std::format("Failed to open file: {}", pathname));
+    if (is_compact_trace(filepath_))
+      throw std::invalid_argument(
+          std::format("Compact traces cannot be streamed, but are small enough to map: {}",
+                      pathname));
+    if (file_bytes_ % Request::UNALIGNED_SIZE != 0)
+      throw std::ios_base::failure(std::format(
+          "File size is not a multiple of record size ({} bytes).", Request::UNALIGNED_SIZE));
+  }
+
+  [[nodiscard]] auto filepath() const noexcept -> const std::string & { return filepath_; }
+
+  [[nodiscard]] auto num_entries() const noexcept -> size_t {
+    return file_bytes_ / Request::UNALIGNED_SIZE;
+  }
+
+  [[nodiscard]] auto size() const noexcept -> size_t { return num_entries(); }
+
+  /**
+   * @brief The memory that a scan of the trace takes for its buffers.
+   */
+  [[nodiscard]] auto footprint_bytes() const noexcept -> size_t {
+    return std::max<size_t>(2, options_.buffers) *
+           std::max(CHUNK_UNIT, options_.chunk_bytes / CHUNK_UNIT * CHUNK_UNIT);
+  }
+
+  // Starts a scan, whose reads begin right away
+  [[nodiscard]] auto begin() const -> iterator {
+    if (file_bytes_ == 0)
+      return {};
+    return iterator(std::make_unique<Stream>(filepath_, file_bytes_, options_));
+  }
+
+  [[nodiscard]] auto end() const -> std::default_sentinel_t { return std::default_sentinel; }
+
+private:
+  std::string filepath_;
+  size_t file_bytes_ = 0;
+  StreamingTraceOptions options_;
+};
+
+/**
+ * @brief Whether the trace at `path` is better streamed than mapped, i.e., whether it would take
+ * more than half of the memory available.
+ */
+[[nodiscard]] inline auto prefer_streaming(const std::string &path) -> bool {
+  std::error_code ec;
+  const auto file_bytes = std::filesystem::file_size(path, ec);
+  const auto available = available_memory_bytes();
+  return !ec && available != 0 && file_bytes > available / 2 && !is_compact_trace(path);
+}
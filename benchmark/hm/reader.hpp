@@ -1,6 +1,8 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <charconv>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
@@ -11,14 +13,24 @@
 #include <ios>
 #include <iostream>
 #include <iterator>
+#include <memory>
+#include <optional>
+#include <random>
+#include <span>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
 #include <version>
 
 #include <mio/mmap.hpp>
 #include <spdlog/spdlog.h>
 #include <unordered_set>
 
+#include "../utils/profile.hpp"
+
 // NOLINTNEXTLINE(cppcoreguidelines-pro-type-member-init)
 struct Transaction {
   uint32_t product_code;
@@ -108,8 +120,127 @@ inline auto count_file_lines_hm(const std::filesystem::path &path, bool use_cach
   return count;
 }
 
+namespace detail {
+
+inline auto hm_file_mtime_ms(const std::filesystem::path &path) -> long long {
+  const auto ftime = std::filesystem::last_write_time(path);
+#if __cpp_lib_chrono >= 201907L
+  const auto sys_time = std::chrono::clock_cast<std::chrono::system_clock>(ftime);
+#else
+  const auto sys_time = std::chrono::file_clock::to_sys(ftime);
+#endif
+  const auto ms = std::chrono::time_point_cast<std::chrono::milliseconds>(sys_time);
+  return ms.time_since_epoch().count();
+}
+
+/**
+ * @brief The header of a `.hmbin` file, which is followed by `num_entries` product codes as
+ * native-endian `uint32_t`.
+ */
+struct HmBinHeader {
+  static constexpr std::array<char, 8> MAGIC = {'H', 'M', 'B', 'I', 'N', '\0', '\0', '\1'};
+
+  std::array<char, 8> magic = MAGIC;
+  uint64_t num_entries = 0;
+};
+static_assert(sizeof(HmBinHeader) == 16 && alignof(HmBinHeader) <= alignof(uint64_t));
+
+/**
+ * @brief Parse the product codes of a CSV transaction trace, i.e., the second column of every line
+ * but the header.
+ *
+ * Lines and columns are found with `std::memchr`, which libc vectorizes, and the codes are parsed
+ * with `std::from_chars`, so no line is ever copied into a string.
+ */
+inline auto parse_hm_csv(const char *data, const size_t size, const std::string &filepath)
+    -> std::vector<uint32_t> {
+  const char *const end = data + size;
+  const char *line = static_cast<const char *>(std::memchr(data, '\n', size));
+  line = line == nullptr ? end : line + 1; // Skip the header
+
+  std::vector<uint32_t> codes;
+  // A transaction line is seldom shorter than this, so reserving for it rarely reallocates
+  constexpr size_t MIN_LINE_BYTES = 16;
+  codes.reserve(static_cast<size_t>(end - line) / MIN_LINE_BYTES);
+  for (size_t number = 2; line < end; number++) {
+    const auto *newline = static_cast<const char *>(std::memchr(line, '\n', end - line));
+    const char *const line_end = newline == nullptr ? end : newline;
+    if (line_end != line && !(line_end - line == 1 && *line == '\r')) {
+      const auto *comma = static_cast<const char *>(std::memchr(line, ',', line_end - line));
+      uint32_t code = 0;
+      const auto [ptr, ec] =
+          comma == nullptr ? std::from_chars_result{line, std::errc::invalid_argument}
+                           : std::from_chars(comma + 1, line_end, code);
+      if (ec != std::errc{})
+        throw std::ios_base::failure(
+            std::format("Malformed product code on line {} of {}", number, filepath));
+      codes.push_back(code);
+    }
+    line = newline == nullptr ? end : newline + 1;
+  }
+  return codes;
+}
+
+} // namespace detail
+
 /**
- * @brief A wrapper of a transaction trace file supporting read-only iteration using mmap.
+ * @brief The product codes of the transaction trace at `path` in a `.hmbin` file under the cache
+ * directory, converted from the CSV on first use and again whenever the CSV changes.
+ *
+ * @param path Path to the CSV trace.
+ * @return The path of the `.hmbin` file.
+ */
+inline auto hm_binary_cache(const std::filesystem::path &path) -> std::filesystem::path {
+  const auto cache_dir = get_hm_cache_dir();
+  const std::string cache_key_prefix = "transactions_" + path.filename().string() + "_";
+  const std::string cache_key =
+      cache_key_prefix + std::to_string(detail::hm_file_mtime_ms(path)) + ".hmbin";
+  const auto cache_file = cache_dir / cache_key;
+  if (std::filesystem::exists(cache_file))
+    return cache_file;
+
+  mio::mmap_source csv;
+  try {
+    csv = mio::mmap_source(path.string());
+  } catch (const std::system_error &e) {
+    throw std::ios_base::failure(std::format("Failed to open file: {}", path.string()));
+  }
+  const auto codes = detail::parse_hm_csv(csv.data(), csv.size(), path.string());
+
+  // Write under a name of its own and rename it into place, so that concurrent benchmark processes
+  // converting the same trace never see a partial file
+  const auto temp_file = cache_dir / std::format("{}.{}.tmp", cache_key, std::random_device{}());
+  {
+    std::ofstream ofs{temp_file, std::ios::out | std::ios::binary | std::ios::trunc};
+    const detail::HmBinHeader header{.num_entries = codes.size()};
+    ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char *>(codes.data()),
+              static_cast<std::streamsize>(codes.size() * sizeof(uint32_t)));
+    if (!ofs)
+      throw std::ios_base::failure(std::format("Failed to write {}", temp_file.string()));
+  }
+  std::filesystem::rename(temp_file, cache_file);
+
+  // Remove outdated cache files sharing the prefix (but not the current key)
+  for (const auto &entry : std::filesystem::directory_iterator{cache_dir}) {
+    if (!entry.is_regular_file())
+      continue;
+    const auto filename = entry.path().filename().string();
+    if (filename.starts_with(cache_key_prefix) && filename != cache_key &&
+        filename.ends_with(".hmbin"))
+      std::filesystem::remove(entry.path());
+  }
+
+  return cache_file;
+}
+
+/**
+ * @brief A wrapper of a transaction trace file supporting read-only iteration and O(1) random
+ * access.
+ *
+ * The CSV is converted once into a binary `.hmbin` file of product codes (see `hm_binary_cache`),
+ * which is then memory-mapped, so the trace loads without parsing. With `use_cache` off, the CSV is
+ * parsed into memory instead. Either way, copies of the trace and its iterators share the codes.
  */
 class TransactionTrace {
 public:
@@ -122,85 +253,14 @@ public:
     using pointer = const Transaction *;
     using reference = const Transaction &;
 
-    iterator() : index_(0), offset_(0), total_(0), end_(true), current_record_() {}
-
-    iterator(std::string filename, size_t index, size_t total)
-        : filename_(std::move(filename)), index_(index), total_(total), end_(index >= total),
-          current_record_() {
-      if (!end_) {
-        // Memory-map the file
-        try {
-          mmap_ = mio::mmap_source(filename_);
-        } catch (const std::system_error &e) {
-          throw std::ios_base::failure(
-              std::format("Failed to open file in iterator: {}", filename_));
-        }
-
-        offset_ = index_to_offset(mmap_, index, total);
-
-        // Read the current record
-        read_current();
-      }
-    }
-
-    iterator(iterator &&other) noexcept
-        : filename_(std::move(other.filename_)), index_(other.index_), offset_(other.offset_),
-          total_(other.total_), end_(other.end_), mmap_(std::move(other.mmap_)),
-          current_record_(other.current_record_) {
-      other.end_ = true;
-    }
-
-    auto operator=(iterator &&other) noexcept -> iterator & {
-      if (this != &other) {
-        filename_ = std::move(other.filename_);
-        index_ = other.index_;
-        offset_ = other.offset_;
-        total_ = other.total_;
-        end_ = other.end_;
-        mmap_ = std::move(other.mmap_);
-        current_record_ = other.current_record_;
-        other.end_ = true;
-      }
-      return *this;
-    }
-
-    iterator(const iterator &other)
-        : filename_(other.filename_), index_(other.index_), offset_(other.offset_),
-          total_(other.total_), end_(other.end_), current_record_(other.current_record_) {
-      try {
-        mmap_ = mio::mmap_source(filename_); // Re-map the file content
-      } catch (const std::system_error &e) {
-        throw std::ios_base::failure(std::format("Failed to copy mmap in iterator: {}", filename_));
-      }
-      if (!end_) {
-        read_current();
-      }
-    }
-
-    auto operator=(const iterator &other) -> iterator & {
-      if (this != &other) {
-        filename_ = other.filename_;
-        index_ = other.index_;
-        offset_ = other.offset_;
-        total_ = other.total_;
-        end_ = other.end_;
-        current_record_ = other.current_record_;
-
-        try {
-          mmap_ = mio::mmap_source(filename_); // Re-map the file content
-        } catch (const std::system_error &e) {
-          throw std::ios_base::failure(
-              std::format("Failed to copy mmap in iterator: {}", filename_));
-        }
+    iterator() : index_(0), total_(0), end_(true), current_record_() {}
 
-        if (!end_)
-          read_current();
-      }
-      return *this;
+    iterator(std::shared_ptr<const void> storage, std::span<const uint32_t> codes, size_t index)
+        : storage_(std::move(storage)), codes_(codes), index_(index), total_(codes.size()),
+          end_(index >= total_), current_record_() {
+      read_current();
     }
 
-    ~iterator() = default;
-
     auto operator*() const -> const Transaction & { return current_record_; }
 
     auto operator->() const -> const Transaction * { return &current_record_; }
@@ -223,229 +283,126 @@ public:
     }
 
     auto operator==(const iterator &other) const -> bool {
-      return (end_ && other.end_) || (index_ == other.index_ && filename_ == other.filename_);
+      return (end_ && other.end_) || (index_ == other.index_ && storage_ == other.storage_);
     }
 
     auto operator!=(const iterator &other) const -> bool { return !(*this == other); }
 
   private:
     void read_current() {
-      if (end_)
-        return;
-
-      // Read the raw data into the record
-      const char *data = &mmap_[offset_];
-
-      size_t start = 0;
-      size_t end = 0;
-      while (offset_ + end < mmap_.size() && data[end] != ',')
-        end++;
-
-      start = end + 1; // Skip the comma
-      end++;
-      while (offset_ + end < mmap_.size() && data[end] != '\n')
-        end++;
-      current_record_.product_code =
-          static_cast<uint32_t>(std::stoul(std::string(data + start, end - start)));
-
-      offset_ += end; // Move to the next record
+      if (!end_)
+        current_record_.product_code = codes_[index_];
     }
 
-    std::string filename_;       // File path
-    size_t index_;               // Current index
-    size_t offset_;              // Current offset
-    size_t total_;               // Total number of records
-    bool end_;                   // End flag
-    mio::mmap_source mmap_;      // Memory-mapped file
-    Transaction current_record_; // Current record
+    std::shared_ptr<const void> storage_; // Keeps the codes alive
+    std::span<const uint32_t> codes_;     // Product codes
+    size_t index_;                        // Current index
+    size_t total_;                        // Total number of records
+    bool end_;                            // End flag
+    Transaction current_record_;          // Current record
   };
 
-  // Constructor, open file and read total number of records
-  explicit TransactionTrace(const std::string_view pathname) : filepath_(pathname) {
-    try {
-      mmap_ = mio::mmap_source(filepath_);
-    } catch (const std::system_error &e) {
+  // Constructor, open file and load the product codes, converting the CSV on first use
+  explicit TransactionTrace(const std::string_view pathname, const bool use_cache = true)
+      : filepath_(pathname) {
+    if (!std::filesystem::exists(filepath_))
       throw std::ios_base::failure(std::format("Failed to open file: {}", pathname));
-    }
-
-    // Compute the number of entries
-    num_entries_ = count_file_lines_hm(filepath_) - 1; // Subtract 1 for the header line
-  }
-
-  ~TransactionTrace() = default;
-
-  TransactionTrace(const TransactionTrace &other)
-      : filepath_(other.filepath_), num_entries_(other.num_entries_) {
-    try {
-      mmap_ = mio::mmap_source(filepath_); // Re-map the file content
-    } catch (const std::system_error &e) {
-      throw std::ios_base::failure(
-          std::format("Failed to copy mmap in TransactionTrace: {}", filepath_));
-    }
-  }
 
-  auto operator=(const TransactionTrace &other) -> TransactionTrace & {
-    if (this != &other) {
-      filepath_ = other.filepath_;
-      num_entries_ = other.num_entries_;
-      try {
-        mmap_ = mio::mmap_source(filepath_); // Re-map the file content
-      } catch (const std::system_error &e) {
-        throw std::ios_base::failure(
-            std::format("Failed to copy mmap in TransactionTrace: {}", filepath_));
+    if (!use_cache) {
+      auto codes = std::make_shared<std::vector<uint32_t>>();
+      {
+        mio::mmap_source csv;
+        try {
+          csv = mio::mmap_source(filepath_);
+        } catch (const std::system_error &e) {
+          throw std::ios_base::failure(std::format("Failed to open file: {}", pathname));
+        }
+        *codes = detail::parse_hm_csv(csv.data(), csv.size(), filepath_);
       }
+      codes_ = *codes;
+      storage_ = std::move(codes);
+      return;
     }
-    return *this;
-  }
 
-  TransactionTrace(TransactionTrace &&other) noexcept
-      : filepath_(std::move(other.filepath_)), num_entries_(other.num_entries_),
-        mmap_(std::move(other.mmap_)) {
-    other.num_entries_ = 0;
-  }
-
-  TransactionTrace &operator=(TransactionTrace &&other) noexcept {
-    if (this != &other) {
-      filepath_ = std::move(other.filepath_);
-      num_entries_ = other.num_entries_;
-      mmap_ = std::move(other.mmap_);
-      other.num_entries_ = 0;
+    const auto binary = hm_binary_cache(filepath_);
+    std::shared_ptr<const mio::mmap_source> mmap;
+    try {
+      mmap = std::make_shared<const mio::mmap_source>(binary.string());
+    } catch (const std::system_error &e) {
+      throw std::ios_base::failure(std::format("Failed to open file: {}", binary.string()));
     }
-    return *this;
+    detail::HmBinHeader header;
+    if (mmap->size() >= sizeof(header))
+      std::memcpy(&header, mmap->data(), sizeof(header));
+    if (mmap->size() < sizeof(header) || header.magic != detail::HmBinHeader::MAGIC ||
+        mmap->size() != sizeof(header) + header.num_entries * sizeof(uint32_t))
+      throw std::ios_base::failure(
+          std::format("Corrupt converted trace {}; delete it to convert again", binary.string()));
+    // The mapping is page-aligned and the header keeps the codes 4-byte aligned
+    codes_ = {reinterpret_cast<const uint32_t *>(mmap->data() + sizeof(header)),
+              static_cast<size_t>(header.num_entries)};
+    storage_ = std::move(mmap);
   }
 
-  auto operator[](size_t index) const -> Transaction {
-    if (index >= num_entries_)
+  [[nodiscard]] auto operator[](size_t index) const -> Transaction {
+    if (index >= codes_.size())
       throw std::out_of_range(
-          std::format("Index {} is out of range (total entries: {}).", index, num_entries_));
-
-    // Read the record from the memory-mapped file
-    const size_t offset = index_to_offset(mmap_, index, num_entries_);
-    const char *data = &mmap_[offset];
-
-    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-member-init)
-    Transaction record;
-
-    size_t start = 0;
-    size_t end = 0;
-    while (offset + end < mmap_.size() && data[end] != ',')
-      end++;
-
-    start = end + 1; // Skip the comma
-    end++;
-    while (offset + end < mmap_.size() && data[end] != '\n')
-      end++;
-    record.product_code = static_cast<uint32_t>(std::stoul(std::string(data + start, end - start)));
-
-    return record;
+          std::format("Index {} is out of range (total entries: {}).", index, codes_.size()));
+    return {.product_code = codes_[index]};
   }
 
+  /**
+   * @brief All product codes in order, e.g., for bulk processing without an iterator.
+   */
+  [[nodiscard]] auto product_codes() const noexcept -> std::span<const uint32_t> { return codes_; }
+
   [[nodiscard]] auto filepath() const noexcept -> const std::string & { return filepath_; }
 
-  [[nodiscard]] auto num_entries() const noexcept -> size_t { return num_entries_; }
+  [[nodiscard]] auto num_entries() const noexcept -> size_t { return codes_.size(); }
 
-  [[nodiscard]] auto size() const noexcept -> size_t { return num_entries_; }
+  [[nodiscard]] auto size() const noexcept -> size_t { return codes_.size(); }
 
-  [[nodiscard]] auto begin() const -> iterator { return {filepath_, 0, num_entries_}; }
-  [[nodiscard]] auto rbegin() const -> iterator {
-    return {filepath_, num_entries_ - 1, num_entries_};
-  }
+  [[nodiscard]] auto begin() const -> iterator { return {storage_, codes_, 0}; }
+  [[nodiscard]] auto rbegin() const -> iterator { return {storage_, codes_, codes_.size() - 1}; }
 
-  [[nodiscard]] auto end() const -> iterator { return {filepath_, num_entries_, num_entries_}; }
-  [[nodiscard]] auto rend() const -> iterator { return {filepath_, num_entries_, num_entries_}; }
+  [[nodiscard]] auto end() const -> iterator { return {storage_, codes_, codes_.size()}; }
+  [[nodiscard]] auto rend() const -> iterator { return {storage_, codes_, codes_.size()}; }
 
 private:
-  std::string filepath_;   // File path
-  size_t num_entries_ = 0; // Total number of records
-  mio::mmap_source mmap_;  // Memory-mapped file
-
-  static auto index_to_offset(const mio::mmap_source &mmap, const size_t index, const size_t total)
-      -> std::size_t {
-    if (index >= total)
-      throw std::out_of_range(
-          std::format("Index {} is out of range (total entries: {}).", index, total));
-    size_t offset = 0;
-    for (size_t i = 0; i < index + 1; i++) {
-      while (offset < mmap.size() && mmap[offset] != '\n')
-        offset++;
-      offset++;
-    }
-    return offset;
-  }
+  std::string filepath_;                // File path
+  std::shared_ptr<const void> storage_; // The mapped `.hmbin` file or the parsed codes
+  std::span<const uint32_t> codes_;     // Product codes, owned by `storage_`
 };
 
 /**
- * @brief Counts unique products in a transcation trace, with persistent file-based cache.
+ * @brief The profile of a transaction trace (see `TraceProfile`), computed in one parallel pass
+ * over its product codes, with persistent file-based cache. Transactions have no timestamps, so
+ * the profile has no request rate.
+ *
+ * @param trace Reference to a trace object.
+ * @param use_cache Whether to read/write cache files (default: true).
+ */
+inline auto profile_trace(const TransactionTrace &trace, bool use_cache = true) -> TraceProfile {
+  return cached_trace_profile(
+      trace.filepath(), get_hm_cache_dir(), trace.size(),
+      [&] {
+        return profile_keys<uint32_t>(
+            trace.size(),
+            [&](const size_t first, const size_t count, auto &&f) {
+              f(trace.product_codes().subspan(first, count), std::span<const uint32_t>{});
+            },
+            std::nullopt, profile_threads(trace.size()));
+      },
+      use_cache);
+}
+
+/**
+ * @brief Counts unique products in a transcation trace, from its profile (see `profile_trace()`).
  *
  * @param trace Reference to a trace object.
  * @param use_cache Whether to read/write cache files (default: true).
  * @return Number of unique IPs (size_t).
  */
 inline auto count_unique_products(const TransactionTrace &trace, bool use_cache = true) -> size_t {
-  // Determine cache directory
-  const auto cache_dir = get_hm_cache_dir();
-
-  const std::filesystem::path file_path = trace.filepath();
-
-  // Get last write time and convert to milliseconds since epoch
-  const auto ftime = std::filesystem::last_write_time(file_path);
-#if __cpp_lib_chrono >= 201907L
-  const auto sys_time = std::chrono::clock_cast<std::chrono::system_clock>(ftime);
-#else
-  const auto sys_time = std::chrono::file_clock::to_sys(ftime);
-#endif
-  const auto ms = std::chrono::time_point_cast<std::chrono::milliseconds>(sys_time);
-  const auto mtime_ms = ms.time_since_epoch().count();
-
-  const auto basename = file_path.filename().string();
-  const std::string cache_key_prefix = "unique_products_" + basename + "_";
-  const std::string cache_key = cache_key_prefix + std::to_string(mtime_ms);
-
-  // Full path to cache file
-  const auto cache_file = cache_dir / cache_key;
-
-  // Attempt to read from cache
-  if (use_cache) {
-    if (std::filesystem::exists(cache_file)) {
-      std::ifstream ifs{cache_file, std::ios::in};
-      if (ifs) {
-        std::string content;
-        std::getline(ifs, content);
-        try {
-          const size_t cached_count = std::stoull(content);
-          return cached_count;
-        } catch (const std::exception &e) {
-          std::cerr << "Warning: failed to parse cached count (" << e.what() << ")\n";
-          // Fall through to recompute
-        }
-      }
-    }
-  }
-
-  // Compute unique-count
-  std::unordered_set<uint32_t> id_set;
-  for (const auto &transaction : trace)
-    id_set.insert(transaction.product_code);
-  const size_t unique_count = id_set.size();
-
-  // Write to cache and clean up old entries
-  if (use_cache) {
-    // Write current count
-    {
-      std::ofstream ofs{cache_file, std::ios::out | std::ios::trunc};
-      ofs << unique_count;
-    }
-
-    // Remove outdated cache files sharing the prefix (but not the current key)
-    for (const auto &entry : std::filesystem::directory_iterator{cache_dir}) {
-      if (!entry.is_regular_file())
-        continue;
-      const auto filename = entry.path().filename().string();
-      if (filename.starts_with(cache_key_prefix) && filename != cache_key) {
-        std::filesystem::remove(entry.path());
-      }
-    }
-  }
-
-  return unique_count;
+  return profile_trace(trace, use_cache).num_objects;
 }
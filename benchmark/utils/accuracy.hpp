@@ -0,0 +1,231 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <argparse/argparse.hpp>
+#include <fplus/fplus.hpp>
+
+#include "../../src/sketch.hpp"
+#include "../../src/utils/oracle.hpp"
+#include "../../src/utils/random.hpp"
+#include "../baselines/AdaSketch.hpp"
+#include "../baselines/CountMinSketch.hpp"
+#include "../caching/reader.hpp"
+#include "benchmark_task.hpp"
+#include "errors.hpp"
+
+/**
+ * @brief The arguments of the accuracy benchmark tasks.
+ */
+struct AccuracyArgs {
+  std::string trace_path;
+  std::vector<size_t> sizes;
+  double alpha;
+  size_t top;
+  size_t samples;
+  uint64_t seed;
+};
+
+inline auto parse_accuracy_args(int argc, char **argv) -> AccuracyArgs {
+  argparse::ArgumentParser program;
+  program.add_argument("trace_path").help("The path to the cache trace file");
+  program.add_argument("sizes").help(
+      "Comma-separated list of sketch sizes in bytes (e.g., '4096,65536,1048576')");
+  program.add_argument("alpha")
+      .help("The alpha value for time-decaying sketches")
+      .scan<'g', double>();
+  program.add_argument("--top")
+      .help("The number of most frequent keys to measure the error on")
+      .default_value(size_t{1000})
+      .scan<'u', size_t>();
+  program.add_argument("--samples")
+      .help("The number of keys drawn uniformly from all keys to measure the error on")
+      .default_value(size_t{1000})
+      .scan<'u', size_t>();
+  program.add_argument("--seed")
+      .help("The seed of the random keys and of the row hashes of sketches")
+      .default_value(uint64_t{42})
+      .scan<'u', uint64_t>();
+
+  try {
+    program.parse_args(argc, argv);
+    return {
+        .trace_path = program.get<std::string>("trace_path"),
+        .sizes = fplus::transform([](const std::string &s) -> size_t { return std::stoull(s); },
+                                  fplus::split(',', false, program.get<std::string>("sizes"))),
+        .alpha = program.get<double>("alpha"),
+        .top = program.get<size_t>("--top"),
+        .samples = program.get<size_t>("--samples"),
+        .seed = program.get<uint64_t>("--seed"),
+    };
+  } catch (const std::exception &e) {
+    throw usage_error(program.help().str(), e.what());
+  }
+}
+
+/**
+ * @brief Decode the object IDs of the trace once, so that all sketches and the oracle replay it
+ * from memory at the same time.
+ */
+inline auto decode_obj_ids(const std::string &trace_path) -> std::vector<uint64_t> {
+  const CachingTrace trace(trace_path);
+  std::vector<uint64_t> keys;
+  keys.reserve(trace.size());
+  RequestColumnBuffers buffers;
+  trace.for_each_columns(
+      [&](const RequestColumns &columns) {
+        keys.insert(keys.end(), columns.obj_ids.begin(), columns.obj_ids.end());
+      },
+      buffers);
+  return keys;
+}
+
+/**
+ * @brief Append the average relative and absolute errors of `sketch` over `keys` to `results`.
+ *
+ * Keys whose frequency has decayed to 0 are left out of the relative error.
+ */
+template <typename Sketch, typename Oracle>
+void append_errors(std::vector<double> &results, const Sketch &sketch, const Oracle &oracle,
+                   const std::vector<uint64_t> &keys) {
+  double relative = 0.0;
+  double absolute = 0.0;
+  size_t relative_count = 0;
+  for (const auto key : keys) {
+    const double truth = oracle.estimate(key);
+    const double error = std::abs(static_cast<double>(sketch.estimate(key)) - truth);
+    absolute += error;
+    if (truth > 0.0) {
+      relative += error / truth;
+      relative_count++;
+    }
+  }
+  constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+  results.push_back(relative_count > 0 ? relative / static_cast<double>(relative_count) : NaN);
+  results.push_back(keys.empty() ? NaN : absolute / static_cast<double>(keys.size()));
+}
+
+/**
+ * @brief Replay the trace into a sketch of each size and into the oracle, all in parallel, then
+ * measure the error of each sketch at the end of the trace.
+ *
+ * @return The errors of each size in turn, in the order of `ACCURACY_METRICS`.
+ */
+template <typename MakeSketch, typename OracleF>
+auto measure_accuracy(const AccuracyArgs &args, MakeSketch &&make_sketch, OracleF f)
+    -> std::vector<double> {
+  const auto trace = decode_obj_ids(args.trace_path);
+
+  using Sketch = std::invoke_result_t<MakeSketch &, size_t>;
+  std::vector<Sketch> sketches;
+  sketches.reserve(args.sizes.size());
+  for (const auto size : args.sizes)
+    sketches.push_back(make_sketch(size));
+  DecayedFrequencyOracle<uint64_t, OracleF> oracle(std::move(f), args.alpha);
+
+  {
+    std::vector<std::jthread> threads;
+    threads.emplace_back([&] {
+      for (const auto key : trace)
+        oracle.update(key);
+    });
+    for (auto &sketch : sketches)
+      threads.emplace_back([&] {
+        for (const auto key : trace)
+          sketch.update(key);
+      });
+  }
+
+  std::vector<std::pair<double, uint64_t>> frequencies;
+  frequencies.reserve(oracle.size());
+  oracle.for_each([&](const uint64_t key, const double frequency) {
+    frequencies.emplace_back(frequency, key);
+  });
+
+  // The most frequent keys, i.e., the ones a cache or a top-k query cares about
+  const auto top = std::min(args.top, frequencies.size());
+  std::ranges::partial_sort(frequencies, frequencies.begin() + static_cast<std::ptrdiff_t>(top),
+                            std::greater{});
+  std::vector<uint64_t> top_keys;
+  for (size_t i = 0; i < top; i++)
+    top_keys.push_back(frequencies[i].second);
+
+  // Keys drawn uniformly, most of which are rare and mostly suffer from collisions
+  std::vector<std::pair<double, uint64_t>> sampled;
+  std::mt19937_64 rng{derive_seed(args.seed, KEYS_SEED_STREAM)};
+  std::ranges::sample(frequencies, std::back_inserter(sampled), args.samples, rng);
+  std::vector<uint64_t> random_keys;
+  for (const auto &[_, key] : sampled)
+    random_keys.push_back(key);
+
+  std::vector<double> results;
+  for (const auto &sketch : sketches) {
+    append_errors(results, sketch, oracle, top_keys);
+    append_errors(results, sketch, oracle, random_keys);
+  }
+  return results;
+}
+
+// The decay of the sketches and the oracle, whose tasks take alphas in units of 10000 updates
+inline auto accuracy_decay(const uint32_t t, const double alpha) -> float {
+  return static_cast<float>(std::exp(alpha * static_cast<double>(t) / 10000.0));
+}
+
+/**
+ * @brief The errors of count-min sketches, which do not decay and are thus compared against exact
+ * counts.
+ */
+inline auto cms_accuracy(const AccuracyArgs &args) -> std::vector<double> {
+  auto no_decay = [](uint32_t /*t*/, double /*alpha*/) -> float { return 1.0F; };
+  return measure_accuracy(
+      args,
+      [&](const size_t size) {
+        return CountMinSketch<uint64_t>(MemoryBudget{size},
+                                        derive_seed(args.seed, SKETCH_SEED_STREAM));
+      },
+      no_decay);
+}
+
+/**
+ * @brief The errors of Ada-Sketches.
+ */
+inline auto ada_accuracy(const AccuracyArgs &args) -> std::vector<double> {
+  auto f = [alpha = args.alpha](uint32_t t) -> float { return accuracy_decay(t, alpha); };
+  return measure_accuracy(
+      args,
+      [&](const size_t size) {
+        return AdaSketch<uint64_t, decltype(f)>(
+            MemoryBudget{size},
+            AdaSketchOptions<decltype(f)>{.f = f,
+                                          .seed = derive_seed(args.seed, SKETCH_SEED_STREAM)});
+      },
+      accuracy_decay);
+}
+
+/**
+ * @brief The errors of evolving sketches at the fixed alpha of `args`.
+ */
+inline auto evo_accuracy(const AccuracyArgs &args) -> std::vector<double> {
+  auto f = [](uint32_t t, double alpha) -> float { return accuracy_decay(t, alpha); };
+  return measure_accuracy(
+      args,
+      [&](const size_t size) {
+        return EvolvingSketch<uint64_t, decltype(f)>(
+            MemoryBudget{size}, {.initial_alpha = args.alpha,
+                                 .f = f,
+                                 .seed = derive_seed(args.seed, SKETCH_SEED_STREAM)});
+      },
+      f);
+}
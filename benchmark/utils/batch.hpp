@@ -0,0 +1,347 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <semaphore>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <typeindex>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "../../src/utils/time.hpp"
+
+/*
+ * The in-process execution mode: instead of one process per task, the driver hands a whole batch of
+ * tasks to one `benchmark_<name> --batch` process, which runs them as functions on a fixed pool of
+ * worker threads over traces decoded once (see `SharedTraces`), or, with `--fan-out`, all at once
+ * over traces scanned once (see `FanOutTrace`).
+ */
+
+/**
+ * @brief One task of a batch, i.e., what would otherwise be the command line of one process.
+ */
+struct TaskJob {
+  size_t id = 0;
+  std::string task; // e.g., "W-TinyLFU_EVO"
+  std::vector<std::string> args;
+
+  NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(TaskJob, id, task, args)
+};
+
+/**
+ * @brief What a task of a batch returns to the driver, one JSON line each, as they finish.
+ */
+struct TaskResult {
+  size_t id = 0;
+  std::vector<double> values;
+  // With fan-out, only the time that the task ran rather than waited for the turns of others
+  double time_spent_s = 0.0;
+  std::string error; // Empty if the task succeeded
+
+  NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(TaskResult, id, values, time_spent_s, error)
+};
+
+/**
+ * @brief Traces decoded once per process into memory and shared by all tasks replaying them.
+ *
+ * Only worth it when several tasks replay the same trace in one process, i.e., in batches: a task
+ * running alone is better off streaming its trace from the file.
+ */
+template <typename Record> class SharedTraces {
+public:
+  /**
+   * @brief The records of the trace at `path`, decoded through `Trace` by the first caller while
+   * later ones wait. Traces decoded through different types, e.g., with dense IDs or without, are
+   * kept apart.
+   */
+  template <typename Trace>
+  [[nodiscard]] static auto get(const std::string &path)
+      -> std::shared_ptr<const std::vector<Record>> {
+    const std::lock_guard lock(mutex_);
+    auto &records = traces_[{path, typeid(Trace)}];
+    if (!records) {
+      const Trace trace(path);
+      auto decoded = std::make_shared<std::vector<Record>>();
+      decoded->reserve(trace.size());
+      for (const auto &record : trace)
+        decoded->push_back(record);
+      records = std::move(decoded);
+    }
+    return records;
+  }
+
+private:
+  static inline std::mutex mutex_;
+  static inline std::map<std::pair<std::string, std::type_index>,
+                        std::shared_ptr<const std::vector<Record>>>
+      traces_;
+};
+
+// The records of a trace decoded at a time by a fan-out replay, which all tasks replaying the trace
+// consume in turn while they are still in cache
+inline constexpr size_t FAN_OUT_CHUNK_RECORDS = size_t{1} << 14;
+
+/**
+ * @brief When the fan-out replays of a batch start, i.e., once every task has either subscribed to
+ * its trace or finished without one.
+ */
+class FanOut {
+public:
+  /**
+   * @brief Expect `tasks` tasks, each running on a thread of its own.
+   */
+  static void expect(const size_t tasks) {
+    const std::lock_guard lock(mutex_);
+    pending_ = tasks;
+  }
+
+  /**
+   * @brief Whether the replays have started, after which no task may subscribe anymore.
+   */
+  [[nodiscard]] static auto started() -> bool {
+    const std::lock_guard lock(mutex_);
+    return started_;
+  }
+
+  /**
+   * @brief Count the calling task in once it has finished, unless it already subscribed.
+   */
+  static void finish_task() {
+    if (!std::exchange(subscribed_, false))
+      settle();
+  }
+
+  /**
+   * @brief The seconds that the calling task has waited for its turns on the chunks of the traces
+   * it replays so far, which do not count as its time.
+   */
+  [[nodiscard]] static auto waiting_seconds() -> double { return waiting_s_; }
+
+  /**
+   * @brief Wait for all tasks to subscribe or finish, then run every replay on a thread of its own
+   * until all are done.
+   */
+  static void run() {
+    std::vector<std::function<void()>> replays;
+    {
+      std::unique_lock lock(mutex_);
+      cv_.wait(lock, [] { return pending_ == 0; });
+      started_ = true;
+      replays = std::exchange(replays_, {});
+    }
+    std::vector<std::jthread> threads;
+    for (auto &replay : replays)
+      threads.emplace_back(std::move(replay));
+  }
+
+private:
+  template <typename Record> friend class FanOutTrace;
+
+  static inline std::mutex mutex_;
+  static inline std::condition_variable cv_;
+  static inline size_t pending_ = 0;
+  static inline bool started_ = false;
+  static inline std::vector<std::function<void()>> replays_;
+  static inline thread_local bool subscribed_ = false;
+  static inline thread_local double waiting_s_ = 0.0;
+
+  static void settle() {
+    {
+      const std::lock_guard lock(mutex_);
+      pending_--;
+    }
+    cv_.notify_all();
+  }
+};
+
+/**
+ * @brief A trace that many tasks of a batch replay together in a single scan: the trace is decoded
+ * one chunk at a time, and each chunk is handed to every subscribed task in turn, so that decoding
+ * and memory traffic are paid once for all of them.
+ *
+ * Each task runs on a thread of its own but only one runs at a time, i.e., the loop over tasks sits
+ * inside the loop over chunks. A subscription can be iterated once, and must be dropped by the task
+ * that made it. If reading the trace fails, every task replaying it gets the error when it waits
+ * for its next chunk.
+ */
+template <typename Record> class FanOutTrace {
+  struct Feed;
+
+  struct Subscriber {
+    std::binary_semaphore go{0};   // A chunk is ready, or the trace has ended
+    std::binary_semaphore done{0}; // The chunk is consumed, or the task left
+    std::span<const Record> chunk;
+    bool ended = false;
+    bool left = false;
+    bool holding = false; // Only touched by the task, i.e., whether it is consuming a chunk
+    const Feed *feed = nullptr;
+  };
+
+  struct Feed {
+    size_t size = 0;
+    std::vector<std::shared_ptr<Subscriber>> subscribers;
+    std::exception_ptr error; // Why the trace ended early, if it did
+  };
+
+public:
+  class iterator {
+  public:
+    using value_type = Record;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+    explicit iterator(Subscriber *subscriber) : subscriber_(subscriber) {}
+
+    auto operator*() const -> const Record & { return subscriber_->chunk[index_]; }
+
+    auto operator++() -> iterator & {
+      if (++index_ == subscriber_->chunk.size()) {
+        index_ = 0;
+        subscriber_->holding = false;
+        subscriber_->done.release();
+        if (!await_chunk(*subscriber_))
+          subscriber_ = nullptr;
+      }
+      return *this;
+    }
+
+    void operator++(int) { ++*this; }
+
+    friend auto operator==(const iterator &it, std::default_sentinel_t /*end*/) -> bool {
+      return it.subscriber_ == nullptr;
+    }
+
+  private:
+    Subscriber *subscriber_ = nullptr;
+    size_t index_ = 0;
+  };
+
+  /**
+   * @brief Subscribe the calling task to the trace at `path`, which is opened through `Trace` by
+   * the first subscriber and replayed once all tasks of the batch have subscribed or finished.
+   * Subscribers through different types of traces get feeds of their own.
+   */
+  template <typename Trace> [[nodiscard]] static auto subscribe(const std::string &path) {
+    const std::lock_guard lock(mutex_);
+    if (FanOut::started())
+      throw std::runtime_error("Cannot subscribe to a fan-out replay that has started: " + path);
+
+    auto &feed = feeds_[{path, typeid(Trace)}];
+    if (!feed) {
+      // Opened before the feed exists, so that the next subscriber tries again if it fails
+      auto trace = std::make_shared<const Trace>(path);
+      feed = std::make_shared<Feed>();
+      feed->size = trace->size();
+      const std::lock_guard fan_out_lock(FanOut::mutex_);
+      FanOut::replays_.emplace_back([feed, trace] { replay(*feed, *trace); });
+    }
+    auto subscriber = std::make_shared<Subscriber>();
+    subscriber->feed = feed.get();
+    feed->subscribers.push_back(subscriber);
+
+    FanOut::subscribed_ = true;
+    FanOut::settle();
+    return FanOutTrace(feed->size, std::move(subscriber));
+  }
+
+  ~FanOutTrace() {
+    auto &subscriber = *subscriber_;
+    if (subscriber.holding) {
+      // Left in the middle of a chunk, e.g., because of an exception
+      subscriber.left = true;
+      subscriber.done.release();
+    } else if (!subscriber.ended) {
+      // Never started, so wait for the first chunk to leave
+      wait_turn(subscriber);
+      if (!subscriber.ended) {
+        subscriber.left = true;
+        subscriber.done.release();
+      }
+    }
+  }
+
+  FanOutTrace(const FanOutTrace &) = delete;
+  auto operator=(const FanOutTrace &) -> FanOutTrace & = delete;
+  FanOutTrace(FanOutTrace &&) = delete;
+  auto operator=(FanOutTrace &&) -> FanOutTrace & = delete;
+
+  [[nodiscard]] auto size() const noexcept -> size_t { return size_; }
+
+  // Blocks until the first chunk is handed to the task
+  [[nodiscard]] auto begin() const -> iterator {
+    return await_chunk(*subscriber_) ? iterator(subscriber_.get()) : iterator();
+  }
+
+  [[nodiscard]] auto end() const -> std::default_sentinel_t { return std::default_sentinel; }
+
+private:
+  size_t size_;
+  std::shared_ptr<Subscriber> subscriber_;
+
+  static inline std::mutex mutex_;
+  static inline std::map<std::pair<std::string, std::type_index>, std::shared_ptr<Feed>> feeds_;
+
+  FanOutTrace(const size_t size, std::shared_ptr<Subscriber> subscriber)
+      : size_(size), subscriber_(std::move(subscriber)) {}
+
+  // Wait for the next chunk, and return whether there is one or throw why the trace ended early
+  static auto await_chunk(Subscriber &subscriber) -> bool {
+    wait_turn(subscriber);
+    subscriber.holding = !subscriber.ended;
+    if (subscriber.ended && subscriber.feed->error)
+      std::rethrow_exception(subscriber.feed->error);
+    return subscriber.holding;
+  }
+
+  static void wait_turn(Subscriber &subscriber) {
+    const double start = get_current_time_in_seconds();
+    subscriber.go.acquire();
+    FanOut::waiting_s_ += get_current_time_in_seconds() - start;
+  }
+
+  template <typename Trace> static void replay(Feed &feed, const Trace &trace) {
+    std::vector<Record> chunk;
+    chunk.reserve(FAN_OUT_CHUNK_RECORDS);
+    auto hand_out = [&] {
+      for (const auto &subscriber : feed.subscribers) {
+        if (subscriber->left)
+          continue;
+        subscriber->chunk = chunk;
+        subscriber->go.release();
+        subscriber->done.acquire();
+      }
+      chunk.clear();
+    };
+
+    // Errors would otherwise terminate the batch from this thread, and leave the tasks waiting
+    try {
+      for (const auto &record : trace) {
+        chunk.push_back(record);
+        if (chunk.size() == FAN_OUT_CHUNK_RECORDS)
+          hand_out();
+      }
+      if (!chunk.empty())
+        hand_out();
+    } catch (...) {
+      feed.error = std::current_exception();
+    }
+
+    for (const auto &subscriber : feed.subscribers) {
+      if (subscriber->left)
+        continue;
+      subscriber->ended = true;
+      subscriber->go.release();
+    }
+  }
+};
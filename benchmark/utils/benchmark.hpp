@@ -1,19 +1,26 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
+#include <format>
 #include <fplus/split.hpp>
+#include <fstream>
 #include <functional>
 #include <future>
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <type_traits>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include <fplus/fplus.hpp>
+#include <nlohmann/json.hpp>
 #include <reproc++/run.hpp>
 #include <spdlog/spdlog.h>
 
@@ -29,7 +36,9 @@
 #endif
 
 #include "../../src/utils/time.hpp"
+#include "batch.hpp"
 #include "errors.hpp"
+#include "scheduler.hpp"
 
 inline constexpr bool DEFAULT_PARALLEL = false;
 // inline constexpr size_t DEFAULT_TIMEOUT_MILLISECONDS = 900'000UZ;
@@ -40,11 +49,11 @@ inline constexpr size_t DEFAULT_TIMEOUT_MILLISECONDS = std::numeric_limits<size_
 #define CONCAT_INNER(a, b) a##b
 
 template <typename T>
-concept ConvertibleToString = std::is_integral_v<std::remove_cvref_t<T>> ||
-                              std::is_floating_point_v<std::remove_cvref_t<T>> ||
-                              std::is_same_v<std::remove_cvref_t<T>, std::string> ||
-                              std::is_same_v<std::remove_cvref_t<T>, std::string_view> ||
-                              std::is_same_v<std::remove_cvref_t<T>, const char *>;
+concept ConvertibleToString = std::is_integral_v<std::decay_t<T>> ||
+                              std::is_floating_point_v<std::decay_t<T>> ||
+                              std::is_same_v<std::decay_t<T>, std::string> ||
+                              std::is_same_v<std::decay_t<T>, std::string_view> ||
+                              std::is_same_v<std::decay_t<T>, const char *>;
 
 auto convert_to_string(ConvertibleToString auto &&value) -> std::string {
   using T = std::decay_t<decltype(value)>;
@@ -60,6 +69,23 @@ auto convert_to_string(ConvertibleToString auto &&value) -> std::string {
 struct BenchmarkOptions {
   bool parallel = DEFAULT_PARALLEL;
   size_t timeout_milliseconds = DEFAULT_TIMEOUT_MILLISECONDS;
+  // Whether the benchmark runs no tasks (and has no `benchmark_<name>` executable), e.g., to
+  // post-process the results of others
+  bool standalone = false;
+  // Whether tasks run as functions in one `benchmark_<name> --batch` process per `wait()` rather
+  // than in a process each, so that they share decoded traces
+  bool in_process = false;
+  // Whether in-process tasks replay each trace together in a single scan rather than separately,
+  // which implies `in_process`
+  bool fan_out = false;
+  // The threads of the in-process runner, where 0 means one per physical core with `parallel`
+  // and one without
+  size_t workers = 0;
+  // The tasks running at once with `parallel`, where 0 means one per physical core
+  size_t jobs = 0;
+  // The memory that tasks running at once with `parallel` may be estimated to use in total (see
+  // `estimate_task_memory()`), where 0 means all available
+  size_t memory_budget_bytes = 0;
 };
 
 class Benchmark {
@@ -69,7 +95,8 @@ public:
 
   explicit Benchmark(const std::string &&name, const BenchmarkOptions &&opts)
       : name(name), filename_(name), options(opts),
-        available_benchmark_names_(get_available_benchmarks()),
+        available_benchmark_names_(opts.standalone ? std::vector<std::string>{}
+                                                   : get_available_benchmarks()),
         enabled_benchmark_names_(available_benchmark_names_) {
     benchmarks[name] = this;
     benchmark_names.push_back(name);
@@ -103,12 +130,34 @@ public:
   }
 
   void wait() {
+    if (!pending_.empty())
+      run_batch(std::exchange(pending_, {}));
     for (auto &task : tasks_)
       task.wait();
   }
 
+  /**
+   * @brief Set how much memory each task submitted from now on is estimated to use of its own, and
+   * the `shared` memory counted once for all of them (e.g., their trace), so that parallel runs
+   * admit only as many of them at once as fit in memory.
+   */
+  void estimate_task_memory(const size_t bytes, SharedMemoryEstimate shared = {}) {
+    task_memory_bytes_ = bytes;
+    task_shared_memory_ = std::move(shared);
+  }
+
   template <ConvertibleToString... Args> void benchmark(const std::string &name, Args &&...args) {
-    const std::vector<std::string> arguments{convert_to_string(std::forward<Args>(args))...};
+    benchmark(name, std::vector<std::string>{convert_to_string(std::forward<Args>(args))...});
+  }
+
+  /**
+   * @brief Run the task `name` with `arguments`, e.g., as built by another benchmark.
+   */
+  void benchmark(const std::string &name, const std::vector<std::string> &arguments) {
+    if (options.in_process || options.fan_out) {
+      pending_.push_back({.id = pending_.size(), .task = name, .args = arguments});
+      return;
+    }
 
     auto benchmark_func = [this, name = std::string(name), arguments = arguments]() {
       reproc::process process;
@@ -180,7 +229,8 @@ public:
     };
 
     if (options.parallel)
-      tasks_.emplace_back(std::async(std::launch::async, benchmark_func));
+      tasks_.emplace_back(
+          scheduler().submit(benchmark_func, task_memory_bytes_, task_shared_memory_));
     else
       benchmark_func();
   }
@@ -190,6 +240,11 @@ public:
       benchmark(name, std::forward<Args>(args)...);
   }
 
+  /**
+   * @brief Replace the options of the benchmark, e.g., when another benchmark runs its tasks.
+   */
+  void set_options(const BenchmarkOptions &opts) { options = opts; }
+
   void set_enabled_benchmarks(const std::vector<std::string> &enabled_benchmarks) {
     // Check if all enabled benchmarks are available
     for (const std::string &enabled_benchmark : enabled_benchmarks)
@@ -217,11 +272,127 @@ private:
   std::vector<std::string> enabled_benchmark_names_;
 
   std::vector<std::future<void>> tasks_;
+  // Created on the first parallel task, once `options` are final
+  std::unique_ptr<JobScheduler> scheduler_;
+  size_t task_memory_bytes_ = 0;
+  SharedMemoryEstimate task_shared_memory_;
+  // The tasks that the next `wait()` runs in process
+  std::vector<TaskJob> pending_;
 
   std::vector<std::function<void(const std::string_view name, const std::vector<std::string> &args,
                                  const std::vector<double> &results, const double time_spent)>>
       benchmark_finished_listeners_;
 
+  auto scheduler() -> JobScheduler & {
+    if (!scheduler_) {
+      scheduler_ = std::make_unique<JobScheduler>(JobSchedulerOptions{
+          .max_jobs = options.jobs, .memory_budget_bytes = options.memory_budget_bytes});
+      spdlog::debug("[{}] Running up to {} tasks at once within {} bytes", name,
+                    scheduler_->max_jobs(), scheduler_->memory_budget_bytes());
+    }
+    return *scheduler_;
+  }
+
+  /**
+   * @brief Run `jobs` in one `benchmark_<name> --batch` process, notifying the listeners of each
+   * task as its result line arrives.
+   */
+  void run_batch(const std::vector<TaskJob> &jobs) {
+    const size_t workers =
+        options.workers != 0
+            ? options.workers
+            : (options.parallel ? physical_core_cpus().size() : 1);
+
+    const auto jobs_path =
+        std::filesystem::temp_directory_path() /
+        std::format("benchmark_{}_{}.jsonl", filename_,
+                    std::chrono::steady_clock::now().time_since_epoch().count());
+    {
+      std::ofstream file(jobs_path);
+      if (!file.is_open())
+        throw std::runtime_error("Failed to open jobs file: " + jobs_path.string());
+      for (const TaskJob &job : jobs)
+        file << nlohmann::json(job).dump() << '\n';
+    }
+
+    std::vector<std::string> process_args{
+        (executable_path().parent_path() / ("benchmark_" + filename_)).string(), "--batch",
+        jobs_path.string(), "--workers", std::to_string(workers)};
+    if (options.fan_out)
+      process_args.emplace_back("--fan-out");
+    spdlog::debug("[{}] Running {} tasks in process{}", name, jobs.size(),
+                  options.fan_out ? " over single trace scans"
+                                  : std::format(" on {} threads", workers));
+
+    auto on_line = [&](std::string_view line) {
+      // Tasks may print other output (e.g., progress) before the result on the same line
+      const auto begin = line.find('{');
+      if (begin == std::string_view::npos)
+        return;
+      TaskResult result;
+      try {
+        result = nlohmann::json::parse(line.substr(begin)).get<TaskResult>();
+      } catch (const nlohmann::json::exception &) {
+        return;
+      }
+      if (result.id >= jobs.size())
+        return;
+      const TaskJob &job = jobs[result.id];
+      if (!result.error.empty()) {
+        spdlog::error("[{}] {}", job.task, fplus::trim_whitespace(result.error));
+        return;
+      }
+      for (const auto &listener : benchmark_finished_listeners_)
+        listener(job.task, job.args, result.values, result.time_spent_s);
+    };
+
+    reproc::process process;
+
+    reproc::options opts;
+    opts.redirect.out.type = reproc::redirect::pipe;
+    opts.redirect.err.type = reproc::redirect::pipe;
+
+    std::error_code ec = process.start(process_args, opts);
+    if (ec) {
+      spdlog::error("[{}] Batch failed to start: {}", name, fplus::trim_whitespace(ec.message()));
+      std::filesystem::remove(jobs_path);
+      return;
+    }
+
+    std::string buffer;
+    auto out_sink = [&](reproc::stream /*stream*/, const uint8_t *data, const size_t size) {
+      buffer.append(reinterpret_cast<const char *>(data), size);
+      size_t end = 0;
+      while ((end = buffer.find('\n')) != std::string::npos) {
+        on_line(std::string_view(buffer).substr(0, end));
+        buffer.erase(0, end + 1);
+      }
+      return std::error_code{};
+    };
+    std::string errors;
+    reproc::sink::string err_sink(errors);
+
+    ec = reproc::drain(process, out_sink, err_sink);
+    std::filesystem::remove(jobs_path);
+    if (ec) {
+      spdlog::error("[{}] Failed to read batch output: {}", name,
+                    fplus::trim_whitespace(ec.message()));
+      return;
+    }
+
+    int status = 0;
+    std::tie(status, ec) = process.wait(reproc::milliseconds{options.timeout_milliseconds});
+    if (ec) {
+      spdlog::error("[{}] Failed to wait for batch: {}", name,
+                    fplus::trim_whitespace(ec.message()));
+      return;
+    }
+    if (status) {
+      spdlog::error("[{}] {}", name, fplus::trim_whitespace(errors));
+      spdlog::error("[{}] Batch exited with status: {}", name, status);
+    }
+  }
+
   auto get_available_benchmarks() -> std::vector<std::string> {
     reproc::process process;
 
@@ -364,6 +535,11 @@ inline auto benchmark_main(int argc, char **argv) -> int {
     delete[] processed_argv[0];
     delete[] processed_argv;
     return 1;
+  } catch (const std::exception &e) {
+    std::println(std::cerr, "Error: {}", e.what());
+    delete[] processed_argv[0];
+    delete[] processed_argv;
+    return 1;
   }
 
   delete[] processed_argv[0];
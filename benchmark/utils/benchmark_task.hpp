@@ -1,26 +1,47 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <format>
+#include <fstream>
 #include <iostream>
+#include <mutex>
 #include <print>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <variant>
 #include <vector>
 
 #include <fplus/fplus.hpp>
+#include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
 
+#include "../../src/utils/time.hpp"
+#include "batch.hpp"
 #include "errors.hpp"
+#include "memory.hpp"
 
 // NOLINTNEXTLINE(cppcoreguidelines-macro-usage)
 #define CONCAT(a, b) CONCAT_INNER(a, b)
 #define CONCAT_INNER(a, b) a##b
 
+// The streams of `derive_seed()` that the randomized parts of a task draw from, so that one
+// `--seed` gives each of them an independent seed
+inline constexpr uint64_t SKETCH_SEED_STREAM = 0;
+inline constexpr uint64_t ADAPTER_SEED_STREAM = 1;
+inline constexpr uint64_t KEYS_SEED_STREAM = 2; // And up, e.g., one per thread
+
 class BenchmarkTask {
 public:
   static std::unordered_map<std::string, BenchmarkTask *> tasks;
   static std::vector<std::string> task_names;
+  // Whether tasks run side by side in one process (see `run_batch()`), e.g., to share traces
+  static bool batched;
+  // Whether tasks of a batch replay each trace together in a single scan (see `FanOutTrace`)
+  static bool fan_out;
 
   explicit BenchmarkTask(const std::string &name) {
     tasks[name] = this;
@@ -39,6 +60,8 @@ public:
 
 inline std::unordered_map<std::string, BenchmarkTask *> BenchmarkTask::tasks;
 inline std::vector<std::string> BenchmarkTask::task_names;
+inline bool BenchmarkTask::batched = false;
+inline bool BenchmarkTask::fan_out = false;
 
 // NOLINTNEXTLINE(cppcoreguidelines-macro-usage)
 #define REGISTER_BENCHMARK_TASK(task_name)                                                         \
@@ -52,7 +75,107 @@ inline std::vector<std::string> BenchmarkTask::task_names;
   auto CONCAT(BenchmarkTask, __LINE__)::run(int argc, char **argv)                                 \
       -> std::variant<double, std::vector<double>>
 
+/**
+ * @brief Run the tasks listed in the JSON-lines file at `jobs_path` (see `TaskJob`) on `workers`
+ * threads, each task as if it was the command line `<executable> <task> <args>...`, and print one
+ * `TaskResult` per line as each finishes.
+ *
+ * With `fan_out`, all tasks instead run at once on a thread each, taking turns on the chunks of the
+ * traces they replay (see `FanOutTrace`), so `workers` is ignored. A task that fails reports its
+ * error instead of failing the whole batch.
+ */
+inline auto run_batch(const std::string &executable, const std::string &jobs_path,
+                      const size_t workers, const bool fan_out = false) -> int {
+  std::ifstream file(jobs_path);
+  if (!file.is_open()) {
+    std::println(std::cerr, "Failed to open jobs file: {}", jobs_path);
+    return 1;
+  }
+  std::vector<TaskJob> jobs;
+  std::string line;
+  while (std::getline(file, line))
+    if (line.find_first_not_of(" \t\r") != std::string::npos)
+      jobs.push_back(nlohmann::json::parse(line).get<TaskJob>());
+
+  BenchmarkTask::batched = true;
+  BenchmarkTask::fan_out = fan_out;
+
+  std::mutex output_mutex;
+  auto run_job = [&](const TaskJob &job) {
+    std::string program = executable + " " + job.task;
+    std::vector<std::string> args = job.args;
+    std::vector<char *> job_argv{program.data()};
+    for (auto &arg : args)
+      job_argv.push_back(arg.data());
+    job_argv.push_back(nullptr);
+
+    // The counters are per thread, and the previous task of this thread has freed its memory
+    AllocationCounter<PolicyMemory>::reset_peak();
+    AllocationCounter<CacheMemory>::reset_peak();
+
+    TaskResult result{.id = job.id};
+    const double start = get_current_time_in_seconds();
+    const double waited = FanOut::waiting_seconds();
+    try {
+      const auto it = BenchmarkTask::tasks.find(job.task);
+      if (it == BenchmarkTask::tasks.end())
+        throw std::runtime_error("Unknown benchmark name: " + job.task);
+      const auto results = it->second->run(static_cast<int>(job_argv.size() - 1), job_argv.data());
+      result.values = std::holds_alternative<double>(results)
+                          ? std::vector<double>{std::get<double>(results)}
+                          : std::get<std::vector<double>>(results);
+    } catch (const usage_error &e) {
+      result.error = e.msg();
+    } catch (const std::exception &e) {
+      result.error = e.what();
+    }
+    result.time_spent_s =
+        get_current_time_in_seconds() - start - (FanOut::waiting_seconds() - waited);
+
+    const std::lock_guard lock(output_mutex);
+    std::cout << nlohmann::json(result).dump() << '\n' << std::flush;
+  };
+
+  if (fan_out) {
+    FanOut::expect(jobs.size());
+    std::vector<std::jthread> threads;
+    for (size_t i = 0; i < jobs.size(); i++)
+      threads.emplace_back([&, i] {
+        run_job(jobs[i]);
+        FanOut::finish_task();
+      });
+    FanOut::run();
+    return 0;
+  }
+
+  std::atomic<size_t> next_job{0};
+  auto work = [&] {
+    for (size_t i = next_job++; i < jobs.size(); i = next_job++)
+      run_job(jobs[i]);
+  };
+
+  {
+    std::vector<std::jthread> threads;
+    for (size_t i = 0; i < std::clamp<size_t>(workers, 1, std::max<size_t>(jobs.size(), 1)); i++)
+      threads.emplace_back(work);
+  }
+  return 0;
+}
+
 inline auto benchmark_task_main(int argc, char **argv) -> int {
+  // `<executable> --batch <jobs_path> [--workers <n>] [--fan-out]`, as run by `Benchmark` in
+  // process
+  if (argc >= 3 && std::string(argv[1]) == "--batch") {
+    size_t workers = 1;
+    bool fan_out = false;
+    for (int i = 3; i < argc; i++)
+      if (std::string(argv[i]) == "--workers" && i + 1 < argc)
+        workers = std::stoull(argv[++i]);
+      else if (std::string(argv[i]) == "--fan-out")
+        fan_out = true;
+    return run_batch(argv[0], argv[2], workers, fan_out);
+  }
+
   if (argc < 2) {
     std::println(std::cerr, "Usage: {} {{{}}} ...", argv[0],
                  fplus::join_elem('|', BenchmarkTask::task_names));
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "../../src/utils/hash.hpp"
+
+/*
+ * Ways to share one sketch between threads, all exposing `update()` and `estimate()` that are safe
+ * to call concurrently. The sketches themselves are single-threaded, so these wrap them.
+ */
+
+// The size of a cache line, i.e., the distance that keeps two objects from false sharing
+inline constexpr size_t CACHE_LINE_SIZE = 64;
+
+// The results of concurrency benchmark tasks, in order: the aggregate throughput in MOps, then the
+// latency in seconds at each of these quantiles, taken from the slowest thread at that quantile
+inline constexpr std::array CONCURRENCY_QUANTILES = {0.5, 0.99, 0.999, 1.0};
+inline constexpr std::array<std::string_view, CONCURRENCY_QUANTILES.size()>
+    CONCURRENCY_QUANTILE_KEYS = {"p50", "p99", "p999", "max"};
+
+/**
+ * @brief Serialize every operation with a mutex. With `std::shared_mutex`, estimates only take a
+ * shared lock and run concurrently with each other, i.e., a single-writer/multi-reader scheme.
+ */
+template <typename Sketch, typename Mutex = std::mutex> class LockedSketch {
+public:
+  explicit LockedSketch(Sketch sketch) : sketch_(std::move(sketch)) {}
+
+  template <typename T> void update(const T &item) {
+    const std::lock_guard lock(mutex_);
+    sketch_.update(item);
+  }
+
+  template <typename T> [[nodiscard]] auto estimate(const T &item) const {
+    if constexpr (std::is_same_v<Mutex, std::shared_mutex>) {
+      const std::shared_lock lock(mutex_);
+      return sketch_.estimate(item);
+    } else {
+      const std::lock_guard lock(mutex_);
+      return sketch_.estimate(item);
+    }
+  }
+
+private:
+  mutable Mutex mutex_;
+  Sketch sketch_;
+};
+
+/**
+ * @brief Split items between `shards` independently locked sketches by hash, so that threads only
+ * contend when they touch the same shard.
+ *
+ * Each shard is aligned to its own cache lines unless `Padded` is false, which only exists to
+ * measure the cost of false sharing between the locks of adjacent shards. Note that each shard
+ * advances its own decay clock, so with `DecayClock::UPDATES` the decay of an item depends on the
+ * traffic of its shard rather than of the whole stream.
+ */
+template <typename Sketch, bool Padded = true> class ShardedSketch {
+  // A different seed than the sketches use, so that shards do not correlate with columns
+  static constexpr size_t SHARD_SEED = 0x5eed;
+
+  template <typename U> struct alignas(CACHE_LINE_SIZE) PaddedSlot {
+    U value;
+  };
+
+  template <typename U> struct PackedSlot {
+    U value;
+  };
+
+  template <typename U> using Slot = std::conditional_t<Padded, PaddedSlot<U>, PackedSlot<U>>;
+
+public:
+  /**
+   * @brief Construct `shards` shards, each holding the sketch returned by `make_sketch()`.
+   */
+  template <typename MakeSketch>
+  ShardedSketch(const size_t shards, MakeSketch &&make_sketch)
+      : mutexes_(new Slot<std::mutex>[shards]) {
+    sketches_.reserve(shards);
+    for (size_t i = 0; i < shards; i++)
+      sketches_.push_back({make_sketch()});
+  }
+
+  template <typename T> void update(const T &item) {
+    const size_t shard = shard_of(item);
+    const std::lock_guard lock(mutexes_[shard].value);
+    sketches_[shard].value.update(item);
+  }
+
+  template <typename T> [[nodiscard]] auto estimate(const T &item) const {
+    const size_t shard = shard_of(item);
+    const std::lock_guard lock(mutexes_[shard].value);
+    return sketches_[shard].value.estimate(item);
+  }
+
+private:
+  // Both are contiguous, so that without padding adjacent shards share cache lines
+  std::unique_ptr<Slot<std::mutex>[]> mutexes_;
+  std::vector<Slot<Sketch>> sketches_;
+
+  template <typename T> [[nodiscard]] auto shard_of(const T &item) const -> size_t {
+    return fastrange(hash(item, SHARD_SEED), sketches_.size());
+  }
+};
+
+/**
+ * @brief Pin the calling thread to `core` (modulo the number of cores), if the platform allows.
+ *
+ * @return Whether the thread was pinned.
+ */
+inline auto pin_to_core(const size_t core) -> bool {
+#if defined(__linux__)
+  const auto cores = std::max(1U, std::thread::hardware_concurrency());
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(core % cores, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
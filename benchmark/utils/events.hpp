@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#include "../../src/utils/trace.hpp"
+
+// The most recent events kept by `--events`, i.e., about 3.5MB of memory
+inline constexpr size_t EVENT_TRACE_CAPACITY = size_t{1} << 16;
+
+/**
+ * @brief The event trace for the `--events` option of benchmark tasks, or null if it is unset.
+ */
+inline auto make_event_trace(const std::string &path) -> std::unique_ptr<EventTrace> {
+  if (path.empty())
+    return nullptr;
+  return std::make_unique<EventTrace>(EVENT_TRACE_CAPACITY);
+}
+
+/**
+ * @brief Save `events` as a Chrome trace at `path`, if the `--events` option is set.
+ */
+inline void save_event_trace(const std::unique_ptr<EventTrace> &events, const std::string &path) {
+  if (events)
+    events->save_chrome_trace(std::filesystem::path{path});
+}
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <cstddef>
 #include <iterator>
+#include <memory>
 #include <unordered_map>
 #include <utility>
 
@@ -27,26 +28,27 @@
  * - Get the current size of the FIFO
  * - Check if the FIFO is empty or full
  */
-template <typename T> class RingBufferFIFO {
+template <typename T, typename Allocator = std::allocator<T>> class RingBufferFIFO {
 private:
 public:
-  explicit RingBufferFIFO(size_t capacity) : k_capacity_(capacity), buffer_(new T[capacity]) {}
+  explicit RingBufferFIFO(size_t capacity)
+      : k_capacity_(capacity), buffer_(allocate_buffer(capacity)) {}
 
-  ~RingBufferFIFO() { delete[] buffer_; }
+  ~RingBufferFIFO() { free_buffer(); }
 
   // Copy constructor
   RingBufferFIFO(const RingBufferFIFO &other)
-      : k_capacity_(other.k_capacity_), buffer_(new T[other.k_capacity_]), head_(other.head_),
-        tail_(other.tail_), size_(other.size_) {
+      : k_capacity_(other.k_capacity_), buffer_(allocate_buffer(other.k_capacity_)),
+        head_(other.head_), tail_(other.tail_), size_(other.size_) {
     std::copy(other.buffer_, other.buffer_ + other.k_capacity_, buffer_);
   }
 
   // Copy assignment operator
   auto operator=(const RingBufferFIFO &other) -> RingBufferFIFO & {
     if (this != &other) {
-      delete[] buffer_;
+      free_buffer();
       k_capacity_ = other.k_capacity_;
-      buffer_ = new T[other.k_capacity_];
+      buffer_ = allocate_buffer(other.k_capacity_);
       head_ = other.head_;
       tail_ = other.tail_;
       size_ = other.size_;
@@ -66,7 +68,7 @@ public:
   // Move assignment operator
   auto operator=(RingBufferFIFO &&other) noexcept -> RingBufferFIFO & {
     if (this != &other) {
-      delete[] buffer_;
+      free_buffer();
       k_capacity_ = other.k_capacity_;
       buffer_ = other.buffer_;
       head_ = other.head_;
@@ -124,12 +126,30 @@ public:
   [[nodiscard]] auto full() const -> bool { return size_ == k_capacity_; }
 
 private:
+  // Declared first, as the buffer is allocated from it during construction
+  [[no_unique_address]] Allocator allocator_;
+
   size_t k_capacity_; // Maximum capacity of the FIFO
 
   T *buffer_;       // Dynamically allocated buffer for entries
   size_t head_ = 0; // Index of the oldest entry
   size_t tail_ = 0; // Index for the next insertion
   size_t size_ = 0; // Current size of the FIFO
+
+  using BufferTraits = std::allocator_traits<Allocator>;
+
+  auto allocate_buffer(const size_t capacity) -> T * {
+    T *buffer = BufferTraits::allocate(allocator_, capacity);
+    std::uninitialized_value_construct_n(buffer, capacity);
+    return buffer;
+  }
+
+  void free_buffer() {
+    if (buffer_ == nullptr)
+      return;
+    std::destroy_n(buffer_, k_capacity_);
+    BufferTraits::deallocate(allocator_, buffer_, k_capacity_);
+  }
 };
 
 /**
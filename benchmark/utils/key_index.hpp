@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief A map from keys to values of type `T` in a hash table, for keys of any kind.
+ */
+template <typename K, typename T, typename Allocator = std::allocator<T>> class HashKeyIndex {
+public:
+  auto operator[](const K &key) -> T & { return map_[key]; }
+
+  void erase(const K &key) { map_.erase(key); }
+
+private:
+  using PairAllocator =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<std::pair<const K, T>>;
+
+  std::unordered_map<K, T, std::hash<K>, std::equal_to<K>, PairAllocator> map_;
+};
+
+/**
+ * @brief A map from keys to values of type `T` in an array indexed by the keys themselves, for
+ * dense keys, i.e., small unsigned integers such as those of `DenseCachingTrace`.
+ *
+ * A lookup is a single load instead of a hash probe, but the array spans every key up to the
+ * largest one seen, with erased keys holding `T{}`.
+ */
+template <typename K, typename T, typename Allocator = std::allocator<T>> class DenseKeyIndex {
+public:
+  auto operator[](const K &key) -> T & {
+    const auto index = static_cast<size_t>(key);
+    if (index >= slots_.size())
+      slots_.resize(std::max(index + 1, slots_.size() * 2));
+    return slots_[index];
+  }
+
+  void erase(const K &key) {
+    const auto index = static_cast<size_t>(key);
+    if (index < slots_.size())
+      slots_[index] = T{};
+  }
+
+private:
+  std::vector<T, Allocator> slots_;
+};
+
+// The key indexes that policies such as `WTinyLFUPolicy` are parameterized with
+struct HashKeys {
+  template <typename K, typename T, typename Allocator>
+  using index = HashKeyIndex<K, T, Allocator>;
+};
+
+struct DenseKeys {
+  template <typename K, typename T, typename Allocator>
+  using index = DenseKeyIndex<K, T, Allocator>;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <memory>
 
 #ifndef NDEBUG
 #include <unordered_set>
@@ -14,7 +15,10 @@ template <typename T> struct Node {
   Node<T> *next;
 };
 
-template <typename T> class DoublyLinkedList {
+/**
+ * @brief A doubly linked list whose nodes are taken from `Allocator`, e.g., to count their memory.
+ */
+template <typename T, typename Allocator = std::allocator<Node<T>>> class DoublyLinkedList {
 
 public:
   DoublyLinkedList() : head_(nullptr), tail_(nullptr) {}
@@ -24,7 +28,7 @@ public:
     while (current != nullptr) {
       Node<T> *temp = current;
       current = current->next;
-      delete temp;
+      destroy_node(temp);
     }
   }
 
@@ -61,7 +65,7 @@ public:
     while (current != nullptr) {
       Node<T> *temp = current;
       current = current->prev;
-      delete temp;
+      destroy_node(temp);
     }
 
     // Copy nodes from other list
@@ -88,7 +92,7 @@ public:
     while (current != nullptr) {
       Node<T> *temp = current;
       current = current->prev;
-      delete temp;
+      destroy_node(temp);
     }
 
     // Transfer ownership from other
@@ -119,7 +123,7 @@ public:
    * @return The node containing the value.
    */
   auto insert(T value) -> Node<T> * {
-    auto *node = new Node<T>;
+    auto *node = create_node();
     node->value = value;
     node->prev = nullptr;
     node->next = head_;
@@ -141,7 +145,7 @@ public:
   }
 
   void insert_tail(T value) {
-    auto *node = new Node<T>;
+    auto *node = create_node();
     node->value = value;
     node->prev = tail_;
     node->next = nullptr;
@@ -171,7 +175,7 @@ public:
     }
 #endif
 
-    auto *new_node = new Node<T>;
+    auto *new_node = create_node();
     new_node->value = value;
     new_node->prev = node->prev;
     new_node->next = node;
@@ -203,7 +207,7 @@ public:
     }
 #endif
 
-    auto *new_node = new Node<T>;
+    auto *new_node = create_node();
     new_node->value = value;
     new_node->prev = node;
     new_node->next = node->next;
@@ -258,7 +262,7 @@ public:
 
     size_--;
 
-    delete node;
+    destroy_node(node);
   }
 
   /**
@@ -285,7 +289,7 @@ public:
 
     size_--;
 
-    delete node;
+    destroy_node(node);
   }
 
   /**
@@ -312,7 +316,7 @@ public:
 
     size_--;
 
-    delete node;
+    destroy_node(node);
   }
 
   /**
@@ -325,7 +329,7 @@ public:
    * @param node The node to transfer.
    * @param list The list to transfer the node to.
    */
-  void transfer_node_to_head_of(Node<T> *node, DoublyLinkedList<T> &list) {
+  void transfer_node_to_head_of(Node<T> *node, DoublyLinkedList &list) {
 #ifndef NDEBUG
     if (node == nullptr) {
       spdlog::warn(
@@ -376,7 +380,7 @@ public:
    * @param list The list to transfer the node to.
    * @return The transferred node (i.e., the original head node).
    */
-  auto transfer_tail_to_head_of(DoublyLinkedList<T> &list) -> Node<T> * {
+  auto transfer_tail_to_head_of(DoublyLinkedList &list) -> Node<T> * {
 #ifndef NDEBUG
     if (head_ == nullptr)
       spdlog::warn("DoublyLinkedList: Suspicious `transfer_tail_to_head_of` call with empty list");
@@ -485,11 +489,26 @@ public:
   [[nodiscard]] auto size() const -> size_t { return size_; }
 
 private:
+  using NodeTraits = std::allocator_traits<Allocator>;
+
+  [[no_unique_address]] Allocator allocator_;
+
   Node<T> *head_;
   Node<T> *tail_;
 
   size_t size_ = 0;
 
+  auto create_node() -> Node<T> * {
+    Node<T> *node = NodeTraits::allocate(allocator_, 1);
+    NodeTraits::construct(allocator_, node);
+    return node;
+  }
+
+  void destroy_node(Node<T> *node) {
+    NodeTraits::destroy(allocator_, node);
+    NodeTraits::deallocate(allocator_, node, 1);
+  }
+
 #ifndef NDEBUG
   std::unordered_set<Node<T> *> debug_node_set_;
 
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+
+#if defined(_WIN32)
+#include <windows.h>
+// Must come after windows.h
+#include <psapi.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+/**
+ * @brief The bytes currently and at most allocated through `CountingAllocator`s sharing `Tag` on
+ * the calling thread.
+ *
+ * Only requested bytes are counted, i.e., the bookkeeping of the underlying allocator is not. The
+ * counts are per thread so that tasks running side by side in one process (see `run_batch()`) each
+ * see only their own, which assumes that memory is freed on the thread that allocated it.
+ */
+template <typename Tag> class AllocationCounter {
+public:
+  static void allocated(const size_t bytes) noexcept {
+    current_ += bytes;
+    peak_ = std::max(peak_, current_);
+  }
+
+  static void deallocated(const size_t bytes) noexcept { current_ -= bytes; }
+
+  [[nodiscard]] static auto current_bytes() noexcept -> size_t { return current_; }
+
+  [[nodiscard]] static auto peak_bytes() noexcept -> size_t { return peak_; }
+
+  /**
+   * @brief Start measuring the peak anew from the current bytes, e.g., before the next task.
+   */
+  static void reset_peak() noexcept { peak_ = current_; }
+
+private:
+  static inline thread_local size_t current_ = 0;
+  static inline thread_local size_t peak_ = 0;
+};
+
+/**
+ * @brief A stateless allocator that forwards to `std::allocator` and counts the bytes in
+ * `AllocationCounter<Tag>`.
+ */
+template <typename T, typename Tag> class CountingAllocator {
+public:
+  using value_type = T;
+
+  template <typename U> struct rebind {
+    using other = CountingAllocator<U, Tag>;
+  };
+
+  CountingAllocator() noexcept = default;
+
+  template <typename U> CountingAllocator(const CountingAllocator<U, Tag> & /*other*/) noexcept {}
+
+  [[nodiscard]] auto allocate(const size_t n) -> T * {
+    T *p = std::allocator<T>{}.allocate(n);
+    AllocationCounter<Tag>::allocated(n * sizeof(T));
+    return p;
+  }
+
+  void deallocate(T *p, const size_t n) noexcept {
+    std::allocator<T>{}.deallocate(p, n);
+    AllocationCounter<Tag>::deallocated(n * sizeof(T));
+  }
+
+  template <typename U>
+  friend auto operator==(const CountingAllocator & /*lhs*/,
+                         const CountingAllocator<U, Tag> & /*rhs*/) noexcept -> bool {
+    return true;
+  }
+};
+
+// The index of which keys are cached, i.e., `MockCache`
+struct CacheMemory {};
+// The metadata of replacement policies and of the top-k tracking of the hm benchmark
+struct PolicyMemory {};
+
+template <typename T> using CacheAllocator = CountingAllocator<T, CacheMemory>;
+template <typename T> using PolicyAllocator = CountingAllocator<T, PolicyMemory>;
+
+/**
+ * @brief The peak resident set size of the process in bytes, or 0 if the platform does not report
+ * it.
+ */
+[[nodiscard]] inline auto peak_rss_bytes() -> size_t {
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS counters;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return counters.PeakWorkingSetSize;
+  return 0;
+#elif defined(__unix__) || defined(__APPLE__)
+  rusage usage{};
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#if defined(__APPLE__)
+  return static_cast<size_t>(usage.ru_maxrss); // In bytes
+#else
+  return static_cast<size_t>(usage.ru_maxrss) * 1024; // In kilobytes
+#endif
+#else
+  return 0;
+#endif
+}
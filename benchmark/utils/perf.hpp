@@ -0,0 +1,135 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief The hardware events read by `PerfCounters`, in order.
+ */
+enum class PerfEvent : uint8_t {
+  CYCLES,
+  INSTRUCTIONS,
+  LLC_MISSES,
+  DTLB_MISSES,
+  BRANCH_MISSES,
+};
+
+inline constexpr size_t PERF_EVENT_COUNT = 5;
+inline constexpr std::array<std::string_view, PERF_EVENT_COUNT> PERF_EVENT_NAMES = {
+    "cycles", "instructions", "llc_misses", "dtlb_misses", "branch_misses"};
+
+struct PerfReading {
+  double seconds;
+  // Empty for the events that could not be counted
+  std::array<std::optional<double>, PERF_EVENT_COUNT> counts;
+
+  [[nodiscard]] auto operator[](const PerfEvent event) const -> std::optional<double> {
+    return counts[static_cast<size_t>(event)];
+  }
+};
+
+/**
+ * @brief Count hardware events of the calling thread between `start()` and `stop()` with
+ * `perf_event_open`.
+ *
+ * Each event is opened on its own, so that the events the CPU, the kernel (see
+ * `/proc/sys/kernel/perf_event_paranoid`) or the virtualization layer refuse are simply reported as
+ * missing. Outside of Linux no event is available, and only the elapsed time is measured. Counts
+ * are scaled up when the kernel had to multiplex the counters.
+ */
+class PerfCounters {
+public:
+  PerfCounters() {
+#if defined(__linux__)
+    const std::array<std::pair<uint32_t, uint64_t>, PERF_EVENT_COUNT> configs = {{
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    }};
+    for (size_t i = 0; i < PERF_EVENT_COUNT; i++) {
+      perf_event_attr attr{};
+      attr.size = sizeof(attr);
+      attr.type = configs[i].first;
+      attr.config = configs[i].second;
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      fds_[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+#endif
+  }
+
+  ~PerfCounters() {
+#if defined(__linux__)
+    for (const int fd : fds_)
+      if (fd >= 0)
+        close(fd);
+#endif
+  }
+
+  PerfCounters(const PerfCounters &) = delete;
+  auto operator=(const PerfCounters &) -> PerfCounters & = delete;
+  PerfCounters(PerfCounters &&) = delete;
+  auto operator=(PerfCounters &&) -> PerfCounters & = delete;
+
+  /**
+   * @brief Whether any hardware event can be counted.
+   */
+  [[nodiscard]] auto available() const noexcept -> bool {
+    for (const int fd : fds_)
+      if (fd >= 0)
+        return true;
+    return false;
+  }
+
+  void start() {
+#if defined(__linux__)
+    for (const int fd : fds_)
+      if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+#endif
+    start_ = std::chrono::steady_clock::now();
+  }
+
+  auto stop() -> PerfReading {
+    const auto end = std::chrono::steady_clock::now();
+    PerfReading reading{.seconds = std::chrono::duration<double>(end - start_).count(),
+                        .counts = {}};
+#if defined(__linux__)
+    for (const int fd : fds_)
+      if (fd >= 0)
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    for (size_t i = 0; i < PERF_EVENT_COUNT; i++) {
+      // The value, followed by the time the event was enabled and the time it was counted
+      std::array<uint64_t, 3> values{};
+      if (fds_[i] < 0 || read(fds_[i], values.data(), sizeof(values)) != sizeof(values) ||
+          values[2] == 0)
+        continue;
+      reading.counts[i] = static_cast<double>(values[0]) * static_cast<double>(values[1]) /
+                          static_cast<double>(values[2]);
+    }
+#endif
+    return reading;
+  }
+
+private:
+  std::array<int, PERF_EVENT_COUNT> fds_{-1, -1, -1, -1, -1};
+  std::chrono::steady_clock::time_point start_;
+};
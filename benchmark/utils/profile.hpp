@@ -0,0 +1,337 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <ios>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <version>
+
+#include <nlohmann/json.hpp>
+
+#include "../../src/utils/hash.hpp"
+
+/**
+ * @brief What a trace looks like as a whole, computed in a single parallel pass over the trace (see
+ * `profile_keys()`) and kept in a sidecar file that readers consult instead of scanning the trace
+ * again (see `cached_trace_profile()`).
+ */
+struct TraceProfile {
+  // Bumped whenever a field is added or changes meaning, so that outdated sidecars are recomputed
+  static constexpr uint32_t VERSION = 1;
+
+  uint32_t version = VERSION;
+  uint64_t num_requests = 0;
+  uint64_t num_objects = 0;
+  uint64_t one_hit_wonders = 0; // Objects requested exactly once
+  // The exponent of the Zipf distribution that best fits the request counts of objects by rank
+  double zipf_alpha = 0.0;
+  // The objects requested [2^i, 2^(i+1)) times, at index i
+  std::vector<uint64_t> popularity_histogram;
+  // The requests in [first_timestamp + i * rate_interval, first_timestamp + (i + 1) *
+  // rate_interval), at index i, or none if the trace has no timestamps
+  uint64_t first_timestamp = 0;
+  uint64_t rate_interval = 0;
+  std::vector<uint64_t> request_rate;
+
+  NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(TraceProfile, version, num_requests, num_objects,
+                                              one_hit_wonders, zipf_alpha, popularity_histogram,
+                                              first_timestamp, rate_interval, request_rate)
+
+  [[nodiscard]] auto one_hit_wonder_ratio() const noexcept -> double {
+    return num_objects == 0
+               ? 0.0
+               : static_cast<double>(one_hit_wonders) / static_cast<double>(num_objects);
+  }
+};
+
+/**
+ * @brief The first and last timestamps of a trace, which the request rate of its profile spans.
+ */
+struct TraceTimeSpan {
+  uint64_t first = 0;
+  uint64_t last = 0;
+};
+
+// The most intervals that the request rate of a profile is split into
+inline constexpr size_t PROFILE_RATE_INTERVALS = 1000;
+
+// The fewest requests per thread of a profile, since threads add up their counts in shared tables
+inline constexpr size_t PROFILE_MIN_REQUESTS_PER_THREAD = size_t{1} << 20;
+
+// The most distinct keys that a thread of a profile counts on its own before adding them to the
+// shared tables, which bounds the memory of a profile to the objects plus this many keys per thread
+inline constexpr size_t PROFILE_FLUSH_KEYS = size_t{1} << 18;
+
+/**
+ * @brief The threads worth profiling a trace of `num_requests` requests with, i.e., one per
+ * hardware thread unless the trace is too short to pay for them.
+ */
+[[nodiscard]] inline auto profile_threads(const size_t num_requests) -> size_t {
+  return std::clamp<size_t>(num_requests / PROFILE_MIN_REQUESTS_PER_THREAD, 1,
+                            std::max(1U, std::thread::hardware_concurrency()));
+}
+
+namespace detail {
+
+/**
+ * @brief The Zipf exponent whose rank-frequency line best fits `objects`, the number of objects
+ * requested each number of times, by least squares in log-log space at log-spaced ranks.
+ *
+ * One-hit wonders are left out, since their plateau at the tail would flatten the fit.
+ */
+inline auto fit_zipf_alpha(const std::map<uint64_t, uint64_t> &objects) -> double {
+  // Ranks grow by at least 1/8 between points, so that the many ranks of the tail do not outweigh
+  // the head
+  constexpr double RANK_STEP = 1.125;
+
+  double sum_x = 0.0, sum_y = 0.0, sum_xx = 0.0, sum_xy = 0.0;
+  size_t points = 0;
+  uint64_t rank = 0; // The last rank of the requests counts seen so far
+  double next_rank = 1.0;
+  for (auto it = objects.rbegin(); it != objects.rend() && it->first > 1; ++it) {
+    const auto &[requests, count] = *it;
+    rank += count;
+    for (; next_rank <= static_cast<double>(rank); next_rank = std::ceil(next_rank * RANK_STEP)) {
+      const double x = std::log(next_rank);
+      const double y = std::log(static_cast<double>(requests));
+      sum_x += x;
+      sum_y += y;
+      sum_xx += x * x;
+      sum_xy += x * y;
+      points++;
+    }
+  }
+  const double n = static_cast<double>(points);
+  const double denominator = n * sum_xx - sum_x * sum_x;
+  if (points < 2 || denominator <= 0.0)
+    return 0.0;
+  return -(n * sum_xy - sum_x * sum_y) / denominator;
+}
+
+} // namespace detail
+
+/**
+ * @brief Profile a trace of `num_requests` `Key`s in one pass split among `threads` threads (one
+ * per hardware thread by default).
+ *
+ * `scan(first, count, f)` must call `f(keys, timestamps)` with each consecutive chunk of the
+ * requests `[first, first + count)` in order, as spans of keys and of `uint32_t` timestamps (empty
+ * if the trace has none), and is called by every thread at once for a range of its own, so that the
+ * trace is read once. Each thread counts the keys of its range into small tables of its own, one
+ * per hash partition, and adds them to the shared table of each partition whenever they hold
+ * `PROFILE_FLUSH_KEYS` keys, so that threads rarely wait for each other and memory does not grow
+ * with the threads.
+ *
+ * @param span The timestamps that the request rate spans, or none to leave it out.
+ */
+template <typename Key, typename Scan>
+auto profile_keys(const size_t num_requests, Scan &&scan, const std::optional<TraceTimeSpan> span,
+                  size_t threads = 0) -> TraceProfile {
+  if (threads == 0)
+    threads = std::max(1U, std::thread::hardware_concurrency());
+
+  TraceProfile profile;
+  size_t rate_intervals = 0;
+  if (span && span->last >= span->first) {
+    const uint64_t duration = span->last - span->first + 1;
+    profile.first_timestamp = span->first;
+    profile.rate_interval = (duration + PROFILE_RATE_INTERVALS - 1) / PROFILE_RATE_INTERVALS;
+    rate_intervals = static_cast<size_t>((duration + profile.rate_interval - 1) /
+                                         profile.rate_interval);
+  }
+
+  // Run `task(i)` for each `i` of the threads, on the calling thread for the first, and rethrow the
+  // first exception of any
+  auto parallel = [threads](auto &&task) {
+    std::vector<std::exception_ptr> errors(threads);
+    {
+      std::vector<std::jthread> workers;
+      for (size_t i = 1; i < threads; i++)
+        workers.emplace_back([&, i] {
+          try {
+            task(i);
+          } catch (...) {
+            errors[i] = std::current_exception();
+          }
+        });
+      try {
+        task(0);
+      } catch (...) {
+        errors[0] = std::current_exception();
+      }
+    }
+    for (const auto &error : errors)
+      if (error)
+        std::rethrow_exception(error);
+  };
+
+  struct Range {
+    uint64_t requests = 0;
+    std::vector<uint64_t> request_rate;
+  };
+
+  struct Partition {
+    std::mutex mutex;
+    std::unordered_map<Key, uint64_t> counts;
+  };
+
+  const size_t range_requests = (num_requests + threads - 1) / threads;
+  std::vector<Range> ranges(threads);
+  std::vector<Partition> partitions(threads);
+  parallel([&](const size_t index) {
+    Range &range = ranges[index];
+    range.request_rate.assign(rate_intervals, 0);
+
+    std::vector<std::unordered_map<Key, uint64_t>> counts(threads); // By hash partition
+    size_t keys_counted = 0;
+    auto flush = [&] {
+      // Starting from a partition of its own, so that threads flushing at once rarely collide
+      for (size_t k = 0; k < threads; k++) {
+        auto &local = counts[(index + k) % threads];
+        if (local.empty())
+          continue;
+        Partition &partition = partitions[(index + k) % threads];
+        const std::lock_guard lock(partition.mutex);
+        for (const auto &[key, n] : local)
+          partition.counts[key] += n;
+        local.clear();
+      }
+      keys_counted = 0;
+    };
+
+    const size_t first = std::min(index * range_requests, num_requests);
+    const size_t count = std::min(range_requests, num_requests - first);
+    scan(first, count,
+         [&](const std::span<const Key> keys, const std::span<const uint32_t> timestamps) {
+           range.requests += keys.size();
+           for (size_t i = 0; i < keys.size(); i++) {
+             const size_t partition = threads > 1 ? fastrange(hash(keys[i]), threads) : 0;
+             const auto [it, inserted] = counts[partition].try_emplace(keys[i], 0);
+             it->second++;
+             if (inserted && ++keys_counted == PROFILE_FLUSH_KEYS)
+               flush();
+             if (rate_intervals != 0 && !timestamps.empty()) {
+               // Out-of-order timestamps count towards the first or last interval
+               const uint64_t since = timestamps[i] > profile.first_timestamp
+                                          ? timestamps[i] - profile.first_timestamp
+                                          : 0;
+               range.request_rate[std::min(static_cast<size_t>(since / profile.rate_interval),
+                                           rate_intervals - 1)]++;
+             }
+           }
+         });
+    flush();
+  });
+
+  // The objects of each partition by number of requests
+  std::vector<std::map<uint64_t, uint64_t>> objects_by_partition(threads);
+  parallel([&](const size_t partition) {
+    for (const auto &[key, n] : partitions[partition].counts)
+      objects_by_partition[partition][n]++;
+    std::unordered_map<Key, uint64_t>().swap(partitions[partition].counts);
+  });
+
+  std::map<uint64_t, uint64_t> objects;
+  profile.request_rate.assign(rate_intervals, 0);
+  for (size_t i = 0; i < threads; i++) {
+    profile.num_requests += ranges[i].requests;
+    for (const auto &[n, count] : objects_by_partition[i])
+      objects[n] += count;
+    for (size_t j = 0; j < rate_intervals; j++)
+      profile.request_rate[j] += ranges[i].request_rate[j];
+  }
+
+  for (const auto &[n, count] : objects) {
+    const auto bucket = static_cast<size_t>(std::bit_width(n) - 1);
+    if (bucket >= profile.popularity_histogram.size())
+      profile.popularity_histogram.resize(bucket + 1, 0);
+    profile.popularity_histogram[bucket] += count;
+    profile.num_objects += count;
+  }
+  profile.one_hit_wonders = objects.contains(1) ? objects.at(1) : 0;
+  profile.zipf_alpha = detail::fit_zipf_alpha(objects);
+  return profile;
+}
+
+/**
+ * @brief The profile of the trace at `path` of `num_requests` requests from its sidecar file in
+ * `cache_dir`, or else from `compute()`, which is then saved there.
+ *
+ * Sidecars are keyed by the modification time of the trace, and recomputed when they were written
+ * by another version of `TraceProfile` or do not describe `num_requests` requests.
+ *
+ * @param use_cache Whether to read/write sidecar files (default: true).
+ */
+template <typename Compute>
+auto cached_trace_profile(const std::filesystem::path &path, const std::filesystem::path &cache_dir,
+                          const size_t num_requests, Compute &&compute, const bool use_cache = true)
+    -> TraceProfile {
+  if (!use_cache)
+    return compute();
+
+  // Get last write time and convert to milliseconds since epoch
+  const auto ftime = std::filesystem::last_write_time(path);
+#if __cpp_lib_chrono >= 201907L
+  const auto sys_time = std::chrono::clock_cast<std::chrono::system_clock>(ftime);
+#else
+  const auto sys_time = std::chrono::file_clock::to_sys(ftime);
+#endif
+  const auto ms = std::chrono::time_point_cast<std::chrono::milliseconds>(sys_time);
+  const auto mtime_ms = ms.time_since_epoch().count();
+
+  const std::string cache_key_prefix = "profile_" + path.filename().string() + "_";
+  const std::string cache_key = cache_key_prefix + std::to_string(mtime_ms) + ".json";
+  const auto cache_file = cache_dir / cache_key;
+
+  if (std::ifstream ifs{cache_file}) {
+    try {
+      auto profile = nlohmann::json::parse(ifs).get<TraceProfile>();
+      if (profile.version == TraceProfile::VERSION && profile.num_requests == num_requests)
+        return profile;
+    } catch (const nlohmann::json::exception &) {
+      // Fall through to recompute
+    }
+  }
+
+  const TraceProfile profile = compute();
+
+  // Write under a name of its own and rename it into place, so that concurrent benchmark processes
+  // profiling the same trace never see a partial file
+  const auto temp_file = cache_dir / std::format("{}.{}.tmp", cache_key, std::random_device{}());
+  {
+    std::ofstream ofs{temp_file, std::ios::out | std::ios::trunc};
+    ofs << nlohmann::json(profile).dump();
+    if (!ofs)
+      throw std::ios_base::failure(std::format("Failed to write {}", temp_file.string()));
+  }
+  std::filesystem::rename(temp_file, cache_file);
+
+  // Remove outdated sidecars sharing the prefix (but not the current key)
+  for (const auto &entry : std::filesystem::directory_iterator{cache_dir}) {
+    if (!entry.is_regular_file())
+      continue;
+    const auto filename = entry.path().filename().string();
+    if (filename.starts_with(cache_key_prefix) && filename != cache_key &&
+        filename.ends_with(".json"))
+      std::filesystem::remove(entry.path());
+  }
+
+  return profile;
+}
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+#if defined(__APPLE__)
+#include <sys/sysctl.h>
+#endif
+
+#include <nlohmann/json.hpp>
+
+#include "../../src/utils/hash_functions/murmur.hpp"
+#include "results.hpp"
+
+// The commit the benchmarks were configured from, defined by CMake
+#ifndef BENCHMARK_GIT_COMMIT
+#define BENCHMARK_GIT_COMMIT "unknown"
+#endif
+
+/**
+ * @brief What a result depends on besides its parameters, recorded with every result so that runs
+ * on different machines, builds or traces are not compared unknowingly.
+ */
+struct RunMetadata {
+  std::string commit;
+  std::string compiler;
+  std::string build_type;
+  std::string cpu_model;
+  unsigned cores = 0;
+  std::string hostname;
+  std::string started_at; // In UTC, e.g., "2025-01-31T12:34:56Z"
+  std::string command;
+  std::string trace_checksum; // Empty for benchmarks without a trace
+
+  NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(RunMetadata, commit, compiler, build_type, cpu_model,
+                                              cores, hostname, started_at, command, trace_checksum)
+};
+
+/**
+ * @brief The result of one task, i.e., one line of a result file.
+ */
+struct ResultRecord {
+  std::string benchmark; // e.g., "caching"
+  std::string name;      // e.g., "W-TinyLFU_EVO (Ia=10000)"
+  std::map<std::string, std::string> params;
+  std::map<std::string, double> metrics;
+  double time_spent_s = 0.0;
+  RunMetadata metadata;
+
+  NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(ResultRecord, benchmark, name, params, metrics,
+                                              time_spent_s, metadata)
+
+  /**
+   * @brief What identifies the configuration of the record, i.e., which records are repetitions of
+   * each other, which may differ in their "seed" parameter only.
+   */
+  [[nodiscard]] auto configuration() const -> std::string {
+    auto configuration_params = params;
+    configuration_params.erase("seed");
+    return std::format("{} {} {}", benchmark, name, nlohmann::json(configuration_params).dump());
+  }
+};
+
+/**
+ * @brief Whether larger values of `metric` are better, e.g., DCGs and throughputs. Smaller values
+ * are better for all others, e.g., miss ratios, latencies, errors and bytes.
+ */
+[[nodiscard]] inline auto higher_is_better(const std::string_view metric) -> bool {
+  return metric == "dcg" || metric.ends_with("mops") || metric.find("hit_ratio") != metric.npos;
+}
+
+[[nodiscard]] inline auto compiler_version() -> std::string {
+#if defined(__clang__)
+  return std::format("clang {}.{}.{}", __clang_major__, __clang_minor__, __clang_patchlevel__);
+#elif defined(__GNUC__)
+  return std::format("gcc {}.{}.{}", __GNUC__, __GNUC_MINOR__, __GNUC_PATCHLEVEL__);
+#elif defined(_MSC_VER)
+  return std::format("msvc {}", _MSC_FULL_VER);
+#else
+  return "unknown";
+#endif
+}
+
+[[nodiscard]] inline auto cpu_model() -> std::string {
+#if defined(__linux__)
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line))
+    if (line.starts_with("model name"))
+      if (const auto colon = line.find(':'); colon != std::string::npos)
+        return line.substr(line.find_first_not_of(' ', colon + 1));
+#elif defined(__APPLE__)
+  std::array<char, 256> buffer{};
+  size_t size = buffer.size();
+  if (sysctlbyname("machdep.cpu.brand_string", buffer.data(), &size, nullptr, 0) == 0)
+    return buffer.data();
+#endif
+  return "unknown";
+}
+
+[[nodiscard]] inline auto hostname() -> std::string {
+#if defined(__unix__) || defined(__APPLE__)
+  std::array<char, 256> buffer{};
+  if (gethostname(buffer.data(), buffer.size() - 1) == 0)
+    return buffer.data();
+#endif
+  return "unknown";
+}
+
+/**
+ * @brief Hash the whole content of the file at `path` with 64-bit MurmurHash2, one block at a time.
+ */
+[[nodiscard]] inline auto file_checksum(const std::string &path) -> std::string {
+  constexpr size_t BLOCK_SIZE = size_t{1} << 20;
+
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open())
+    throw std::runtime_error("Failed to open file for checksum: " + path);
+  std::vector<char> block(BLOCK_SIZE);
+  uint64_t checksum = 0;
+  while (file.read(block.data(), static_cast<std::streamsize>(block.size())) || file.gcount() > 0)
+    checksum = murmur_hash2_x64_64(block.data(), static_cast<int>(file.gcount()), checksum);
+  return std::format("{:016x}", checksum);
+}
+
+/**
+ * @brief Describe the current run of the driver invoked with `argv`.
+ */
+[[nodiscard]] inline auto collect_run_metadata(const int argc, char **argv) -> RunMetadata {
+  std::string command;
+  for (int i = 0; i < argc; i++)
+    command += (i == 0 ? "" : " ") + std::string(argv[i]);
+  return {
+      .commit = BENCHMARK_GIT_COMMIT,
+      .compiler = compiler_version(),
+#ifdef NDEBUG
+      .build_type = "release",
+#else
+      .build_type = "debug",
+#endif
+      .cpu_model = cpu_model(),
+      .cores = std::thread::hardware_concurrency(),
+      .hostname = hostname(),
+      .started_at = std::format("{:%FT%TZ}", std::chrono::floor<std::chrono::seconds>(
+                                                 std::chrono::system_clock::now())),
+      .command = command,
+      .trace_checksum = "",
+  };
+}
+
+/**
+ * @brief Append results as JSON lines to a file, from any thread. Does nothing without a path.
+ *
+ * Appending lets repeated runs of the same configuration accumulate in one file, which is what
+ * `compare` needs to tell regressions from noise.
+ */
+class ResultStore {
+public:
+  ResultStore(const std::string &path, RunMetadata metadata) : metadata_(std::move(metadata)) {
+    if (path.empty())
+      return;
+    file_.open(path, std::ios::app);
+    if (!file_.is_open())
+      throw std::runtime_error("Failed to open result file: " + path);
+  }
+
+  [[nodiscard]] auto enabled() const -> bool { return file_.is_open(); }
+
+  [[nodiscard]] auto metadata() -> RunMetadata & { return metadata_; }
+
+  /**
+   * @brief Write `record` with the metadata of the run, leaving out metrics that are NaN (e.g.,
+   * hardware events that could not be counted).
+   */
+  void record(ResultRecord record) {
+    if (!enabled())
+      return;
+    std::erase_if(record.metrics, [](const auto &metric) { return std::isnan(metric.second); });
+    record.metadata = metadata_;
+
+    const std::lock_guard lock(mutex_);
+    file_ << nlohmann::json(record).dump() << '\n' << std::flush;
+  }
+
+  /**
+   * @brief Read all records of the file at `path`, skipping blank lines.
+   */
+  [[nodiscard]] static auto load(const std::string &path) -> std::vector<ResultRecord> {
+    std::ifstream file(path);
+    if (!file.is_open())
+      throw std::runtime_error("Failed to open result file: " + path);
+
+    std::vector<ResultRecord> records;
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(file, line)) {
+      line_number++;
+      if (line.find_first_not_of(" \t\r") == std::string::npos)
+        continue;
+      try {
+        records.push_back(nlohmann::json::parse(line).get<ResultRecord>());
+      } catch (const nlohmann::json::exception &e) {
+        throw std::runtime_error(
+            std::format("Malformed record at {}:{}: {}", path, line_number, e.what()));
+      }
+    }
+    return records;
+  }
+
+private:
+  RunMetadata metadata_;
+  std::ofstream file_;
+  std::mutex mutex_;
+};
+
+/**
+ * @brief The metrics of a sketch benchmark task (see `ResultColumn`), named like the rows of its
+ * CSV output, where `primary` names the task-specific metric (e.g., "miss_ratio").
+ *
+ * Timings that the stats policy did not record are left out.
+ */
+[[nodiscard]] inline auto sketch_metrics(const std::string &primary,
+                                         const std::vector<double> &results)
+    -> std::map<std::string, double> {
+  std::map<std::string, double> metrics{{primary, result_at(results, ResultColumn::PRIMARY)}};
+  auto add_timing = [&](const std::string &type, const ResultColumn column) {
+    if (const double value = result_at(results, column); value != 0.0)
+      metrics[type] = value;
+  };
+  add_timing("update_avg_time_s", ResultColumn::UPDATE_AVG_S);
+  add_timing("estimate_avg_time_s", ResultColumn::ESTIMATE_AVG_S);
+  for (const auto &column : latency_columns())
+    add_timing(column.type, column.column);
+  for (const auto &column : MEMORY_COLUMNS)
+    if (static_cast<size_t>(column.column) < results.size())
+      metrics[std::string(column.type)] = result_at(results, column.column);
+  return metrics;
+}
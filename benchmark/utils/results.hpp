@@ -0,0 +1,148 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../../src/utils/stats.hpp"
+#include "benchmark_task.hpp"
+#include "memory.hpp"
+#include "perf.hpp"
+
+/**
+ * @brief The columns of the results printed by sketch benchmark tasks, in order.
+ *
+ * Timings are in seconds, and are 0 when the stats policy of the task does not record them. Memory
+ * is in bytes, where the policy and cache columns are the peaks of their counting allocators.
+ */
+enum class ResultColumn : uint8_t {
+  PRIMARY, // The task-specific metric, e.g., the miss ratio or the DCG
+  UPDATE_AVG_S,
+  ESTIMATE_AVG_S,
+  UPDATE_P50_S,
+  UPDATE_P90_S,
+  UPDATE_P99_S,
+  UPDATE_P999_S,
+  UPDATE_MAX_S,
+  ESTIMATE_P50_S,
+  ESTIMATE_P90_S,
+  ESTIMATE_P99_S,
+  ESTIMATE_P999_S,
+  ESTIMATE_MAX_S,
+  SKETCH_BYTES,
+  POLICY_BYTES,
+  CACHE_BYTES,
+  PEAK_RSS_BYTES,
+};
+
+/**
+ * @brief A memory column of the results, which tasks may leave out, e.g., the peak RSS of tasks run
+ * in batches, where it would be the peak of the whole batch process rather than of the task.
+ */
+struct MemoryColumn {
+  std::string_view type; // The name of the column in CSV output
+  ResultColumn column;
+  std::string_view description;
+};
+
+inline constexpr std::array MEMORY_COLUMNS = {
+    MemoryColumn{"sketch_bytes", ResultColumn::SKETCH_BYTES, "Sketch Footprint"},
+    MemoryColumn{"policy_bytes", ResultColumn::POLICY_BYTES, "Peak Policy Metadata"},
+    MemoryColumn{"cache_bytes", ResultColumn::CACHE_BYTES, "Peak Cache Index"},
+    MemoryColumn{"peak_rss_bytes", ResultColumn::PEAK_RSS_BYTES,
+                 "Peak RSS of the Task (Separate Processes Only)"},
+};
+
+// The latency quantiles reported per operation, matching the `*_P50_S` to `*_MAX_S` columns
+inline constexpr std::array LATENCY_QUANTILES = {0.5, 0.9, 0.99, 0.999, 1.0};
+inline constexpr std::array<std::string_view, LATENCY_QUANTILES.size()> LATENCY_QUANTILE_NAMES = {
+    "p50", "p90", "p99", "p99.9", "max"};
+inline constexpr std::array<std::string_view, LATENCY_QUANTILES.size()> LATENCY_QUANTILE_KEYS = {
+    "p50", "p90", "p99", "p999", "max"};
+
+struct LatencyColumn {
+  std::string type; // The name of the column in CSV output, e.g., "update_p99_s"
+  ResultColumn column;
+  SketchOp op;
+  std::string_view quantile_name; // e.g., "p99.9"
+};
+
+/**
+ * @brief All latency columns, grouped by operation and in increasing order of quantile.
+ */
+[[nodiscard]] inline auto latency_columns() -> std::vector<LatencyColumn> {
+  std::vector<LatencyColumn> columns;
+  auto column = static_cast<size_t>(ResultColumn::UPDATE_P50_S);
+  for (const auto op : {SketchOp::UPDATE, SketchOp::ESTIMATE})
+    for (size_t i = 0; i < LATENCY_QUANTILES.size(); i++)
+      columns.push_back({.type = std::format("{}_{}_s",
+                                             op == SketchOp::UPDATE ? "update" : "estimate",
+                                             LATENCY_QUANTILE_KEYS[i]),
+                         .column = static_cast<ResultColumn>(column++),
+                         .op = op,
+                         .quantile_name = LATENCY_QUANTILE_NAMES[i]});
+  return columns;
+}
+
+/**
+ * @brief The value of `column` in `results`, or 0 if an older task did not report it.
+ */
+[[nodiscard]] inline auto result_at(const std::vector<double> &results, const ResultColumn column)
+    -> double {
+  const auto index = static_cast<size_t>(column);
+  return index < results.size() ? results[index] : 0.0;
+}
+
+/**
+ * @brief Append the memory columns of a task that has finished, starting at `SKETCH_BYTES`.
+ *
+ * Tasks run in batches (see `BenchmarkTask::batched`) leave out `PEAK_RSS_BYTES`, the last column,
+ * since they share their process with the other tasks of the batch.
+ */
+inline void append_memory_results(std::vector<double> &results, const size_t sketch_bytes) {
+  results.push_back(static_cast<double>(sketch_bytes));
+  results.push_back(static_cast<double>(AllocationCounter<PolicyMemory>::peak_bytes()));
+  results.push_back(static_cast<double>(AllocationCounter<CacheMemory>::peak_bytes()));
+  if (!BenchmarkTask::batched)
+    results.push_back(static_cast<double>(peak_rss_bytes()));
+}
+
+/**
+ * @brief Assemble the results of a task from its primary metric and the stats of its sketch.
+ */
+template <typename Sketch>
+[[nodiscard]] auto sketch_results(const double primary, const Sketch &sketch)
+    -> std::vector<double> {
+  std::vector<double> results{primary, sketch.update_time_avg_seconds(),
+                              sketch.estimate_time_avg_seconds()};
+  for (const auto op : {SketchOp::UPDATE, SketchOp::ESTIMATE})
+    for (const auto quantile : LATENCY_QUANTILES)
+      results.push_back(sketch.op_stats().latency_seconds(op, quantile));
+  append_memory_results(results, sketch.footprint_bytes());
+  return results;
+}
+
+/**
+ * @brief Assemble the results of a task without a sketch, whose timings are therefore all 0.
+ */
+[[nodiscard]] inline auto sketchless_results(const double primary) -> std::vector<double> {
+  std::vector<double> results(static_cast<size_t>(ResultColumn::SKETCH_BYTES), 0.0);
+  results[static_cast<size_t>(ResultColumn::PRIMARY)] = primary;
+  append_memory_results(results, 0);
+  return results;
+}
+
+// The operations timed by micro-benchmark tasks, each reported as the nanoseconds per call followed
+// by the hardware events per call (in the order of `PERF_EVENT_NAMES`, NaN if unavailable)
+inline constexpr std::array<std::string_view, 3> MICRO_OPS = {"update", "estimate",
+                                                              "update_and_estimate"};
+inline constexpr size_t MICRO_VALUES_PER_OP = 1 + PERF_EVENT_COUNT;
+
+// The errors reported by accuracy benchmark tasks for each sketch size, in order: the average
+// relative and absolute errors on the most frequent keys, then on keys drawn uniformly
+inline constexpr std::array<std::string_view, 4> ACCURACY_METRICS = {"top_are", "top_aae",
+                                                                     "random_are", "random_aae"};
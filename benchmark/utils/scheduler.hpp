@@ -0,0 +1,261 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+/**
+ * @brief The logical CPUs that the process may run on, one per physical core (i.e., without SMT
+ * siblings), or the first `std::thread::hardware_concurrency()` IDs where the topology is unknown.
+ */
+[[nodiscard]] inline auto physical_core_cpus() -> std::vector<int> {
+  std::vector<int> cpus;
+#if defined(__linux__)
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+    auto read_id = [](const std::string &path) {
+      std::ifstream file(path);
+      int id = -1;
+      file >> id;
+      return id;
+    };
+    std::set<std::pair<int, int>> cores; // (package, core)
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (!CPU_ISSET(cpu, &allowed))
+        continue;
+      const auto topology = std::format("/sys/devices/system/cpu/cpu{}/topology/", cpu);
+      const int package = read_id(topology + "physical_package_id");
+      const int core = read_id(topology + "core_id");
+      // Without a topology, count every logical CPU as a core of its own
+      if (core < 0 ? cores.emplace(-1, -1 - cpu).second : cores.emplace(package, core).second)
+        cpus.push_back(cpu);
+    }
+  }
+#endif
+  if (cpus.empty())
+    for (unsigned cpu = 0; cpu < std::max(1U, std::thread::hardware_concurrency()); cpu++)
+      cpus.push_back(static_cast<int>(cpu));
+  return cpus;
+}
+
+/**
+ * @brief Restrict the calling thread, and the processes it starts from now on, to `cpu`.
+ *
+ * @return Whether the platform supports it and it succeeded.
+ */
+inline auto pin_current_thread(const int cpu) -> bool {
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+
+/**
+ * @brief The physical memory available to new processes in bytes, or 0 if the platform does not
+ * report it.
+ */
+[[nodiscard]] inline auto available_memory_bytes() -> size_t {
+#if defined(__linux__)
+  std::ifstream meminfo("/proc/meminfo");
+  std::string key;
+  size_t kilobytes = 0;
+  std::string unit;
+  while (meminfo >> key >> kilobytes >> unit)
+    if (key == "MemAvailable:")
+      return kilobytes * 1024;
+#endif
+#if defined(_SC_PHYS_PAGES) && defined(_SC_PAGE_SIZE)
+  const long pages = sysconf(_SC_PHYS_PAGES);
+  const long page_size = sysconf(_SC_PAGE_SIZE);
+  if (pages > 0 && page_size > 0)
+    return static_cast<size_t>(pages) * static_cast<size_t>(page_size);
+#endif
+  return 0;
+}
+
+struct JobSchedulerOptions {
+  // The jobs running at once, where 0 means one per physical core
+  size_t max_jobs = 0;
+  // The memory that running jobs may be estimated to use in total, where 0 means all available
+  size_t memory_budget_bytes = 0;
+  // Whether each job runs pinned to a physical core of its own
+  bool pin = true;
+};
+
+/**
+ * @brief Memory that jobs share while any of them runs, e.g., the page cache of a trace that they
+ * all map, which the budget of a `JobScheduler` counts once rather than per job.
+ */
+struct SharedMemoryEstimate {
+  // What identifies the memory, e.g., the path of a trace, or empty for none
+  std::string key;
+  size_t bytes = 0;
+};
+
+/**
+ * @brief Run jobs in submission order on a fixed pool of workers, each pinned to a physical core,
+ * admitting the next job only once the memory it is estimated to use fits in the budget.
+ *
+ * A job whose estimate alone exceeds the budget still runs, but by itself. Jobs should start their
+ * timers when they run rather than when they are submitted, so that queueing does not count.
+ */
+class JobScheduler {
+public:
+  explicit JobScheduler(const JobSchedulerOptions &options = {}) {
+    auto cpus = physical_core_cpus();
+    const size_t max_jobs = options.max_jobs != 0 ? options.max_jobs : cpus.size();
+    budget_bytes_ = options.memory_budget_bytes != 0 ? options.memory_budget_bytes
+                                                     : available_memory_bytes();
+    if (budget_bytes_ == 0)
+      budget_bytes_ = std::numeric_limits<size_t>::max();
+
+    for (size_t i = 0; i < max_jobs; i++) {
+      // With more jobs than cores, pinning would only stack jobs on the same cores
+      const int cpu = options.pin && max_jobs <= cpus.size() ? cpus[i] : -1;
+      workers_.emplace_back([this, cpu] { work(cpu); });
+    }
+  }
+
+  ~JobScheduler() {
+    {
+      const std::lock_guard lock(mutex_);
+      stopping_ = true;
+    }
+    cv_.notify_all();
+    workers_.clear(); // Join before the queue and the mutex go away
+  }
+
+  JobScheduler(const JobScheduler &) = delete;
+  auto operator=(const JobScheduler &) -> JobScheduler & = delete;
+  JobScheduler(JobScheduler &&) = delete;
+  auto operator=(JobScheduler &&) -> JobScheduler & = delete;
+
+  /**
+   * @brief Queue `job`, which is estimated to use `estimated_bytes` of memory of its own while it
+   * runs, besides the `shared` memory of all running jobs with the same key.
+   */
+  auto submit(std::function<void()> job, const size_t estimated_bytes = 0,
+              SharedMemoryEstimate shared = {}) -> std::future<void> {
+    std::packaged_task<void()> task(std::move(job));
+    auto future = task.get_future();
+    {
+      const std::lock_guard lock(mutex_);
+      queue_.push_back({.task = std::move(task),
+                        .estimated_bytes = estimated_bytes,
+                        .shared = std::move(shared)});
+    }
+    cv_.notify_all();
+    return future;
+  }
+
+  [[nodiscard]] auto max_jobs() const noexcept -> size_t { return workers_.size(); }
+
+  [[nodiscard]] auto memory_budget_bytes() const noexcept -> size_t { return budget_bytes_; }
+
+private:
+  struct Job {
+    std::packaged_task<void()> task;
+    size_t estimated_bytes = 0;
+    SharedMemoryEstimate shared;
+  };
+
+  // The running jobs of a key of shared memory, and the bytes counted for it
+  struct SharedUse {
+    size_t jobs = 0;
+    size_t bytes = 0;
+  };
+
+  size_t budget_bytes_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Job> queue_;
+  size_t running_ = 0;
+  size_t used_bytes_ = 0;
+  std::map<std::string, SharedUse> shared_;
+  bool stopping_ = false;
+
+  std::vector<std::jthread> workers_;
+
+  // Admit jobs strictly in order, so that a large job is not starved by smaller ones behind it
+  [[nodiscard]] auto can_admit() const -> bool {
+    return !queue_.empty() &&
+           (running_ == 0 || admission_bytes(queue_.front()) <= budget_bytes_ - used_bytes_);
+  }
+
+  // The bytes that running `job` adds, counting its shared memory only if no running job does
+  [[nodiscard]] auto admission_bytes(const Job &job) const -> size_t {
+    const bool shared = !job.shared.key.empty() && !shared_.contains(job.shared.key);
+    return job.estimated_bytes + (shared ? job.shared.bytes : 0);
+  }
+
+  void work(const int cpu) {
+    if (cpu >= 0)
+      pin_current_thread(cpu);
+
+    while (true) {
+      Job job;
+      {
+        std::unique_lock lock(mutex_);
+        cv_.wait(lock, [this] { return can_admit() || (stopping_ && queue_.empty()); });
+        if (queue_.empty())
+          return;
+        job = std::move(queue_.front());
+        queue_.pop_front();
+        running_++;
+        // A job admitted alone over budget takes the whole budget
+        if (!job.shared.key.empty()) {
+          auto &use = shared_[job.shared.key];
+          if (use.jobs++ == 0) {
+            use.bytes = std::min(job.shared.bytes, budget_bytes_ - used_bytes_);
+            used_bytes_ += use.bytes;
+          }
+        }
+        job.estimated_bytes = std::min(job.estimated_bytes, budget_bytes_ - used_bytes_);
+        used_bytes_ += job.estimated_bytes;
+      }
+
+      job.task();
+
+      {
+        const std::lock_guard lock(mutex_);
+        running_--;
+        used_bytes_ -= job.estimated_bytes;
+        if (!job.shared.key.empty()) {
+          const auto it = shared_.find(job.shared.key);
+          if (--it->second.jobs == 0) {
+            used_bytes_ -= it->second.bytes;
+            shared_.erase(it);
+          }
+        }
+      }
+      cv_.notify_all();
+    }
+  }
+};
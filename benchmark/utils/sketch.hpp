@@ -2,17 +2,23 @@
 
 #include <algorithm>
 #include <bit>
+#include <compare>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <limits>
-#include <random>
+#include <optional>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
 
 #include "../../src/adapters/adapter.hpp"
+#include "../../src/sketch.hpp"
 #include "../../src/utils/hash.hpp"
 #include "../../src/utils/memory.hpp"
-#include "../../src/utils/time.hpp"
+#include "../../src/utils/random.hpp"
+#include "../../src/utils/stats.hpp"
+#include "../../src/utils/trace.hpp"
 
 template <typename F>
   requires std::is_invocable_r_v<float, F, uint32_t, double>
@@ -20,7 +26,13 @@ struct EvolvingSketchOptimOptions {
   double initial_alpha = 1.0;
   F f;
   Adapter<double, double> *adapter = nullptr;
+  // Counted in updates for `DecayClock::UPDATES`, and in seconds for `DecayClock::SECONDS`
   uint32_t adapt_interval = 0;
+  DecayClock clock = DecayClock::UPDATES;
+  // Where to record prunes and adaptations, if anywhere. Copies of the sketch record nothing
+  EventTrace *events = nullptr;
+  // The seed of the row hashes, drawn from `std::random_device` if unset
+  std::optional<uint64_t> seed = std::nullopt;
 };
 
 /**
@@ -30,7 +42,7 @@ struct EvolvingSketchOptimOptions {
  * Note that this version only performs better performance than regular Evolving Sketch when
  * adaptation is enabled (i.e., adapter is not nullptr).
  */
-template <typename T, typename F, typename SumType = size_t>
+template <typename T, typename F, typename SumType = size_t, typename Stats = NoStats>
   requires std::is_invocable_r_v<float, F, uint32_t, double>
 class EvolvingSketchOptim {
 private:
@@ -43,20 +55,15 @@ public:
   SumType sum = 0;
 
   explicit EvolvingSketchOptim(const size_t size, const EvolvingSketchOptimOptions<F> &options)
-      : k_width_(std::bit_ceil(std::max(size / 4, 8UZ))),
-        data_(aligned_alloc<std::remove_pointer_t<decltype(data_)>>(4 * k_width_)), k_f_(options.f),
-        k_adapter_(options.adapter), alpha_(options.initial_alpha),
-        k_adapt_interval_(options.adapt_interval) {
-    if (!data_)
-      throw std::bad_alloc();
-
-    for (size_t i = 0; i < 4 * k_width_; i++)
-      data_[i] = 0;
+      : EvolvingSketchOptim(options, std::bit_ceil(std::max(size / 4, 8UZ))) {}
 
-    std::mt19937 gen{std::random_device{}()};
-    for (auto &seed : seeds_)
-      seed = gen();
-  }
+  /**
+   * @brief Construct a sketch that occupies at most `budget` in total (see `footprint_bytes()`),
+   * using the widest rows that fit instead of rounding the width to a power of two.
+   */
+  explicit EvolvingSketchOptim(const MemoryBudget budget,
+                               const EvolvingSketchOptimOptions<F> &options)
+      : EvolvingSketchOptim(options, width_for(budget)) {}
 
   ~EvolvingSketchOptim() { cleanup(); }
 
@@ -64,7 +71,9 @@ public:
       : k_width_(other.k_width_),
         data_(aligned_alloc<std::remove_pointer_t<decltype(data_)>>(4 * k_width_)),
         k_f_(other.k_f_), k_adapter_(other.k_adapter_), alpha_(other.alpha_),
-        k_adapt_interval_(other.k_adapt_interval_) {
+        k_adapt_interval_(other.k_adapt_interval_), k_clock_(other.k_clock_), now_(other.now_),
+        epoch_start_(other.epoch_start_), adapt_start_(other.adapt_start_),
+        clock_started_(other.clock_started_) {
     if (!data_)
       throw std::bad_alloc();
 
@@ -81,7 +90,9 @@ public:
   EvolvingSketchOptim(EvolvingSketchOptim &&other) noexcept
       : k_width_(other.k_width_), data_(other.data_), k_f_(std::move(other.k_f_)),
         k_adapter_(other.k_adapter_), alpha_(other.alpha_),
-        k_adapt_interval_(other.k_adapt_interval_) {
+        k_adapt_interval_(other.k_adapt_interval_), k_clock_(other.k_clock_), now_(other.now_),
+        epoch_start_(other.epoch_start_), adapt_start_(other.adapt_start_),
+        clock_started_(other.clock_started_), k_events_(other.k_events_) {
     for (size_t i = 0; i < 4; i++)
       seeds_[i] = other.seeds_[i];
 
@@ -91,6 +102,7 @@ public:
     other.alpha_ = 0.0;
     other.k_adapt_interval_ = 0;
     other.adapt_counter_ = 0;
+    other.k_events_ = nullptr;
   }
 
   auto operator=(const EvolvingSketchOptim &other) -> EvolvingSketchOptim & {
@@ -119,6 +131,11 @@ public:
     alpha_ = other.alpha_;
     k_adapt_interval_ = other.k_adapt_interval_;
     adapt_counter_ = other.adapt_counter_;
+    k_clock_ = other.k_clock_;
+    now_ = other.now_;
+    epoch_start_ = other.epoch_start_;
+    adapt_start_ = other.adapt_start_;
+    clock_started_ = other.clock_started_;
 
     return *this;
   }
@@ -136,6 +153,12 @@ public:
     alpha_ = other.alpha_;
     k_adapt_interval_ = other.k_adapt_interval_;
     adapt_counter_ = other.adapt_counter_;
+    k_clock_ = other.k_clock_;
+    now_ = other.now_;
+    epoch_start_ = other.epoch_start_;
+    adapt_start_ = other.adapt_start_;
+    clock_started_ = other.clock_started_;
+    k_events_ = other.k_events_;
 
     for (size_t i = 0; i < 4; i++)
       seeds_[i] = other.seeds_[i];
@@ -146,81 +169,125 @@ public:
     other.alpha_ = 0.0;
     other.k_adapt_interval_ = 0;
     other.adapt_counter_ = 0;
+    other.k_events_ = nullptr;
 
     return *this;
   }
 
-  void update(const T &item) {
-    const auto start = get_current_time_in_seconds();
-
-  retry_update:
-    const auto increment = k_f_(++t_, alpha_);
-
-    // For rollback if overflow detected
-    size_t counter_positions[4];
-    float original_counters[4];
-
-    // Increment counters
-    bool overflow_detected = false;
-    size_t index = hash(item) % k_width_;
-    size_t i;
-    for (i = 0; i < 4; i++) {
-      if (i > 0)
-        index = alt_index(index, seeds_[i]);
-      const size_t pos = i * k_width_ + index;
-      auto &v = data_[pos];
-      if (v > PRUNE_THRESHOLD - increment) {
-        overflow_detected = true;
-        break;
-      }
-      counter_positions[i] = pos;
-      original_counters[i] = v;
-      v += increment;
-    }
+  void update(const T &item) { update(item, 1.0F); }
 
-    // If overflow detected, rollback written counters
-    if (overflow_detected) {
-      for (size_t j = 0; j < i; j++)
-        data_[counter_positions[j]] = original_counters[j];
-      t_--;
-      prune();
-      // NOLINTNEXTLINE(cppcoreguidelines-avoid-goto)
-      goto retry_update;
-    }
+  /**
+   * @brief Update `item` by `weight` (non-negative) units at once, which is equivalent to `weight`
+   * unit updates made at the same time, e.g., for pre-aggregated counts or byte-weighted
+   * frequencies. Counters prune before reaching 2^24 - 1 decayed units, where a float still counts
+   * by one, and saturate there only when pruning cannot make room (i.e., without decay, or for a
+   * weight that alone exceeds it).
+   */
+  void update(const T &item, const float weight) {
+    [[maybe_unused]] const auto scope = stats_.measure(SketchOp::UPDATE);
 
-    if (k_adapt_interval_ && ++adapt_counter_ >= k_adapt_interval_)
-      adapt();
+    size_t positions[4];
+    locate(item, positions);
+    update_counters(positions, weight);
+  }
+
+  /**
+   * @brief Update `item` by `weight` and return its estimate after the update, which is cheaper
+   * than calling `update()` and `estimate()` in a row as the counters are only located once.
+   *
+   * Counted as an update by the stats policy.
+   */
+  auto update_and_estimate(const T &item, const float weight = 1.0F) -> float {
+    [[maybe_unused]] const auto scope = stats_.measure(SketchOp::UPDATE);
+
+    size_t positions[4];
+    locate(item, positions);
+    update_counters(positions, weight);
+    const auto res = min_counter(positions) / k_f_(t_, alpha_);
 
-    total_update_time_seconds_ += get_current_time_in_seconds() - start;
-    update_count_++;
+    return res;
+  }
+
+  /**
+   * @brief Advance the decay clock to `timestamp` (in seconds) and then update `item` by `weight`.
+   *
+   * Only meaningful with `DecayClock::SECONDS`; with `DecayClock::UPDATES` the timestamp is
+   * ignored.
+   */
+  void update_at(const T &item, const uint32_t timestamp, const float weight = 1.0F) {
+    advance_to(timestamp);
+    update(item, weight);
+  }
+
+  /**
+   * @brief Advance the decay clock to `timestamp` (in seconds) without updating any item.
+   *
+   * The first timestamp seen becomes the origin of the clock. Timestamps earlier than the latest
+   * one seen do not move the clock backwards. Has no effect with `DecayClock::UPDATES`.
+   */
+  void advance_to(const uint32_t timestamp) {
+    if (k_clock_ != DecayClock::SECONDS)
+      return;
+
+    if (!clock_started_) {
+      now_ = epoch_start_ = adapt_start_ = timestamp;
+      clock_started_ = true;
+    } else if (timestamp > now_) {
+      now_ = timestamp;
+    }
+
+    // Counters are only rescaled on prune, so `t` is the time elapsed since the last prune
+    t_ = now_ - epoch_start_;
   }
 
   [[nodiscard]] auto estimate(const T &item) const -> float {
-    const auto start = get_current_time_in_seconds();
+    [[maybe_unused]] const auto scope = stats_.measure(SketchOp::ESTIMATE);
 
-    auto res = std::numeric_limits<std::remove_pointer_t<decltype(data_)>>::max();
-    size_t index = hash(item) % k_width_;
+    size_t positions[4];
+    locate(item, positions);
+    // All counters share the same positive divisor, so it suffices to divide their minimum
+    const auto res = min_counter(positions) / k_f_(t_, alpha_);
+
+    return res;
+  }
+
+  /**
+   * @brief Compare the estimates of `a` and `b`, probing the counters of both items at once.
+   *
+   * Counted as a single estimate by the stats policy.
+   */
+  [[nodiscard]] auto compare(const T &a, const T &b) const -> std::partial_ordering {
+    [[maybe_unused]] const auto scope = stats_.measure(SketchOp::ESTIMATE);
+
+    size_t positions_a[4];
+    size_t positions_b[4];
+    locate(a, positions_a);
+    locate(b, positions_b);
     for (size_t i = 0; i < 4; i++) {
-      if (i > 0)
-        index = alt_index(index, seeds_[i]);
-      const size_t pos = i * k_width_ + index;
-      res = std::min(res, data_[pos] / k_f_(t_, alpha_));
+      prefetch(&data_[positions_a[i]]);
+      prefetch(&data_[positions_b[i]]);
     }
-
-    total_estimate_time_seconds_ += get_current_time_in_seconds() - start;
-    estimate_count_++;
+    // Both estimates share the same positive divisor, so comparing the raw counters suffices
+    const auto res = min_counter(positions_a) <=> min_counter(positions_b);
 
     return res;
   }
 
-  /* Benchmark start */
+  /**
+   * @brief The number of bytes occupied by the sketch, including the counter rows.
+   */
+  [[nodiscard]] auto footprint_bytes() const noexcept -> size_t {
+    return sizeof(*this) + 4 * k_width_ * sizeof(std::remove_pointer_t<decltype(data_)>);
+  }
+
+  [[nodiscard]] auto op_stats() const noexcept -> const Stats & { return stats_; }
+
   [[nodiscard]] auto update_time_avg_seconds() const -> double {
-    return total_update_time_seconds_ / update_count_;
+    return stats_.avg_seconds(SketchOp::UPDATE);
   }
   [[nodiscard]] auto estimate_time_avg_seconds() const -> double {
-    return total_estimate_time_seconds_ / estimate_count_;
+    return stats_.avg_seconds(SketchOp::ESTIMATE);
   }
-  /* Benchmark end */
 
 private:
   size_t k_width_;
@@ -235,14 +302,43 @@ private:
   uint32_t k_adapt_interval_;
   uint32_t adapt_counter_ = 0;
 
+  DecayClock k_clock_;
+  uint32_t now_ = 0;           // Latest timestamp seen (`DecayClock::SECONDS` only)
+  uint32_t epoch_start_ = 0;   // Timestamp of the last prune (`DecayClock::SECONDS` only)
+  uint32_t adapt_start_ = 0;   // Timestamp of the last adaptation (`DecayClock::SECONDS` only)
+  bool clock_started_ = false; // Whether a timestamp has been seen (`DecayClock::SECONDS` only)
+
   Adapter<double, double> *k_adapter_;
 
-  /* Benchmark start */
-  mutable size_t update_count_ = 0;
-  mutable double total_update_time_seconds_ = 0.0;
-  mutable size_t estimate_count_ = 0;
-  mutable double total_estimate_time_seconds_ = 0.0;
-  /* Benchmark end */
+  EventTrace *k_events_ = nullptr;
+
+  [[no_unique_address]] Stats stats_;
+
+  // Shared by the public constructors, which only differ in how they pick the width
+  EvolvingSketchOptim(const EvolvingSketchOptimOptions<F> &options, const size_t width)
+      : k_width_(width),
+        data_(aligned_alloc<std::remove_pointer_t<decltype(data_)>>(4 * k_width_)), k_f_(options.f),
+        k_adapter_(options.adapter), alpha_(options.initial_alpha),
+        k_adapt_interval_(options.adapt_interval), k_clock_(options.clock),
+        k_events_(options.events) {
+    if (!data_)
+      throw std::bad_alloc();
+
+    for (size_t i = 0; i < 4 * k_width_; i++)
+      data_[i] = 0;
+
+    auto gen = make_random_engine(options.seed);
+    for (auto &seed : seeds_)
+      seed = gen();
+  }
+
+  [[nodiscard]] static auto width_for(const MemoryBudget budget) -> size_t {
+    constexpr size_t row_bytes = sizeof(std::remove_pointer_t<decltype(data_)>);
+    if (budget.bytes < sizeof(EvolvingSketchOptim) + 4 * row_bytes)
+      throw std::invalid_argument("Memory budget of " + std::to_string(budget.bytes) +
+                                  " bytes is too small for a sketch");
+    return (budget.bytes - sizeof(EvolvingSketchOptim)) / (4 * row_bytes);
+  }
 
   void cleanup() {
     if (data_) {
@@ -251,31 +347,118 @@ private:
     }
   }
 
-  [[nodiscard]] auto alt_index(const size_t index, const size_t seed) const -> size_t {
-    // A quick and dirty way to generate an alternative index
-    // 0x5bd1e995 is the hash constant from MurmurHash2
-    return (index ^ (seed * 0x5bd1e995)) % k_width_;
+  /**
+   * @brief Compute the positions of the counters of `item` in each row.
+   */
+  void locate(const T &item, size_t (&positions)[4]) const {
+    const size_t h = hash(item);
+    for (size_t i = 0; i < 4; i++)
+      positions[i] = i * k_width_ + fastrange(row_hash(h, seeds_[i]), k_width_);
+  }
+
+  [[nodiscard]] auto min_counter(const size_t (&positions)[4]) const -> float {
+    auto res = std::numeric_limits<std::remove_pointer_t<decltype(data_)>>::max();
+    for (const size_t pos : positions)
+      res = std::min(res, data_[pos]);
+    return res;
+  }
+
+  /**
+   * @brief Add `weight` decayed units to the counters at `positions`, then prune or adapt if due.
+   */
+  void update_counters(const size_t (&positions)[4], const float weight) {
+    if (k_clock_ == DecayClock::UPDATES)
+      ++t_;
+    auto increment = weight * k_f_(t_, alpha_);
+
+    // Prune at most once if a counter would reach the threshold. When a prune cannot make room,
+    // counters saturate at the threshold instead of scanning the whole table for nothing
+    bool overflow = false;
+    for (const size_t pos : positions)
+      overflow |= data_[pos] >= PRUNE_THRESHOLD - increment;
+    if (overflow && prune_helps(weight)) {
+      if (k_clock_ == DecayClock::UPDATES) {
+        t_--;
+        prune(SketchEventType::PRUNE_OVERFLOW);
+        ++t_;
+      } else {
+        prune(SketchEventType::PRUNE_OVERFLOW);
+      }
+      increment = weight * k_f_(t_, alpha_);
+    }
+
+    for (const size_t pos : positions)
+      data_[pos] = std::min(data_[pos] + increment, PRUNE_THRESHOLD);
+
+    ++adapt_counter_;
+    if (k_adapt_interval_ && adapt_due())
+      adapt();
+  }
+
+  /**
+   * @brief Whether an overflow prune before adding `weight` makes room, i.e., whether it shrinks
+   * the counters (f(t) > 1) and the weight then fits on its own.
+   */
+  [[nodiscard]] auto prune_helps(const float weight) const -> bool {
+    // The clock by updates has already advanced for this update, which happens after the prune
+    const bool by_updates = k_clock_ == DecayClock::UPDATES;
+    return k_f_(by_updates ? t_ - 1 : t_, alpha_) > 1.0F &&
+           weight * k_f_(by_updates ? 1 : 0, alpha_) < PRUNE_THRESHOLD;
   }
 
   /**
    * @brief Periodically reset 't' and prune counters to avoid overflow.
+   *
+   * @param cause Why the prune happens, as recorded in the event trace
    */
-  void prune() {
+  void prune(const SketchEventType cause) {
+    const auto start_ns = k_events_ ? EventTrace::now() : 0;
     const auto d = k_f_(t_, alpha_);
     for (size_t i = 0; i < 4; i++)
       for (size_t j = 0; j < k_width_; j++)
         data_[i * k_width_ + j] /= d;
     t_ = 0;
+    epoch_start_ = now_;
+    record_event(cause, start_ns, 4 * k_width_, alpha_);
+  }
+
+  [[nodiscard]] auto adapt_due() const -> bool {
+    const uint32_t elapsed = k_clock_ == DecayClock::SECONDS ? now_ - adapt_start_ : adapt_counter_;
+    return elapsed >= k_adapt_interval_;
   }
 
   /**
    * @brief Periodically adapt alpha.
    */
   void adapt() {
-    prune();
-    const double normalized_sum = static_cast<double>(sum) / static_cast<double>(k_adapt_interval_);
+    prune(SketchEventType::PRUNE_ADAPT);
+
+    const auto start_ns = k_events_ ? EventTrace::now() : 0;
+    const auto old_alpha = alpha_;
+    // Normalize by the number of updates in this interval, which only equals `adapt_interval` when
+    // the interval is counted in updates
+    const double normalized_sum = static_cast<double>(sum) / static_cast<double>(adapt_counter_);
     sum = 0; // Reset for the next interval
     alpha_ = (*k_adapter_)(normalized_sum, alpha_);
     adapt_counter_ = 0;
+    adapt_start_ = now_;
+    record_event(SketchEventType::ADAPT, start_ns, 0, old_alpha, normalized_sum);
+  }
+
+  /**
+   * @brief Record an event that started at `start_ns` and ends now, if a trace is attached.
+   */
+  void record_event(const SketchEventType type, const uint64_t start_ns, const size_t counters,
+                    const double old_alpha,
+                    const double objective = std::numeric_limits<double>::quiet_NaN()) const {
+    if (!k_events_)
+      return;
+    k_events_->record({.type = type,
+                       .start_ns = start_ns,
+                       .duration_ns = EventTrace::now() - start_ns,
+                       .counters = counters,
+                       .old_alpha = old_alpha,
+                       .new_alpha = alpha_,
+                       .objective = objective});
   }
 };
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+/*
+ * Summary statistics and tests over repeated measurements of the same benchmark configuration.
+ */
+
+[[nodiscard]] inline auto mean(const std::vector<double> &samples) -> double {
+  if (samples.empty())
+    return std::numeric_limits<double>::quiet_NaN();
+  return std::accumulate(samples.begin(), samples.end(), 0.0) /
+         static_cast<double>(samples.size());
+}
+
+/**
+ * @brief The unbiased sample variance, or NaN with fewer than two samples.
+ */
+[[nodiscard]] inline auto sample_variance(const std::vector<double> &samples) -> double {
+  if (samples.size() < 2)
+    return std::numeric_limits<double>::quiet_NaN();
+  const double m = mean(samples);
+  double sum = 0.0;
+  for (const double x : samples)
+    sum += (x - m) * (x - m);
+  return sum / static_cast<double>(samples.size() - 1);
+}
+
+namespace detail {
+
+// The continued fraction of the regularized incomplete beta function (Numerical Recipes, 6.4)
+inline auto beta_continued_fraction(const double a, const double b, const double x) -> double {
+  constexpr int MAX_ITERATIONS = 300;
+  constexpr double EPSILON = 1e-14;
+  constexpr double TINY = 1e-300;
+
+  double c = 1.0;
+  double d = 1.0 - (a + b) * x / (a + 1.0);
+  if (std::abs(d) < TINY)
+    d = TINY;
+  d = 1.0 / d;
+  double h = d;
+  for (int m = 1; m <= MAX_ITERATIONS; m++) {
+    const double m2 = 2.0 * m;
+    double aa = m * (b - m) * x / ((a - 1.0 + m2) * (a + m2));
+    d = 1.0 + aa * d;
+    d = std::abs(d) < TINY ? TINY : d;
+    c = 1.0 + aa / c;
+    c = std::abs(c) < TINY ? TINY : c;
+    d = 1.0 / d;
+    h *= d * c;
+    aa = -(a + m) * (a + b + m) * x / ((a + m2) * (a + 1.0 + m2));
+    d = 1.0 + aa * d;
+    d = std::abs(d) < TINY ? TINY : d;
+    c = 1.0 + aa / c;
+    c = std::abs(c) < TINY ? TINY : c;
+    d = 1.0 / d;
+    const double delta = d * c;
+    h *= delta;
+    if (std::abs(delta - 1.0) < EPSILON)
+      break;
+  }
+  return h;
+}
+
+// The regularized incomplete beta function I_x(a, b)
+inline auto incomplete_beta(const double a, const double b, const double x) -> double {
+  if (x <= 0.0)
+    return 0.0;
+  if (x >= 1.0)
+    return 1.0;
+  const double front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) +
+                                a * std::log(x) + b * std::log1p(-x));
+  // The continued fraction converges quickly only on one side of the mean of the distribution
+  if (x < (a + 1.0) / (a + b + 2.0))
+    return front * beta_continued_fraction(a, b, x) / a;
+  return 1.0 - front * beta_continued_fraction(b, a, 1.0 - x) / b;
+}
+
+} // namespace detail
+
+/**
+ * @brief The probability that a Student's t variable with `df` degrees of freedom exceeds `|t|` in
+ * either direction.
+ */
+[[nodiscard]] inline auto student_t_two_sided_p(const double t, const double df) -> double {
+  if (std::isnan(t) || std::isnan(df) || df <= 0.0)
+    return std::numeric_limits<double>::quiet_NaN();
+  if (std::isinf(t))
+    return 0.0;
+  return detail::incomplete_beta(df / 2.0, 0.5, df / (df + t * t));
+}
+
+/**
+ * @brief The value that a Student's t variable with `df` degrees of freedom exceeds in either
+ * direction with probability `p`, e.g., about 2.0 for `p = 0.05` and many degrees of freedom.
+ */
+[[nodiscard]] inline auto student_t_critical(const double p, const double df) -> double {
+  // The p-value decreases with |t|, so bisect on it
+  double lo = 0.0;
+  double hi = 1.0;
+  while (student_t_two_sided_p(hi, df) > p && hi < 1e6)
+    hi *= 2.0;
+  for (int i = 0; i < 100; i++) {
+    const double mid = (lo + hi) / 2.0;
+    (student_t_two_sided_p(mid, df) > p ? lo : hi) = mid;
+  }
+  return (lo + hi) / 2.0;
+}
+
+/**
+ * @brief The half-width of the two-sided `confidence` interval of the mean of `samples`, from
+ * Student's t distribution, or NaN with fewer than two samples.
+ */
+[[nodiscard]] inline auto confidence_half_width(const std::vector<double> &samples,
+                                                const double confidence = 0.95) -> double {
+  if (samples.size() < 2)
+    return std::numeric_limits<double>::quiet_NaN();
+  const auto n = static_cast<double>(samples.size());
+  return student_t_critical(1.0 - confidence, n - 1.0) * std::sqrt(sample_variance(samples) / n);
+}
+
+struct WelchTest {
+  double t;
+  double df;
+  double p; // Two-sided, i.e., of the means differing in either direction
+};
+
+/**
+ * @brief Welch's t-test of whether the means of `a` and `b` differ, which does not assume equal
+ * variances. All fields are NaN with fewer than two samples on either side.
+ */
+[[nodiscard]] inline auto welch_t_test(const std::vector<double> &a, const std::vector<double> &b)
+    -> WelchTest {
+  constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+  if (a.size() < 2 || b.size() < 2)
+    return {.t = NaN, .df = NaN, .p = NaN};
+
+  const auto na = static_cast<double>(a.size());
+  const auto nb = static_cast<double>(b.size());
+  const double va = sample_variance(a) / na;
+  const double vb = sample_variance(b) / nb;
+  const double diff = mean(b) - mean(a);
+  if (va + vb == 0.0) {
+    // Identical repetitions, e.g., of a deterministic metric: any difference is significant
+    constexpr double INF = std::numeric_limits<double>::infinity();
+    const double t = diff == 0.0 ? 0.0 : std::copysign(INF, diff);
+    return {.t = t, .df = na + nb - 2.0, .p = diff == 0.0 ? 1.0 : 0.0};
+  }
+
+  const double t = diff / std::sqrt(va + vb);
+  const double df = (va + vb) * (va + vb) / (va * va / (na - 1.0) + vb * vb / (nb - 1.0));
+  return {.t = t, .df = df, .p = student_t_two_sided_p(t, df)};
+}
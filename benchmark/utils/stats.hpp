@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "../../src/utils/stats.hpp"
+
+// Stats policies selectable from the command line of benchmark tasks (see `with_stats()`)
+inline constexpr auto STATS_NONE = "none";
+inline constexpr auto STATS_COUNTING = "counting";
+inline constexpr auto STATS_SAMPLED = "sampled";
+inline constexpr auto STATS_FULL = "full";
+
+/**
+ * @brief Call `fn` with `std::type_identity<Stats>` for the stats policy called `name`, so that a
+ * benchmark task can pick the policy of its sketch at run time.
+ */
+template <typename Fn> auto with_stats(const std::string &name, Fn &&fn) {
+  if (name == STATS_NONE)
+    return fn(std::type_identity<NoStats>{});
+  if (name == STATS_COUNTING)
+    return fn(std::type_identity<CountingStats>{});
+  if (name == STATS_SAMPLED)
+    return fn(std::type_identity<SampledCycleStats<>>{});
+  if (name == STATS_FULL)
+    return fn(std::type_identity<SampledCycleStats<1>>{});
+  throw std::invalid_argument("Unknown stats policy: " + name);
+}
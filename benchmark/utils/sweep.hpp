@@ -0,0 +1,269 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "records.hpp"
+
+/*
+ * Parameter sweeps of the `caching` and `hm` benchmarks, described by a JSON specification such as
+ *
+ *   {
+ *     "benchmark": "caching",
+ *     "trace": "data/msr.oracleGeneral",
+ *     "algorithms": ["W-TinyLFU_CMS", "W-TinyLFU_EVO"],
+ *     "seeds": [1, 2, 3],
+ *     "sampling": "grid",
+ *     "cache_size_ratio": [0.001, 0.01, 0.1],
+ *     "alpha": [0.5, 1.0],
+ *     "adapt_interval": [1000, 10000]
+ *   }
+ *
+ * With "random" or "lhs" (Latin hypercube) sampling, "samples" points are drawn instead, where each
+ * parameter is either a list of values or a range such as {"min": 0.1, "max": 10, "log": true}.
+ * Caching sweeps replay dense object IDs with "dense_ids": true (see `--dense-ids`).
+ */
+
+/**
+ * @brief The values of one parameter of a sweep, i.e., a list or a range to draw from.
+ */
+struct SweepAxis {
+  std::vector<double> values;
+  double min = 0.0;
+  double max = 0.0;
+  bool log = false;
+
+  [[nodiscard]] auto is_range() const noexcept -> bool { return values.empty(); }
+
+  /**
+   * @brief The value at quantile `u` in [0, 1) of the axis.
+   */
+  [[nodiscard]] auto at(const double u) const -> double {
+    if (!is_range())
+      return values[std::min(static_cast<size_t>(u * static_cast<double>(values.size())),
+                              values.size() - 1)];
+    if (log)
+      return std::exp(std::log(min) + u * (std::log(max) - std::log(min)));
+    return min + u * (max - min);
+  }
+};
+
+inline void to_json(nlohmann::json &j, const SweepAxis &axis) {
+  j = axis.is_range() ? nlohmann::json{{"min", axis.min}, {"max", axis.max}, {"log", axis.log}}
+                      : nlohmann::json(axis.values);
+}
+
+inline void from_json(const nlohmann::json &j, SweepAxis &axis) {
+  if (j.is_array()) {
+    axis.values = j.get<std::vector<double>>();
+    if (axis.values.empty())
+      throw std::invalid_argument("A sweep parameter needs at least one value");
+    return;
+  }
+  axis.min = j.at("min").get<double>();
+  axis.max = j.at("max").get<double>();
+  axis.log = j.value("log", false);
+  if (axis.min > axis.max || (axis.log && axis.min <= 0.0))
+    throw std::invalid_argument("Invalid sweep range: " + j.dump());
+}
+
+struct SweepSpec {
+  std::string benchmark; // "caching" or "hm"
+  std::string trace;
+  std::vector<std::string> algorithms;
+  std::vector<uint64_t> seeds = {0};
+  std::string sampling = "grid"; // "grid", "random" or "lhs"
+  // The points drawn by "random" and "lhs", and their seed, so that resumed sweeps draw them again
+  size_t samples = 0;
+  uint64_t sampling_seed = 0;
+  SweepAxis cache_size_ratio;
+  SweepAxis alpha;
+  SweepAxis adapt_interval{.values = {10000}}; // Only used by evolving sketches
+  size_t top_k = 100;                          // Only used by `hm`
+  bool dense_ids = false;                      // Only used by `caching`, see `--dense-ids`
+  std::string stats = "sampled";
+
+  NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(SweepSpec, benchmark, trace, algorithms, seeds,
+                                              sampling, samples, sampling_seed, cache_size_ratio,
+                                              alpha, adapt_interval, top_k, dense_ids, stats)
+
+  [[nodiscard]] static auto load(const std::string &path) -> SweepSpec {
+    std::ifstream file(path);
+    if (!file.is_open())
+      throw std::runtime_error("Failed to open sweep specification: " + path);
+    SweepSpec spec;
+    try {
+      spec = nlohmann::json::parse(file).get<SweepSpec>();
+    } catch (const nlohmann::json::exception &e) {
+      throw std::runtime_error("Malformed sweep specification " + path + ": " + e.what());
+    }
+    if (spec.algorithms.empty() || spec.seeds.empty())
+      throw std::invalid_argument("A sweep needs at least one algorithm and one seed");
+    if (spec.dense_ids && spec.benchmark != "caching")
+      throw std::invalid_argument("Only caching sweeps replay dense IDs");
+    if (spec.sampling == "grid") {
+      for (const SweepAxis *axis : {&spec.cache_size_ratio, &spec.alpha, &spec.adapt_interval})
+        if (axis->is_range())
+          throw std::invalid_argument("Grid sweeps need lists of values, not ranges");
+    } else if (spec.sampling != "random" && spec.sampling != "lhs") {
+      throw std::invalid_argument("Unknown sampling: " + spec.sampling);
+    }
+    return spec;
+  }
+};
+
+/**
+ * @brief One run of a sweep. `adapt_interval` is 0 for algorithms that do not adapt.
+ */
+struct SweepPoint {
+  std::string algorithm;
+  double cache_size_ratio;
+  double alpha;
+  size_t adapt_interval;
+  uint64_t seed;
+
+  auto operator<=>(const SweepPoint &) const = default;
+};
+
+namespace detail {
+
+// A uniform draw in [0, 1) that does not depend on the standard library implementation, unlike
+// `std::uniform_real_distribution`, so that resumed sweeps draw the same points anywhere
+inline auto unit_draw(std::mt19937_64 &rng) -> double {
+  return static_cast<double>(rng() >> 11) * 0x1.0p-53;
+}
+
+// The quantiles of `samples` draws along one axis, one in each of `samples` equal strata, in random
+// order
+inline auto latin_hypercube_column(std::mt19937_64 &rng, const size_t samples)
+    -> std::vector<double> {
+  std::vector<double> column(samples);
+  for (size_t i = 0; i < samples; i++)
+    column[i] = (static_cast<double>(i) + unit_draw(rng)) / static_cast<double>(samples);
+  for (size_t i = samples; i > 1; i--)
+    std::swap(column[i - 1], column[rng() % i]);
+  return column;
+}
+
+} // namespace detail
+
+/**
+ * @brief The points of `spec`, every algorithm and seed at each combination of parameters, without
+ * duplicates (e.g., intervals of algorithms that do not adapt) and in a deterministic order.
+ */
+[[nodiscard]] inline auto
+expand_sweep(const SweepSpec &spec,
+             const std::function<bool(std::string_view algorithm)> &uses_adapt_interval)
+    -> std::vector<SweepPoint> {
+  // (cache_size_ratio, alpha, adapt_interval)
+  std::vector<std::tuple<double, double, double>> combinations;
+  if (spec.sampling == "grid") {
+    for (const double ratio : spec.cache_size_ratio.values)
+      for (const double alpha : spec.alpha.values)
+        for (const double interval : spec.adapt_interval.values)
+          combinations.emplace_back(ratio, alpha, interval);
+  } else {
+    std::mt19937_64 rng{spec.sampling_seed};
+    if (spec.sampling == "lhs") {
+      const auto ratios = detail::latin_hypercube_column(rng, spec.samples);
+      const auto alphas = detail::latin_hypercube_column(rng, spec.samples);
+      const auto intervals = detail::latin_hypercube_column(rng, spec.samples);
+      for (size_t i = 0; i < spec.samples; i++)
+        combinations.emplace_back(spec.cache_size_ratio.at(ratios[i]), spec.alpha.at(alphas[i]),
+                                  spec.adapt_interval.at(intervals[i]));
+    } else {
+      for (size_t i = 0; i < spec.samples; i++) {
+        const double ratio = spec.cache_size_ratio.at(detail::unit_draw(rng));
+        const double alpha = spec.alpha.at(detail::unit_draw(rng));
+        combinations.emplace_back(ratio, alpha, spec.adapt_interval.at(detail::unit_draw(rng)));
+      }
+    }
+  }
+
+  std::vector<SweepPoint> points;
+  std::set<SweepPoint> seen;
+  for (const auto &[ratio, alpha, interval] : combinations)
+    for (const auto &algorithm : spec.algorithms)
+      for (const uint64_t seed : spec.seeds) {
+        SweepPoint point{
+            .algorithm = algorithm,
+            .cache_size_ratio = ratio,
+            .alpha = alpha,
+            .adapt_interval = uses_adapt_interval(algorithm)
+                                  ? std::max<size_t>(1, static_cast<size_t>(std::llround(interval)))
+                                  : 0,
+            .seed = seed,
+        };
+        if (seen.insert(point).second)
+          points.push_back(std::move(point));
+      }
+  return points;
+}
+
+/**
+ * @brief The record of `point` of `spec` without its metrics, i.e., what identifies the point in
+ * the result file of the sweep, where `name` names its results (e.g., "W-TinyLFU_EVO (Ia=10000)")
+ * and `cache_size` is its cache size in objects.
+ */
+[[nodiscard]] inline auto sweep_record(const SweepSpec &spec, const SweepPoint &point,
+                                       std::string name, const size_t cache_size)
+    -> ResultRecord {
+  ResultRecord record{
+      .benchmark = spec.benchmark,
+      .name = std::move(name),
+      .params = {{"trace", spec.trace},
+                 {"cache_size_ratio", std::format("{}", point.cache_size_ratio)},
+                 {"cache_size", std::to_string(cache_size)},
+                 {"alpha", std::format("{}", point.alpha)},
+                 {"stats", spec.stats},
+                 {"seed", std::to_string(point.seed)}},
+  };
+  if (spec.benchmark == "hm")
+    record.params["top_k"] = std::to_string(spec.top_k);
+  // Like the caching benchmark, which records it only when set
+  if (spec.dense_ids)
+    record.params["dense_ids"] = "true";
+  return record;
+}
+
+/**
+ * @brief The indices of the `records` of the points of a sweep (see `sweep_record()`) that
+ * `completed` holds no result of, in order.
+ *
+ * Points are matched by their configuration and seed, so resuming relies on expanding the same
+ * specification to the same points and formatting them the same way.
+ */
+[[nodiscard]] inline auto pending_sweep_records(const std::vector<ResultRecord> &records,
+                                                const std::vector<ResultRecord> &completed)
+    -> std::vector<size_t> {
+  // Repetitions share a configuration, so the seed tells them apart
+  auto point_key = [](const ResultRecord &record) {
+    const auto seed = record.params.find("seed");
+    return std::format("{} seed={}", record.configuration(),
+                       seed == record.params.end() ? "" : seed->second);
+  };
+
+  std::set<std::string> completed_keys;
+  for (const auto &record : completed)
+    completed_keys.insert(point_key(record));
+  std::vector<size_t> pending;
+  for (size_t i = 0; i < records.size(); i++)
+    if (!completed_keys.contains(point_key(records[i])))
+      pending.push_back(i);
+  return pending;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * @brief Draw keys from `n` distinct ones, where the key of rank `i` (from 1) is drawn with a
+ * probability proportional to `1 / i^theta`. A `theta` of 0 gives the uniform distribution.
+ *
+ * Ranks are drawn by a binary search over the precomputed CDF, and mapped to scattered keys so that
+ * hot keys are not adjacent integers.
+ */
+class ZipfGenerator {
+public:
+  ZipfGenerator(const size_t n, const double theta) : cdf_(n) {
+    if (n == 0)
+      throw std::invalid_argument("Zipf generator needs at least one key");
+    if (theta < 0.0)
+      throw std::invalid_argument("Zipf exponent must be non-negative");
+
+    double sum = 0.0;
+    for (size_t i = 0; i < n; i++) {
+      sum += 1.0 / std::pow(static_cast<double>(i + 1), theta);
+      cdf_[i] = sum;
+    }
+    for (auto &p : cdf_)
+      p /= sum;
+  }
+
+  template <typename Rng> auto operator()(Rng &rng) const -> uint64_t {
+    const double u = std::uniform_real_distribution<double>{0.0, 1.0}(rng);
+    const auto rank = static_cast<uint64_t>(std::ranges::lower_bound(cdf_, u) - cdf_.begin());
+    return key_of(std::min<uint64_t>(rank, cdf_.size() - 1));
+  }
+
+  /**
+   * @brief Draw `count` keys at once, e.g., to keep the generator out of timed loops.
+   */
+  template <typename Rng>
+  auto generate(const size_t count, Rng &rng) const -> std::vector<uint64_t> {
+    std::vector<uint64_t> keys(count);
+    for (auto &key : keys)
+      key = (*this)(rng);
+    return keys;
+  }
+
+private:
+  std::vector<double> cdf_;
+
+  // A bijection on 64-bit integers (the finalizer of SplitMix64)
+  [[nodiscard]] static constexpr auto key_of(uint64_t rank) noexcept -> uint64_t {
+    rank = (rank ^ (rank >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    rank = (rank ^ (rank >> 27)) * 0x94d049bb133111ebULL;
+    return rank ^ (rank >> 31);
+  }
+};
@@ -5,28 +5,34 @@
 #include <cstddef>
 #include <functional>
 #include <iterator>
+#include <optional>
 #include <random>
 #include <utility>
 #include <variant>
 #include <vector>
 
+#include "../utils/random.hpp"
 #include "adapter.hpp"
 
 inline constexpr double EPSILON = 0.1; // Exploration rate
 
 class EpsilonGreedyAdapter : public Adapter<double, double> {
 public:
+  /**
+   * @param seed The seed of the exploration, drawn from `std::random_device` if unset.
+   */
   explicit EpsilonGreedyAdapter(
       double min_param, double max_param, size_t num_arms, double epsilon = EPSILON,
       std::variant<double, std::function<double(const size_t n)>> step =
-          [](const size_t n) { return 1.0 / static_cast<double>(n); })
+          [](const size_t n) { return 1.0 / static_cast<double>(n); },
+      const std::optional<uint64_t> seed = std::nullopt)
       : k_num_arms_(num_arms), k_epsilon_(epsilon),
         k_is_step_constant_(std::holds_alternative<double>(step)),
         k_step_constant_(k_is_step_constant_ ? std::get<double>(step) : 0.0),
         k_step_function_(k_is_step_constant_
                              ? nullptr
                              : std::move(std::get<std::function<double(const size_t n)>>(step))),
-        int_dist_{0, k_num_arms_ - 1} {
+        rng_(make_random_engine(seed)), int_dist_{0, k_num_arms_ - 1} {
     arms_.resize(k_num_arms_);
     estimates_.resize(k_num_arms_, 0.0);
     updated_counts_.resize(k_num_arms_, 0);
@@ -46,9 +52,7 @@ public:
 
 protected:
   auto disturb_param(const double & /*param*/) -> double override {
-    std::mt19937 rng(std::random_device{}());
-    std::uniform_int_distribution<size_t> dist(0, k_num_arms_ - 1);
-    current_arm_ = dist(rng);
+    current_arm_ = int_dist_(rng_);
     return arms_[current_arm_];
   }
 
@@ -85,7 +89,7 @@ private:
 
   size_t current_arm_ = 0;
 
-  mutable std::mt19937 rng_{std::random_device{}()};
+  mutable std::mt19937 rng_;
   mutable std::uniform_real_distribution<double> real_dist_{0.0, 1.0};
   mutable std::uniform_int_distribution<size_t> int_dist_;
 
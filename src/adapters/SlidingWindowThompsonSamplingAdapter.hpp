@@ -1,9 +1,12 @@
 #pragma once
 
+#include <cstdint>
 #include <deque>
+#include <optional>
 #include <random>
 #include <vector>
 
+#include "../utils/random.hpp"
 #include "adapter.hpp"
 
 inline constexpr double MIN_PARAM = 0.1;
@@ -67,12 +70,15 @@ private:
   };
 
 public:
-  explicit SlidingWindowThompsonSamplingAdapter(const double min_param = MIN_PARAM,
-                                                const double max_param = MAX_PARAM,
-                                                const size_t num_arms = NUM_ARMS,
-                                                const double reward_scaling = REWARD_SCALING,
-                                                const size_t window_size = WINDOW_SIZE)
-      : k_num_arms_(num_arms), k_reward_scaling_(reward_scaling) {
+  /**
+   * @param seed The seed of the sampling, drawn from `std::random_device` if unset.
+   */
+  explicit SlidingWindowThompsonSamplingAdapter(
+      const double min_param = MIN_PARAM, const double max_param = MAX_PARAM,
+      const size_t num_arms = NUM_ARMS, const double reward_scaling = REWARD_SCALING,
+      const size_t window_size = WINDOW_SIZE, const std::optional<uint64_t> seed = std::nullopt)
+      : k_num_arms_(num_arms), k_reward_scaling_(reward_scaling),
+        rng_(make_random_engine(seed)) {
 
     arms_.resize(k_num_arms_);
     arm_histories_.resize(k_num_arms_, ArmHistory(window_size));
@@ -127,7 +133,7 @@ private:
   size_t current_arm_ = 0;
   size_t total_pulls_ = 0;
 
-  std::mt19937 rng_ = std::mt19937(std::random_device{}());
+  std::mt19937 rng_;
 
   [[nodiscard]] auto sample_thompson_arm() -> size_t {
     size_t best_arm = 0;
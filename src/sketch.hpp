@@ -1,23 +1,82 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <bit>
+#include <compare>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <limits>
-#include <random>
+#include <optional>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
 #include <variant>
 
 #include "utils/hash.hpp"
 #include "utils/memory.hpp"
-#include "utils/time.hpp"
+#include "utils/random.hpp"
+#include "utils/stats.hpp"
+#include "utils/trace.hpp"
 
 template <typename E> struct IdentityAdapter {
   constexpr double operator()(E & /*e*/, double alpha) const noexcept { return alpha; }
 };
 
+/**
+ * @brief The unit in which the decay clock `t` advances.
+ */
+enum class DecayClock : uint8_t {
+  UPDATES, // `t` advances by one on each update
+  SECONDS, // `t` advances by the seconds elapsed between request timestamps (see `update_at()`)
+};
+
+/**
+ * @brief When a sketch resizes itself, judged at each prune by its load, i.e., the fraction of
+ * counters still holding at least one (decayed) unit.
+ */
+struct AutoResizePolicy {
+  size_t min_width = 8;
+  size_t max_width = size_t{1} << 24;
+  double grow_load = 0.75; // Double the width when the load exceeds this
+  // Halve the width when the load it would have once folded stays below this. Judging the folded
+  // load rather than the current one keeps a shrink from immediately calling for a grow
+  double shrink_load = 0.5;
+  // Prunes to skip after a resize, as the moved counters still reflect the load before it
+  uint32_t cooldown = 4;
+};
+
+/**
+ * @brief The distribution of the counters of one row, in units of estimates.
+ */
+struct RowDistribution {
+  float mean;
+  float p50;
+  float p90;
+  float p99;
+  float max;
+};
+
+/**
+ * @brief A snapshot of the health of a sketch, see `EvolvingSketch::stats()`.
+ */
+struct SketchStats {
+  // Fraction of counters holding at least one (decayed) unit. A load close to 1 means that most
+  // items share their counters with others, i.e., the sketch is undersized
+  double load;
+  std::array<RowDistribution, 4> rows;
+  uint64_t updates;
+  uint64_t overflow_prunes;
+  uint64_t adapt_prunes;
+  // Average number of updates between two prunes caused by overflow, or 0 if there was none yet
+  double updates_per_overflow_prune;
+  double alpha;
+  uint32_t t;
+  size_t width;
+  size_t footprint_bytes;
+};
+
 template <typename F, typename E = std::monostate, typename Adapter = IdentityAdapter<E>>
   requires std::is_invocable_r_v<float, F, uint32_t, double> &&
            std::is_invocable_r_v<double, Adapter, E &, double>
@@ -25,11 +84,19 @@ struct EvolvingSketchOptions {
   double initial_alpha = 1.0;
   F f;
   Adapter adapter;
+  // Counted in updates for `DecayClock::UPDATES`, and in seconds for `DecayClock::SECONDS`
   uint32_t adapt_interval = 0;
+  DecayClock clock = DecayClock::UPDATES;
+  std::optional<AutoResizePolicy> auto_resize = std::nullopt;
+  // Where to record prunes, adaptations and resizes, if anywhere. Copies of the sketch record
+  // nothing
+  EventTrace *events = nullptr;
+  // The seed of the row hashes, drawn from `std::random_device` if unset
+  std::optional<uint64_t> seed = std::nullopt;
 };
 
 template <typename T, typename F, typename E = std::monostate,
-          typename Adapter = IdentityAdapter<E>>
+          typename Adapter = IdentityAdapter<E>, typename Stats = NoStats>
   requires std::is_invocable_r_v<float, F, uint32_t, double> &&
            std::is_invocable_r_v<double, Adapter, E &, double>
 class EvolvingSketch {
@@ -38,25 +105,23 @@ private:
   // This is the max safe threshold where +1 would not be omitted
   static constexpr float PRUNE_THRESHOLD = 16777215.0F;
 
+  // Counters sampled from each row by `stats()`
+  static constexpr size_t STATS_SAMPLES_PER_ROW = 256;
+
 public:
   // NOLINTNEXTLINE
   E external_metrics;
 
   explicit EvolvingSketch(const size_t size, const EvolvingSketchOptions<F, E, Adapter> &options)
-      : k_width_(std::bit_ceil(std::max(size / 4, 8UZ))),
-        data_(aligned_alloc<std::remove_pointer_t<decltype(data_)>>(4 * k_width_)), k_f_(options.f),
-        k_adapter_(options.adapter), alpha_(options.initial_alpha),
-        k_adapt_interval_(options.adapt_interval) {
-    if (!data_)
-      throw std::bad_alloc();
+      : EvolvingSketch(options, std::bit_ceil(std::max(size / 4, 8UZ))) {}
 
-    for (size_t i = 0; i < 4 * k_width_; i++)
-      data_[i] = 0;
-
-    std::mt19937 gen{std::random_device{}()};
-    for (auto &seed : seeds_)
-      seed = gen();
-  }
+  /**
+   * @brief Construct a sketch that occupies at most `budget` in total (see `footprint_bytes()`),
+   * using the widest rows that fit instead of rounding the width to a power of two.
+   */
+  explicit EvolvingSketch(const MemoryBudget budget,
+                          const EvolvingSketchOptions<F, E, Adapter> &options)
+      : EvolvingSketch(options, width_for(budget)) {}
 
   ~EvolvingSketch() { cleanup(); }
 
@@ -64,7 +129,12 @@ public:
       : k_width_(other.k_width_),
         data_(aligned_alloc<std::remove_pointer_t<decltype(data_)>>(4 * k_width_)),
         k_f_(other.k_f_), k_adapter_(other.k_adapter_), alpha_(other.alpha_),
-        k_adapt_interval_(other.k_adapt_interval_) {
+        k_adapt_interval_(other.k_adapt_interval_), k_clock_(other.k_clock_), now_(other.now_),
+        epoch_start_(other.epoch_start_), adapt_start_(other.adapt_start_),
+        clock_started_(other.clock_started_), k_auto_resize_(other.k_auto_resize_),
+        resize_cooldown_(other.resize_cooldown_), pending_resize_(other.pending_resize_),
+        updates_(other.updates_), overflow_prunes_(other.overflow_prunes_),
+        adapt_prunes_(other.adapt_prunes_) {
     if (!data_)
       throw std::bad_alloc();
 
@@ -81,7 +151,12 @@ public:
   EvolvingSketch(EvolvingSketch &&other) noexcept
       : k_width_(other.k_width_), data_(other.data_), k_f_(std::move(other.k_f_)),
         k_adapter_(std::move(other.k_adapter_)), alpha_(other.alpha_),
-        k_adapt_interval_(other.k_adapt_interval_) {
+        k_adapt_interval_(other.k_adapt_interval_), k_clock_(other.k_clock_), now_(other.now_),
+        epoch_start_(other.epoch_start_), adapt_start_(other.adapt_start_),
+        clock_started_(other.clock_started_), k_auto_resize_(other.k_auto_resize_),
+        resize_cooldown_(other.resize_cooldown_), pending_resize_(other.pending_resize_),
+        updates_(other.updates_), overflow_prunes_(other.overflow_prunes_),
+        adapt_prunes_(other.adapt_prunes_), k_events_(other.k_events_) {
     for (size_t i = 0; i < 4; i++)
       seeds_[i] = other.seeds_[i];
 
@@ -90,6 +165,7 @@ public:
     other.alpha_ = 0.0;
     other.k_adapt_interval_ = 0;
     other.adapt_counter_ = 0;
+    other.k_events_ = nullptr;
   }
 
   auto operator=(const EvolvingSketch &other) -> EvolvingSketch & {
@@ -118,6 +194,17 @@ public:
     alpha_ = other.alpha_;
     k_adapt_interval_ = other.k_adapt_interval_;
     adapt_counter_ = other.adapt_counter_;
+    k_clock_ = other.k_clock_;
+    now_ = other.now_;
+    epoch_start_ = other.epoch_start_;
+    adapt_start_ = other.adapt_start_;
+    clock_started_ = other.clock_started_;
+    k_auto_resize_ = other.k_auto_resize_;
+    resize_cooldown_ = other.resize_cooldown_;
+    pending_resize_ = other.pending_resize_;
+    updates_ = other.updates_;
+    overflow_prunes_ = other.overflow_prunes_;
+    adapt_prunes_ = other.adapt_prunes_;
 
     return *this;
   }
@@ -135,6 +222,18 @@ public:
     alpha_ = other.alpha_;
     k_adapt_interval_ = other.k_adapt_interval_;
     adapt_counter_ = other.adapt_counter_;
+    k_clock_ = other.k_clock_;
+    now_ = other.now_;
+    epoch_start_ = other.epoch_start_;
+    adapt_start_ = other.adapt_start_;
+    clock_started_ = other.clock_started_;
+    k_auto_resize_ = other.k_auto_resize_;
+    resize_cooldown_ = other.resize_cooldown_;
+    pending_resize_ = other.pending_resize_;
+    updates_ = other.updates_;
+    overflow_prunes_ = other.overflow_prunes_;
+    adapt_prunes_ = other.adapt_prunes_;
+    k_events_ = other.k_events_;
 
     for (size_t i = 0; i < 4; i++)
       seeds_[i] = other.seeds_[i];
@@ -144,81 +243,245 @@ public:
     other.alpha_ = 0.0;
     other.k_adapt_interval_ = 0;
     other.adapt_counter_ = 0;
+    other.k_events_ = nullptr;
 
     return *this;
   }
 
-  void update(const T &item) {
-    const auto start = get_current_time_in_seconds();
-
-  retry_update:
-    const auto increment = k_f_(++t_, alpha_);
-
-    // For rollback if overflow detected
-    size_t counter_positions[4];
-    float original_counters[4];
-
-    // Increment counters
-    bool overflow_detected = false;
-    size_t index = hash(item) % k_width_;
-    size_t i;
-    for (i = 0; i < 4; i++) {
-      if (i > 0)
-        index = alt_index(index, seeds_[i]);
-      const size_t pos = i * k_width_ + index;
-      auto &v = data_[pos];
-      if (v > PRUNE_THRESHOLD - increment) {
-        overflow_detected = true;
-        break;
-      }
-      counter_positions[i] = pos;
-      original_counters[i] = v;
-      v += increment;
-    }
+  void update(const T &item) { update(item, 1.0F); }
 
-    // If overflow detected, rollback written counters
-    if (overflow_detected) {
-      for (size_t j = 0; j < i; j++)
-        data_[counter_positions[j]] = original_counters[j];
-      t_--;
-      prune();
-      // NOLINTNEXTLINE(cppcoreguidelines-avoid-goto)
-      goto retry_update;
-    }
+  /**
+   * @brief Update `item` by `weight` (non-negative) units at once, which is equivalent to `weight`
+   * unit updates made at the same time, e.g., for pre-aggregated counts or byte-weighted
+   * frequencies. Counters prune before reaching 2^24 - 1 decayed units, where a float still counts
+   * by one, and saturate there only when pruning cannot make room (i.e., without decay, or for a
+   * weight that alone exceeds it).
+   */
+  void update(const T &item, const float weight) {
+    [[maybe_unused]] const auto scope = stats_.measure(SketchOp::UPDATE);
 
-    if (k_adapt_interval_ && ++adapt_counter_ >= k_adapt_interval_)
-      adapt();
+    size_t positions[4];
+    locate(item, positions);
+    update_counters(positions, weight);
+  }
+
+  /**
+   * @brief Update `item` by `weight` and return its estimate after the update, which is cheaper
+   * than calling `update()` and `estimate()` in a row as the counters are only located once.
+   *
+   * Counted as an update by the stats policy.
+   */
+  auto update_and_estimate(const T &item, const float weight = 1.0F) -> float {
+    [[maybe_unused]] const auto scope = stats_.measure(SketchOp::UPDATE);
+
+    size_t positions[4];
+    locate(item, positions);
+    update_counters(positions, weight);
+    const auto res = min_counter(positions) / k_f_(t_, alpha_);
+
+    return res;
+  }
+
+  /**
+   * @brief Advance the decay clock to `timestamp` (in seconds) and then update `item` by `weight`.
+   *
+   * Only meaningful with `DecayClock::SECONDS`; with `DecayClock::UPDATES` the timestamp is
+   * ignored.
+   */
+  void update_at(const T &item, const uint32_t timestamp, const float weight = 1.0F) {
+    advance_to(timestamp);
+    update(item, weight);
+  }
+
+  /**
+   * @brief Advance the decay clock to `timestamp` (in seconds) without updating any item.
+   *
+   * The first timestamp seen becomes the origin of the clock. Timestamps earlier than the latest
+   * one seen do not move the clock backwards. Has no effect with `DecayClock::UPDATES`.
+   */
+  void advance_to(const uint32_t timestamp) {
+    if (k_clock_ != DecayClock::SECONDS)
+      return;
+
+    if (!clock_started_) {
+      now_ = epoch_start_ = adapt_start_ = timestamp;
+      clock_started_ = true;
+    } else if (timestamp > now_) {
+      now_ = timestamp;
+    }
 
-    total_update_time_seconds_ += get_current_time_in_seconds() - start;
-    update_count_++;
+    // Counters are only rescaled on prune, so `t` is the time elapsed since the last prune
+    t_ = now_ - epoch_start_;
   }
 
   [[nodiscard]] auto estimate(const T &item) const -> float {
-    const auto start = get_current_time_in_seconds();
+    [[maybe_unused]] const auto scope = stats_.measure(SketchOp::ESTIMATE);
 
-    auto res = std::numeric_limits<std::remove_pointer_t<decltype(data_)>>::max();
-    size_t index = hash(item) % k_width_;
+    size_t positions[4];
+    locate(item, positions);
+    // All counters share the same positive divisor, so it suffices to divide their minimum
+    const auto res = min_counter(positions) / k_f_(t_, alpha_);
+
+    return res;
+  }
+
+  /**
+   * @brief Compare the estimates of `a` and `b`, probing the counters of both items at once.
+   *
+   * Counted as a single estimate by the stats policy.
+   */
+  [[nodiscard]] auto compare(const T &a, const T &b) const -> std::partial_ordering {
+    [[maybe_unused]] const auto scope = stats_.measure(SketchOp::ESTIMATE);
+
+    size_t positions_a[4];
+    size_t positions_b[4];
+    locate(a, positions_a);
+    locate(b, positions_b);
     for (size_t i = 0; i < 4; i++) {
-      if (i > 0)
-        index = alt_index(index, seeds_[i]);
-      const size_t pos = i * k_width_ + index;
-      res = std::min(res, data_[pos] / k_f_(t_, alpha_));
+      prefetch(&data_[positions_a[i]]);
+      prefetch(&data_[positions_b[i]]);
     }
+    // Both estimates share the same positive divisor, so comparing the raw counters suffices
+    const auto res = min_counter(positions_a) <=> min_counter(positions_b);
+
+    return res;
+  }
+
+  /**
+   * @brief Halve the width (rounded down) by adding each column into the columns that its items
+   * map to once halved. Estimates can only grow, as merged columns add to the minimum.
+   *
+   * Under `fastrange()`, the items of column `j` map to columns `j * w' / w` up to
+   * `((j + 1) * w' - 1) / w` of width `w'`. For even widths that is exactly column `j / 2`, so the
+   * fold merely sums adjacent columns; for odd widths, a column straddling two halved columns is
+   * added to both, which keeps every estimate an upper bound.
+   *
+   * The halved rows are allocated anew rather than folded in place, so that the memory is released.
+   * Folded counters beyond the pruning threshold prune the sketch, and saturate at the threshold if
+   * that cannot make room.
+   */
+  void shrink() {
+    const auto start_ns = k_events_ ? EventTrace::now() : 0;
+    const size_t width = std::max(k_width_ / 2, 1UZ);
+    auto *data = aligned_alloc<std::remove_pointer_t<decltype(data_)>>(4 * width);
+    if (!data)
+      throw std::bad_alloc();
+
+    bool overflow = false;
+    for (size_t i = 0; i < 4; i++) {
+      float *row = data + i * width;
+      std::fill_n(row, width, 0.0F);
+      for (size_t j = 0; j < k_width_; j++) {
+        const auto value = data_[i * k_width_ + j];
+        for (size_t k = j * width / k_width_; k <= ((j + 1) * width - 1) / k_width_; k++) {
+          row[k] += value;
+          overflow |= row[k] > PRUNE_THRESHOLD;
+        }
+      }
+    }
+
+    cleanup();
+    data_ = data;
+    k_width_ = width;
+    record_event(SketchEventType::SHRINK, start_ns, 4 * k_width_, alpha_);
+
+    if (!overflow)
+      return;
+    if (k_f_(t_, alpha_) > 1.0F)
+      prune(SketchEventType::PRUNE_OVERFLOW);
+    for (size_t i = 0; i < 4 * k_width_; i++)
+      data_[i] = std::min(data_[i], PRUNE_THRESHOLD);
+  }
+
+  /**
+   * @brief Double the width by duplicating each column into the two columns it splits into. Every
+   * estimate is kept unchanged, while items updated from now on collide less.
+   */
+  void grow() {
+    const auto start_ns = k_events_ ? EventTrace::now() : 0;
+    const size_t width = k_width_ * 2;
+    auto *data = aligned_alloc<std::remove_pointer_t<decltype(data_)>>(4 * width);
+    if (!data)
+      throw std::bad_alloc();
+
+    for (size_t i = 0; i < 4; i++)
+      for (size_t j = 0; j < k_width_; j++)
+        data[i * width + 2 * j] = data[i * width + 2 * j + 1] = data_[i * k_width_ + j];
 
-    total_estimate_time_seconds_ += get_current_time_in_seconds() - start;
-    estimate_count_++;
+    cleanup();
+    data_ = data;
+    k_width_ = width;
+    record_event(SketchEventType::GROW, start_ns, 4 * k_width_, alpha_);
+  }
+
+  [[nodiscard]] auto width() const noexcept -> size_t { return k_width_; }
+
+  /**
+   * @brief The number of bytes occupied by the sketch, including the counter rows.
+   */
+  [[nodiscard]] auto footprint_bytes() const noexcept -> size_t {
+    return sizeof(*this) + 4 * k_width_ * sizeof(std::remove_pointer_t<decltype(data_)>);
+  }
+
+  /**
+   * @brief Report the load and counter distribution of the sketch along with its prune history,
+   * to tell whether it is undersized.
+   *
+   * Only `STATS_SAMPLES_PER_ROW` evenly spaced counters of each row are read, which represent the
+   * row as well as random ones would since items are hashed to columns, so the cost does not grow
+   * with the width.
+   */
+  [[nodiscard]] auto stats() const -> SketchStats {
+    SketchStats res{
+        .load = 0.0,
+        .rows = {},
+        .updates = updates_,
+        .overflow_prunes = overflow_prunes_,
+        .adapt_prunes = adapt_prunes_,
+        .updates_per_overflow_prune = 0.0,
+        .alpha = alpha_,
+        .t = t_,
+        .width = k_width_,
+        .footprint_bytes = footprint_bytes(),
+    };
+
+    const size_t samples = std::min(k_width_, STATS_SAMPLES_PER_ROW);
+    const auto d = k_f_(t_, alpha_);
+    std::array<float, STATS_SAMPLES_PER_ROW> values;
+    size_t loaded = 0;
+    for (size_t i = 0; i < 4; i++) {
+      double sum = 0.0;
+      for (size_t k = 0; k < samples; k++) {
+        values[k] = data_[i * k_width_ + k * k_width_ / samples] / d;
+        sum += values[k];
+        loaded += values[k] >= 1.0F;
+      }
+      std::sort(values.begin(), values.begin() + samples);
+      auto at = [&](const double quantile) {
+        return values[std::min(samples - 1, static_cast<size_t>(quantile * samples))];
+      };
+      res.rows[i] = {.mean = static_cast<float>(sum / static_cast<double>(samples)),
+                     .p50 = at(0.5),
+                     .p90 = at(0.9),
+                     .p99 = at(0.99),
+                     .max = values[samples - 1]};
+    }
+    res.load = static_cast<double>(loaded) / static_cast<double>(4 * samples);
+    if (overflow_prunes_ > 0)
+      res.updates_per_overflow_prune =
+          static_cast<double>(updates_) / static_cast<double>(overflow_prunes_);
 
     return res;
   }
 
-  /* Benchmark start */
+  [[nodiscard]] auto op_stats() const noexcept -> const Stats & { return stats_; }
+
   [[nodiscard]] auto update_time_avg_seconds() const -> double {
-    return total_update_time_seconds_ / update_count_;
+    return stats_.avg_seconds(SketchOp::UPDATE);
   }
   [[nodiscard]] auto estimate_time_avg_seconds() const -> double {
-    return total_estimate_time_seconds_ / estimate_count_;
+    return stats_.avg_seconds(SketchOp::ESTIMATE);
   }
-  /* Benchmark end */
 
 private:
   size_t k_width_;
@@ -233,14 +496,51 @@ private:
   uint32_t k_adapt_interval_;
   uint32_t adapt_counter_ = 0;
 
+  DecayClock k_clock_;
+  uint32_t now_ = 0;           // Latest timestamp seen (`DecayClock::SECONDS` only)
+  uint32_t epoch_start_ = 0;   // Timestamp of the last prune (`DecayClock::SECONDS` only)
+  uint32_t adapt_start_ = 0;   // Timestamp of the last adaptation (`DecayClock::SECONDS` only)
+  bool clock_started_ = false; // Whether a timestamp has been seen (`DecayClock::SECONDS` only)
+
   Adapter k_adapter_;
 
-  /* Benchmark start */
-  mutable size_t update_count_ = 0;
-  mutable double total_update_time_seconds_ = 0.0;
-  mutable size_t estimate_count_ = 0;
-  mutable double total_estimate_time_seconds_ = 0.0;
-  /* Benchmark end */
+  std::optional<AutoResizePolicy> k_auto_resize_;
+  uint32_t resize_cooldown_ = 0;
+  int8_t pending_resize_ = 0; // 1 to grow, -1 to shrink, decided at the last prune
+
+  uint64_t updates_ = 0;
+  uint64_t overflow_prunes_ = 0;
+  uint64_t adapt_prunes_ = 0;
+
+  EventTrace *k_events_ = nullptr;
+
+  [[no_unique_address]] Stats stats_;
+
+  // Shared by the public constructors, which only differ in how they pick the width
+  EvolvingSketch(const EvolvingSketchOptions<F, E, Adapter> &options, const size_t width)
+      : k_width_(width),
+        data_(aligned_alloc<std::remove_pointer_t<decltype(data_)>>(4 * k_width_)), k_f_(options.f),
+        k_adapter_(options.adapter), alpha_(options.initial_alpha),
+        k_adapt_interval_(options.adapt_interval), k_clock_(options.clock),
+        k_auto_resize_(options.auto_resize), k_events_(options.events) {
+    if (!data_)
+      throw std::bad_alloc();
+
+    for (size_t i = 0; i < 4 * k_width_; i++)
+      data_[i] = 0;
+
+    auto gen = make_random_engine(options.seed);
+    for (auto &seed : seeds_)
+      seed = gen();
+  }
+
+  [[nodiscard]] static auto width_for(const MemoryBudget budget) -> size_t {
+    constexpr size_t row_bytes = sizeof(std::remove_pointer_t<decltype(data_)>);
+    if (budget.bytes < sizeof(EvolvingSketch) + 4 * row_bytes)
+      throw std::invalid_argument("Memory budget of " + std::to_string(budget.bytes) +
+                                  " bytes is too small for a sketch");
+    return (budget.bytes - sizeof(EvolvingSketch)) / (4 * row_bytes);
+  }
 
   void cleanup() {
     if (data_) {
@@ -249,29 +549,170 @@ private:
     }
   }
 
-  [[nodiscard]] auto alt_index(const size_t index, const size_t seed) const -> size_t {
-    // A quick and dirty way to generate an alternative index
-    // 0x5bd1e995 is the hash constant from MurmurHash2
-    return (index ^ (seed * 0x5bd1e995)) % k_width_;
+  /**
+   * @brief Compute the positions of the counters of `item` in each row.
+   */
+  void locate(const T &item, size_t (&positions)[4]) const {
+    const size_t h = hash(item);
+    for (size_t i = 0; i < 4; i++)
+      positions[i] = i * k_width_ + fastrange(row_hash(h, seeds_[i]), k_width_);
+  }
+
+  [[nodiscard]] auto min_counter(const size_t (&positions)[4]) const -> float {
+    auto res = std::numeric_limits<std::remove_pointer_t<decltype(data_)>>::max();
+    for (const size_t pos : positions)
+      res = std::min(res, data_[pos]);
+    return res;
+  }
+
+  /**
+   * @brief Add `weight` decayed units to the counters at `positions`, then prune or adapt if due.
+   */
+  void update_counters(const size_t (&positions)[4], const float weight) {
+    if (k_clock_ == DecayClock::UPDATES)
+      ++t_;
+    auto increment = weight * k_f_(t_, alpha_);
+
+    // Prune at most once if a counter would reach the threshold. When a prune cannot make room,
+    // counters saturate at the threshold instead of scanning the whole table for nothing
+    bool overflow = false;
+    for (const size_t pos : positions)
+      overflow |= data_[pos] >= PRUNE_THRESHOLD - increment;
+    if (overflow && prune_helps(weight)) {
+      if (k_clock_ == DecayClock::UPDATES) {
+        t_--;
+        prune(SketchEventType::PRUNE_OVERFLOW);
+        ++t_;
+      } else {
+        prune(SketchEventType::PRUNE_OVERFLOW);
+      }
+      increment = weight * k_f_(t_, alpha_);
+    }
+
+    for (const size_t pos : positions)
+      data_[pos] = std::min(data_[pos] + increment, PRUNE_THRESHOLD);
+
+    ++updates_;
+    ++adapt_counter_;
+    if (k_adapt_interval_ && adapt_due())
+      adapt();
+
+    // Resizing moves the counters, so it waits until `positions` are no longer used
+    if (pending_resize_ > 0)
+      grow();
+    else if (pending_resize_ < 0)
+      shrink();
+    pending_resize_ = 0;
+  }
+
+  /**
+   * @brief Whether an overflow prune before adding `weight` makes room, i.e., whether it shrinks
+   * the counters (f(t) > 1) and the weight then fits on its own.
+   */
+  [[nodiscard]] auto prune_helps(const float weight) const -> bool {
+    // The clock by updates has already advanced for this update, which happens after the prune
+    const bool by_updates = k_clock_ == DecayClock::UPDATES;
+    return k_f_(by_updates ? t_ - 1 : t_, alpha_) > 1.0F &&
+           weight * k_f_(by_updates ? 1 : 0, alpha_) < PRUNE_THRESHOLD;
   }
 
   /**
    * @brief Periodically reset 't' and prune counters to avoid overflow.
+   *
+   * @param cause Why the prune happens, as recorded in the event trace
    */
-  void prune() {
+  void prune(const SketchEventType cause) {
+    const auto start_ns = k_events_ ? EventTrace::now() : 0;
+    if (cause == SketchEventType::PRUNE_OVERFLOW)
+      ++overflow_prunes_;
+    else
+      ++adapt_prunes_;
+
     const auto d = k_f_(t_, alpha_);
     for (size_t i = 0; i < 4; i++)
       for (size_t j = 0; j < k_width_; j++)
         data_[i * k_width_ + j] /= d;
     t_ = 0;
+    epoch_start_ = now_;
+
+    if (k_auto_resize_)
+      plan_resize();
+    record_event(cause, start_ns, 4 * k_width_, alpha_);
+  }
+
+  /**
+   * @brief Decide whether to resize after the ongoing update, right after a prune so that the
+   * counters are expressed in units of the current time.
+   */
+  void plan_resize() {
+    if (resize_cooldown_ > 0) {
+      resize_cooldown_--;
+      return;
+    }
+
+    size_t loaded = 0;
+    size_t loaded_folded = 0;
+    for (size_t i = 0; i < 4; i++) {
+      const float *row = data_ + i * k_width_;
+      for (size_t j = 0; j + 1 < k_width_; j += 2) {
+        loaded += (row[j] >= 1.0F) + (row[j + 1] >= 1.0F);
+        loaded_folded += row[j] + row[j + 1] >= 1.0F;
+      }
+      // The last column of an odd width is merged into the last pair, which is close enough here
+      if (k_width_ % 2 != 0)
+        loaded += row[k_width_ - 1] >= 1.0F;
+    }
+
+    const auto &policy = *k_auto_resize_;
+    const auto load = static_cast<double>(loaded) / static_cast<double>(4 * k_width_);
+    const auto folded_load =
+        static_cast<double>(loaded_folded) / static_cast<double>(4 * (k_width_ / 2));
+    if (load > policy.grow_load && k_width_ * 2 <= policy.max_width)
+      pending_resize_ = 1;
+    else if (folded_load < policy.shrink_load && k_width_ / 2 >= policy.min_width)
+      pending_resize_ = -1;
+    if (pending_resize_ != 0)
+      resize_cooldown_ = policy.cooldown;
+  }
+
+  [[nodiscard]] auto adapt_due() const -> bool {
+    const uint32_t elapsed = k_clock_ == DecayClock::SECONDS ? now_ - adapt_start_ : adapt_counter_;
+    return elapsed >= k_adapt_interval_;
   }
 
   /**
    * @brief Periodically adapt alpha.
    */
   void adapt() {
-    prune();
+    prune(SketchEventType::PRUNE_ADAPT);
+
+    const auto start_ns = k_events_ ? EventTrace::now() : 0;
+    const auto old_alpha = alpha_;
     alpha_ = k_adapter_(external_metrics, alpha_);
     adapt_counter_ = 0;
+    adapt_start_ = now_;
+
+    if constexpr (std::is_convertible_v<const E &, double>)
+      record_event(SketchEventType::ADAPT, start_ns, 0, old_alpha,
+                   static_cast<double>(external_metrics));
+    else
+      record_event(SketchEventType::ADAPT, start_ns, 0, old_alpha);
+  }
+
+  /**
+   * @brief Record an event that started at `start_ns` and ends now, if a trace is attached.
+   */
+  void record_event(const SketchEventType type, const uint64_t start_ns, const size_t counters,
+                    const double old_alpha,
+                    const double objective = std::numeric_limits<double>::quiet_NaN()) const {
+    if (!k_events_)
+      return;
+    k_events_->record({.type = type,
+                       .start_ns = start_ns,
+                       .duration_ns = EventTrace::now() - start_ns,
+                       .counters = counters,
+                       .old_alpha = old_alpha,
+                       .new_alpha = alpha_,
+                       .objective = objective});
   }
 };
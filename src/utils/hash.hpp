@@ -6,6 +6,10 @@
 #include <string>
 #include <type_traits>
 
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
 #include "hash_functions/murmur.hpp"
 
 template <typename T>
@@ -54,3 +58,29 @@ template <typename T>
   return hash32(item, seed);
 #endif
 }
+
+/**
+ * @brief Map `hash` onto `[0, range)` with a multiply-shift (Lemire's fastrange) instead of a
+ * modulo, so that any `range` is as cheap as a power of two. Only the high bits of `hash` matter.
+ */
+[[nodiscard]] inline auto fastrange(const size_t hash, const size_t range) -> size_t {
+#if SIZE_MAX == UINT32_MAX
+  return static_cast<size_t>((static_cast<uint64_t>(hash) * range) >> 32);
+#elif defined(_MSC_VER) && !defined(__clang__)
+  return __umulh(hash, range);
+#else
+  return static_cast<size_t>((static_cast<unsigned __int128>(hash) * range) >> 64);
+#endif
+}
+
+/**
+ * @brief Derive the hash of row `seed` from the item hash `hash`, with the entropy moved into the
+ * high bits consumed by `fastrange()`.
+ */
+[[nodiscard]] inline auto row_hash(const size_t hash, const size_t seed) -> size_t {
+  // 0x9e3779b97f4a7c15 is 2^64 divided by the golden ratio (Fibonacci hashing)
+  if constexpr (sizeof(size_t) == sizeof(uint32_t))
+    return (hash ^ seed) * static_cast<size_t>(0x9e3779b9U);
+  else
+    return (hash ^ seed) * static_cast<size_t>(0x9e3779b97f4a7c15ULL);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief A latency histogram with logarithmic buckets (in the spirit of HdrHistogram), taking a
+ * fixed amount of memory and recording without locks.
+ *
+ * Each power of two is split into `2^SubBucketBits` linear sub-buckets, so any recorded value is
+ * reported within a relative error of `2^-SubBucketBits` (6.25% by default). Values are unitless,
+ * e.g., cycles or nanoseconds.
+ */
+template <unsigned SubBucketBits = 4> class LatencyHistogram {
+  static_assert(SubBucketBits > 0 && SubBucketBits < 16, "Unsupported sub-bucket resolution");
+
+  static constexpr size_t SUB_BUCKETS = size_t{1} << SubBucketBits;
+  // Values below `SUB_BUCKETS` get a bucket each, and every power of two above gets `SUB_BUCKETS`
+  static constexpr size_t BUCKETS = SUB_BUCKETS * (64 - SubBucketBits + 1);
+
+public:
+  void record(const uint64_t value) noexcept {
+    buckets_[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+
+    auto max = max_.load(std::memory_order_relaxed);
+    while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+  }
+
+  [[nodiscard]] auto count() const noexcept -> uint64_t {
+    return count_.load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] auto max() const noexcept -> uint64_t {
+    return max_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief The smallest value such that at least `quantile` (in [0, 1]) of the recorded values are
+   * not greater, up to the bucket resolution. Returns 0 if nothing has been recorded.
+   */
+  [[nodiscard]] auto value_at(const double quantile) const noexcept -> uint64_t {
+    const auto count = this->count();
+    if (count == 0)
+      return 0;
+    if (quantile >= 1.0)
+      return max();
+
+    const auto rank = std::max<uint64_t>(
+        1, static_cast<uint64_t>(std::ceil(std::max(quantile, 0.0) * static_cast<double>(count))));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+      seen += buckets_[i].load(std::memory_order_relaxed);
+      if (seen >= rank)
+        return std::min(highest_value_of(i), max());
+    }
+    return max();
+  }
+
+private:
+  std::array<std::atomic<uint64_t>, BUCKETS> buckets_{};
+  std::atomic<uint64_t> count_ = 0;
+  std::atomic<uint64_t> max_ = 0;
+
+  [[nodiscard]] static constexpr auto bucket_of(const uint64_t value) noexcept -> size_t {
+    if (value < SUB_BUCKETS)
+      return static_cast<size_t>(value);
+    // The top `SubBucketBits + 1` bits of `value` select the bucket
+    const auto shift = static_cast<unsigned>(std::bit_width(value)) - SubBucketBits - 1;
+    return SUB_BUCKETS * (shift + 1) + static_cast<size_t>((value >> shift) - SUB_BUCKETS);
+  }
+
+  [[nodiscard]] static constexpr auto highest_value_of(const size_t bucket) noexcept -> uint64_t {
+    if (bucket < SUB_BUCKETS)
+      return bucket;
+    const auto shift = static_cast<unsigned>(bucket / SUB_BUCKETS - 1);
+    const auto lowest = (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return lowest + ((uint64_t{1} << shift) - 1);
+  }
+};
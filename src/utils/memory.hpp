@@ -7,10 +7,18 @@
 
 #ifdef _WIN32
 #include <malloc.h>
+#include <xmmintrin.h>
 #else
 #include <cstdlib>
 #endif
 
+/**
+ * @brief An exact number of bytes a data structure may occupy, including its own object.
+ */
+struct MemoryBudget {
+  size_t bytes;
+};
+
 template <typename T> [[nodiscard]] inline auto aligned_alloc(size_t size) -> T * {
   void *ptr = nullptr;
 #ifdef _WIN32
@@ -53,3 +61,14 @@ template <typename U> inline void aligned_free_atomic(std::atomic<U> *ptr) {
   free(ptr);
 #endif
 }
+
+/**
+ * @brief Hint the CPU to fetch the cache line containing `ptr` ahead of an imminent read.
+ */
+inline void prefetch(const void *ptr) noexcept {
+#ifdef _WIN32
+  _mm_prefetch(static_cast<const char *>(ptr), _MM_HINT_T0);
+#else
+  __builtin_prefetch(ptr);
+#endif
+}
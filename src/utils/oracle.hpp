@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief The exact time-decayed frequencies of all items, under the same decay function and
+ * update-driven clock as the sketches (i.e., `DecayClock::UPDATES`), to measure their estimation
+ * error against.
+ *
+ * The frequency of an item at time `t` is the sum of `weight * f(t_i, alpha) / f(t, alpha)` over
+ * its updates at times `t_i`. Like the sketches, the clock restarts at every change of alpha, so that
+ * each alpha only applies to the updates made while it was in effect, and `f(0, alpha)` must be 1.
+ * Decay is lazy: each item keeps the epoch (i.e., the span between two restarts) it was last
+ * updated in, and is only brought up to date on its next update or estimate.
+ *
+ * Takes memory proportional to the number of distinct items, so it is only meant for benchmarks and
+ * tests.
+ */
+template <typename T, typename F>
+  requires std::is_invocable_r_v<float, F, uint32_t, double>
+class DecayedFrequencyOracle {
+  // Restart the clock before `f` gets large enough to cost doubles their precision, which does not
+  // change any frequency as long as `f(a + b, alpha) == f(a, alpha) * f(b, alpha)`
+  static constexpr double RESTART_THRESHOLD = 1e30;
+
+public:
+  DecayedFrequencyOracle(F f, const double alpha) : k_f_(std::move(f)), alpha_(alpha) {}
+
+  void update(const T &item, const double weight = 1.0) {
+    ++t_;
+    auto d = static_cast<double>(k_f_(t_, alpha_));
+    if (d > RESTART_THRESHOLD) {
+      t_--;
+      restart();
+      ++t_;
+      d = static_cast<double>(k_f_(t_, alpha_));
+    }
+
+    auto &entry = entries_[item];
+    entry.value = rebased(entry) + weight * d;
+    entry.epoch = current_epoch();
+  }
+
+  /**
+   * @brief Change alpha from now on, as an adapter does between two updates.
+   */
+  void set_alpha(const double alpha) {
+    if (alpha == alpha_)
+      return;
+    restart();
+    alpha_ = alpha;
+  }
+
+  [[nodiscard]] auto estimate(const T &item) const -> double {
+    const auto it = entries_.find(item);
+    return it == entries_.end() ? 0.0 : rebased(it->second) / divisor();
+  }
+
+  /**
+   * @brief Call `fn(item, frequency)` for every item updated so far, in no particular order.
+   */
+  template <typename Fn> void for_each(Fn &&fn) const {
+    const double d = divisor();
+    for (const auto &[item, entry] : entries_)
+      fn(item, rebased(entry) / d);
+  }
+
+  [[nodiscard]] auto alpha() const noexcept -> double { return alpha_; }
+
+  // The number of distinct items updated so far
+  [[nodiscard]] auto size() const noexcept -> size_t { return entries_.size(); }
+
+private:
+  struct Entry {
+    double value = 0.0; // In units of the start of `epoch`, i.e., not yet divided by `f(t, alpha)`
+    uint32_t epoch = 0;
+  };
+
+  F k_f_;
+  double alpha_;
+  uint32_t t_ = 0;
+
+  std::unordered_map<T, Entry> entries_;
+  // The log of the decay applied from the start of the first epoch to the start of each epoch
+  std::vector<double> log_decay_{0.0};
+
+  [[nodiscard]] auto current_epoch() const noexcept -> uint32_t {
+    return static_cast<uint32_t>(log_decay_.size() - 1);
+  }
+
+  [[nodiscard]] auto divisor() const -> double { return static_cast<double>(k_f_(t_, alpha_)); }
+
+  // The value of `entry` in units of the start of the current epoch
+  [[nodiscard]] auto rebased(const Entry &entry) const -> double {
+    if (entry.epoch == current_epoch())
+      return entry.value;
+    return entry.value * std::exp(log_decay_[entry.epoch] - log_decay_.back());
+  }
+
+  void restart() {
+    log_decay_.push_back(log_decay_.back() + std::log(divisor()));
+    t_ = 0;
+  }
+};
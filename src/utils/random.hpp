@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <random>
+
+/**
+ * @brief A random engine seeded with `seed`, or from `std::random_device` without one, so that
+ * sketches and adapters given the same seed make the same choices on every run.
+ */
+[[nodiscard]] inline auto make_random_engine(const std::optional<uint64_t> seed) -> std::mt19937 {
+  if (!seed)
+    return std::mt19937{std::random_device{}()};
+  std::seed_seq seq{static_cast<uint32_t>(*seed), static_cast<uint32_t>(*seed >> 32)};
+  return std::mt19937{seq};
+}
+
+/**
+ * @brief Derive an independent seed for the `stream`-th user of `seed` (e.g., the sketch and the
+ * adapter of one run), using the SplitMix64 finalizer so that nearby seeds do not correlate.
+ */
+[[nodiscard]] constexpr auto derive_seed(const uint64_t seed, const uint64_t stream) -> uint64_t {
+  uint64_t z = seed + (stream + 1) * 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+[[nodiscard]] constexpr auto derive_seed(const std::optional<uint64_t> seed, const uint64_t stream)
+    -> std::optional<uint64_t> {
+  if (!seed)
+    return std::nullopt;
+  return derive_seed(*seed, stream);
+}
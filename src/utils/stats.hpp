@@ -0,0 +1,214 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "histogram.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define SKETCH_STATS_HAS_TSC 1
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define SKETCH_STATS_HAS_TSC 1
+#endif
+
+/**
+ * @brief The operations of a sketch that a stats policy tells apart.
+ */
+enum class SketchOp : uint8_t {
+  UPDATE,   // `update()` and its variants
+  ESTIMATE, // `estimate()` and `compare()`
+};
+
+/*
+ * Stats policies decide what a sketch records about its own operations. Each operation opens a
+ * scope with `measure()` that covers the rest of its body, and the results are read back with
+ * `calls()`, `avg_seconds()` and `latency_seconds()`. All policies are safe to use from concurrent
+ * `estimate()` calls.
+ */
+
+/**
+ * @brief Record nothing, so that instrumentation costs nothing in production.
+ */
+struct NoStats {
+  struct Scope {};
+
+  [[nodiscard]] static constexpr auto measure(const SketchOp /*op*/) noexcept -> Scope {
+    return {};
+  }
+
+  [[nodiscard]] static constexpr auto calls(const SketchOp /*op*/) noexcept -> uint64_t {
+    return 0;
+  }
+
+  [[nodiscard]] static constexpr auto avg_seconds(const SketchOp /*op*/) noexcept -> double {
+    return 0.0;
+  }
+
+  [[nodiscard]] static constexpr auto latency_seconds(const SketchOp /*op*/,
+                                                      const double /*quantile*/) noexcept
+      -> double {
+    return 0.0;
+  }
+};
+
+/**
+ * @brief Count the calls of each operation without timing them.
+ */
+class CountingStats {
+public:
+  struct Scope {};
+
+  auto measure(const SketchOp op) const noexcept -> Scope {
+    calls_[static_cast<size_t>(op)].fetch_add(1, std::memory_order_relaxed);
+    return {};
+  }
+
+  [[nodiscard]] auto calls(const SketchOp op) const noexcept -> uint64_t {
+    return calls_[static_cast<size_t>(op)].load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] static constexpr auto avg_seconds(const SketchOp /*op*/) noexcept -> double {
+    return 0.0;
+  }
+
+  [[nodiscard]] static constexpr auto latency_seconds(const SketchOp /*op*/,
+                                                      const double /*quantile*/) noexcept
+      -> double {
+    return 0.0;
+  }
+
+private:
+  mutable std::array<std::atomic<uint64_t>, 2> calls_{};
+};
+
+/**
+ * @brief Read a monotonic cycle counter, i.e., the TSC on x86 and the steady clock in nanoseconds
+ * elsewhere.
+ */
+[[nodiscard]] inline auto read_cycles() noexcept -> uint64_t {
+#ifdef SKETCH_STATS_HAS_TSC
+  return __rdtsc();
+#else
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now().time_since_epoch())
+                                   .count());
+#endif
+}
+
+/**
+ * @brief The rate of `read_cycles()`, calibrated once against the steady clock on first use.
+ */
+[[nodiscard]] inline auto cycles_per_second() -> double {
+#ifdef SKETCH_STATS_HAS_TSC
+  static const double value = [] {
+    using namespace std::chrono_literals;
+    const auto start = std::chrono::steady_clock::now();
+    const auto start_cycles = read_cycles();
+    auto now = start;
+    while (now - start < 10ms)
+      now = std::chrono::steady_clock::now();
+    const auto cycles = static_cast<double>(read_cycles() - start_cycles);
+    return cycles / std::chrono::duration<double>(now - start).count();
+  }();
+  return value;
+#else
+  return 1e9;
+#endif
+}
+
+/**
+ * @brief Time roughly one in `Period` calls of each operation in cycles (see `read_cycles()`),
+ * leaving the other calls with a thread-local countdown as their only cost.
+ *
+ * The distance between two samples is randomized around `Period` so that periodic access patterns
+ * cannot line up with the sampling. Sampled latencies also go to a histogram per operation, from
+ * which tail latencies are read; use a `Period` of 1 to time every call when the exact maximum
+ * matters.
+ */
+template <uint32_t Period = 64> class SampledCycleStats {
+  static_assert(Period > 0, "Sampling period must be positive");
+
+public:
+  class Scope {
+  public:
+    Scope(const SampledCycleStats *stats, const SketchOp op) noexcept
+        : stats_(stats), op_(op), start_(stats ? read_cycles() : 0) {}
+
+    ~Scope() {
+      if (stats_)
+        stats_->record(op_, read_cycles() - start_);
+    }
+
+    Scope(const Scope &) = delete;
+    auto operator=(const Scope &) -> Scope & = delete;
+    Scope(Scope &&) = delete;
+    auto operator=(Scope &&) -> Scope & = delete;
+
+  private:
+    const SampledCycleStats *stats_; // Null if this call is not sampled
+    SketchOp op_;
+    uint64_t start_;
+  };
+
+  auto measure(const SketchOp op) const noexcept -> Scope {
+    thread_local std::array<uint32_t, 2> countdowns{};
+    auto &countdown = countdowns[static_cast<size_t>(op)];
+    if (countdown > 0) {
+      countdown--;
+      return {nullptr, op};
+    }
+    countdown = next_gap();
+    return {this, op};
+  }
+
+  /**
+   * @brief The estimated number of calls, extrapolated from the number of samples.
+   */
+  [[nodiscard]] auto calls(const SketchOp op) const noexcept -> uint64_t {
+    return samples_[static_cast<size_t>(op)].load(std::memory_order_relaxed) * Period;
+  }
+
+  [[nodiscard]] auto avg_seconds(const SketchOp op) const -> double {
+    const auto samples = samples_[static_cast<size_t>(op)].load(std::memory_order_relaxed);
+    if (samples == 0)
+      return 0.0;
+    const auto cycles = cycles_[static_cast<size_t>(op)].load(std::memory_order_relaxed);
+    return static_cast<double>(cycles) / static_cast<double>(samples) / cycles_per_second();
+  }
+
+  /**
+   * @brief The latency of `op` at `quantile` among the sampled calls, where a `quantile` of 1 gives
+   * the maximum. Returns 0 if no call has been sampled.
+   */
+  [[nodiscard]] auto latency_seconds(const SketchOp op, const double quantile) const -> double {
+    const auto cycles = latencies_[static_cast<size_t>(op)].value_at(quantile);
+    return cycles == 0 ? 0.0 : static_cast<double>(cycles) / cycles_per_second();
+  }
+
+private:
+  mutable std::array<std::atomic<uint64_t>, 2> samples_{};
+  mutable std::array<std::atomic<uint64_t>, 2> cycles_{};
+  mutable std::array<LatencyHistogram<>, 2> latencies_{};
+
+  void record(const SketchOp op, const uint64_t cycles) const noexcept {
+    samples_[static_cast<size_t>(op)].fetch_add(1, std::memory_order_relaxed);
+    cycles_[static_cast<size_t>(op)].fetch_add(cycles, std::memory_order_relaxed);
+    latencies_[static_cast<size_t>(op)].record(cycles);
+  }
+
+  // The number of calls to skip before the next sample, drawn so that a sample is taken about
+  // every `Period` calls on average
+  [[nodiscard]] static auto next_gap() noexcept -> uint32_t {
+    thread_local uint32_t state = 0x9e3779b9U;
+    // xorshift32
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (Period - 1) / 2 + state % Period;
+  }
+};
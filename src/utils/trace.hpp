@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief The maintenance work a sketch can do in the middle of an update.
+ */
+enum class SketchEventType : uint8_t {
+  PRUNE_OVERFLOW, // Counters were rescaled because one would have overflowed
+  PRUNE_ADAPT,    // Counters were rescaled ahead of an adaptation
+  ADAPT,          // Alpha was adapted
+  GROW,           // The width was doubled
+  SHRINK,         // The width was halved
+};
+
+[[nodiscard]] constexpr auto event_name(const SketchEventType type) -> std::string_view {
+  switch (type) {
+  case SketchEventType::PRUNE_OVERFLOW:
+    return "prune (overflow)";
+  case SketchEventType::PRUNE_ADAPT:
+    return "prune (adapt)";
+  case SketchEventType::ADAPT:
+    return "adapt";
+  case SketchEventType::GROW:
+    return "grow";
+  case SketchEventType::SHRINK:
+    return "shrink";
+  }
+  return "unknown";
+}
+
+struct SketchEvent {
+  SketchEventType type;
+  uint64_t start_ns;    // See `EventTrace::now()`
+  uint64_t duration_ns;
+  size_t counters;      // Counters read or written
+  double old_alpha;
+  double new_alpha;
+  double objective = std::numeric_limits<double>::quiet_NaN(); // What the adapter saw, if any
+};
+
+/**
+ * @brief A bounded ring of sketch events, allocated once up front so that recording is a plain
+ * store. Once full, the oldest events are overwritten.
+ *
+ * A trace has a single writer, i.e., the sketch it is attached to.
+ */
+class EventTrace {
+public:
+  explicit EventTrace(const size_t capacity) : events_(capacity) {
+    if (capacity == 0)
+      throw std::invalid_argument("Event trace capacity must be positive");
+  }
+
+  /**
+   * @brief A monotonic timestamp in nanoseconds for `SketchEvent::start_ns`.
+   */
+  [[nodiscard]] static auto now() noexcept -> uint64_t {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+  }
+
+  void record(const SketchEvent &event) noexcept {
+    events_[recorded_ % events_.size()] = event;
+    recorded_++;
+  }
+
+  /**
+   * @brief The number of events held, at most the capacity.
+   */
+  [[nodiscard]] auto size() const noexcept -> size_t {
+    return static_cast<size_t>(std::min<uint64_t>(recorded_, events_.size()));
+  }
+
+  /**
+   * @brief The number of events overwritten since the trace was created.
+   */
+  [[nodiscard]] auto dropped() const noexcept -> uint64_t { return recorded_ - size(); }
+
+  /**
+   * @brief Call `fn` on each held event, from the oldest to the newest.
+   */
+  template <typename Fn> void for_each(Fn &&fn) const {
+    const uint64_t first = recorded_ - size();
+    for (uint64_t i = first; i < recorded_; i++)
+      fn(events_[i % events_.size()]);
+  }
+
+  /**
+   * @brief Save the held events in the Chrome trace event format, which can be opened in
+   * `chrome://tracing` or Perfetto. Alpha and the adapter objective are also exported as counters.
+   */
+  void save_chrome_trace(const std::filesystem::path &path) const {
+    if (path.has_parent_path() && !std::filesystem::exists(path.parent_path()))
+      std::filesystem::create_directories(path.parent_path());
+
+    std::ofstream file(path);
+    if (!file.is_open())
+      throw std::runtime_error("Failed to open file for writing: " + path.string());
+
+    uint64_t origin = std::numeric_limits<uint64_t>::max();
+    for_each([&](const SketchEvent &event) { origin = std::min(origin, event.start_ns); });
+    auto to_us = [origin](const uint64_t ns) {
+      return static_cast<double>(ns - origin) / 1000.0;
+    };
+
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"sketch\"}}";
+    for_each([&](const SketchEvent &event) {
+      file << std::format(",\n{{\"name\":\"{}\",\"cat\":\"sketch\",\"ph\":\"X\",\"pid\":1,"
+                          "\"tid\":1,\"ts\":{:.3f},\"dur\":{:.3f},\"args\":{{\"counters\":{},"
+                          "\"old_alpha\":{},\"new_alpha\":{}",
+                          event_name(event.type), to_us(event.start_ns),
+                          static_cast<double>(event.duration_ns) / 1000.0, event.counters,
+                          event.old_alpha, event.new_alpha);
+      if (std::isfinite(event.objective))
+        file << std::format(",\"objective\":{}", event.objective);
+      file << "}}";
+
+      if (event.type != SketchEventType::ADAPT)
+        return;
+      const auto end_us = to_us(event.start_ns + event.duration_ns);
+      file << std::format(",\n{{\"name\":\"alpha\",\"ph\":\"C\",\"pid\":1,\"ts\":{:.3f},"
+                          "\"args\":{{\"alpha\":{}}}}}",
+                          end_us, event.new_alpha);
+      if (std::isfinite(event.objective))
+        file << std::format(",\n{{\"name\":\"objective\",\"ph\":\"C\",\"pid\":1,\"ts\":{:.3f},"
+                            "\"args\":{{\"objective\":{}}}}}",
+                            end_us, event.objective);
+    });
+    file << "\n]}\n";
+
+    file.close();
+  }
+
+private:
+  std::vector<SketchEvent> events_;
+  uint64_t recorded_ = 0;
+};
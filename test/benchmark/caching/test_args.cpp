@@ -0,0 +1,39 @@
+#include <array>
+#include <cstddef>
+
+#include <doctest/doctest.h>
+
+#include "../../../benchmark/caching/args.hpp"
+#include "../../../benchmark/utils/errors.hpp"
+
+namespace {
+
+// Parses `flags` after the positional arguments of a caching task on a trace that does not exist,
+// which is thus never preferred to be streamed
+template <size_t N> auto parse_with(std::array<const char *, N> flags) -> CachingArgs {
+  std::array<const char *, 5 + N> argv = {"caching", "missing.bin", "100", "10", "0.5"};
+  for (size_t i = 0; i < N; i++)
+    argv[5 + i] = flags[i];
+  return parse_caching_args(static_cast<int>(argv.size()), const_cast<char **>(argv.data()));
+}
+
+} // namespace
+
+TEST_CASE("[caching] parse arguments") {
+  const CachingArgs args = parse_with(std::array<const char *, 0>{});
+  CHECK(args.trace_path == "missing.bin");
+  CHECK(args.cache_size == 100);
+  CHECK(args.adapt_interval == 10);
+  CHECK(args.alpha == doctest::Approx(0.5));
+  CHECK_FALSE(args.stream);
+  CHECK_FALSE(args.dense_ids);
+}
+
+TEST_CASE("[caching] parse --dense-ids") {
+  const CachingArgs args = parse_with(std::array{"--dense-ids"});
+  CHECK(args.dense_ids);
+  CHECK_FALSE(args.stream);
+
+  CHECK(parse_with(std::array{"--stream"}).stream);
+  CHECK_THROWS_AS(parse_with(std::array{"--dense-ids", "--stream"}), usage_error);
+}
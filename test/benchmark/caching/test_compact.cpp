@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+#include "../../../benchmark/caching/compact.hpp"
+#include "../../../benchmark/caching/reader.hpp"
+
+namespace {
+
+// The requests of a compact trace as they should read back, i.e., without next access times and
+// with sizes of 1 unless the trace stores them
+auto expected_request(const Request &request, const bool sizes) -> Request {
+  return {.timestamp = request.timestamp,
+          .obj_id = request.obj_id,
+          .obj_size = sizes ? request.obj_size : 1,
+          .next_access_vtime = std::numeric_limits<uint64_t>::max()};
+}
+
+void check_request(const Request &actual, const Request &expected) {
+  CHECK(actual.timestamp == expected.timestamp);
+  CHECK(actual.obj_id == expected.obj_id);
+  CHECK(actual.obj_size == expected.obj_size);
+  CHECK(actual.next_access_vtime == expected.next_access_vtime);
+}
+
+// Writes `requests` as a compact trace, and reads them back through every access path of
+// `CachingTrace`
+void check_round_trip(const std::vector<Request> &requests, const CompactTraceOptions &options) {
+  const auto path = std::filesystem::temp_directory_path() / "test_compact.ctrace";
+  write_compact_trace(requests, path, options);
+
+  const CachingTrace trace(path.string());
+  REQUIRE(trace.compact() != nullptr);
+  REQUIRE(trace.size() == requests.size());
+
+  size_t i = 0;
+  for (const auto &request : trace)
+    check_request(request, expected_request(requests[i++], options.sizes));
+  CHECK(i == requests.size());
+
+  for (i = 0; i < requests.size(); i++) {
+    check_request(trace[i], expected_request(requests[i], options.sizes));
+    CHECK(trace.obj_id(i) == requests[i].obj_id);
+  }
+
+  // Chunks that start and end mid-block, in order so that decoding resumes where it stopped, and
+  // then out of order
+  RequestColumnBuffers buffers;
+  const size_t chunk = options.block_records + 3;
+  std::vector<size_t> firsts;
+  for (size_t first = 1; first < requests.size(); first += chunk)
+    firsts.push_back(first);
+  firsts.push_back(0);
+  for (const size_t first : firsts) {
+    const auto columns = trace.decode_columns(first, chunk, buffers);
+    REQUIRE(columns.size() == std::min(chunk, requests.size() - first));
+    for (size_t j = 0; j < columns.size(); j++)
+      check_request({.timestamp = columns.timestamps[j],
+                     .obj_id = columns.obj_ids[j],
+                     .obj_size = columns.obj_sizes[j],
+                     .next_access_vtime = columns.next_access_vtimes[j]},
+                    expected_request(requests[first + j], options.sizes));
+  }
+
+  std::filesystem::remove(path);
+}
+
+} // namespace
+
+TEST_CASE("[compact] round trip") {
+  // Timestamps that go back and forth, including by more than 2^31, over 13 objects of many sizes,
+  // in blocks of 7 records, the last of which holds 2
+  std::vector<Request> requests;
+  for (uint32_t i = 0; i < 100; i++)
+    requests.push_back({.timestamp = i == 50 ? 4'000'000'000U : 1000 + (i * 37) % 50,
+                        .obj_id = (uint64_t{i} * 7919 % 13) << 40,
+                        .obj_size = 1 + i * i * 1013 % 100'000,
+                        .next_access_vtime = i});
+
+  check_round_trip(requests, {.block_records = 7, .sizes = true});
+  check_round_trip(requests, {.block_records = 7, .sizes = false});
+#if defined(BENCHMARK_HAS_ZSTD)
+  check_round_trip(requests, {.block_records = 7, .sizes = true, .zstd_level = 3});
+#endif
+}
+
+TEST_CASE("[compact] round trip of width-0 columns") {
+  // A single object of a single size requested at a single time packs every column in 0 bits
+  const std::vector<Request> requests(
+      40, {.timestamp = 12345, .obj_id = 42, .obj_size = 4096, .next_access_vtime = 0});
+  check_round_trip(requests, {.block_records = 16, .sizes = true});
+
+  const auto path = std::filesystem::temp_directory_path() / "test_compact_zero.ctrace";
+  write_compact_trace(requests, path, {.block_records = 16});
+  const CachingTrace trace(path.string());
+  const auto &block = trace.compact()->block(0);
+  CHECK(block.timestamp_width == 0);
+  CHECK(block.id_width == 0);
+  CHECK(block.size_width == 0);
+  CHECK(trace.compact()->num_objects() == 1);
+  std::filesystem::remove(path);
+}
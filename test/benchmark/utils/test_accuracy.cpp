@@ -0,0 +1,49 @@
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+#include "../../../benchmark/utils/accuracy.hpp"
+
+namespace {
+
+// Writes a trace of `n` requests, most of which go to 10 hot objects and the rest to 1000 others
+void write_trace(const std::filesystem::path &path, const uint32_t n) {
+  std::ofstream file(path, std::ios::binary);
+  for (uint32_t i = 0; i < n; i++) {
+    const uint64_t obj_id = i % 7 == 0 ? 10 + i % 1000 : i % 10;
+    const uint32_t obj_size = 1;
+    const uint64_t next_access_vtime = UINT64_MAX;
+    file.write(reinterpret_cast<const char *>(&i), sizeof(i));
+    file.write(reinterpret_cast<const char *>(&obj_id), sizeof(obj_id));
+    file.write(reinterpret_cast<const char *>(&obj_size), sizeof(obj_size));
+    file.write(reinterpret_cast<const char *>(&next_access_vtime), sizeof(next_access_vtime));
+  }
+}
+
+} // namespace
+
+TEST_CASE("[accuracy] finite errors for every sketch") {
+  const auto path = std::filesystem::temp_directory_path() / "test_accuracy.oracleGeneral";
+  write_trace(path, 20'000);
+
+  // At this alpha, f(t) = e^(t / 100) overflows floats after about 8900 updates
+  const AccuracyArgs args{.trace_path = path.string(),
+                          .sizes = {4096},
+                          .alpha = 100.0,
+                          .top = 10,
+                          .samples = 10,
+                          .seed = 42};
+  for (const auto &errors : {cms_accuracy(args), ada_accuracy(args), evo_accuracy(args)}) {
+    REQUIRE(errors.size() == 4);
+    for (const double error : errors)
+      CHECK(std::isfinite(error));
+    // The hot objects have counters of their own in a sketch of this size
+    CHECK(errors[0] < 0.1);
+  }
+
+  std::filesystem::remove(path);
+}
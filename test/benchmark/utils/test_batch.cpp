@@ -0,0 +1,83 @@
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+#include "../../../benchmark/utils/batch.hpp"
+
+namespace {
+
+// A trace of `FAN_OUT_CHUNK_RECORDS + 10` records that fails to read the one after
+class FailingTrace {
+public:
+  class iterator {
+  public:
+    using value_type = size_t;
+    using difference_type = std::ptrdiff_t;
+
+    auto operator*() const -> size_t {
+      if (index_ == FAN_OUT_CHUNK_RECORDS + 10)
+        throw std::runtime_error("Corrupt block");
+      return index_;
+    }
+
+    auto operator++() -> iterator & {
+      index_++;
+      return *this;
+    }
+
+    void operator++(int) { ++*this; }
+
+    friend auto operator==(const iterator & /*it*/, std::default_sentinel_t /*end*/) -> bool {
+      return false;
+    }
+
+  private:
+    size_t index_ = 0;
+  };
+
+  explicit FailingTrace(const std::string & /*path*/) {}
+
+  [[nodiscard]] static auto size() -> size_t { return FAN_OUT_CHUNK_RECORDS * 2; }
+
+  [[nodiscard]] static auto begin() -> iterator { return {}; }
+
+  [[nodiscard]] static auto end() -> std::default_sentinel_t { return std::default_sentinel; }
+};
+
+} // namespace
+
+TEST_CASE("[batch] fan-out replays report errors of the trace to every task") {
+  constexpr size_t tasks = 3;
+  FanOut::expect(tasks);
+
+  std::vector<size_t> replayed(tasks, 0);
+  std::vector<std::string> errors(tasks);
+  std::vector<double> waited(tasks, 0.0);
+  {
+    std::vector<std::jthread> threads;
+    for (size_t i = 0; i < tasks; i++)
+      threads.emplace_back([&, i] {
+        try {
+          const auto trace = FanOutTrace<size_t>::subscribe<FailingTrace>("failing");
+          for ([[maybe_unused]] const size_t record : trace)
+            replayed[i]++;
+        } catch (const std::runtime_error &e) {
+          errors[i] = e.what();
+        }
+        waited[i] = FanOut::waiting_seconds();
+        FanOut::finish_task();
+      });
+    FanOut::run();
+  }
+
+  for (size_t i = 0; i < tasks; i++) {
+    CHECK(replayed[i] == FAN_OUT_CHUNK_RECORDS);
+    CHECK(errors[i] == "Corrupt block");
+    CHECK(waited[i] > 0.0);
+  }
+}
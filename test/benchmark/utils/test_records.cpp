@@ -0,0 +1,56 @@
+#include <cmath>
+#include <filesystem>
+#include <limits>
+
+#include <doctest/doctest.h>
+
+#include "../../../benchmark/utils/records.hpp"
+
+TEST_CASE("[records] repetitions share a configuration") {
+  const ResultRecord record{.benchmark = "caching",
+                            .name = "W-TinyLFU_EVO (Ia=10000)",
+                            .params = {{"cache_size", "1000"}, {"seed", "1"}}};
+
+  // The seed is what tells repetitions apart
+  auto repetition = record;
+  repetition.params["seed"] = "2";
+  CHECK(repetition.configuration() == record.configuration());
+  repetition.params.erase("seed");
+  CHECK(repetition.configuration() == record.configuration());
+
+  // Everything else is part of the configuration
+  auto other = record;
+  other.params["cache_size"] = "2000";
+  CHECK(other.configuration() != record.configuration());
+  other = record;
+  other.params["trace"] = "a.csv";
+  CHECK(other.configuration() != record.configuration());
+  other = record;
+  other.name = "W-TinyLFU_EVO (Ia=1000)";
+  CHECK(other.configuration() != record.configuration());
+  other = record;
+  other.benchmark = "hm";
+  CHECK(other.configuration() != record.configuration());
+}
+
+TEST_CASE("[records] stored records load back without NaN metrics") {
+  const auto path = std::filesystem::temp_directory_path() / "test_records.jsonl";
+  std::filesystem::remove(path);
+  {
+    ResultStore store(path.string(), {.commit = "abc"});
+    store.record({.benchmark = "caching",
+                  .name = "LRU",
+                  .params = {{"seed", "3"}},
+                  .metrics = {{"miss_ratio", 0.25},
+                              {"cycles", std::numeric_limits<double>::quiet_NaN()}}});
+  }
+
+  const auto records = ResultStore::load(path.string());
+  REQUIRE(records.size() == 1);
+  CHECK(records[0].name == "LRU");
+  CHECK(records[0].params.at("seed") == "3");
+  CHECK(records[0].metrics.size() == 1);
+  CHECK(records[0].metrics.at("miss_ratio") == 0.25);
+  CHECK(records[0].metadata.commit == "abc");
+  std::filesystem::remove(path);
+}
@@ -0,0 +1,99 @@
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <future>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+#include "../../../benchmark/utils/scheduler.hpp"
+
+namespace {
+
+// The most jobs seen running at once, where each job waits for that many to run (or for a few
+// seconds if the scheduler never admits them), so that the count does not depend on timing
+class Concurrency {
+public:
+  explicit Concurrency(const int expected) : expected_(expected) {}
+
+  void run() {
+    const int running = ++running_;
+    for (int peak = peak_; running > peak && !peak_.compare_exchange_weak(peak, running);)
+      ;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (peak_ < expected_ && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    --running_;
+  }
+
+  [[nodiscard]] auto running() const -> int { return running_; }
+
+  [[nodiscard]] auto peak() const -> int { return peak_; }
+
+private:
+  int expected_;
+  std::atomic<int> running_{0};
+  std::atomic<int> peak_{0};
+};
+
+} // namespace
+
+TEST_CASE("[scheduler] shared memory is counted once") {
+  // Jobs of 10 bytes of their own sharing a trace, within a budget of 100 bytes: a trace of 60
+  // bytes leaves room for 4 jobs, and one of 80 bytes for 2
+  for (const auto [shared_bytes, expected] : {std::pair{60UZ, 4}, std::pair{80UZ, 2}}) {
+    Concurrency concurrency(expected);
+    {
+      JobScheduler scheduler({.max_jobs = 4, .memory_budget_bytes = 100, .pin = false});
+      std::vector<std::future<void>> jobs;
+      for (int i = 0; i < 8; i++)
+        jobs.push_back(scheduler.submit([&] { concurrency.run(); }, 10,
+                                        {.key = "trace", .bytes = shared_bytes}));
+      for (auto &job : jobs)
+        job.get();
+    }
+    CHECK(concurrency.peak() == expected);
+  }
+}
+
+TEST_CASE("[scheduler] jobs over budget run alone and in order") {
+  Concurrency concurrency(4);
+  std::atomic<int> started{0};
+  int started_before_large = -1;
+  int running_with_large = -1;
+  {
+    JobScheduler scheduler({.max_jobs = 4, .memory_budget_bytes = 100, .pin = false});
+    std::vector<std::future<void>> jobs;
+    for (int i = 0; i < 12; i++) {
+      if (i == 5) {
+        jobs.push_back(scheduler.submit(
+            [&] {
+              started_before_large = started++;
+              running_with_large = concurrency.running();
+            },
+            500));
+      } else {
+        jobs.push_back(scheduler.submit(
+            [&] {
+              started++;
+              concurrency.run();
+            },
+            25));
+      }
+    }
+    for (auto &job : jobs)
+      job.get();
+  }
+  // The large job waits for all the jobs before it to finish, and none after it overtakes it
+  CHECK(started_before_large == 5);
+  CHECK(running_with_large == 0);
+  CHECK(concurrency.peak() == 4);
+
+  // So does a job whose shared memory alone exceeds the budget
+  JobScheduler scheduler({.max_jobs = 2, .memory_budget_bytes = 100, .pin = false});
+  scheduler.submit([] {}, 10, {.key = "trace", .bytes = 1000}).get();
+  scheduler.submit([] {}, 10, {.key = "trace", .bytes = 50}).get();
+}
@@ -0,0 +1,42 @@
+#include <cmath>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+#include "../../../benchmark/utils/statistics.hpp"
+
+TEST_CASE("[statistics] critical values of Student's t distribution") {
+  // Two-sided values from the usual tables
+  CHECK(student_t_critical(0.05, 10) == doctest::Approx(2.228).epsilon(1e-3));
+  CHECK(student_t_critical(0.05, 1) == doctest::Approx(12.706).epsilon(1e-3));
+  CHECK(student_t_critical(0.01, 5) == doctest::Approx(4.032).epsilon(1e-3));
+  CHECK(student_t_critical(0.05, 1e6) == doctest::Approx(1.960).epsilon(1e-3));
+
+  CHECK(student_t_two_sided_p(2.228, 10) == doctest::Approx(0.05).epsilon(1e-3));
+  CHECK(student_t_two_sided_p(0.0, 10) == doctest::Approx(1.0));
+  CHECK(student_t_two_sided_p(-2.228, 10) == doctest::Approx(student_t_two_sided_p(2.228, 10)));
+  CHECK(student_t_two_sided_p(INFINITY, 10) == 0.0);
+  CHECK(std::isnan(student_t_two_sided_p(1.0, 0.0)));
+}
+
+TEST_CASE("[statistics] confidence intervals of the mean") {
+  // A standard deviation of sqrt(5/3) over 4 samples, with t = 3.182 for 3 degrees of freedom
+  CHECK(confidence_half_width({10.0, 12.0, 11.0, 13.0}) ==
+        doctest::Approx(3.182 * std::sqrt(5.0 / 3.0) / 2.0).epsilon(1e-3));
+  CHECK(confidence_half_width({5.0, 5.0, 5.0}) == 0.0);
+  CHECK(std::isnan(confidence_half_width({5.0})));
+}
+
+TEST_CASE("[statistics] Welch's t-test") {
+  // As reported by R's t.test(1:5, c(2, 4, 6, 8, 10)), with the sign flipped since `b` is the new
+  // side
+  const auto test = welch_t_test({1, 2, 3, 4, 5}, {2, 4, 6, 8, 10});
+  CHECK(test.t == doctest::Approx(1.8974).epsilon(1e-4));
+  CHECK(test.df == doctest::Approx(5.8824).epsilon(1e-4));
+  CHECK(test.p == doctest::Approx(0.1075).epsilon(1e-3));
+
+  // Deterministic metrics differ significantly as soon as they differ at all
+  CHECK(welch_t_test({3, 3}, {4, 4}).p == 0.0);
+  CHECK(welch_t_test({3, 3}, {3, 3}).p == 1.0);
+  CHECK(std::isnan(welch_t_test({1}, {2, 3}).p));
+}
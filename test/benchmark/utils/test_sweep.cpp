@@ -0,0 +1,110 @@
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+#include "../../../benchmark/utils/records.hpp"
+#include "../../../benchmark/utils/sweep.hpp"
+
+namespace {
+
+auto uses_adapt_interval(const std::string_view algorithm) -> bool {
+  return algorithm.ends_with("_EVO");
+}
+
+// The records of the points of `spec`, named and sized like the driver does
+auto records_of(const SweepSpec &spec, const std::vector<SweepPoint> &points)
+    -> std::vector<ResultRecord> {
+  std::vector<ResultRecord> records;
+  for (const auto &point : points)
+    records.push_back(sweep_record(
+        spec, point, point.algorithm + " " + std::to_string(point.adapt_interval),
+        static_cast<size_t>(point.cache_size_ratio * 1e6)));
+  return records;
+}
+
+} // namespace
+
+TEST_CASE("[sweep] resumed sweeps run exactly the points left") {
+  SweepSpec spec{.benchmark = "caching",
+                 .trace = "trace.oracleGeneral",
+                 .algorithms = {"W-TinyLFU_CMS", "W-TinyLFU_EVO"},
+                 .seeds = {1, 2},
+                 .samples = 10,
+                 .sampling_seed = 42,
+                 .cache_size_ratio = {.min = 0.001, .max = 0.1, .log = true},
+                 .alpha = {.min = 0.1, .max = 2.0},
+                 .adapt_interval = {.values = {1000, 10000, 100000}}};
+
+  for (const auto *sampling : {"random", "lhs"}) {
+    spec.sampling = sampling;
+    const auto points = expand_sweep(spec, uses_adapt_interval);
+    REQUIRE(points.size() == 40);
+    CHECK(expand_sweep(spec, uses_adapt_interval) == points);
+
+    // A sweep interrupted after every third point, whose results went through the result file
+    const auto path = std::filesystem::temp_directory_path() / "test_sweep.jsonl";
+    std::filesystem::remove(path);
+    const auto records = records_of(spec, points);
+    std::vector<size_t> expected;
+    {
+      ResultStore store(path.string(), {});
+      for (size_t i = 0; i < records.size(); i++) {
+        if (i % 3 == 0) {
+          auto record = records[i];
+          record.metrics["miss_ratio"] = 0.5;
+          store.record(record);
+        } else {
+          expected.push_back(i);
+        }
+      }
+    }
+
+    const auto resumed = expand_sweep(spec, uses_adapt_interval);
+    CHECK(pending_sweep_records(records_of(spec, resumed), ResultStore::load(path.string())) ==
+          expected);
+    CHECK(pending_sweep_records(records, {}).size() == records.size());
+    std::filesystem::remove(path);
+  }
+}
+
+TEST_CASE("[sweep] grids are expanded without duplicates") {
+  const SweepSpec spec{.benchmark = "hm",
+                       .algorithms = {"CMS", "W-TinyLFU_EVO"},
+                       .seeds = {7},
+                       .cache_size_ratio = {.values = {0.01, 0.1}},
+                       .alpha = {.values = {1.0}},
+                       .adapt_interval = {.values = {1000, 10000}}};
+  const auto points = expand_sweep(spec, uses_adapt_interval);
+  // The intervals of algorithms that do not adapt collapse into one point
+  CHECK(points.size() == 2 * (1 + 2));
+  CHECK(expand_sweep(spec, uses_adapt_interval) == points);
+  CHECK(sweep_record(spec, points[0], "CMS", 10).params.at("top_k") == "100");
+}
+
+TEST_CASE("[sweep] dense replays are recorded apart from hashed ones") {
+  SweepSpec spec{.benchmark = "caching",
+                 .algorithms = {"LRU"},
+                 .cache_size_ratio = {.values = {0.01}},
+                 .alpha = {.values = {1.0}}};
+  const auto point = expand_sweep(spec, uses_adapt_interval).at(0);
+  const auto hashed = sweep_record(spec, point, "LRU", 10);
+  spec.dense_ids = true;
+  const auto dense = sweep_record(spec, point, "LRU", 10);
+  CHECK(!hashed.params.contains("dense_ids"));
+  CHECK(dense.params.at("dense_ids") == "true");
+  CHECK(dense.configuration() != hashed.configuration());
+  CHECK(pending_sweep_records({dense}, {hashed}) == std::vector<size_t>{0});
+
+  // Only the caching benchmark replays dense IDs
+  const auto path = std::filesystem::temp_directory_path() / "test_sweep_spec.json";
+  spec.benchmark = "hm";
+  std::ofstream(path) << nlohmann::json(spec).dump();
+  CHECK_THROWS_AS(static_cast<void>(SweepSpec::load(path.string())), std::invalid_argument);
+  std::filesystem::remove(path);
+}
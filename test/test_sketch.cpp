@@ -0,0 +1,232 @@
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+#include "../src/sketch.hpp"
+
+namespace {
+
+// Halves the weight of past updates every 10 ticks of the decay clock
+auto half_life_10(const uint32_t t, const double alpha) -> float {
+  return static_cast<float>(std::exp(alpha * std::log(2.0) * static_cast<double>(t) / 10.0));
+}
+
+using HalfLife10 = decltype(&half_life_10);
+
+} // namespace
+
+TEST_CASE("[sketch] decay clock driven by timestamps") {
+  EvolvingSketch<uint64_t, HalfLife10> sketch(
+      1 << 16, {.initial_alpha = 1.0, .f = half_life_10, .clock = DecayClock::SECONDS});
+
+  for (int i = 0; i < 100; i++)
+    sketch.update_at(1, 1000);
+  CHECK(sketch.estimate(1) == doctest::Approx(100.0));
+
+  // A burst of unrelated traffic within the same second does not decay the history
+  for (uint64_t key = 2; key < 1000; key++)
+    sketch.update_at(key, 1000);
+  CHECK(sketch.estimate(1) >= doctest::Approx(100.0));
+
+  // Ten seconds later the history is worth half as much, regardless of how many updates happened
+  sketch.advance_to(1010);
+  CHECK(sketch.estimate(1) == doctest::Approx(50.0).epsilon(0.05));
+
+  // Out-of-order timestamps never move the clock backwards
+  sketch.update_at(1, 1005);
+  CHECK(sketch.estimate(1) == doctest::Approx(51.0).epsilon(0.05));
+}
+
+TEST_CASE("[sketch] weighted update") {
+  EvolvingSketch<uint64_t, HalfLife10> sketch(1 << 16, {.initial_alpha = 0.0, .f = half_life_10});
+
+  sketch.update(1, 250.0F);
+  for (int i = 0; i < 250; i++)
+    sketch.update(2);
+  CHECK(sketch.estimate(1) == doctest::Approx(250.0));
+  CHECK(sketch.estimate(1) == doctest::Approx(sketch.estimate(2)));
+
+  // A weight far beyond the safe pruning threshold saturates the counters, and as pruning cannot
+  // shrink counters when f(t) = 1, neither it nor the updates after it prune
+  sketch.update(3, 1e9F);
+  CHECK(sketch.estimate(3) == doctest::Approx(16777215.0));
+  CHECK(sketch.estimate(1) == doctest::Approx(250.0));
+  for (int i = 0; i < 100; i++)
+    sketch.update(3);
+  CHECK(sketch.estimate(3) == doctest::Approx(16777215.0));
+  CHECK(sketch.stats().overflow_prunes == 0);
+}
+
+TEST_CASE("[sketch] counters at the threshold prune while decaying") {
+  EvolvingSketch<uint64_t, HalfLife10> sketch(
+      1 << 16, {.initial_alpha = 1.0, .f = half_life_10, .clock = DecayClock::SECONDS});
+
+  // Landing exactly on the threshold saturates without a prune, as f(0) = 1
+  sketch.update_at(1, 1000, 16777215.0F);
+  CHECK(sketch.estimate(1) == doctest::Approx(16777215.0));
+  CHECK(sketch.stats().overflow_prunes == 0);
+
+  // Once f(t) = 2, a prune halves the saturated counters and makes room for further updates
+  sketch.advance_to(1010);
+  sketch.update_at(1, 1010, 1e6F);
+  CHECK(sketch.stats().overflow_prunes == 1);
+  CHECK(sketch.estimate(1) == doctest::Approx(16777215.0 / 2 + 1e6));
+  sketch.update_at(1, 1010, 1e6F);
+  CHECK(sketch.estimate(1) == doctest::Approx(16777215.0 / 2 + 2e6));
+  CHECK(sketch.stats().updates_per_overflow_prune == doctest::Approx(3.0));
+}
+
+TEST_CASE("[sketch] fused update-and-estimate and compare") {
+  EvolvingSketch<uint64_t, HalfLife10> sketch(1 << 16, {.initial_alpha = 1.0, .f = half_life_10});
+
+  for (int i = 0; i < 10; i++)
+    sketch.update(1);
+  const float fused = sketch.update_and_estimate(1);
+  CHECK(fused == doctest::Approx(sketch.estimate(1)));
+
+  sketch.update(2);
+  CHECK(sketch.compare(1, 2) > 0);
+  CHECK(sketch.compare(2, 1) < 0);
+  CHECK(sketch.compare(1, 1) == 0);
+}
+
+TEST_CASE("[sketch] memory budget sizing") {
+  const EvolvingSketch<uint64_t, HalfLife10> sketch(MemoryBudget{100'000},
+                                                    {.initial_alpha = 1.0, .f = half_life_10});
+  CHECK(sketch.footprint_bytes() <= 100'000);
+  CHECK(sketch.footprint_bytes() > 100'000 - 4 * sizeof(float));
+
+  EvolvingSketch<uint64_t, HalfLife10> odd(MemoryBudget{1'000'000},
+                                           {.initial_alpha = 0.0, .f = half_life_10});
+  for (uint64_t key = 0; key < 100; key++)
+    for (uint64_t i = 0; i <= key; i++)
+      odd.update(key);
+  for (uint64_t key = 0; key < 100; key++)
+    CHECK(odd.estimate(key) >= doctest::Approx(static_cast<double>(key + 1)));
+
+  CHECK_THROWS_AS((EvolvingSketch<uint64_t, HalfLife10>(MemoryBudget{8}, {.f = half_life_10})),
+                  std::invalid_argument);
+}
+
+TEST_CASE("[sketch] shrink and grow") {
+  EvolvingSketch<uint64_t, HalfLife10> sketch(MemoryBudget{40'000},
+                                              {.initial_alpha = 0.0, .f = half_life_10});
+  if (sketch.width() % 2 != 0)
+    sketch.grow();
+  for (uint64_t key = 0; key < 200; key++)
+    sketch.update(key, static_cast<float>(key));
+
+  float before[200];
+  for (uint64_t key = 0; key < 200; key++)
+    before[key] = sketch.estimate(key);
+
+  const size_t width = sketch.width();
+  sketch.shrink();
+  CHECK(sketch.width() == width / 2);
+  for (uint64_t key = 0; key < 200; key++)
+    CHECK(sketch.estimate(key) >= doctest::Approx(before[key]));
+
+  // Growing duplicates columns, so estimates after the round trip equal those of the halved sketch
+  float halved[200];
+  for (uint64_t key = 0; key < 200; key++)
+    halved[key] = sketch.estimate(key);
+  sketch.grow();
+  CHECK(sketch.width() == width);
+  for (uint64_t key = 0; key < 200; key++)
+    CHECK(sketch.estimate(key) == doctest::Approx(halved[key]));
+
+  // Odd widths are rehashed, adding columns that straddle two halved ones to both
+  EvolvingSketch<uint64_t, HalfLife10> odd(
+      MemoryBudget{sizeof(EvolvingSketch<uint64_t, HalfLife10>) + 4 * 7 * sizeof(float)},
+      {.initial_alpha = 0.0, .f = half_life_10});
+  REQUIRE(odd.width() == 7);
+  for (uint64_t key = 0; key < 20; key++)
+    odd.update(key, static_cast<float>(key));
+  odd.shrink();
+  CHECK(odd.width() == 3);
+  for (uint64_t key = 0; key < 20; key++)
+    CHECK(odd.estimate(key) >= doctest::Approx(static_cast<double>(key)));
+}
+
+TEST_CASE("[sketch] shrinking prunes folded counters beyond the threshold") {
+  EvolvingSketch<uint64_t, HalfLife10> sketch(
+      32, {.initial_alpha = 1.0, .f = half_life_10, .clock = DecayClock::SECONDS});
+  REQUIRE(sketch.width() == 8);
+  for (uint64_t key = 0; key < 64; key++)
+    sketch.update_at(key, 1000, 1.6e7F);
+
+  // Summing saturated columns doubles them, which a prune by f(10) = 2 brings back in range
+  sketch.advance_to(1010);
+  sketch.shrink();
+  CHECK(sketch.stats().overflow_prunes == 1);
+  CHECK(sketch.stats().t == 0);
+  for (const auto &row : sketch.stats().rows)
+    CHECK(row.max <= 16777215.0F);
+
+  // Updates no longer lower the folded counters to the threshold
+  const float folded = sketch.estimate(1);
+  sketch.update_at(1, 1010);
+  CHECK(sketch.estimate(1) >= folded);
+}
+
+TEST_CASE("[sketch] auto resize follows the load") {
+  EvolvingSketch<uint64_t, HalfLife10> sketch(
+      64, {.initial_alpha = 0.001,
+           .f = half_life_10,
+           .adapt_interval = 100,
+           .auto_resize = AutoResizePolicy{.min_width = 16, .max_width = 1024, .cooldown = 0}});
+  REQUIRE(sketch.width() == 16);
+
+  for (uint64_t i = 0; i < 100'000; i++)
+    sketch.update(i % 5000);
+  CHECK(sketch.width() == 1024);
+
+  for (uint64_t i = 0; i < 100'000; i++)
+    sketch.update(i % 2);
+  CHECK(sketch.width() == 16);
+}
+
+TEST_CASE("[sketch] health stats") {
+  EvolvingSketch<uint64_t, HalfLife10> sketch(
+      1 << 12, {.initial_alpha = 0.0, .f = half_life_10, .adapt_interval = 1000});
+  for (uint64_t i = 0; i < 10'000; i++)
+    sketch.update(i % 100);
+
+  const auto stats = sketch.stats();
+  CHECK(stats.updates == 10'000);
+  CHECK(stats.adapt_prunes == 10);
+  CHECK(stats.overflow_prunes == 0);
+  CHECK(stats.updates_per_overflow_prune == 0.0);
+  CHECK(stats.width == sketch.width());
+  CHECK(stats.footprint_bytes == sketch.footprint_bytes());
+  // 100 items cannot occupy more than 100 of the 1024 columns of each row
+  CHECK(stats.load > 0.0);
+  CHECK(stats.load <= 100.0 / 1024.0 + 0.05);
+  for (const auto &row : stats.rows) {
+    CHECK(row.p50 <= row.p99);
+    CHECK(row.max <= 10'000.0F);
+  }
+
+  // Without decay, a prune cannot make room for a weight beyond the threshold
+  sketch.update(1, 2e7F);
+  CHECK(sketch.stats().overflow_prunes == 0);
+}
+
+TEST_CASE("[sketch] seeded row hashes") {
+  // A sketch small enough for collisions, so that estimates depend on the row hashes
+  auto run = [](const std::optional<uint64_t> seed) {
+    EvolvingSketch<uint64_t, HalfLife10> sketch(64, {.f = half_life_10, .seed = seed});
+    for (uint64_t i = 0; i < 1000; i++)
+      sketch.update(i * i % 997);
+    std::vector<float> estimates;
+    for (uint64_t i = 0; i < 997; i++)
+      estimates.push_back(sketch.estimate(i));
+    return estimates;
+  };
+  CHECK(run(42) == run(42));
+  CHECK(run(42) != run(43));
+}
@@ -0,0 +1,25 @@
+#include <cstdint>
+
+#include <doctest/doctest.h>
+
+#include "../../src/utils/histogram.hpp"
+
+TEST_CASE("[histogram] quantiles within bucket resolution") {
+  LatencyHistogram<> histogram;
+  CHECK(histogram.value_at(0.5) == 0);
+
+  for (uint64_t value = 1; value <= 1000; value++)
+    histogram.record(value);
+  histogram.record(1'000'000);
+
+  CHECK(histogram.count() == 1001);
+  CHECK(histogram.max() == 1'000'000);
+  CHECK(histogram.value_at(0.5) == doctest::Approx(501).epsilon(0.0625));
+  CHECK(histogram.value_at(0.99) == doctest::Approx(991).epsilon(0.0625));
+  CHECK(histogram.value_at(1.0) == 1'000'000);
+
+  // Small values are recorded exactly
+  LatencyHistogram<> small;
+  small.record(3);
+  CHECK(small.value_at(0.5) == 3);
+}
@@ -0,0 +1,64 @@
+#include <cmath>
+#include <cstdint>
+
+#include <doctest/doctest.h>
+
+#include "../../src/sketch.hpp"
+#include "../../src/utils/oracle.hpp"
+
+namespace {
+
+auto f(const uint32_t t, const double alpha) -> float {
+  return static_cast<float>(std::exp(alpha * static_cast<double>(t) / 10.0));
+}
+
+} // namespace
+
+TEST_CASE("[oracle] exact decayed frequencies") {
+  DecayedFrequencyOracle<uint64_t, decltype(&f)> oracle(f, 1.0);
+  // Item 1 at t=1 and t=3, item 2 at t=2
+  oracle.update(1);
+  oracle.update(2);
+  oracle.update(1);
+  CHECK(oracle.size() == 2);
+  CHECK(oracle.estimate(3) == 0.0);
+
+  const double expected = std::exp(-2.0 / 10.0) + 1.0;
+  CHECK(std::abs(oracle.estimate(1) - expected) < 1e-6);
+  CHECK(std::abs(oracle.estimate(2) - std::exp(-1.0 / 10.0)) < 1e-6);
+
+  // Each alpha only decays the time it was in effect: item 1 ages by 1 at alpha 1, then by 2 at
+  // alpha 3, while item 2 is only updated after the change
+  oracle.set_alpha(3.0);
+  oracle.update(2);
+  oracle.update(4);
+  const double expected_1 = expected * std::exp(-2.0 * 3.0 / 10.0);
+  const double expected_2 = std::exp(-1.0 / 10.0) * std::exp(-2.0 * 3.0 / 10.0) +
+                            std::exp(-1.0 * 3.0 / 10.0);
+  CHECK(std::abs(oracle.estimate(1) - expected_1) < 1e-6);
+  CHECK(std::abs(oracle.estimate(2) - expected_2) < 1e-6);
+}
+
+TEST_CASE("[oracle] restarts of the clock keep frequencies") {
+  DecayedFrequencyOracle<uint64_t, decltype(&f)> oracle(f, 1.0);
+  // Long enough to restart the clock several times, with 1 updated every other time
+  for (uint64_t i = 0; i < 10'000; i++)
+    oracle.update(i % 2 == 0 ? 1 : i);
+  // The geometric series of the updates at even times, seen from an odd time
+  const double ratio = std::exp(-2.0 / 10.0);
+  const double expected = std::exp(-1.0 / 10.0) / (1.0 - ratio);
+  CHECK(std::abs(oracle.estimate(1) - expected) < 1e-6 * expected);
+}
+
+TEST_CASE("[oracle] sketch without collisions matches the oracle") {
+  EvolvingSketch<uint64_t, decltype(&f)> sketch(1 << 16, {.initial_alpha = 1.0, .f = f});
+  DecayedFrequencyOracle<uint64_t, decltype(&f)> oracle(f, 1.0);
+  for (uint64_t i = 0; i < 1000; i++) {
+    sketch.update(i % 7);
+    oracle.update(i % 7);
+  }
+  for (uint64_t i = 0; i < 7; i++) {
+    const double truth = oracle.estimate(i);
+    CHECK(std::abs(sketch.estimate(i) - truth) < 1e-3 * truth);
+  }
+}
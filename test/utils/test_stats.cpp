@@ -0,0 +1,22 @@
+#include <doctest/doctest.h>
+
+#include "../../src/utils/stats.hpp"
+
+TEST_CASE("[stats] counting stats") {
+  const CountingStats stats;
+  for (int i = 0; i < 10; i++) {
+    [[maybe_unused]] const auto scope = stats.measure(SketchOp::UPDATE);
+  }
+  CHECK(stats.calls(SketchOp::UPDATE) == 10);
+  CHECK(stats.calls(SketchOp::ESTIMATE) == 0);
+}
+
+TEST_CASE("[stats] sampled cycle stats") {
+  const SampledCycleStats<1> stats;
+  for (int i = 0; i < 10; i++) {
+    [[maybe_unused]] const auto scope = stats.measure(SketchOp::ESTIMATE);
+  }
+  CHECK(stats.calls(SketchOp::ESTIMATE) == 10);
+  CHECK(stats.avg_seconds(SketchOp::ESTIMATE) > 0.0);
+  CHECK(stats.avg_seconds(SketchOp::UPDATE) == 0.0);
+}
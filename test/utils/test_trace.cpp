@@ -0,0 +1,60 @@
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <doctest/doctest.h>
+
+#include "../../src/sketch.hpp"
+#include "../../src/utils/trace.hpp"
+
+TEST_CASE("[trace] ring keeps the most recent events") {
+  EventTrace trace(4);
+  for (uint64_t i = 0; i < 6; i++)
+    trace.record({.type = SketchEventType::PRUNE_OVERFLOW,
+                  .start_ns = i,
+                  .duration_ns = 1,
+                  .counters = 0,
+                  .old_alpha = 1.0,
+                  .new_alpha = 1.0});
+  CHECK(trace.size() == 4);
+  CHECK(trace.dropped() == 2);
+
+  std::vector<uint64_t> starts;
+  trace.for_each([&](const SketchEvent &event) { starts.push_back(event.start_ns); });
+  const std::vector<uint64_t> expected{2, 3, 4, 5};
+  CHECK(starts == expected);
+}
+
+TEST_CASE("[trace] sketch records prunes and adaptations") {
+  auto f = [](const uint32_t t, const double alpha) -> float {
+    return static_cast<float>(std::exp(alpha * static_cast<double>(t) / 10.0));
+  };
+  EventTrace trace(1024);
+  EvolvingSketch<uint64_t, decltype(f)> sketch(
+      64, {.initial_alpha = 1.0, .f = f, .adapt_interval = 10, .events = &trace});
+  for (uint64_t i = 0; i < 100; i++)
+    sketch.update(i);
+
+  size_t prunes = 0;
+  size_t adapts = 0;
+  trace.for_each([&](const SketchEvent &event) {
+    if (event.type == SketchEventType::PRUNE_ADAPT) {
+      CHECK(event.counters == 4 * sketch.width());
+      prunes++;
+    }
+    if (event.type == SketchEventType::ADAPT) {
+      // The identity adapter keeps alpha and sees no numeric objective
+      CHECK(event.new_alpha == event.old_alpha);
+      CHECK(std::isnan(event.objective));
+      adapts++;
+    }
+  });
+  CHECK(prunes == 10);
+  CHECK(adapts == 10);
+
+  // Copies do not record into the trace of the original
+  auto copy = sketch;
+  for (uint64_t i = 0; i < 100; i++)
+    copy.update(i);
+  CHECK(trace.size() == 20);
+}